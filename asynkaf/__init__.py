@@ -1,3 +1,5 @@
-from .consumer import Consumer
+from ._core import Poller
+from .consumer import Consumer, PartitionConsumer
+from .producer import Producer
 
-__all__ = ["Consumer"]
\ No newline at end of file
+__all__ = ["Consumer", "PartitionConsumer", "Poller", "Producer"]
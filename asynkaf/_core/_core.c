@@ -1,5 +1,13 @@
 #include <Python.h>
+#include "awaitable.h"
+#include "columnar.h"
 #include "consumer.h"
+#include "errors.h"
+#include "futures.h"
+#include "message.h"
+#include "partition.h"
+#include "poller.h"
+#include "producer.h"
 
 /**
  * @brief Defines the methods available in the `_core` module.
@@ -9,49 +17,109 @@
  * the calling convention, and a docstring.
  */
 static PyMethodDef core_methods[] = {
-    {"create_consumer", create_consumer, METH_VARARGS, "Create a new Kafka consumer."},
+    {"create_consumer", (PyCFunction)(void(*)(void))create_consumer, METH_VARARGS | METH_KEYWORDS, "Create a new Kafka consumer."},
+    {"create_producer", (PyCFunction)(void(*)(void))create_producer, METH_VARARGS | METH_KEYWORDS, "Create a new Kafka producer."},
     {NULL, NULL, 0, NULL}  // Sentinel to indicate the end of the method table.
 };
 
+/**
+ * @brief Populates a freshly created `_core` module.
+ *
+ * Called through the Py_mod_exec slot. It prepares the custom ConsumerType,
+ * ProducerType, MessageType, PartitionQueueType, PollerType, the
+ * columnar batch types and CompletedType, and adds the types and
+ * the KafkaError exception to the module's namespace.
+ *
+ * @param m The module being initialized.
+ * @return 0 on success, -1 with an exception set on failure.
+ */
+static int core_exec(PyObject *m) {
+    // Finalize the type objects, preparing them for use.
+    if (PyType_Ready(&ConsumerType) < 0)
+        return -1;
+    if (PyType_Ready(&ProducerType) < 0)
+        return -1;
+    if (PyType_Ready(&MessageType) < 0)
+        return -1;
+    if (PyType_Ready(&PartitionQueueType) < 0)
+        return -1;
+    if (PyType_Ready(&PollerType) < 0)
+        return -1;
+    if (PyType_Ready(&ColumnType) < 0)
+        return -1;
+    if (PyType_Ready(&ColumnarBatchType) < 0)
+        return -1;
+    if (PyType_Ready(&CompletedType) < 0)
+        return -1;
+    if (futures_init() < 0)
+        return -1;
+
+    // Add the types to the module.
+    if (PyModule_AddObjectRef(m, "Consumer", (PyObject *)&ConsumerType) < 0)
+        return -1;
+    if (PyModule_AddObjectRef(m, "Producer", (PyObject *)&ProducerType) < 0)
+        return -1;
+    if (PyModule_AddObjectRef(m, "Message", (PyObject *)&MessageType) < 0)
+        return -1;
+    if (PyModule_AddObjectRef(m, "PartitionQueue", (PyObject *)&PartitionQueueType) < 0)
+        return -1;
+    if (PyModule_AddObjectRef(m, "Poller", (PyObject *)&PollerType) < 0)
+        return -1;
+    if (PyModule_AddObjectRef(m, "Column", (PyObject *)&ColumnType) < 0)
+        return -1;
+    if (PyModule_AddObjectRef(m, "ColumnarBatch", (PyObject *)&ColumnarBatchType) < 0)
+        return -1;
+    if (PyModule_AddObjectRef(m, "Completed", (PyObject *)&CompletedType) < 0)
+        return -1;
+
+    return errors_init(m);
+}
+
+/**
+ * @brief Module slots.
+ *
+ * The extension does not rely on the GIL: state shared with the background
+ * threads is atomic or lock-protected, and the pop paths may be entered
+ * from several Python threads at once. Free-threaded builds can therefore
+ * import it without re-enabling the GIL.
+ */
+static PyModuleDef_Slot core_slots[] = {
+    {Py_mod_exec, core_exec},
+#ifdef Py_mod_multiple_interpreters
+    // The types and the KafkaError class are process-wide statics.
+    {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_NOT_SUPPORTED},
+#endif
+#ifdef Py_mod_gil
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL}  // Sentinel
+};
+
 /**
  * @brief Defines the `_core` module.
  *
  * This structure contains all the information needed to create the module object.
- * It includes the module's name, docstring, and a reference to its method table.
+ * It includes the module's name, docstring, a reference to its method table
+ * and the slots run by multi-phase initialization.
  */
 static struct PyModuleDef core_module = {
     PyModuleDef_HEAD_INIT,
-    "_core",                             // Module name
-    "Core Kafka client functionality.",  // Module docstring
-    -1,                                  // Module state size (-1 for global state)
-    core_methods                         // Method table
+    .m_name = "_core",
+    .m_doc = "Core Kafka client functionality.",
+    .m_size = 0,                         // No per-module state
+    .m_methods = core_methods,
+    .m_slots = core_slots,
 };
 
 /**
  * @brief Initializes the `_core` module.
  *
- * This function is called by the Python interpreter when the module is imported.
- * It prepares the custom ConsumerType, creates the module, and adds the
- * Consumer type to the module's namespace.
+ * This function is called by the Python interpreter when the module is
+ * imported. It returns the module definition; the interpreter then creates
+ * the module and runs core_exec().
  *
- * @return A new PyObject representing the initialized module, or NULL on failure.
+ * @return The module definition, or NULL on failure.
  */
 PyMODINIT_FUNC PyInit__core(void) {
-    PyObject *m;
-
-    // Finalize the ConsumerType object, preparing it for use.
-    if (PyType_Ready(&ConsumerType) < 0)
-        return NULL;
-
-    // Create the module object.
-    m = PyModule_Create(&core_module);
-    if (m == NULL)
-        return NULL;
-
-    // Add the Consumer type to the module.
-    // Py_INCREF is necessary because PyModule_AddObject steals a reference.
-    Py_INCREF(&ConsumerType);
-    PyModule_AddObject(m, "Consumer", (PyObject *)&ConsumerType);
-
-    return m;
+    return PyModuleDef_Init(&core_module);
 }
@@ -0,0 +1,133 @@
+#include <Python.h>
+#include "awaitable.h"
+
+/**
+ * @brief Creates an awaitable that completes with `value`.
+ */
+PyObject *completed_new(PyObject *value) {
+    CompletedObject *self = PyObject_New(CompletedObject, &CompletedType);
+    if (!self) {
+        Py_XDECREF(value);
+        return NULL;
+    }
+    self->value = value;
+    self->awaited = 0;
+    return (PyObject *)self;
+}
+
+/**
+ * @brief Deallocates a Completed object.
+ */
+static void
+Completed_dealloc(CompletedObject *self) {
+    Py_XDECREF(self->value);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Returns the object itself as its own iterator (`__await__`).
+ */
+static PyObject *
+Completed_await(CompletedObject *self) {
+    return Py_NewRef(self);
+}
+
+/**
+ * @brief Delivers the outcome on the first send.
+ *
+ * This is the path `await` and asyncio tasks take: the result comes back
+ * through `*result` without raising StopIteration.
+ */
+static PySendResult
+Completed_send(CompletedObject *self, PyObject *Py_UNUSED(arg), PyObject **result) {
+    if (self->awaited) {
+        PyErr_SetString(PyExc_RuntimeError, "cannot reuse already awaited __anext__()");
+        *result = NULL;
+        return PYGEN_ERROR;
+    }
+    self->awaited = 1;
+    if (!self->value) {
+        PyErr_SetNone(PyExc_StopAsyncIteration);
+        *result = NULL;
+        return PYGEN_ERROR;
+    }
+    *result = self->value;
+    self->value = NULL;
+    return PYGEN_RETURN;
+}
+
+/**
+ * @brief Delivers the outcome through the iterator protocol.
+ *
+ * Used by callers that step the awaitable with `__next__()`; the result is
+ * raised as StopIteration, as a finished coroutine does.
+ */
+static PyObject *
+Completed_iternext(CompletedObject *self) {
+    PyObject *value;
+    if (Completed_send(self, Py_None, &value) == PYGEN_ERROR) {
+        return NULL;
+    }
+    // Wrap the value so tuples and exceptions are not unpacked.
+    PyObject *stop = PyObject_CallOneArg(PyExc_StopIteration, value);
+    Py_DECREF(value);
+    if (stop) {
+        PyErr_SetObject(PyExc_StopIteration, stop);
+        Py_DECREF(stop);
+    }
+    return NULL;
+}
+
+/**
+ * @brief `send(value)`, for callers that drive awaitables by hand.
+ */
+static PyObject *
+Completed_send_method(CompletedObject *self, PyObject *Py_UNUSED(arg)) {
+    return Completed_iternext(self);
+}
+
+/**
+ * @brief `close()`: nothing is pending, so there is nothing to clean up.
+ */
+static PyObject *
+Completed_close(CompletedObject *self, PyObject *Py_UNUSED(ignored)) {
+    self->awaited = 1;
+    Py_CLEAR(self->value);
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Defines the methods available on Completed objects.
+ */
+static PyMethodDef Completed_methods[] = {
+    {"send", (PyCFunction)Completed_send_method, METH_O, "Deliver the outcome."},
+    {"close", (PyCFunction)Completed_close, METH_NOARGS, "Drop the outcome."},
+    {NULL, NULL, 0, NULL}  // Sentinel
+};
+
+/**
+ * @brief Async slots: the object is awaitable and steps with am_send.
+ */
+static PyAsyncMethods Completed_as_async = {
+    .am_await = (unaryfunc)Completed_await,
+    .am_send = (sendfunc)Completed_send,
+};
+
+/**
+ * @brief Defines the Python type object for Completed.
+ *
+ * Only created by the C code, so there is no `__new__`.
+ */
+PyTypeObject CompletedType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_core.Completed",
+    .tp_doc = "Awaitable whose result is already available",
+    .tp_basicsize = sizeof(CompletedObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)Completed_dealloc,
+    .tp_as_async = &Completed_as_async,
+    .tp_iter = (getiterfunc)Completed_await,
+    .tp_iternext = (iternextfunc)Completed_iternext,
+    .tp_methods = Completed_methods,
+};
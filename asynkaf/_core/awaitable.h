@@ -0,0 +1,35 @@
+#ifndef ASYNKAF_AWAITABLE_H
+#define ASYNKAF_AWAITABLE_H
+
+#include <Python.h>
+
+/**
+ * @brief An awaitable whose outcome is known when it is created.
+ *
+ * Awaiting it returns `value` at once, or raises StopAsyncIteration if
+ * `value` is NULL, without suspending the awaiting task: there is no
+ * asyncio Future and nothing is scheduled on the event loop. It backs
+ * `__anext__` calls that find a message already buffered.
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject *value;          // The result, or NULL for StopAsyncIteration.
+    int awaited;              // Set once the outcome has been delivered.
+} CompletedObject;
+
+/**
+ * @brief External declaration of the CompletedType object.
+ */
+extern PyTypeObject CompletedType;
+
+/**
+ * @brief Creates an awaitable that completes with `value`.
+ *
+ * @param value The result, stolen; NULL makes awaiting it raise
+ *        StopAsyncIteration.
+ * @return A new reference, or NULL with an exception set (`value` is
+ *         released).
+ */
+PyObject *completed_new(PyObject *value);
+
+#endif
@@ -0,0 +1,401 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "columnar.h"
+
+/**
+ * @brief Allocates a zero-filled column of `length` items.
+ *
+ * At least one byte is allocated, so even an empty column exports a valid
+ * pointer.
+ *
+ * @return A new reference, or NULL with a MemoryError set.
+ */
+static ColumnObject *column_new(const char *format, Py_ssize_t itemsize, Py_ssize_t length) {
+    ColumnObject *self = PyObject_New(ColumnObject, &ColumnType);
+    if (!self) {
+        return NULL;
+    }
+    size_t size = (size_t)length * (size_t)itemsize;
+    self->data = PyMem_RawCalloc(size ? size : 1, 1);
+    self->length = length;
+    self->itemsize = itemsize;
+    self->format = format;
+    if (!self->data) {
+        Py_DECREF(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    return self;
+}
+
+/**
+ * @brief Frees a Column; exported buffers hold a reference, so none is left.
+ */
+static void
+Column_dealloc(ColumnObject *self) {
+    PyMem_RawFree(self->data);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Exports the column through the buffer protocol.
+ */
+static int
+Column_getbuffer(ColumnObject *self, Py_buffer *view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "Column is read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    view->obj = Py_NewRef(self);
+    view->buf = self->data;
+    view->len = self->length * self->itemsize;
+    view->readonly = 1;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char *)self->format : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &self->length : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &self->itemsize : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+/**
+ * @brief Returns the number of items.
+ */
+static Py_ssize_t
+Column_length(ColumnObject *self) {
+    return self->length;
+}
+
+/**
+ * @brief Returns a short description of the column.
+ */
+static PyObject *
+Column_repr(ColumnObject *self) {
+    return PyUnicode_FromFormat("<Column format=%s length=%zd>", self->format, self->length);
+}
+
+/**
+ * @brief Buffer protocol slots of Column objects.
+ */
+static PyBufferProcs Column_as_buffer = {
+    .bf_getbuffer = (getbufferproc)Column_getbuffer,
+};
+
+/**
+ * @brief Sequence slots of Column objects.
+ */
+static PySequenceMethods Column_as_sequence = {
+    .sq_length = (lenfunc)Column_length,
+};
+
+/**
+ * @brief Defines the Python type object for the Column.
+ *
+ * Columns are only created by getmany_columnar(), so there is no `__new__`.
+ */
+PyTypeObject ColumnType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_core.Column",
+    .tp_doc = "A read-only typed array exported through the buffer protocol",
+    .tp_basicsize = sizeof(ColumnObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)Column_dealloc,
+    .tp_repr = (reprfunc)Column_repr,
+    .tp_as_buffer = &Column_as_buffer,
+    .tp_as_sequence = &Column_as_sequence,
+};
+
+/**
+ * @brief Returns the index of `rkt` in `topics`, appending it if new.
+ *
+ * Consumers read few topics, so a linear scan beats hashing.
+ *
+ * @return The index, or -1 with a MemoryError set.
+ */
+static int32_t topic_index(rd_kafka_topic_t ***topics, size_t *count, size_t *capacity,
+                           rd_kafka_topic_t *rkt) {
+    for (size_t i = *count; i > 0; i--) {
+        if ((*topics)[i - 1] == rkt) {
+            return (int32_t)(i - 1);
+        }
+    }
+    if (*count == *capacity) {
+        size_t grown_capacity = *capacity ? *capacity * 2 : 4;
+        rd_kafka_topic_t **grown = PyMem_RawRealloc(*topics, grown_capacity * sizeof(rd_kafka_topic_t *));
+        if (!grown) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        *topics = grown;
+        *capacity = grown_capacity;
+    }
+    (*topics)[*count] = rkt;
+    return (int32_t)(*count)++;
+}
+
+/**
+ * @brief Copies messages into a new ColumnarBatch and destroys them.
+ *
+ * A first pass sizes the buffers and collects the topics; the columns are
+ * then allocated once each and filled, and the messages destroyed, with the
+ * GIL released.
+ *
+ * @return A new reference, or NULL with an exception set. The messages are
+ *         destroyed either way.
+ */
+static PyObject *columnar_batch_new(rd_kafka_message_t **messages, size_t count) {
+    ColumnarBatchObject *batch = NULL;
+    rd_kafka_topic_t **topics = NULL;
+    size_t topic_count = 0;
+    size_t topic_capacity = 0;
+    size_t value_bytes = 0;
+    size_t key_bytes = 0;
+    int value_nulls = 0;
+    int key_nulls = 0;
+    Py_ssize_t n = (Py_ssize_t)count;
+    Py_ssize_t bitmap_bytes = (n + 7) / 8;
+
+    for (size_t i = 0; i < count; i++) {
+        if (messages[i]->payload) {
+            value_bytes += messages[i]->len;
+        } else {
+            value_nulls = 1;
+        }
+        if (messages[i]->key) {
+            key_bytes += messages[i]->key_len;
+        } else {
+            key_nulls = 1;
+        }
+        if (topic_index(&topics, &topic_count, &topic_capacity, messages[i]->rkt) < 0) {
+            goto fail;
+        }
+    }
+
+    batch = PyObject_New(ColumnarBatchObject, &ColumnarBatchType);
+    if (!batch) {
+        goto fail;
+    }
+    batch->count = n;
+    batch->values = (PyObject *)column_new("B", 1, (Py_ssize_t)value_bytes);
+    batch->value_offsets = (PyObject *)column_new("q", sizeof(int64_t), n + 1);
+    batch->value_validity = value_nulls ? (PyObject *)column_new("B", 1, bitmap_bytes) : Py_NewRef(Py_None);
+    batch->keys = (PyObject *)column_new("B", 1, (Py_ssize_t)key_bytes);
+    batch->key_offsets = (PyObject *)column_new("q", sizeof(int64_t), n + 1);
+    batch->key_validity = key_nulls ? (PyObject *)column_new("B", 1, bitmap_bytes) : Py_NewRef(Py_None);
+    batch->offsets = (PyObject *)column_new("q", sizeof(int64_t), n);
+    batch->partitions = (PyObject *)column_new("q", sizeof(int64_t), n);
+    batch->timestamps = (PyObject *)column_new("q", sizeof(int64_t), n);
+    batch->topic_ids = (PyObject *)column_new("i", sizeof(int32_t), n);
+    batch->topics = PyTuple_New((Py_ssize_t)topic_count);
+    if (!batch->values || !batch->value_offsets || !batch->value_validity ||
+        !batch->keys || !batch->key_offsets || !batch->key_validity ||
+        !batch->offsets || !batch->partitions || !batch->timestamps ||
+        !batch->topic_ids || !batch->topics) {
+        goto fail;
+    }
+    for (size_t t = 0; t < topic_count; t++) {
+        PyObject *name = PyUnicode_FromString(rd_kafka_topic_name(topics[t]));
+        if (!name) {
+            goto fail;
+        }
+        PyTuple_SET_ITEM(batch->topics, (Py_ssize_t)t, name);
+    }
+
+    uint8_t *values = ((ColumnObject *)batch->values)->data;
+    int64_t *value_offsets = ((ColumnObject *)batch->value_offsets)->data;
+    uint8_t *value_validity = value_nulls ? ((ColumnObject *)batch->value_validity)->data : NULL;
+    uint8_t *keys = ((ColumnObject *)batch->keys)->data;
+    int64_t *key_offsets = ((ColumnObject *)batch->key_offsets)->data;
+    uint8_t *key_validity = key_nulls ? ((ColumnObject *)batch->key_validity)->data : NULL;
+    int64_t *offsets = ((ColumnObject *)batch->offsets)->data;
+    int64_t *partitions = ((ColumnObject *)batch->partitions)->data;
+    int64_t *timestamps = ((ColumnObject *)batch->timestamps)->data;
+    int32_t *topic_ids = ((ColumnObject *)batch->topic_ids)->data;
+
+    Py_BEGIN_ALLOW_THREADS
+    size_t value_pos = 0;
+    size_t key_pos = 0;
+    int32_t topic = 0;
+    for (size_t i = 0; i < count; i++) {
+        rd_kafka_message_t *message = messages[i];
+        value_offsets[i] = (int64_t)value_pos;
+        if (message->payload) {
+            memcpy(values + value_pos, message->payload, message->len);
+            value_pos += message->len;
+            if (value_validity) {
+                value_validity[i / 8] |= (uint8_t)(1u << (i % 8));
+            }
+        }
+        key_offsets[i] = (int64_t)key_pos;
+        if (message->key) {
+            memcpy(keys + key_pos, message->key, message->key_len);
+            key_pos += message->key_len;
+            if (key_validity) {
+                key_validity[i / 8] |= (uint8_t)(1u << (i % 8));
+            }
+        }
+        offsets[i] = message->offset;
+        partitions[i] = message->partition;
+        timestamps[i] = rd_kafka_message_timestamp(message, NULL);
+        // Runs of one topic are the norm; only rescan when it changes.
+        if (topics[topic] != message->rkt) {
+            for (topic = 0; topics[topic] != message->rkt; topic++) {
+            }
+        }
+        topic_ids[i] = topic;
+        rd_kafka_message_destroy(message);
+    }
+    value_offsets[count] = (int64_t)value_pos;
+    key_offsets[count] = (int64_t)key_pos;
+    Py_END_ALLOW_THREADS
+
+    PyMem_RawFree(topics);
+    return (PyObject *)batch;
+
+fail:
+    Py_XDECREF(batch);
+    for (size_t i = 0; i < count; i++) {
+        rd_kafka_message_destroy(messages[i]);
+    }
+    PyMem_RawFree(topics);
+    return NULL;
+}
+
+/**
+ * @brief Pops up to `max_records` messages into a new ColumnarBatch.
+ */
+PyObject *columnar_batch_drain(MessageQueue *queue, Wakeup *wakeup, MessageScratch *scratch,
+                               size_t max_records) {
+    rd_kafka_message_t **messages;
+    Py_ssize_t count = message_scratch_pop(queue, wakeup, scratch, max_records, &messages, NULL);
+    if (count < 0) {
+        return NULL;
+    }
+    PyObject *batch = columnar_batch_new(messages, (size_t)count);
+    message_scratch_release(scratch, messages);
+    return batch;
+}
+
+/**
+ * @brief Records the offset of every message in a batch. Requires the table lock.
+ */
+int columnar_batch_store_offsets(ColumnarBatchObject *batch, OffsetTable *table) {
+    const int64_t *offsets = ((ColumnObject *)batch->offsets)->data;
+    const int64_t *partitions = ((ColumnObject *)batch->partitions)->data;
+    const int32_t *topic_ids = ((ColumnObject *)batch->topic_ids)->data;
+    const char *topic = NULL;
+    int32_t topic_id = -1;
+    for (Py_ssize_t i = 0; i < batch->count; i++) {
+        if (topic_ids[i] != topic_id) {
+            topic_id = topic_ids[i];
+            topic = PyUnicode_AsUTF8(PyTuple_GET_ITEM(batch->topics, topic_id));
+            if (!topic) {
+                return -1;
+            }
+        }
+        if (offset_table_store_locked(table, topic, (int32_t)partitions[i], offsets[i]) != 0) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Releases every column of a ColumnarBatch.
+ *
+ * Also used on a batch whose construction failed half-way.
+ */
+static void
+ColumnarBatch_dealloc(ColumnarBatchObject *self) {
+    Py_XDECREF(self->values);
+    Py_XDECREF(self->value_offsets);
+    Py_XDECREF(self->value_validity);
+    Py_XDECREF(self->keys);
+    Py_XDECREF(self->key_offsets);
+    Py_XDECREF(self->key_validity);
+    Py_XDECREF(self->offsets);
+    Py_XDECREF(self->partitions);
+    Py_XDECREF(self->timestamps);
+    Py_XDECREF(self->topic_ids);
+    Py_XDECREF(self->topics);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Returns the field at the byte offset given as `closure`.
+ */
+static PyObject *
+ColumnarBatch_get_field(ColumnarBatchObject *self, void *closure) {
+    return Py_NewRef(*(PyObject **)((char *)self + (size_t)closure));
+}
+
+/**
+ * @brief Returns the number of messages.
+ */
+static Py_ssize_t
+ColumnarBatch_length(ColumnarBatchObject *self) {
+    return self->count;
+}
+
+/**
+ * @brief Returns a short description of the batch.
+ */
+static PyObject *
+ColumnarBatch_repr(ColumnarBatchObject *self) {
+    return PyUnicode_FromFormat("<ColumnarBatch messages=%zd value_bytes=%zd>",
+                                self->count, ((ColumnObject *)self->values)->length);
+}
+
+#define COLUMNAR_FIELD(name, doc) \
+    {#name, (getter)ColumnarBatch_get_field, NULL, doc, (void *)offsetof(ColumnarBatchObject, name)}
+
+/**
+ * @brief Attribute accessors for ColumnarBatch objects.
+ */
+static PyGetSetDef ColumnarBatch_getset[] = {
+    COLUMNAR_FIELD(values, "Payloads concatenated, as bytes."),
+    COLUMNAR_FIELD(value_offsets, "int64 start of each payload in values, plus the end."),
+    COLUMNAR_FIELD(value_validity, "Bitmap of non-null payloads, or None if none are null."),
+    COLUMNAR_FIELD(keys, "Keys concatenated, as bytes."),
+    COLUMNAR_FIELD(key_offsets, "int64 start of each key in keys, plus the end."),
+    COLUMNAR_FIELD(key_validity, "Bitmap of non-null keys, or None if none are null."),
+    COLUMNAR_FIELD(offsets, "int64 offset of each message."),
+    COLUMNAR_FIELD(partitions, "int64 partition of each message."),
+    COLUMNAR_FIELD(timestamps, "int64 timestamp in ms of each message, -1 if unknown."),
+    COLUMNAR_FIELD(topic_ids, "int32 index into topics of each message."),
+    COLUMNAR_FIELD(topics, "Tuple of the distinct topic names."),
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Sequence slots of ColumnarBatch objects.
+ */
+static PySequenceMethods ColumnarBatch_as_sequence = {
+    .sq_length = (lenfunc)ColumnarBatch_length,
+};
+
+/**
+ * @brief Defines the Python type object for the ColumnarBatch.
+ *
+ * Batches are only created by getmany_columnar(), so there is no `__new__`.
+ */
+PyTypeObject ColumnarBatchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_core.ColumnarBatch",
+    .tp_doc = "A batch of messages as Arrow-compatible columns",
+    .tp_basicsize = sizeof(ColumnarBatchObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)ColumnarBatch_dealloc,
+    .tp_repr = (reprfunc)ColumnarBatch_repr,
+    .tp_as_sequence = &ColumnarBatch_as_sequence,
+    .tp_getset = ColumnarBatch_getset,
+};
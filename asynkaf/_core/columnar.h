@@ -0,0 +1,79 @@
+#ifndef ASYNKAF_COLUMNAR_H
+#define ASYNKAF_COLUMNAR_H
+
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include "message.h"
+#include "offsets.h"
+#include "queue.h"
+#include "wakeup.h"
+
+/**
+ * @brief One column of a ColumnarBatch: a read-only typed array.
+ *
+ * Exported through the buffer protocol with a struct-module format (`B`,
+ * `i` or `q`) and a 1-D shape, so `memoryview`, `numpy.frombuffer` and
+ * `pyarrow.py_buffer` use the memory in place.
+ */
+typedef struct {
+    PyObject_HEAD
+    void *data;               // Owned storage, never resized.
+    Py_ssize_t length;        // Number of items.
+    Py_ssize_t itemsize;      // Bytes per item.
+    const char *format;       // Struct-module format of one item.
+} ColumnObject;
+
+/**
+ * @brief A batch of messages laid out as Arrow-compatible columns.
+ *
+ * Payloads and keys are concatenated into one `values` / `keys` buffer each,
+ * delimited by `count + 1` int64 `value_offsets` / `key_offsets`, as an Arrow
+ * `large_binary` array stores them. Null payloads and keys are marked in
+ * LSB-first validity bitmaps, which are None when nothing is null. Offsets,
+ * partitions and timestamps are int64 columns, and topics are dictionary
+ * encoded: `topic_ids` (int32) index the `topics` tuple.
+ */
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t count;         // Number of messages.
+    PyObject *values;         // Column of concatenated payload bytes.
+    PyObject *value_offsets;  // Column of int64 payload boundaries.
+    PyObject *value_validity; // Column bitmap of non-null payloads, or None.
+    PyObject *keys;           // Column of concatenated key bytes.
+    PyObject *key_offsets;    // Column of int64 key boundaries.
+    PyObject *key_validity;   // Column bitmap of non-null keys, or None.
+    PyObject *offsets;        // Column of int64 message offsets.
+    PyObject *partitions;     // Column of int64 partition numbers.
+    PyObject *timestamps;     // Column of int64 timestamps in ms (-1 if unknown).
+    PyObject *topic_ids;      // Column of int32 indices into `topics`.
+    PyObject *topics;         // Tuple of the distinct topic names.
+} ColumnarBatchObject;
+
+extern PyTypeObject ColumnType;
+extern PyTypeObject ColumnarBatchType;
+
+/**
+ * @brief Pops up to `max_records` messages into a new ColumnarBatch.
+ *
+ * Pops like message_list_drain(), then copies the messages into the batch's
+ * columns and destroys them, so the batch costs a dozen allocations however
+ * many messages it holds.
+ *
+ * @param queue The queue to drain.
+ * @param wakeup The queue's Wakeup.
+ * @param scratch Scratch array to pop into.
+ * @param max_records Maximum number of messages to take (>= 1).
+ * @return A new ColumnarBatch, possibly empty, or NULL with an exception set.
+ */
+PyObject *columnar_batch_drain(MessageQueue *queue, Wakeup *wakeup, MessageScratch *scratch,
+                               size_t max_records);
+
+/**
+ * @brief Records the offset of every message in a batch. Requires the table lock.
+ * @param batch A ColumnarBatch.
+ * @param table The offset table to store into.
+ * @return 0 on success, -1 with an exception set.
+ */
+int columnar_batch_store_offsets(ColumnarBatchObject *batch, OffsetTable *table);
+
+#endif
@@ -0,0 +1,187 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <string.h>
+#include "conf.h"
+
+/**
+ * @brief Sets an integer librdkafka property if the caller supplied one.
+ *
+ * @return 0 on success (or if `value` is negative, i.e. unset), -1 with a
+ *         ValueError set on failure.
+ */
+int conf_set_optional_int(rd_kafka_conf_t *conf, const char *name, long long value) {
+    char errstr[512];
+    char buf[32];
+    if (value < 0) {
+        return 0;
+    }
+    snprintf(buf, sizeof(buf), "%lld", value);
+    if (rd_kafka_conf_set(conf, name, buf, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+        PyErr_SetString(PyExc_ValueError, errstr);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts a config value to the string librdkafka expects.
+ *
+ * @return A new reference to a str, or NULL with a TypeError set.
+ */
+static PyObject *conf_value_str(PyObject *value) {
+    if (PyBool_Check(value)) {
+        return PyUnicode_FromString(value == Py_True ? "true" : "false");
+    }
+    if (PyUnicode_Check(value)) {
+        return Py_NewRef(value);
+    }
+    if (PyLong_Check(value) || PyFloat_Check(value)) {
+        return PyObject_Str(value);
+    }
+    PyErr_Format(PyExc_TypeError, "config values must be str, int, float or bool, not %.100s",
+                 Py_TYPE(value)->tp_name);
+    return NULL;
+}
+
+/**
+ * @brief Returns whether `name` is one of the NULL-terminated `reserved` names.
+ */
+static int conf_is_reserved(const char *name, const char *const *reserved) {
+    for (; reserved && *reserved; reserved++) {
+        if (strcmp(name, *reserved) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Records that `key` was rejected with `reason`.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int conf_add_error(PyObject *errors, PyObject *key, const char *reason) {
+    PyObject *text = PyUnicode_FromString(reason);
+    if (!text) {
+        return -1;
+    }
+    int rc = PyDict_SetItem(errors, key, text);
+    Py_DECREF(text);
+    return rc;
+}
+
+/**
+ * @brief Raises the ValueError describing every rejected key.
+ */
+static void conf_raise_errors(PyObject *errors) {
+    PyObject *parts = PyList_New(0);
+    PyObject *key;
+    PyObject *reason;
+    Py_ssize_t pos = 0;
+    if (!parts) {
+        return;
+    }
+    while (PyDict_Next(errors, &pos, &key, &reason)) {
+        PyObject *part = PyUnicode_FromFormat("%U: %U", key, reason);
+        if (!part || PyList_Append(parts, part) < 0) {
+            Py_XDECREF(part);
+            Py_DECREF(parts);
+            return;
+        }
+        Py_DECREF(part);
+    }
+    PyObject *sep = PyUnicode_FromString("; ");
+    PyObject *joined = sep ? PyUnicode_Join(sep, parts) : NULL;
+    Py_XDECREF(sep);
+    Py_DECREF(parts);
+    if (!joined) {
+        return;
+    }
+    PyObject *exc = PyObject_CallFunction(PyExc_ValueError, "U", joined);
+    Py_DECREF(joined);
+    if (!exc) {
+        return;
+    }
+    if (PyObject_SetAttrString(exc, "errors", errors) == 0) {
+        PyErr_SetObject(PyExc_ValueError, exc);
+    }
+    Py_DECREF(exc);
+}
+
+/**
+ * @brief Applies a mapping of librdkafka settings to `conf`.
+ *
+ * Type errors (a non-str key or an unsupported value type) are raised
+ * immediately; settings librdkafka rejects are collected so one ValueError
+ * reports all of them.
+ */
+int conf_apply_mapping(rd_kafka_conf_t *conf, PyObject *config, const char *const *reserved) {
+    char errstr[512];
+    if (!config || config == Py_None) {
+        return 0;
+    }
+    if (!PyMapping_Check(config)) {
+        PyErr_SetString(PyExc_TypeError, "config must be a mapping");
+        return -1;
+    }
+    // A snapshot of the items, so the mapping may change concurrently.
+    PyObject *items = PyMapping_Items(config);
+    if (!items) {
+        return -1;
+    }
+    PyObject *errors = PyDict_New();
+    if (!errors) {
+        Py_DECREF(items);
+        return -1;
+    }
+
+    int rc = -1;
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items); i++) {
+        PyObject *item = PyList_GET_ITEM(items, i);
+        if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 2) {
+            PyErr_SetString(PyExc_TypeError, "config items must be (key, value) pairs");
+            goto done;
+        }
+        PyObject *key = PyTuple_GET_ITEM(item, 0);
+        if (!PyUnicode_Check(key)) {
+            PyErr_Format(PyExc_TypeError, "config keys must be str, not %.100s",
+                         Py_TYPE(key)->tp_name);
+            goto done;
+        }
+        const char *name = PyUnicode_AsUTF8(key);
+        if (!name) {
+            goto done;
+        }
+        if (conf_is_reserved(name, reserved)) {
+            if (conf_add_error(errors, key, "managed by asynkaf and cannot be overridden") < 0) {
+                goto done;
+            }
+            continue;
+        }
+        PyObject *text = conf_value_str(PyTuple_GET_ITEM(item, 1));
+        if (!text) {
+            goto done;
+        }
+        const char *value = PyUnicode_AsUTF8(text);
+        if (!value) {
+            Py_DECREF(text);
+            goto done;
+        }
+        rd_kafka_conf_res_t res = rd_kafka_conf_set(conf, name, value, errstr, sizeof(errstr));
+        Py_DECREF(text);
+        if (res != RD_KAFKA_CONF_OK && conf_add_error(errors, key, errstr) < 0) {
+            goto done;
+        }
+    }
+
+    if (PyDict_GET_SIZE(errors)) {
+        conf_raise_errors(errors);
+    } else {
+        rc = 0;
+    }
+
+done:
+    Py_DECREF(errors);
+    Py_DECREF(items);
+    return rc;
+}
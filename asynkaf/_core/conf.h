@@ -0,0 +1,33 @@
+#ifndef ASYNKAF_CONF_H
+#define ASYNKAF_CONF_H
+
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+
+/**
+ * @brief Sets an integer librdkafka property if the caller supplied one.
+ * @param conf The configuration being built.
+ * @param name The librdkafka property name.
+ * @param value The value, or a negative number to leave the default.
+ * @return 0 on success, -1 with a ValueError set on failure.
+ */
+int conf_set_optional_int(rd_kafka_conf_t *conf, const char *name, long long value);
+
+/**
+ * @brief Applies a `{"property": value}` mapping of librdkafka settings.
+ *
+ * Keys are librdkafka property names such as `"fetch.min.bytes"`. Values may
+ * be str, int, float or bool; bools become `"true"`/`"false"`. Every entry is
+ * tried, and if any is rejected a ValueError listing each failing key is
+ * raised, with an `errors` attribute mapping those keys to librdkafka's
+ * reason.
+ *
+ * @param conf The configuration being built.
+ * @param config The mapping, or None for no settings.
+ * @param reserved NULL-terminated property names the caller manages itself,
+ *        rejected like invalid keys. May be NULL.
+ * @return 0 on success, -1 with an exception set on failure.
+ */
+int conf_apply_mapping(rd_kafka_conf_t *conf, PyObject *config, const char *const *reserved);
+
+#endif
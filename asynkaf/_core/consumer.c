@@ -1,143 +1,2993 @@
 #include <Python.h>
+#include <errno.h>
 #include <librdkafka/rdkafka.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "event_queue.h"
+#include "awaitable.h"
+#include "columnar.h"
+#include "decode_pool.h"
+#include "decoder.h"
+#include "metrics.h"
+#include "offsets.h"
+#include "prefetch.h"
 #include "queue.h"
+#include "wakeup.h"
+#include "conf.h"
+#include "errors.h"
+#include "futures.h"
+#include "message.h"
+#include "partition.h"
+#include "poller.h"
 #include "consumer.h"
 
+/**
+ * @brief Default upper bound on messages fetched per poller iteration.
+ */
+#define CONSUMER_DEFAULT_POLL_BATCH_SIZE 1000
+
+/**
+ * @brief Default maximum time the poller waits for a batch to fill.
+ */
+#define CONSUMER_DEFAULT_POLL_TIMEOUT_MS 100
+
+/**
+ * @brief Default time the hybrid strategy busy-polls after the last message.
+ */
+#define CONSUMER_DEFAULT_SPIN_US 100
+
+/**
+ * @brief Name of a consumer's own poller thread unless one is given.
+ */
+#define CONSUMER_DEFAULT_POLLER_NAME "asynkaf-poll"
+
+/**
+ * @brief Longest a paused poller waits for the queue to drain in one go.
+ *
+ * Those waits are on the queue's condition variable, which shutdown does
+ * not signal, so they are sliced independently of the poll timeout.
+ */
+#define CONSUMER_BACKPRESSURE_WAIT_MS 100
+
+/**
+ * @brief How the poller waits when no messages are arriving.
+ */
+typedef enum {
+    POLL_STRATEGY_BLOCK,      // Block up to poll_timeout_ms in every poll.
+    POLL_STRATEGY_HYBRID,     // Busy-poll for spin_us after the last message, then block.
+    POLL_STRATEGY_SPIN,       // Never block: lowest latency, one core always busy.
+} PollStrategy;
+
+/**
+ * @brief Default high watermark by queued payload bytes.
+ */
+#define CONSUMER_DEFAULT_HIGH_WATERMARK_BYTES (256 * 1024 * 1024)
+
+/**
+ * @brief Default interval between coalesced offset commits.
+ */
+#define CONSUMER_DEFAULT_COMMIT_INTERVAL_MS 5000
+
+/**
+ * @brief How long a partitioned poller idles while some queue is full.
+ *
+ * librdkafka only signals a partition queue on the empty -> non-empty
+ * transition, so a partition left behind because its ring was full has to
+ * be retried on a timer.
+ */
+#define CONSUMER_FULL_RETRY_MS 10
+
+/**
+ * @brief Errors kept for Python before further ones are dropped.
+ *
+ * Errors usually come in bursts for the same cause (a broker going away,
+ * every partition reaching EOF), so a bounded backlog is enough to react.
+ */
+#define CONSUMER_MAX_PENDING_ERRORS 1024
+
+/**
+ * @brief Longest the poller waits for librdkafka to apply a seek.
+ */
+#define CONSUMER_SEEK_TIMEOUT_MS 5000
+
+/**
+ * @brief Default timeout of offsets_for_times() lookups.
+ */
+#define CONSUMER_DEFAULT_LOOKUP_TIMEOUT_MS 10000
+
+/**
+ * @brief Kinds of requests Python hands to the poller.
+ */
+typedef enum {
+    CONSUMER_REQUEST_SEEK,    // Seek partitions to the offsets in the list.
+    CONSUMER_REQUEST_ASSIGN,  // Replace the assignment with the list.
+} ConsumerRequestType;
+
+/**
+ * @brief A request applied by the poller between two batches.
+ *
+ * Seeks and assignment changes discard what is already buffered for the
+ * partitions involved. Only the poller pushes, so applying them there
+ * guarantees no batch fetched before the change is pushed after it.
+ */
+typedef struct {
+    ConsumerRequestType type; // What to do.
+    rd_kafka_topic_partition_list_t *partitions; // The partitions, with their offsets.
+    PyObject *future;         // Resolved by deliver_events() once applied, or NULL.
+} ConsumerRequest;
+
+/**
+ * @brief Flags returned by consumer_transfer().
+ */
+#define TRANSFER_MORE 1 // The batch was full; the source may hold more.
+#define TRANSFER_FULL 2 // The destination had no room; nothing was taken.
+#define TRANSFER_ANY 4  // At least one message or callback was served.
+
 /**
  * @brief The internal state of a Consumer object.
  *
- * This structure holds all the C-level data for a Kafka consumer instance.
- * It includes the librdkafka handle, a background poller thread, and a
- * thread-safe queue for messages.
+ * This structure holds all the C-level data for a Kafka consumer instance.
+ * It includes the librdkafka handle, a background poller thread, a
+ * thread-safe queue for messages, and the wakeup fd the event loop watches.
+ *
+ * Nothing here relies on the GIL: state shared with the poller thread is
+ * atomic or lock-protected, so the type also works on free-threaded builds.
+ */
+typedef struct {
+    PyObject_HEAD             // Standard Python object header.
+    rd_kafka_t *rk;           // Handle to the librdkafka consumer instance.
+    rd_kafka_queue_t *rkqu;   // The consumer queue the poller drains in batches.
+    rd_kafka_message_t **poll_batch; // Scratch array filled by each batch poll.
+    size_t poll_batch_size;   // Capacity of `poll_batch`.
+    const Decoder *decoder;   // Decode stage run before messages are queued, or NULL.
+    PyObject *decoder_spec;   // The `decoder` argument, kept alive for `decoder`.
+    void **poll_notes;        // Decode results of `poll_batch`, while there is a decoder.
+    DecodePool decode_pool;   // Threads sharing the decoding of each batch.
+    int decode_pool_ready;    // Whether `decode_pool` was started.
+    int poll_timeout_ms;      // Maximum time to wait for a batch to fill.
+    PollStrategy poll_strategy; // How the poller waits while idle.
+    uint64_t spin_ns;         // How long the hybrid strategy busy-polls.
+    rd_kafka_topic_partition_list_t *paused; // Partitions paused for backpressure, or NULL.
+    pthread_t poller_thread;  // Identifier for the background polling thread.
+    atomic_int run_poller;    // Flag to control the lifecycle of the poller thread.
+    int poller_started;       // Whether `poller_thread` was successfully created.
+    PollerThreadOptions poller_options; // CPU set, priority and name of `poller_thread`.
+    PollerObject *poller;     // Shared poller serving this consumer instead, or NULL.
+    Wakeup *poll_signal;      // What drained queues signal: `poll_wakeup`, the shared poller's, or NULL.
+    uint64_t idle_since_ns;   // When the poller last moved anything (hybrid strategy).
+    int queue_ready;          // Whether `message_queue` was successfully initialized.
+    MessageQueue message_queue; // Thread-safe queue to store fetched messages.
+    Wakeup wakeup;            // Readable when `message_queue` becomes non-empty.
+    int wakeup_ready;         // Whether `wakeup` was successfully initialized.
+    MessageScratch pop_scratch; // Scratch array filled by getmany().
+    int partition_mode;       // Whether partitions may be split into their own queues.
+    int prefetch_ms;          // Processing time the queues should buffer (0 = fixed watermarks).
+    double prefetch_low_share; // Low watermark as a share of the high one.
+    PrefetchController prefetch; // Sizes the message queue's high watermark, under `parts_lock`.
+    Wakeup poll_wakeup;       // Signalled by librdkafka when a drained queue gets messages.
+    int poll_wakeup_ready;    // Whether `poll_wakeup` was successfully initialized.
+    pthread_mutex_t parts_lock; // Protects `parts` and `part_count`.
+    PartitionQueue **parts;   // Partitions split off the consumer queue.
+    size_t part_count;        // Number of entries in `parts`.
+    size_t part_capacity;     // Allocated length of `parts`.
+    OffsetTable offsets;      // Stored offsets waiting to be committed.
+    int has_group;            // Whether a group.id was given; commits need one.
+    int commit_interval_ms;   // Flush stored offsets this often (0 = only on demand).
+    size_t commit_every;      // Flush after this many stores (0 = off).
+    int64_t last_commit_ms;   // When the poller last flushed offsets.
+    atomic_int commit_requested; // Set by commit() to make the poller flush now.
+    atomic_int transactional; // Set while a producer commits the offsets in its transactions.
+    pthread_mutex_t commit_lock; // Protects the commit waiter and request lists, `rebalance_listener` and `anext_waiter`.
+    PyObject **commit_waiters; // Futures waiting for the next flush.
+    size_t commit_waiter_count; // Number of entries in `commit_waiters`.
+    size_t commit_waiter_capacity; // Allocated length of `commit_waiters`.
+    PyObject *rebalance_listener; // Called by deliver_events() on assign/revoke, or NULL.
+    PyObject *anext_waiter;   // Called by __anext__ when the queue is empty, or NULL.
+    ConsumerRequest *requests; // Seeks and assignments waiting for the poller.
+    size_t request_count;     // Number of entries in `requests`.
+    size_t request_capacity;  // Allocated length of `requests`.
+    atomic_int requests_pending; // Set when `requests` is non-empty.
+    atomic_int report_rebalance; // Whether the poller should queue rebalance events.
+    Wakeup events_wakeup;     // Readable when `events` holds results.
+    int events_ready;         // Whether `events` and `events_wakeup` were initialized.
+    EventQueue events;        // Commit results waiting for the event loop.
+    KafkaEvent *event_batch;  // Spare buffer swapped with `events`.
+    size_t event_batch_capacity; // Length of `event_batch`.
+    pthread_mutex_t deliver_lock; // Held by the deliver_events() call using `event_batch`.
+    EventQueue errors;        // Errored messages waiting for errors(); signals `wakeup`.
+    int errors_ready;         // Whether `errors` was initialized.
+    KafkaEvent *error_batch;  // Spare buffer swapped with `errors`.
+    size_t error_batch_capacity; // Length of `error_batch`.
+    pthread_mutex_t error_lock; // Held by the errors() call using `error_batch`.
+    pthread_mutex_t close_lock; // Protects `closing`, `closed` and `close_err`.
+    pthread_cond_t close_cond; // Signalled once the consumer has been closed.
+    int closed;               // Whether rd_kafka_consumer_close() has completed.
+    int closing;              // Whether a close() call claimed the shared-poller close.
+    rd_kafka_resp_err_t close_err; // Result of rd_kafka_consumer_close().
+    ConsumerMetrics metrics;  // Pipeline counters and histograms.
+    pthread_mutex_t stats_lock; // Protects the fields below.
+    char *stats_json;         // Latest statistics JSON not yet parsed (librdkafka-owned memory).
+    size_t stats_json_len;    // Length of `stats_json`.
+    PyObject *stats;          // Latest parsed statistics, or NULL.
+    PyObject *lag;            // Consumer lag per (topic, partition) from `stats`.
+    uint64_t rate_ns;         // When metrics() last computed rates.
+    uint64_t rate_messages;   // `metrics.messages` at that time.
+    uint64_t rate_errors;     // `metrics.errors` at that time.
+} ConsumerObject;
+
+/**
+ * @brief Pauses fetching for the current assignment.
+ *
+ * Called by the poller when the message queue reaches a high watermark. The
+ * paused set is remembered so exactly those partitions are resumed later.
+ */
+static void consumer_pause(ConsumerObject *self) {
+    rd_kafka_topic_partition_list_t *assignment = NULL;
+    if (rd_kafka_assignment(self->rk, &assignment) != RD_KAFKA_RESP_ERR_NO_ERROR) {
+        return;
+    }
+    if (assignment->cnt == 0) {
+        rd_kafka_topic_partition_list_destroy(assignment);
+        return;
+    }
+    rd_kafka_pause_partitions(self->rk, assignment);
+    self->paused = assignment;
+}
+
+/**
+ * @brief Resumes the partitions paused by consumer_pause().
+ */
+static void consumer_resume(ConsumerObject *self) {
+    rd_kafka_resume_partitions(self->rk, self->paused);
+    rd_kafka_topic_partition_list_destroy(self->paused);
+    self->paused = NULL;
+}
+
+/**
+ * @brief Futures waiting for one offset flush, passed as the commit opaque.
+ */
+typedef struct {
+    size_t count;             // Number of entries in `futures`.
+    PyObject *futures[];      // Owned references, resolved with the result.
+} CommitContext;
+
+/**
+ * @brief Returns a monotonic timestamp in milliseconds.
+ */
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Takes the futures waiting for the next flush.
+ *
+ * Runs without the GIL; the references are only moved, never touched.
+ *
+ * @return The waiters, or NULL if there are none (or on allocation failure,
+ *         in which case they wait for the next flush).
+ */
+static CommitContext *consumer_take_commit_waiters(ConsumerObject *self) {
+    CommitContext *ctx = NULL;
+    pthread_mutex_lock(&self->commit_lock);
+    if (self->commit_waiter_count) {
+        ctx = malloc(sizeof(CommitContext) + self->commit_waiter_count * sizeof(PyObject *));
+        if (ctx) {
+            ctx->count = self->commit_waiter_count;
+            memcpy(ctx->futures, self->commit_waiters, ctx->count * sizeof(PyObject *));
+            self->commit_waiter_count = 0;
+        }
+    }
+    pthread_mutex_unlock(&self->commit_lock);
+    return ctx;
+}
+
+/**
+ * @brief Queues a commit result for deliver_events().
+ *
+ * Flushes nobody waits for produce no event.
+ */
+static void consumer_report_commit(ConsumerObject *self, rd_kafka_resp_err_t err, CommitContext *ctx) {
+    if (!ctx) {
+        return;
+    }
+    KafkaEvent event = {
+        .type = KAFKA_EVENT_COMMIT,
+        .err = err,
+        .opaque = ctx,
+    };
+    event_queue_push(&self->events, &event);
+}
+
+/**
+ * @brief librdkafka offset commit callback.
+ *
+ * Served by the poller while it drains the consumer queue. The first
+ * per-partition error is reported if the request as a whole succeeded;
+ * "no offset" (nothing to commit) counts as success.
+ */
+static void commit_cb(rd_kafka_t *rk, rd_kafka_resp_err_t err,
+                      rd_kafka_topic_partition_list_t *offsets, void *commit_opaque) {
+    ConsumerObject *self = (ConsumerObject *)rd_kafka_opaque(rk);
+    if (!err && offsets) {
+        for (int i = 0; i < offsets->cnt; i++) {
+            if (offsets->elems[i].err) {
+                err = offsets->elems[i].err;
+                break;
+            }
+        }
+    }
+    if (err == RD_KAFKA_RESP_ERR__NO_OFFSET) {
+        err = RD_KAFKA_RESP_ERR_NO_ERROR;
+    }
+    consumer_report_commit(self, err, (CommitContext *)commit_opaque);
+}
+
+/**
+ * @brief Commits every offset stored since the last flush in one request.
+ *
+ * The waiters are taken before the offsets, so each waiter's flush covers
+ * everything stored before it called commit(). Runs on the poller thread.
+ *
+ * @param self The consumer.
+ * @param async Whether to commit asynchronously (the result arrives through
+ *        commit_cb()) or block until the broker answers.
+ */
+static void consumer_flush_offsets(ConsumerObject *self, int async) {
+    CommitContext *ctx = consumer_take_commit_waiters(self);
+    // The offsets of a bound consumer only ever go out with a transaction.
+    if (atomic_load_explicit(&self->transactional, memory_order_acquire)) {
+        consumer_report_commit(self, RD_KAFKA_RESP_ERR_NO_ERROR, ctx);
+        return;
+    }
+    rd_kafka_topic_partition_list_t *list = offset_table_take_dirty(&self->offsets);
+    self->last_commit_ms = monotonic_ms();
+    if (!list) {
+        consumer_report_commit(self, RD_KAFKA_RESP_ERR_NO_ERROR, ctx);
+        return;
+    }
+    if (async) {
+        rd_kafka_resp_err_t err = rd_kafka_commit_queue(self->rk, list, self->rkqu, commit_cb, ctx);
+        if (err) {
+            // Rejected up front; the callback will not run.
+            consumer_report_commit(self, err, ctx);
+        }
+    } else {
+        consumer_report_commit(self, rd_kafka_commit(self->rk, list, 0), ctx);
+    }
+    rd_kafka_topic_partition_list_destroy(list);
+}
+
+/**
+ * @brief Flushes stored offsets if a commit is due.
+ *
+ * A flush is due when commit() asked for one, after `commit_every` stores,
+ * or every `commit_interval_ms`. Called once per poller iteration.
+ */
+static void consumer_maybe_commit(ConsumerObject *self) {
+    if (!self->has_group) {
+        return;
+    }
+    int due = atomic_exchange_explicit(&self->commit_requested, 0, memory_order_acq_rel);
+    if (!due && self->commit_every && offset_table_pending(&self->offsets) >= self->commit_every) {
+        due = 1;
+    }
+    if (!due && self->commit_interval_ms &&
+        monotonic_ms() - self->last_commit_ms >= self->commit_interval_ms) {
+        due = 1;
+    }
+    if (due) {
+        consumer_flush_offsets(self, 1);
+    }
+}
+
+/**
+ * @brief Wakes the poller out of its current wait.
+ */
+static void consumer_wake_poller(ConsumerObject *self) {
+    if (self->poll_signal) {
+        wakeup_signal(self->poll_signal);
+    } else {
+        rd_kafka_queue_yield(self->rkqu);
+    }
+}
+
+/**
+ * @brief Closes the consumer and publishes the result.
+ *
+ * Runs without the GIL, normally on the poller thread as it exits, so a
+ * slow group leave never blocks the interpreter. Offsets stored since the
+ * last flush are committed synchronously first, so they are not lost.
+ */
+static void consumer_close_now(ConsumerObject *self) {
+    if (self->events_ready && self->has_group) {
+        consumer_flush_offsets(self, 0);
+    }
+    rd_kafka_resp_err_t err = rd_kafka_consumer_close(self->rk);
+    pthread_mutex_lock(&self->close_lock);
+    self->closed = 1;
+    self->close_err = err;
+    pthread_cond_broadcast(&self->close_cond);
+    pthread_mutex_unlock(&self->close_lock);
+
+    // Wake every reader so iterators notice the end of the stream.
+    if (self->wakeup_ready) {
+        wakeup_signal(&self->wakeup);
+    }
+    pthread_mutex_lock(&self->parts_lock);
+    for (size_t i = 0; i < self->part_count; i++) {
+        wakeup_signal(&self->parts[i]->wakeup);
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+}
+
+/**
+ * @brief librdkafka statistics callback.
+ *
+ * Served by the poller every `statistics.interval.ms`. The JSON is kept
+ * as-is, replacing any earlier one nobody read, and only parsed when
+ * metrics() asks for it, so the poller never needs the GIL.
+ *
+ * @return 1, taking ownership of `json`.
+ */
+static int stats_cb(rd_kafka_t *rk, char *json, size_t json_len, void *opaque) {
+    ConsumerObject *self = (ConsumerObject *)opaque;
+    pthread_mutex_lock(&self->stats_lock);
+    char *stale = self->stats_json;
+    self->stats_json = json;
+    self->stats_json_len = json_len;
+    pthread_mutex_unlock(&self->stats_lock);
+    if (stale) {
+        rd_kafka_mem_free(rk, stale);
+    }
+    return 1;
+}
+
+/**
+ * @brief Polls one batch from a librdkafka queue, timing the call.
+ */
+static ssize_t consumer_consume(ConsumerObject *self, rd_kafka_queue_t *src, int timeout_ms,
+                                rd_kafka_message_t **batch, size_t limit) {
+    uint64_t start = metrics_now_ns();
+    ssize_t count = rd_kafka_consume_batch_queue(src, timeout_ms, batch, limit);
+    histogram_record(&self->metrics.poll_ns, metrics_now_ns() - start);
+    atomic_fetch_add_explicit(&self->metrics.polls, 1, memory_order_relaxed);
+    return count;
+}
+
+/**
+ * @brief Samples a queue's depth after a push.
+ */
+static void consumer_sample_queue(ConsumerObject *self, MessageQueue *queue) {
+    histogram_record(&self->metrics.queue_depth, message_queue_size(queue));
+    histogram_record(&self->metrics.queue_bytes, message_queue_bytes(queue));
+}
+
+/**
+ * @brief Hands an errored message to the error queue.
+ *
+ * The error queue signals the same wakeup as the message queue, so the
+ * event loop notices errors without any extra fd, while the data ring never
+ * carries them. Once CONSUMER_MAX_PENDING_ERRORS are waiting, further errors
+ * are destroyed and counted as dropped.
+ */
+static void consumer_route_error(ConsumerObject *self, rd_kafka_message_t *message) {
+    if (self->errors_ready && event_queue_size(&self->errors) < CONSUMER_MAX_PENDING_ERRORS) {
+        KafkaEvent event = {
+            .type = KAFKA_EVENT_ERROR,
+            .err = message->err,
+            .opaque = message,
+            .partition = message->partition,
+            .offset = message->offset,
+        };
+        if (event_queue_push(&self->errors, &event) == 0) {
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&self->metrics.errors_dropped, 1, memory_order_relaxed);
+    rd_kafka_message_destroy(message);
+}
+
+/**
+ * @brief Hands an error not tied to a message to the error queue.
+ *
+ * Used for failures of the poller's own librdkafka calls that Python could
+ * not otherwise see, such as dropping the assignment after a group error.
+ */
+static void consumer_report_error(ConsumerObject *self, rd_kafka_resp_err_t err) {
+    if (self->errors_ready && event_queue_size(&self->errors) < CONSUMER_MAX_PENDING_ERRORS) {
+        KafkaEvent event = {
+            .type = KAFKA_EVENT_ERROR,
+            .err = err,
+            .partition = RD_KAFKA_PARTITION_UA,
+            .offset = RD_KAFKA_OFFSET_INVALID,
+        };
+        if (event_queue_push(&self->errors, &event) == 0) {
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&self->metrics.errors_dropped, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Moves errored messages of a batch to the error queue and compacts
+ * the rest.
+ *
+ * Also counts the batch into the consumer's metrics.
+ *
+ * @return The number of messages left at the front of `batch`.
+ */
+static size_t consumer_drop_errors(ConsumerObject *self, rd_kafka_message_t **batch, size_t count) {
+    size_t ready = 0;
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (batch[i]->err) {
+            consumer_route_error(self, batch[i]);
+        } else {
+            bytes += batch[i]->len;
+            batch[ready++] = batch[i];
+        }
+    }
+    atomic_fetch_add_explicit(&self->metrics.messages, ready, memory_order_relaxed);
+    atomic_fetch_add_explicit(&self->metrics.bytes, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&self->metrics.errors, count - ready, memory_order_relaxed);
+    return ready;
+}
+
+/**
+ * @brief Runs the decoder over a batch on the poller thread.
+ *
+ * Payloads are parsed here, without the GIL, while Python is still busy
+ * with earlier batches, and with decode workers the batch is spread over
+ * them as well. A payload the decoder rejects is queued anyway with no
+ * result, so that `Message.decoded` can raise for it in order.
+ *
+ * @return The results, parallel to `batch`, or NULL without a decoder.
+ */
+static void **consumer_decode(ConsumerObject *self, rd_kafka_message_t **batch, size_t count) {
+    if (!self->decoder) {
+        return NULL;
+    }
+    size_t failed = 0;
+    if (self->decode_pool_ready) {
+        failed = decode_pool_run(&self->decode_pool, batch, self->poll_notes, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            if (decoder_apply(self->decoder, batch[i], &self->poll_notes[i]) != 0) {
+                failed++;
+            }
+        }
+    }
+    if (failed) {
+        atomic_fetch_add_explicit(&self->metrics.decode_errors, failed, memory_order_relaxed);
+    }
+    return self->poll_notes;
+}
+
+/**
+ * @brief Destroys the messages `[pushed, count)` of a batch the queue did not take.
+ *
+ * They are counted as `messages_dropped`, so the gap in their partitions'
+ * offsets shows up in metrics().
+ */
+static void consumer_drop_unpushed(ConsumerObject *self, rd_kafka_message_t **batch, void **notes,
+                                   size_t pushed, size_t count) {
+    if (pushed >= count) {
+        return;
+    }
+    for (size_t i = pushed; i < count; i++) {
+        if (notes) {
+            decoder_release(self->decoder, notes[i]);
+        }
+        rd_kafka_message_destroy(batch[i]);
+    }
+    atomic_fetch_add_explicit(&self->metrics.messages_dropped, count - pushed, memory_order_relaxed);
+}
+
+/**
+ * @brief Moves one batch from a librdkafka queue into a MessageQueue.
+ *
+ * Never blocks. Only as many messages as the ring has room for are
+ * consumed, so the poller never holds on to messages it cannot push and
+ * one slow partition cannot stall the others; the rest stays in librdkafka,
+ * whose own prefetch limits then apply.
+ *
+ * @return A combination of TRANSFER_MORE and TRANSFER_FULL.
+ */
+static int consumer_transfer(ConsumerObject *self, rd_kafka_queue_t *src, MessageQueue *dst) {
+    size_t limit = self->poll_batch_size;
+    if (dst->capacity) {
+        // Only this thread pushes, so the room can only grow meanwhile.
+        size_t room = dst->capacity - message_queue_size(dst);
+        if (room == 0) {
+            return TRANSFER_FULL;
+        }
+        if (room < limit) {
+            limit = room;
+        }
+    }
+    ssize_t count = consumer_consume(self, src, 0, self->poll_batch, limit);
+    if (count <= 0) {
+        return 0;
+    }
+    size_t ready = consumer_drop_errors(self, self->poll_batch, (size_t)count);
+    void **notes = consumer_decode(self, self->poll_batch, ready);
+    size_t pushed = message_queue_push_batch(dst, self->poll_batch, notes, ready);
+    if (pushed < ready) {
+        // The ring always has room for the batch, so only a list queue that
+        // could not allocate nodes gets here. Try once more, then give up on
+        // the rest rather than block the other partitions.
+        pushed += message_queue_push_batch(dst, self->poll_batch + pushed,
+                                           notes ? notes + pushed : NULL, ready - pushed);
+        consumer_drop_unpushed(self, self->poll_batch, notes, pushed, ready);
+    }
+    consumer_sample_queue(self, dst);
+    return (size_t)count == limit ? TRANSFER_MORE | TRANSFER_ANY : TRANSFER_ANY;
+}
+
+/**
+ * @brief Pauses or resumes one split partition for backpressure.
+ */
+static void consumer_set_partition_paused(ConsumerObject *self, PartitionQueue *part, int paused) {
+    rd_kafka_topic_partition_list_t *list = rd_kafka_topic_partition_list_new(1);
+    rd_kafka_topic_partition_list_add(list, part->topic, part->partition);
+    if (paused) {
+        rd_kafka_pause_partitions(self->rk, list);
+    } else {
+        rd_kafka_resume_partitions(self->rk, list);
+    }
+    rd_kafka_topic_partition_list_destroy(list);
+    part->paused = paused;
+}
+
+/**
+ * @brief Moves one batch from every split partition into its queue.
+ *
+ * Each partition has its own watermarks: crossing the high mark pauses just
+ * that partition, draining to the low mark resumes it.
+ *
+ * @return The TRANSFER_* flags of all partitions combined.
+ */
+static int consumer_sweep_partitions(ConsumerObject *self) {
+    int flags = 0;
+    pthread_mutex_lock(&self->parts_lock);
+    for (size_t i = 0; i < self->part_count; i++) {
+        PartitionQueue *part = self->parts[i];
+        if (part->paused && message_queue_below_low(&part->queue)) {
+            consumer_set_partition_paused(self, part, 0);
+        }
+        flags |= consumer_transfer(self, part->rkqu, &part->queue);
+        if (!part->paused && message_queue_above_high(&part->queue)) {
+            consumer_set_partition_paused(self, part, 1);
+        }
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+    return flags;
+}
+
+/**
+ * @brief Gives a queue the message watermarks its controller chose.
+ */
+static void consumer_apply_prefetch(ConsumerObject *self, MessageQueue *queue, const PrefetchController *ctrl) {
+    message_queue_set_watermarks(queue, ctrl->high, (size_t)((double)ctrl->high * self->prefetch_low_share),
+                                 queue->high_bytes, queue->low_bytes);
+}
+
+/**
+ * @brief Starts a split partition's controller from the consumer's settings.
+ *
+ * Requires `parts_lock`.
+ */
+static void consumer_init_partition_prefetch(ConsumerObject *self, PartitionQueue *part) {
+    if (!self->prefetch_ms) {
+        return;
+    }
+    prefetch_init(&part->prefetch, self->prefetch_ms, self->prefetch.floor, self->prefetch.ceiling,
+                  message_queue_drained(&part->queue), monotonic_ms());
+    consumer_apply_prefetch(self, &part->queue, &part->prefetch);
+}
+
+/**
+ * @brief Resizes the queues' high watermarks to the rate Python drains them.
+ *
+ * The message queue and every split partition have their own controller,
+ * so a slow partition does not shrink the buffer of a fast one. The
+ * watermarks are what pauses fetching, so this bounds what librdkafka
+ * fetches ahead as well. Runs on the poller thread.
+ */
+static void consumer_tune_prefetch(ConsumerObject *self) {
+    if (!self->prefetch_ms) {
+        return;
+    }
+    int64_t now = monotonic_ms();
+    if (now - self->prefetch.window_ms < PREFETCH_WINDOW_MS) {
+        return;
+    }
+    pthread_mutex_lock(&self->parts_lock);
+    MessageQueue *queue = &self->message_queue;
+    if (prefetch_update(&self->prefetch, message_queue_drained(queue), message_queue_size(queue), now)) {
+        consumer_apply_prefetch(self, queue, &self->prefetch);
+    }
+    for (size_t i = 0; i < self->part_count; i++) {
+        PartitionQueue *part = self->parts[i];
+        if (prefetch_update(&part->prefetch, message_queue_drained(&part->queue),
+                            message_queue_size(&part->queue), now)) {
+            consumer_apply_prefetch(self, &part->queue, &part->prefetch);
+        }
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+}
+
+/**
+ * @brief Selects messages of the partitions in `arg`, a partition list.
+ */
+static int message_in_partitions(const rd_kafka_message_t *message, void *arg) {
+    return rd_kafka_topic_partition_list_find((const rd_kafka_topic_partition_list_t *)arg,
+                                              rd_kafka_topic_name(message->rkt),
+                                              message->partition) != NULL;
+}
+
+/**
+ * @brief Selects every message.
+ */
+static int message_any(const rd_kafka_message_t *message, void *arg) {
+    return 1;
+}
+
+/**
+ * @brief Destroys the buffered messages of revoked partitions.
+ *
+ * Python has not seen them yet, and the partitions' new owner starts from
+ * the last committed offset, so handing them out now would process them
+ * twice.
+ */
+static void consumer_purge_revoked(ConsumerObject *self, const rd_kafka_topic_partition_list_t *partitions) {
+    message_queue_purge(&self->message_queue, message_in_partitions, (void *)partitions);
+    pthread_mutex_lock(&self->parts_lock);
+    for (size_t i = 0; i < self->part_count; i++) {
+        PartitionQueue *part = self->parts[i];
+        if (rd_kafka_topic_partition_list_find(partitions, part->topic, part->partition)) {
+            message_queue_purge(&part->queue, message_any, NULL);
+        }
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+}
+
+/**
+ * @brief Brings newly assigned partitions in line with the consumer's state.
+ *
+ * Partitions assigned while the poller holds the assignment paused for
+ * backpressure are paused too, and resumed with the rest. Assigning starts
+ * fetching, which points a partition back at the consumer queue, so split
+ * partitions are detached from it again.
+ */
+static void consumer_on_assigned(ConsumerObject *self, const rd_kafka_topic_partition_list_t *partitions) {
+    if (self->paused && partitions->cnt) {
+        rd_kafka_pause_partitions(self->rk, (rd_kafka_topic_partition_list_t *)partitions);
+        for (int i = 0; i < partitions->cnt; i++) {
+            rd_kafka_topic_partition_list_add(self->paused, partitions->elems[i].topic,
+                                              partitions->elems[i].partition);
+        }
+    }
+    pthread_mutex_lock(&self->parts_lock);
+    for (size_t i = 0; i < self->part_count; i++) {
+        PartitionQueue *part = self->parts[i];
+        if (rd_kafka_topic_partition_list_find(partitions, part->topic, part->partition)) {
+            rd_kafka_queue_forward(part->rkqu, NULL);
+        }
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+}
+
+/**
+ * @brief Queues an assignment change for the rebalance listener.
+ */
+static void consumer_report_rebalance(ConsumerObject *self, rd_kafka_resp_err_t err,
+                                      const rd_kafka_topic_partition_list_t *partitions) {
+    if (!atomic_load_explicit(&self->report_rebalance, memory_order_relaxed)) {
+        return;
+    }
+    KafkaEvent event = {
+        .type = KAFKA_EVENT_REBALANCE,
+        .err = err,
+        .opaque = rd_kafka_topic_partition_list_copy(partitions),
+    };
+    if (event_queue_push(&self->events, &event) != 0) {
+        rd_kafka_topic_partition_list_destroy((rd_kafka_topic_partition_list_t *)event.opaque);
+    }
+}
+
+/**
+ * @brief Drops the stored offsets of partitions the consumer gave up.
+ *
+ * A consumer bound to a transactional producer did not commit them with the
+ * flush before the partitions went, so they are kept until the producer's
+ * next commit_transaction() takes them into the open transaction. That
+ * commit carries the old group generation: if the new owner has started,
+ * the broker refuses the offsets and the transaction must be aborted, so
+ * the records are processed once either way.
+ */
+static void consumer_release_offsets(ConsumerObject *self, const rd_kafka_topic_partition_list_t *partitions) {
+    if (atomic_load_explicit(&self->transactional, memory_order_acquire)) {
+        offset_table_release(&self->offsets, partitions);
+    } else {
+        offset_table_forget(&self->offsets, partitions);
+    }
+}
+
+/**
+ * @brief Makes the pops skip a queue's buffered messages of one partition.
+ *
+ * Falls back to removing them right away if the fence cannot be recorded.
+ */
+static void consumer_fence_queue(MessageQueue *queue, const char *topic, int32_t partition) {
+    if (message_queue_fence(queue, topic, partition) == 0) {
+        return;
+    }
+    rd_kafka_topic_partition_list_t *list = rd_kafka_topic_partition_list_new(1);
+    rd_kafka_topic_partition_list_add(list, topic, partition);
+    message_queue_purge(queue, message_in_partitions, list);
+    rd_kafka_topic_partition_list_destroy(list);
+}
+
+/**
+ * @brief Discards everything buffered for one partition.
+ *
+ * The partition's messages may sit in the consumer queue and, once split,
+ * in its own queue; both are fenced rather than scanned, so this costs the
+ * same however much is buffered. Runs on the poller thread.
+ */
+static void consumer_drop_buffered(ConsumerObject *self, const char *topic, int32_t partition) {
+    consumer_fence_queue(&self->message_queue, topic, partition);
+    pthread_mutex_lock(&self->parts_lock);
+    for (size_t i = 0; i < self->part_count; i++) {
+        PartitionQueue *part = self->parts[i];
+        if (part->partition == partition && strcmp(part->topic, topic) == 0) {
+            consumer_fence_queue(&part->queue, topic, partition);
+        }
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+}
+
+/**
+ * @brief Seeks partitions and discards what was buffered before the seek.
+ *
+ * librdkafka itself drops what it had prefetched for the old position, so
+ * once the buffered messages are fenced the next pop for the partition
+ * returns the target offset straight away.
+ *
+ * @return The error of the seek, or of the first partition that failed
+ *         (the others are still moved).
+ */
+static rd_kafka_resp_err_t consumer_apply_seek(ConsumerObject *self, rd_kafka_topic_partition_list_t *offsets) {
+    rd_kafka_error_t *error = rd_kafka_seek_partitions(self->rk, offsets, CONSUMER_SEEK_TIMEOUT_MS);
+    if (error) {
+        rd_kafka_resp_err_t err = rd_kafka_error_code(error);
+        rd_kafka_error_destroy(error);
+        return err;
+    }
+    rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+    for (int i = 0; i < offsets->cnt; i++) {
+        const rd_kafka_topic_partition_t *elem = &offsets->elems[i];
+        if (elem->err) {
+            if (!err) {
+                err = elem->err;
+            }
+            continue;
+        }
+        consumer_drop_buffered(self, elem->topic, elem->partition);
+    }
+    return err;
+}
+
+/**
+ * @brief Replaces the assignment with `partitions`.
+ *
+ * Every partition of the old assignment restarts, from its committed (or
+ * given) offset if it is assigned again, so its buffered messages are
+ * discarded and its stored offsets flushed first, when there is a group to
+ * commit them to, and then forgotten.
+ *
+ * @return The error of the assignment.
+ */
+static rd_kafka_resp_err_t consumer_apply_assign(ConsumerObject *self, rd_kafka_topic_partition_list_t *partitions) {
+    rd_kafka_topic_partition_list_t *previous = NULL;
+    if (rd_kafka_assignment(self->rk, &previous) != RD_KAFKA_RESP_ERR_NO_ERROR) {
+        previous = NULL;
+    }
+    if (previous && previous->cnt && self->has_group) {
+        consumer_flush_offsets(self, 0);
+    }
+    rd_kafka_resp_err_t err = rd_kafka_assign(self->rk, partitions);
+    if (!err && previous) {
+        for (int i = 0; i < previous->cnt; i++) {
+            consumer_drop_buffered(self, previous->elems[i].topic, previous->elems[i].partition);
+        }
+        consumer_release_offsets(self, previous);
+    }
+    if (previous) {
+        rd_kafka_topic_partition_list_destroy(previous);
+    }
+    if (!err) {
+        consumer_on_assigned(self, partitions);
+    }
+    return err;
+}
+
+/**
+ * @brief Applies the seeks and assignments Python asked for, in order.
+ *
+ * Called once per poller iteration, between batches. Each result goes to
+ * deliver_events() if the request came with a future.
+ */
+static void consumer_serve_requests(ConsumerObject *self) {
+    if (!atomic_exchange_explicit(&self->requests_pending, 0, memory_order_acq_rel)) {
+        return;
+    }
+    pthread_mutex_lock(&self->commit_lock);
+    ConsumerRequest *requests = self->requests;
+    size_t count = self->request_count;
+    self->requests = NULL;
+    self->request_count = 0;
+    self->request_capacity = 0;
+    pthread_mutex_unlock(&self->commit_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        ConsumerRequest *request = &requests[i];
+        rd_kafka_resp_err_t err = request->type == CONSUMER_REQUEST_SEEK
+                                      ? consumer_apply_seek(self, request->partitions)
+                                      : consumer_apply_assign(self, request->partitions);
+        rd_kafka_topic_partition_list_destroy(request->partitions);
+        if (request->future) {
+            KafkaEvent event = {
+                .type = KAFKA_EVENT_REQUEST,
+                .err = err,
+                .opaque = request->future,
+            };
+            event_queue_push(&self->events, &event);
+        }
+    }
+    PyMem_RawFree(requests);
+}
+
+/**
+ * @brief librdkafka rebalance callback.
+ *
+ * Served by the poller. With the cooperative protocol
+ * (`partition.assignment.strategy=cooperative-sticky`, the default here)
+ * only the partitions that move are passed in and applied incrementally,
+ * so the rest of the assignment keeps being consumed throughout the
+ * rebalance; the eager protocol replaces the whole assignment.
+ *
+ * Before revoked partitions are given up, the offsets stored for them are
+ * committed (unless the assignment was lost, in which case the commit would
+ * be rejected), forgotten, and their buffered messages purged. While the
+ * consumer is closing the buffers are left alone, so getmany() can still
+ * drain them after close().
+ */
+static void rebalance_cb(rd_kafka_t *rk, rd_kafka_resp_err_t err,
+                         rd_kafka_topic_partition_list_t *partitions, void *opaque) {
+    ConsumerObject *self = (ConsumerObject *)opaque;
+    const char *protocol = rd_kafka_rebalance_protocol(rk);
+    int cooperative = protocol && strcmp(protocol, "COOPERATIVE") == 0;
+    rd_kafka_error_t *error = NULL;
+    rd_kafka_resp_err_t result = RD_KAFKA_RESP_ERR_NO_ERROR;
+
+    switch (err) {
+    case RD_KAFKA_RESP_ERR__ASSIGN_PARTITIONS:
+        if (cooperative) {
+            error = rd_kafka_incremental_assign(rk, partitions);
+        } else {
+            result = rd_kafka_assign(rk, partitions);
+        }
+        if (!error && !result) {
+            consumer_on_assigned(self, partitions);
+        }
+        break;
+    case RD_KAFKA_RESP_ERR__REVOKE_PARTITIONS:
+        if (!rd_kafka_assignment_lost(rk)) {
+            consumer_flush_offsets(self, 0);
+        }
+        consumer_release_offsets(self, partitions);
+        if (atomic_load_explicit(&self->run_poller, memory_order_acquire)) {
+            consumer_purge_revoked(self, partitions);
+        }
+        if (cooperative) {
+            error = rd_kafka_incremental_unassign(rk, partitions);
+        } else {
+            result = rd_kafka_assign(rk, NULL);
+        }
+        break;
+    default:
+        // The group failed; stop consuming until it recovers. The
+        // cooperative protocol only takes incremental changes here.
+        if (cooperative) {
+            rd_kafka_topic_partition_list_t *assignment = NULL;
+            result = rd_kafka_assignment(rk, &assignment);
+            if (!result) {
+                error = rd_kafka_incremental_unassign(rk, assignment);
+                rd_kafka_topic_partition_list_destroy(assignment);
+            }
+        } else {
+            result = rd_kafka_assign(rk, NULL);
+        }
+        if (error) {
+            result = rd_kafka_error_code(error);
+            rd_kafka_error_destroy(error);
+        }
+        consumer_report_error(self, result ? result : err);
+        return;
+    }
+
+    if (error) {
+        rd_kafka_error_destroy(error);
+        return;
+    }
+    if (!result) {
+        consumer_report_rebalance(self, err, partitions);
+    }
+}
+
+/**
+ * @brief Returns how long the next poll may block.
+ *
+ * Blocking waits are cut short by consumer_wake_poller(), so a long
+ * poll_timeout_ms costs neither shutdown latency nor idle wakeups.
+ *
+ * @param self The consumer.
+ * @return 0 to busy-poll, otherwise the poll timeout.
+ */
+static int consumer_wait_ms(ConsumerObject *self) {
+    switch (self->poll_strategy) {
+    case POLL_STRATEGY_SPIN:
+        return 0;
+    case POLL_STRATEGY_HYBRID:
+        if (metrics_now_ns() - self->idle_since_ns < self->spin_ns) {
+            return 0;
+        }
+        return self->poll_timeout_ms;
+    default:
+        return self->poll_timeout_ms;
+    }
+}
+
+/**
+ * @brief The poller loop used when all partitions share the consumer queue.
+ *
+ * This function continuously pulls batches of
+ * up to `poll_batch_size` messages from the consumer queue with
+ * `rd_kafka_consume_batch_queue`, so librdkafka's queue lock is crossed once
+ * per batch. Each batch is pushed into the thread-safe queue in one splice.
+ *
+ * When the queue reaches its high watermark the assigned partitions are
+ * paused; the poller then waits for Python to drain the queue to its low
+ * watermark, while still serving callbacks, and resumes them. Memory stays
+ * bounded without dropping data.
+ *
+ * Idle waits follow the poll strategy; a blocking poll is interrupted with
+ * `rd_kafka_queue_yield` when the consumer is closed.
+ */
+static void poller_run_shared(ConsumerObject *self) {
+    rd_kafka_message_t **batch = self->poll_batch;
+    while (atomic_load_explicit(&self->run_poller, memory_order_acquire)) {
+        consumer_serve_requests(self);
+        consumer_maybe_commit(self);
+        consumer_tune_prefetch(self);
+        if (self->paused &&
+            message_queue_wait_below_low(&self->message_queue, CONSUMER_BACKPRESSURE_WAIT_MS)) {
+            consumer_resume(self);
+        }
+
+        // While paused only callbacks (and already-fetched messages) are
+        // served, so don't block in librdkafka.
+        int timeout_ms = self->paused ? 0 : consumer_wait_ms(self);
+        ssize_t count = consumer_consume(self, self->rkqu, timeout_ms,
+                                         batch, self->poll_batch_size);
+        if (count <= 0) {
+            if (timeout_ms == 0 && !self->paused) {
+                poller_cpu_relax();
+            }
+            continue;
+        }
+        if (self->poll_strategy == POLL_STRATEGY_HYBRID) {
+            self->idle_since_ns = metrics_now_ns();
+        }
+
+        // Route errored messages aside and compact the rest in place, then
+        // decode what is left before Python sees it.
+        size_t ready = consumer_drop_errors(self, batch, (size_t)count);
+        void **notes = consumer_decode(self, batch, ready);
+
+        // Push the batch onto the queue. If the ring is full, wait for the
+        // consumer to make room.
+        size_t pushed = 0;
+        while (pushed < ready) {
+            pushed += message_queue_push_batch(&self->message_queue, batch + pushed,
+                                               notes ? notes + pushed : NULL, ready - pushed);
+            if (pushed == ready) {
+                break;
+            }
+            if (!atomic_load_explicit(&self->run_poller, memory_order_acquire)) {
+                consumer_drop_unpushed(self, batch, notes, pushed, ready);
+                break;
+            }
+            message_queue_wait_not_full(&self->message_queue, CONSUMER_BACKPRESSURE_WAIT_MS);
+        }
+        consumer_sample_queue(self, &self->message_queue);
+
+        if (!self->paused && message_queue_above_high(&self->message_queue)) {
+            consumer_pause(self);
+        }
+    }
+}
+
+/**
+ * @brief Runs one non-blocking poller iteration.
+ *
+ * Serves the consumer queue and every split partition once. A consumer
+ * without split partitions pauses its assignment at the high watermark,
+ * like poller_run_shared(), but instead of waiting for the low watermark it
+ * asks to be stepped again after CONSUMER_FULL_RETRY_MS.
+ *
+ * @param self The consumer.
+ * @return How long the caller may sleep on `poll_signal` before the next
+ *         iteration; 0 to run it right away.
+ */
+static int consumer_poll_step(ConsumerObject *self) {
+    consumer_serve_requests(self);
+    consumer_maybe_commit(self);
+    consumer_tune_prefetch(self);
+    if (self->paused && message_queue_below_low(&self->message_queue)) {
+        consumer_resume(self);
+    }
+    int flags = consumer_transfer(self, self->rkqu, &self->message_queue);
+    if (!self->partition_mode && !self->paused && message_queue_above_high(&self->message_queue)) {
+        consumer_pause(self);
+    }
+    flags |= consumer_sweep_partitions(self);
+
+    if ((flags & TRANSFER_ANY) && self->poll_strategy == POLL_STRATEGY_HYBRID) {
+        self->idle_since_ns = metrics_now_ns();
+    }
+    if (flags & TRANSFER_MORE) {
+        return 0;
+    }
+    int timeout_ms = consumer_wait_ms(self);
+    if (((flags & TRANSFER_FULL) || self->paused) && timeout_ms > CONSUMER_FULL_RETRY_MS) {
+        timeout_ms = CONSUMER_FULL_RETRY_MS;
+    }
+    return timeout_ms;
+}
+
+/**
+ * @brief Steps a consumer on a shared poller's thread.
+ */
+static int consumer_shared_step(void *arg) {
+    return consumer_poll_step((ConsumerObject *)arg);
+}
+
+/**
+ * @brief The poller loop used when partitions may have their own queues.
+ *
+ * The consumer queue and every split partition queue signal `poll_wakeup`
+ * when they become non-empty, so the poller sleeps on that one fd and then
+ * sweeps all of them without blocking. It only skips the sleep while some
+ * queue is known to hold more than one batch. Split partitions are paused
+ * and resumed individually; the consumer queue, which now only carries the
+ * partitions that were not split, is bounded by its ring.
+ *
+ * With a busy-polling strategy the fd is only checked, never slept on.
+ */
+static void poller_run_partitioned(ConsumerObject *self) {
+    int timeout_ms = 0;
+    while (atomic_load_explicit(&self->run_poller, memory_order_acquire)) {
+        if (timeout_ms > 0) {
+            wakeup_wait(&self->poll_wakeup, timeout_ms);
+        } else {
+            poller_cpu_relax();
+        }
+        // Clear the fd before draining: anything arriving afterwards
+        // signals it again.
+        wakeup_drain(&self->poll_wakeup);
+        timeout_ms = consumer_poll_step(self);
+    }
+}
+
+/**
+ * @brief The background thread function for polling Kafka messages.
+ *
+ * Runs poller_run_shared() or, with `partition_queues=True`,
+ * poller_run_partitioned() until asked to stop. It then closes the consumer
+ * itself before exiting, which keeps the potentially slow group leave off
+ * the Python threads. Consumers on a shared Poller have no such thread:
+ * the Poller steps them with consumer_shared_step() and close() closes
+ * them from its executor thread.
+ *
+ * @param arg A void pointer to the ConsumerObject instance.
+ * @return Always returns NULL.
+ */
+static void *poller_thread_func(void *arg) {
+    ConsumerObject *self = (ConsumerObject *)arg;
+    if (self->partition_mode) {
+        poller_run_partitioned(self);
+    } else {
+        poller_run_shared(self);
+    }
+    consumer_close_now(self);
+    return NULL;
+}
+
+/**
+ * @brief Allocates a new Consumer object.
+ *
+ * This corresponds to the `__new__` method in Python.
+ */
+static PyObject *
+Consumer_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    ConsumerObject *self;
+    self = (ConsumerObject *)type->tp_alloc(type, 0);
+    if (self) {
+        pthread_mutex_init(&self->close_lock, NULL);
+        pthread_cond_init(&self->close_cond, NULL);
+        message_scratch_init(&self->pop_scratch);
+        pthread_mutex_init(&self->parts_lock, NULL);
+        offset_table_init(&self->offsets);
+        pthread_mutex_init(&self->commit_lock, NULL);
+        pthread_mutex_init(&self->deliver_lock, NULL);
+        consumer_metrics_init(&self->metrics);
+        pthread_mutex_init(&self->stats_lock, NULL);
+        pthread_mutex_init(&self->error_lock, NULL);
+        self->rate_ns = metrics_now_ns();
+    }
+    return (PyObject *)self;
+}
+
+/**
+ * @brief Initializes a Consumer object.
+ *
+ * Corresponds to the `__init__` method in Python. It sets up the librdkafka
+ * consumer, initializes the message queue, and starts the background poller thread.
+ *
+ * @param self The ConsumerObject to initialize.
+ * @param args Python arguments (bootstrap_servers, group_id or None). A
+ *        consumer without a group gets its partitions from assign() and
+ *        cannot commit().
+ * @param kwds Python keyword arguments (queue_capacity, poll_batch_size,
+ *        poll_timeout_ms, the high/low watermarks by messages and bytes,
+ *        partition_queues, commit_interval_ms and commit_every). Watermarks
+ *        left unset default to 3/4 and 3/8 of the queue capacity and to
+ *        256 MiB and 128 MiB of payload; a high mark of 0 disables that
+ *        dimension. partition_queues=True enables partition(); split
+ *        partitions reuse the capacity and watermarks. Stored offsets are
+ *        committed every commit_interval_ms (default 5000, 0 = only on
+ *        commit()) and after every commit_every stores (default 0 = off).
+ *        config maps further librdkafka properties (fetch.min.bytes,
+ *        queued.max.messages.kbytes, ...) to values; bootstrap.servers,
+ *        group.id and enable.auto.commit are set by the consumer itself.
+ *        poll_strategy is "block" (default), "hybrid" (busy-poll for
+ *        spin_us, default 100, after the last message, then block) or
+ *        "spin" (never block).
+ *        poller_cpus pins the poller thread to a CPU set, poller_priority
+ *        sets its nice value and poller_name its name (default
+ *        "asynkaf-poll"). Passing a Poller as poller serves the consumer on
+ *        that shared thread instead of starting one; fileno() and
+ *        events_fileno() then both return the poller's shared fd.
+ *        decoder ("json", "frames", "confluent" or a Decoder capsule)
+ *        decodes payloads on the poller thread for Message.decoded;
+ *        decode_workers (default 0) more threads share each batch.
+ *        prefetch_ms (default 0 = off) lets the poller resize the
+ *        message high watermark, and every split partition's, to what
+ *        Python drains in that many milliseconds, between a poll batch
+ *        and the configured high watermark.
+ * @return 0 on success, -1 on failure.
+ */
+static int
+Consumer_init(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"bootstrap_servers", "group_id", "queue_capacity",
+                             "poll_batch_size", "poll_timeout_ms",
+                             "high_watermark_messages", "low_watermark_messages",
+                             "high_watermark_bytes", "low_watermark_bytes",
+                             "partition_queues", "commit_interval_ms", "commit_every",
+                             "config", "poll_strategy", "spin_us",
+                             "poller_cpus", "poller_priority", "poller_name", "poller",
+                             "decoder", "decode_workers", "prefetch_ms", NULL};
+    // Offsets are committed from the offset table, so librdkafka must not
+    // commit on its own.
+    static const char *const reserved[] = {"bootstrap.servers", "group.id",
+                                           "enable.auto.commit", NULL};
+    char *bootstrap_servers;
+    char *group_id = NULL;
+    Py_ssize_t queue_capacity = MESSAGE_QUEUE_DEFAULT_CAPACITY;
+    Py_ssize_t poll_batch_size = CONSUMER_DEFAULT_POLL_BATCH_SIZE;
+    int poll_timeout_ms = CONSUMER_DEFAULT_POLL_TIMEOUT_MS;
+    // -1 means "not given": derived defaults are filled in below.
+    Py_ssize_t high_messages = -1;
+    Py_ssize_t low_messages = -1;
+    Py_ssize_t high_bytes = -1;
+    Py_ssize_t low_bytes = -1;
+    int partition_queues = 0;
+    int commit_interval_ms = CONSUMER_DEFAULT_COMMIT_INTERVAL_MS;
+    Py_ssize_t commit_every = 0;
+    PyObject *config = NULL;
+    const char *poll_strategy = "block";
+    long long spin_us = CONSUMER_DEFAULT_SPIN_US;
+    PyObject *poller_cpus = NULL;
+    PyObject *poller_priority = NULL;
+    const char *poller_name = NULL;
+    PyObject *poller = NULL;
+    PyObject *decoder = NULL;
+    Py_ssize_t decode_workers = 0;
+    int prefetch_ms = 0;
+    char errstr[512];
+
+    // Parse Python arguments.
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sz|$nninnnnpinOsLOOzOOni", kwlist,
+                                     &bootstrap_servers, &group_id, &queue_capacity,
+                                     &poll_batch_size, &poll_timeout_ms,
+                                     &high_messages, &low_messages,
+                                     &high_bytes, &low_bytes, &partition_queues,
+                                     &commit_interval_ms, &commit_every, &config,
+                                     &poll_strategy, &spin_us,
+                                     &poller_cpus, &poller_priority, &poller_name, &poller,
+                                     &decoder, &decode_workers, &prefetch_ms))
+        return -1;
+
+    if (strcmp(poll_strategy, "block") == 0) {
+        self->poll_strategy = POLL_STRATEGY_BLOCK;
+    } else if (strcmp(poll_strategy, "hybrid") == 0) {
+        self->poll_strategy = POLL_STRATEGY_HYBRID;
+    } else if (strcmp(poll_strategy, "spin") == 0) {
+        self->poll_strategy = POLL_STRATEGY_SPIN;
+    } else {
+        PyErr_Format(PyExc_ValueError, "poll_strategy must be 'block', 'hybrid' or 'spin', not '%s'",
+                     poll_strategy);
+        return -1;
+    }
+    if (spin_us < 0) {
+        PyErr_SetString(PyExc_ValueError, "spin_us must be >= 0");
+        return -1;
+    }
+    self->spin_ns = (uint64_t)spin_us * 1000;
+
+    if (poller == Py_None) {
+        poller = NULL;
+    }
+    if (poller) {
+        if (!PyObject_TypeCheck(poller, &PollerType)) {
+            PyErr_SetString(PyExc_TypeError, "poller must be a Poller");
+            return -1;
+        }
+        if ((poller_cpus && poller_cpus != Py_None) ||
+            (poller_priority && poller_priority != Py_None) || poller_name) {
+            PyErr_SetString(PyExc_ValueError,
+                            "poller_cpus, poller_priority and poller_name belong to the shared Poller");
+            return -1;
+        }
+    } else if (poller_options_parse(&self->poller_options, poller_cpus, poller_priority,
+                                    poller_name, CONSUMER_DEFAULT_POLLER_NAME) < 0) {
+        return -1;
+    }
+
+    if (decoder && decoder != Py_None) {
+        self->decoder = decoder_from_object(decoder);
+        if (!self->decoder) {
+            return -1;
+        }
+        self->decoder_spec = Py_NewRef(decoder);
+    }
+    if (decode_workers < 0 || decode_workers > DECODE_POOL_MAX_WORKERS) {
+        PyErr_Format(PyExc_ValueError, "decode_workers must be between 0 and %d", DECODE_POOL_MAX_WORKERS);
+        return -1;
+    }
+    if (decode_workers && !self->decoder) {
+        PyErr_SetString(PyExc_ValueError, "decode_workers requires a decoder");
+        return -1;
+    }
+
+    if (queue_capacity < 0) {
+        PyErr_SetString(PyExc_ValueError, "queue_capacity must be >= 0");
+        return -1;
+    }
+    if (poll_batch_size < 1) {
+        PyErr_SetString(PyExc_ValueError, "poll_batch_size must be >= 1");
+        return -1;
+    }
+    if (poll_timeout_ms < 0) {
+        PyErr_SetString(PyExc_ValueError, "poll_timeout_ms must be >= 0");
+        return -1;
+    }
+    if (commit_interval_ms < 0 || commit_every < 0) {
+        PyErr_SetString(PyExc_ValueError, "commit_interval_ms and commit_every must be >= 0");
+        return -1;
+    }
+
+    // Fill in watermark defaults, then check the hysteresis is sane.
+    if (high_messages < 0) {
+        Py_ssize_t capacity = queue_capacity ? queue_capacity : MESSAGE_QUEUE_DEFAULT_CAPACITY;
+        high_messages = capacity / 4 * 3;
+    }
+    if (low_messages < 0) {
+        low_messages = high_messages / 2;
+    }
+    if (high_bytes < 0) {
+        high_bytes = CONSUMER_DEFAULT_HIGH_WATERMARK_BYTES;
+    }
+    if (low_bytes < 0) {
+        low_bytes = high_bytes / 2;
+    }
+    if ((high_messages && low_messages >= high_messages) || (high_bytes && low_bytes >= high_bytes)) {
+        PyErr_SetString(PyExc_ValueError, "low watermarks must be below their high watermarks");
+        return -1;
+    }
+    if (prefetch_ms < 0) {
+        PyErr_SetString(PyExc_ValueError, "prefetch_ms must be >= 0");
+        return -1;
+    }
+    if (prefetch_ms && !high_messages) {
+        PyErr_SetString(PyExc_ValueError, "prefetch_ms needs a message high watermark to adjust");
+        return -1;
+    }
+    
+    // Create and configure the Kafka client. Callbacks find the consumer
+    // through the opaque.
+    rd_kafka_conf_t *conf = rd_kafka_conf_new();
+    rd_kafka_conf_set_opaque(conf, self);
+    rd_kafka_conf_set_stats_cb(conf, stats_cb);
+    rd_kafka_conf_set_rebalance_cb(conf, rebalance_cb);
+
+    // Cooperative rebalancing only moves the partitions that change owner,
+    // so the rest of the group keeps consuming. config may override it.
+    if (rd_kafka_conf_set(conf, "partition.assignment.strategy", "cooperative-sticky",
+                          errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_ValueError, errstr);
+        return -1;
+    }
+
+    if (conf_apply_mapping(conf, config, reserved) < 0) {
+        rd_kafka_conf_destroy(conf);
+        return -1;
+    }
+    
+    if (rd_kafka_conf_set(conf, "bootstrap.servers", bootstrap_servers, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_ValueError, errstr);
+        return -1;
+    }
+    
+    // Without a group the consumer can only be assign()ed partitions.
+    if (group_id && rd_kafka_conf_set(conf, "group.id", group_id, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_ValueError, errstr);
+        return -1;
+    }
+    self->has_group = group_id != NULL;
+    
+    if (rd_kafka_conf_set(conf, "enable.auto.commit", "false", errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_ValueError, errstr);
+        return -1;
+    }
+
+    // Create the consumer instance. This spawns librdkafka's threads, so
+    // let other Python threads run meanwhile.
+    Py_BEGIN_ALLOW_THREADS
+    self->rk = rd_kafka_new(RD_KAFKA_CONSUMER, conf, errstr, sizeof(errstr));
+    Py_END_ALLOW_THREADS
+    if (!self->rk) {
+        // rd_kafka_new() only takes ownership of the conf on success.
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_RuntimeError, errstr);
+        return -1;
+    }
+
+    // Route the main queue (callbacks, errors) into the consumer queue and
+    // keep a handle to it so the poller can drain it in batches.
+    rd_kafka_poll_set_consumer(self->rk);
+    self->rkqu = rd_kafka_queue_get_consumer(self->rk);
+    self->poll_batch_size = (size_t)poll_batch_size;
+    self->poll_timeout_ms = poll_timeout_ms;
+    self->poll_batch = (rd_kafka_message_t **)PyMem_RawMalloc(self->poll_batch_size * sizeof(rd_kafka_message_t *));
+    if (!self->poll_batch) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (self->decoder) {
+        self->poll_notes = (void **)PyMem_RawMalloc(self->poll_batch_size * sizeof(void *));
+        if (!self->poll_notes) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+    if (decode_workers) {
+        int err;
+        Py_BEGIN_ALLOW_THREADS
+        err = decode_pool_start(&self->decode_pool, self->decoder, (size_t)decode_workers);
+        Py_END_ALLOW_THREADS
+        if (err) {
+            errno = err;
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        self->decode_pool_ready = 1;
+    }
+    
+    // Initialize the message queue. A capacity of 0 selects the unbounded
+    // linked-list fallback instead of the fixed-size ring.
+    if (message_queue_init(&self->message_queue, (size_t)queue_capacity) != 0) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->queue_ready = 1;
+    message_queue_set_watermarks(&self->message_queue,
+                                 (size_t)high_messages, (size_t)low_messages,
+                                 (size_t)high_bytes, (size_t)low_bytes);
+    // The configured high mark becomes the ceiling; no buffer is made too
+    // small to take a whole poll batch.
+    if (prefetch_ms) {
+        size_t floor = poll_batch_size > PREFETCH_MIN_MESSAGES ? (size_t)poll_batch_size : PREFETCH_MIN_MESSAGES;
+        self->prefetch_ms = prefetch_ms;
+        self->prefetch_low_share = (double)low_messages / (double)high_messages;
+        prefetch_init(&self->prefetch, prefetch_ms, floor, (size_t)high_messages, 0, monotonic_ms());
+    }
+    if (message_queue_track_dwell(&self->message_queue, &self->metrics.dwell_ns) != 0 ||
+        (self->decoder && message_queue_track_notes(&self->message_queue, self->decoder) != 0)) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // Create the fd the event loop waits on and attach it to the queue. On
+    // a shared poller every consumer signals the poller's loop fd instead,
+    // so one reader serves them all.
+    if (poller) {
+        wakeup_share(&self->wakeup, &((PollerObject *)poller)->loop_wakeup);
+    } else if (wakeup_init(&self->wakeup) != 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    self->wakeup_ready = 1;
+    message_queue_set_wakeup(&self->message_queue, &self->wakeup);
+    event_queue_init(&self->errors, &self->wakeup);
+    self->errors_ready = 1;
+
+    // Commit results reach the event loop through their own fd, or again
+    // through the shared poller's.
+    self->commit_interval_ms = commit_interval_ms;
+    self->commit_every = (size_t)commit_every;
+    self->last_commit_ms = monotonic_ms();
+    if (poller) {
+        wakeup_share(&self->events_wakeup, &((PollerObject *)poller)->loop_wakeup);
+    } else if (wakeup_init(&self->events_wakeup) != 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    event_queue_init(&self->events, &self->events_wakeup);
+    self->events_ready = 1;
+
+    // In partition mode the poller sleeps on its own fd, which the consumer
+    // queue and every split partition queue signal. A shared poller sleeps
+    // on its fd instead, signalled by all of its consumers.
+    self->partition_mode = partition_queues;
+    if (poller) {
+        self->poller = (PollerObject *)Py_NewRef(poller);
+        self->poll_signal = &self->poller->wakeup;
+    } else if (partition_queues) {
+        if (wakeup_init(&self->poll_wakeup) != 0) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        self->poll_wakeup_ready = 1;
+        self->poll_signal = &self->poll_wakeup;
+    }
+    if (self->poll_signal) {
+        rkqueue_set_wakeup(self->rkqu, self->poll_signal);
+    }
+    self->idle_since_ns = metrics_now_ns();
+
+    // Start polling, on a thread of our own or on the shared one.
+    atomic_store(&self->run_poller, 1);
+    if (self->poller) {
+        if (poller_attach(self->poller, consumer_shared_step, self) < 0) {
+            atomic_store(&self->run_poller, 0);
+            return -1;
+        }
+        return 0;
+    }
+    int err;
+    Py_BEGIN_ALLOW_THREADS
+    err = poller_thread_start(&self->poller_thread, poller_thread_func, self, &self->poller_options);
+    Py_END_ALLOW_THREADS
+    if (err) {
+        atomic_store(&self->run_poller, 0);
+        errno = err;
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    self->poller_started = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Releases a commit context and the futures it holds. Requires the GIL.
+ */
+static void
+commit_context_free(CommitContext *ctx) {
+    for (size_t i = 0; i < ctx->count; i++) {
+        Py_DECREF(ctx->futures[i]);
+    }
+    free(ctx);
+}
+
+/**
+ * @brief Frees the contexts of any results that were never delivered to Python.
+ */
+static void
+consumer_discard_events(ConsumerObject *self) {
+    size_t count = event_queue_swap(&self->events, &self->event_batch, &self->event_batch_capacity);
+    for (size_t i = 0; i < count; i++) {
+        if (self->event_batch[i].type == KAFKA_EVENT_REBALANCE) {
+            rd_kafka_topic_partition_list_destroy((rd_kafka_topic_partition_list_t *)self->event_batch[i].opaque);
+        } else if (self->event_batch[i].type == KAFKA_EVENT_REQUEST) {
+            Py_DECREF((PyObject *)self->event_batch[i].opaque);
+        } else {
+            commit_context_free((CommitContext *)self->event_batch[i].opaque);
+        }
+    }
+}
+
+/**
+ * @brief Destroys the errored messages nobody collected.
+ */
+static void
+consumer_discard_errors(ConsumerObject *self) {
+    size_t count = event_queue_swap(&self->errors, &self->error_batch, &self->error_batch_capacity);
+    for (size_t i = 0; i < count; i++) {
+        if (self->error_batch[i].opaque) {
+            rd_kafka_message_destroy((rd_kafka_message_t *)self->error_batch[i].opaque);
+        }
+    }
+}
+
+/**
+ * @brief Deallocates a Consumer object.
+ *
+ * Corresponds to the `__dealloc__` method. It gracefully stops the poller
+ * thread (which closes the consumer on its way out), destroys the Kafka
+ * consumer, cleans up the message queue, and frees the object's memory.
+ * Every blocking step runs with the GIL released, so tearing down one
+ * consumer does not freeze the rest of the process. Message objects keep
+ * their consumer alive, so none can outlive the librdkafka handle.
+ */
+static void
+Consumer_dealloc(ConsumerObject *self) {
+    Py_BEGIN_ALLOW_THREADS
+    // Signal the poller thread to stop and wait for it to exit.
+    atomic_store_explicit(&self->run_poller, 0, memory_order_release);
+    if (self->poller_started) {
+        consumer_wake_poller(self);
+        pthread_join(self->poller_thread, NULL);
+    } else {
+        if (self->poller) {
+            poller_detach(self->poller, self);
+        }
+        if (self->rk && !self->closed) {
+            // Closed here on a shared poller, or init failed before the
+            // poller started.
+            consumer_close_now(self);
+        }
+    }
+
+    // The poller is gone, so nothing hands the workers batches any more.
+    if (self->decode_pool_ready) {
+        decode_pool_stop(&self->decode_pool);
+    }
+
+    // Buffered messages must go back to librdkafka before it is destroyed.
+    if (self->queue_ready) {
+        message_queue_destroy(&self->message_queue);
+    }
+    for (size_t i = 0; i < self->part_count; i++) {
+        partition_queue_free(self->parts[i]);
+    }
+    if (self->errors_ready) {
+        consumer_discard_errors(self);
+    }
+
+    // Clean up Kafka resources.
+    if (self->stats_json) {
+        rd_kafka_mem_free(self->rk, self->stats_json);
+    }
+    if (self->paused) {
+        rd_kafka_topic_partition_list_destroy(self->paused);
+    }
+    if (self->rkqu) {
+        rd_kafka_queue_destroy(self->rkqu);
+    }
+    if (self->rk) {
+        rd_kafka_destroy(self->rk);
+    }
+    Py_END_ALLOW_THREADS
+
+    // Only now can no queue signal the shared poller's fd any more.
+    Py_XDECREF(self->poller);
+    poller_options_clear(&self->poller_options);
+    // Messages hold the consumer, so none still refers to the decoder.
+    Py_XDECREF(self->decoder_spec);
+
+    if (self->wakeup_ready) {
+        wakeup_destroy(&self->wakeup);
+    }
+    PyMem_RawFree(self->poll_batch);
+    PyMem_RawFree(self->poll_notes);
+    pthread_mutex_destroy(&self->close_lock);
+    pthread_cond_destroy(&self->close_cond);
+    message_scratch_destroy(&self->pop_scratch);
+    if (self->poll_wakeup_ready) {
+        wakeup_destroy(&self->poll_wakeup);
+    }
+    free(self->parts);
+    pthread_mutex_destroy(&self->parts_lock);
+
+    // Drop commit results and waiters nobody will see.
+    if (self->events_ready) {
+        consumer_discard_events(self);
+        event_queue_destroy(&self->events);
+        wakeup_destroy(&self->events_wakeup);
+    }
+    for (size_t i = 0; i < self->commit_waiter_count; i++) {
+        Py_DECREF(self->commit_waiters[i]);
+    }
+    PyMem_RawFree(self->commit_waiters);
+    for (size_t i = 0; i < self->request_count; i++) {
+        rd_kafka_topic_partition_list_destroy(self->requests[i].partitions);
+        Py_XDECREF(self->requests[i].future);
+    }
+    PyMem_RawFree(self->requests);
+    Py_XDECREF(self->rebalance_listener);
+    Py_XDECREF(self->anext_waiter);
+    free(self->event_batch);
+    offset_table_destroy(&self->offsets);
+    pthread_mutex_destroy(&self->commit_lock);
+    pthread_mutex_destroy(&self->deliver_lock);
+    Py_XDECREF(self->stats);
+    Py_XDECREF(self->lag);
+    pthread_mutex_destroy(&self->stats_lock);
+    if (self->errors_ready) {
+        event_queue_destroy(&self->errors);
+    }
+    free(self->error_batch);
+    pthread_mutex_destroy(&self->error_lock);
+
+    // Free the Python object.
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Closes the consumer on the poller thread and waits for it.
+ *
+ * Exposed to Python as `Consumer.close()`. The poller thread is told to
+ * stop; it leaves the group with `rd_kafka_consumer_close` and exits. This
+ * call only waits for that to finish, with the GIL released, so the asyncio
+ * wrapper can run it in an executor without holding up the event loop.
+ * Buffered messages remain available to getmany(). The rebalance listener
+ * is dropped by the next deliver_events(), once the revoke this queued has
+ * been delivered. Calling it again after the consumer is closed returns
+ * immediately.
+ *
+ * @return None, or raises KafkaError if the close failed.
+ */
+static PyObject *
+Consumer_close(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->rk) {
+        Py_RETURN_NONE;
+    }
+
+    rd_kafka_resp_err_t err;
+    Py_BEGIN_ALLOW_THREADS
+    atomic_store_explicit(&self->run_poller, 0, memory_order_release);
+    if (self->poller_started) {
+        // Cut a blocking poll short instead of waiting out its timeout.
+        consumer_wake_poller(self);
+    } else {
+        // A shared poller must stop stepping the consumer before it closes
+        // here, on the calling thread.
+        if (self->poller) {
+            poller_detach(self->poller, self);
+        }
+        // Only the first caller closes; the others wait for it below.
+        pthread_mutex_lock(&self->close_lock);
+        int claimed = !self->closed && !self->closing;
+        self->closing = 1;
+        pthread_mutex_unlock(&self->close_lock);
+        if (claimed) {
+            consumer_close_now(self);
+        }
+    }
+    pthread_mutex_lock(&self->close_lock);
+    while (!self->closed) {
+        pthread_cond_wait(&self->close_cond, &self->close_lock);
+    }
+    err = self->close_err;
+    pthread_mutex_unlock(&self->close_lock);
+    Py_END_ALLOW_THREADS
+
+    if (err) {
+        return kafka_error_set(err, NULL);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns whether the consumer has been closed.
+ */
+static PyObject *
+Consumer_get_closed(ConsumerObject *self, void *closure) {
+    pthread_mutex_lock(&self->close_lock);
+    int closed = self->closed;
+    pthread_mutex_unlock(&self->close_lock);
+    return PyBool_FromLong(closed);
+}
+
+/**
+ * @brief Returns the number of errors waiting for errors().
+ */
+static PyObject *
+Consumer_get_pending_errors(ConsumerObject *self, void *closure) {
+    return PyLong_FromSize_t(self->errors_ready ? event_queue_size(&self->errors) : 0);
+}
+
+/**
+ * @brief Returns the coroutine function `__anext__` falls back to, or None.
+ */
+static PyObject *
+Consumer_get_waiter(ConsumerObject *self, void *closure) {
+    pthread_mutex_lock(&self->commit_lock);
+    PyObject *waiter = Py_XNewRef(self->anext_waiter);
+    pthread_mutex_unlock(&self->commit_lock);
+    return waiter ? waiter : Py_NewRef(Py_None);
+}
+
+/**
+ * @brief Sets the coroutine function `__anext__` falls back to.
+ *
+ * It is called without arguments when no message is buffered, and
+ * awaiting its result must return the next message or raise
+ * StopAsyncIteration. None removes it.
+ */
+static int
+Consumer_set_waiter(ConsumerObject *self, PyObject *value, void *closure) {
+    if (value && value != Py_None && !PyCallable_Check(value)) {
+        PyErr_SetString(PyExc_TypeError, "waiter must be callable or None");
+        return -1;
+    }
+    pthread_mutex_lock(&self->commit_lock);
+    PyObject *old = self->anext_waiter;
+    self->anext_waiter = value && value != Py_None ? Py_NewRef(value) : NULL;
+    pthread_mutex_unlock(&self->commit_lock);
+    Py_XDECREF(old);
+    return 0;
+}
+
+/**
+ * @brief Attribute accessors for Consumer objects.
+ */
+static PyGetSetDef Consumer_getset[] = {
+    {"closed", (getter)Consumer_get_closed, NULL, "Whether the consumer has been closed.", NULL},
+    {"pending_errors", (getter)Consumer_get_pending_errors, NULL, "Number of errors waiting for errors().", NULL},
+    {"waiter", (getter)Consumer_get_waiter, (setter)Consumer_set_waiter,
+     "Coroutine function awaited by __anext__ when no message is buffered.", NULL},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Returns the wakeup file descriptor.
+ *
+ * Exposed to Python as `Consumer.fileno()`. The descriptor becomes readable
+ * when the message queue goes from empty to non-empty, so it can be passed
+ * to `loop.add_reader()`. On a shared poller it is the poller's fd, which
+ * the consumer never drains; see `Poller.drain()`.
+ */
+static PyObject *
+Consumer_fileno(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->wakeup_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    return PyLong_FromLong(self->wakeup.read_fd);
+}
+
+/**
+ * @brief Pops up to `max_records` buffered messages without blocking.
+ *
+ * Exposed to Python as `Consumer.getmany(max_records=500)`. All messages are
+ * taken from the queue with one message_queue_pop_batch() call and the result
+ * list is built in a single pass. Several threads may call it concurrently;
+ * each gets a disjoint run of messages. If the queue turns
+ * out to be empty, the wakeup fd is drained and the queue re-armed, so the
+ * next push makes `fileno()` readable again. The fd is left readable while
+ * errors are pending, so they are not missed until errors() collects them.
+ *
+ * @return A list of Message objects, possibly empty.
+ */
+static PyObject *
+Consumer_getmany(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"max_records", NULL};
+    Py_ssize_t max_records = 500;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &max_records))
+        return NULL;
+    if (max_records < 1) {
+        PyErr_SetString(PyExc_ValueError, "max_records must be >= 1");
+        return NULL;
+    }
+    if (!self->queue_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+
+    PyObject *records = message_list_drain(&self->message_queue, &self->wakeup, &self->pop_scratch,
+                                           (size_t)max_records, (PyObject *)self);
+    // An error pushed after the drain signals the fd itself; one pushed
+    // before it is seen here.
+    if (records && event_queue_size(&self->errors)) {
+        wakeup_signal(&self->wakeup);
+    }
+    return records;
+}
+
+/**
+ * @brief Pops the next buffered message.
+ *
+ * Unlike getmany() this does not keep the fd readable for pending errors:
+ * a task iterating the consumer would otherwise wake up for them over and
+ * over. They stay in errors(), and each new one still signals the fd.
+ *
+ * @return A new Message, or NULL with an exception set, or NULL without one
+ *         if the queue is empty.
+ */
+static PyObject *consumer_pop_one(ConsumerObject *self) {
+    rd_kafka_message_t **batch;
+    void **notes;
+    Py_ssize_t popped = message_scratch_pop(&self->message_queue, &self->wakeup, &self->pop_scratch,
+                                            1, &batch, &notes);
+    if (popped <= 0) {
+        return NULL;
+    }
+    PyObject *record = message_new(batch[0], self->message_queue.decoder, notes[0], (PyObject *)self);
+    message_scratch_release(&self->pop_scratch, batch);
+    return record;
+}
+
+/**
+ * @brief Pops one buffered message without blocking.
+ *
+ * Exposed to Python as `Consumer.getone()`.
+ *
+ * @return A Message, or None if the queue is empty.
+ */
+static PyObject *
+Consumer_getone(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->queue_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    PyObject *record = consumer_pop_one(self);
+    if (!record && !PyErr_Occurred()) {
+        Py_RETURN_NONE;
+    }
+    return record;
+}
+
+/**
+ * @brief Returns the consumer itself as its async iterator.
+ */
+static PyObject *
+Consumer_aiter(ConsumerObject *self) {
+    return Py_NewRef(self);
+}
+
+/**
+ * @brief Returns an awaitable for the next message.
+ *
+ * `async for message in consumer` calls this once per message. While the
+ * queue holds messages the awaitable is already completed, so the loop
+ * body runs again without an asyncio Future or a trip through the event
+ * loop. Once the consumer is closed and drained it raises
+ * StopAsyncIteration. Otherwise the call is passed on to `waiter`, which
+ * waits for the fd.
+ *
+ * @return An awaitable, or NULL with an exception set.
+ */
+static PyObject *
+Consumer_anext(ConsumerObject *self) {
+    if (!self->queue_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    PyObject *record = consumer_pop_one(self);
+    if (record) {
+        return completed_new(record);
+    }
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&self->close_lock);
+    int closed = self->closed;
+    pthread_mutex_unlock(&self->close_lock);
+    if (closed) {
+        // The poller pushes its last messages before it marks the consumer
+        // closed, so one more pop sees them all.
+        record = consumer_pop_one(self);
+        if (!record && PyErr_Occurred()) {
+            return NULL;
+        }
+        return completed_new(record);
+    }
+
+    pthread_mutex_lock(&self->commit_lock);
+    PyObject *waiter = Py_XNewRef(self->anext_waiter);
+    pthread_mutex_unlock(&self->commit_lock);
+    if (!waiter) {
+        PyErr_SetString(PyExc_RuntimeError, "no message is buffered and Consumer.waiter is not set");
+        return NULL;
+    }
+    PyObject *awaitable = PyObject_CallNoArgs(waiter);
+    Py_DECREF(waiter);
+    return awaitable;
+}
+
+/**
+ * @brief Async iteration slots for Consumer objects.
+ */
+static PyAsyncMethods Consumer_as_async = {
+    .am_aiter = (unaryfunc)Consumer_aiter,
+    .am_anext = (unaryfunc)Consumer_anext,
+};
+
+/**
+ * @brief Pops up to `max_records` buffered messages as columns.
+ *
+ * Exposed to Python as `Consumer.getmany_columnar(max_records=500)`. Pops
+ * like getmany(), but copies the batch straight into a ColumnarBatch, whose
+ * columns export the buffer protocol, instead of creating a Message per
+ * record. Pass the batch to store_offsets() once it has been processed.
+ *
+ * @return A ColumnarBatch, possibly empty.
+ */
+static PyObject *
+Consumer_getmany_columnar(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"max_records", NULL};
+    Py_ssize_t max_records = 500;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &max_records))
+        return NULL;
+    if (max_records < 1) {
+        PyErr_SetString(PyExc_ValueError, "max_records must be >= 1");
+        return NULL;
+    }
+    if (!self->queue_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+
+    PyObject *batch = columnar_batch_drain(&self->message_queue, &self->wakeup, &self->pop_scratch,
+                                           (size_t)max_records);
+    if (batch && event_queue_size(&self->errors)) {
+        wakeup_signal(&self->wakeup);
+    }
+    return batch;
+}
+
+/**
+ * @brief Collects the pending consumer errors.
+ *
+ * Exposed to Python as `Consumer.errors()`. Errored messages (partition EOF
+ * when `enable.partition.eof` is set, transport failures, offsets out of
+ * range, ...) are kept out of the message queue and returned here in the
+ * order they arrived, as KafkaError instances with `topic`, `partition` and
+ * `offset` attributes. If another thread is collecting right now this
+ * returns an empty list at once.
+ *
+ * @return A list of KafkaError objects, possibly empty.
+ */
+static PyObject *
+Consumer_errors(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->errors_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    if (pthread_mutex_trylock(&self->error_lock) != 0) {
+        return PyList_New(0);
+    }
+    size_t count = event_queue_swap(&self->errors, &self->error_batch, &self->error_batch_capacity);
+    PyObject *list = PyList_New((Py_ssize_t)count);
+    for (size_t i = 0; i < count; i++) {
+        rd_kafka_message_t *message = (rd_kafka_message_t *)self->error_batch[i].opaque;
+        if (list) {
+            PyObject *exc = message ? kafka_error_from_message(message)
+                                    : kafka_error_new(self->error_batch[i].err, NULL);
+            if (exc) {
+                PyList_SET_ITEM(list, (Py_ssize_t)i, exc);
+            } else {
+                Py_CLEAR(list);
+            }
+        }
+        // The rest are still destroyed if building the list failed.
+        if (message) {
+            rd_kafka_message_destroy(message);
+        }
+    }
+    pthread_mutex_unlock(&self->error_lock);
+    return list;
+}
+
+/**
+ * @brief Subscribes to a list of topics.
+ *
+ * Exposed to Python as `Consumer.subscribe(topics, listener=None)`. The
+ * assignment follows from the group's rebalances, which the poller applies
+ * in rebalance_cb(). If `listener` is given it is called from
+ * deliver_events() with `(assigned, partitions)` after each change; None
+ * removes a previous listener.
+ *
+ * @return None, or raises KafkaError if librdkafka rejected the subscription.
+ */
+static PyObject *
+Consumer_subscribe(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"topics", "listener", NULL};
+    PyObject *topics;
+    PyObject *listener = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &topics, &listener))
+        return NULL;
+    if (!self->rk) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    if (listener != Py_None && !PyCallable_Check(listener)) {
+        PyErr_SetString(PyExc_TypeError, "listener must be callable or None");
+        return NULL;
+    }
+    if (PyUnicode_Check(topics)) {
+        PyErr_SetString(PyExc_TypeError, "topics must be a sequence of str, not a str");
+        return NULL;
+    }
+    PyObject *seq = PySequence_Fast(topics, "topics must be a sequence of str");
+    if (!seq) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    rd_kafka_topic_partition_list_t *list = rd_kafka_topic_partition_list_new((int)count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+        const char *name = PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : NULL;
+        if (!name) {
+            if (!PyErr_Occurred()) {
+                PyErr_Format(PyExc_TypeError, "topic names must be str, not %.100s", Py_TYPE(item)->tp_name);
+            }
+            rd_kafka_topic_partition_list_destroy(list);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        rd_kafka_topic_partition_list_add(list, name, RD_KAFKA_PARTITION_UA);
+    }
+    Py_DECREF(seq);
+
+    // Install the listener first so the first assignment is not missed.
+    pthread_mutex_lock(&self->commit_lock);
+    PyObject *old = self->rebalance_listener;
+    self->rebalance_listener = listener == Py_None ? NULL : Py_NewRef(listener);
+    pthread_mutex_unlock(&self->commit_lock);
+    atomic_store_explicit(&self->report_rebalance, listener != Py_None, memory_order_relaxed);
+    Py_XDECREF(old);
+
+    rd_kafka_resp_err_t err;
+    Py_BEGIN_ALLOW_THREADS
+    err = rd_kafka_subscribe(self->rk, list);
+    Py_END_ALLOW_THREADS
+    rd_kafka_topic_partition_list_destroy(list);
+    if (err) {
+        return kafka_error_set(err, NULL);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns the queue of one partition, splitting it off if needed.
+ *
+ * Exposed to Python as `Consumer.partition(topic, partition)`. Requires a
+ * consumer created with `partition_queues=True`. The first call for a
+ * partition detaches it from the consumer queue; from then on its messages
+ * only arrive through the returned handle, in offset order. Later calls
+ * return a handle over the same queue.
+ *
+ * Split a partition before its fetch starts: messages librdkafka already
+ * forwarded to the consumer queue are still returned by `getmany()`.
+ *
+ * @return A PartitionQueue handle.
+ */
+static PyObject *
+Consumer_partition(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"topic", "partition", NULL};
+    const char *topic;
+    int partition;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "si", kwlist, &topic, &partition))
+        return NULL;
+    if (!self->partition_mode) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "partition queues are disabled; create the consumer with partition_queues=True");
+        return NULL;
+    }
+    if (partition < 0) {
+        PyErr_SetString(PyExc_ValueError, "partition must be >= 0");
+        return NULL;
+    }
+
+    // The poller only holds the lock for a non-blocking sweep and never
+    // needs the GIL, so taking it here cannot deadlock.
+    PartitionQueue *part = NULL;
+    pthread_mutex_lock(&self->parts_lock);
+    for (size_t i = 0; i < self->part_count; i++) {
+        if (self->parts[i]->partition == partition && strcmp(self->parts[i]->topic, topic) == 0) {
+            part = self->parts[i];
+            break;
+        }
+    }
+    if (!part) {
+        if (self->part_count == self->part_capacity) {
+            size_t capacity = self->part_capacity ? self->part_capacity * 2 : 16;
+            PartitionQueue **grown = realloc(self->parts, capacity * sizeof(PartitionQueue *));
+            if (!grown) {
+                pthread_mutex_unlock(&self->parts_lock);
+                return PyErr_NoMemory();
+            }
+            self->parts = grown;
+            self->part_capacity = capacity;
+        }
+        part = partition_queue_new(self->rk, topic, partition, &self->message_queue, self->poll_signal);
+        if (!part) {
+            pthread_mutex_unlock(&self->parts_lock);
+            return NULL;
+        }
+        consumer_init_partition_prefetch(self, part);
+        self->parts[self->part_count++] = part;
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+
+    // Pick up anything that reached the partition queue before the poller
+    // was told to watch it.
+    wakeup_signal(self->poll_signal);
+    return partition_queue_object_new(part, (PyObject *)self);
+}
+
+/**
+ * @brief Records one message's offset in the offset table. Requires the table lock.
+ *
+ * @return 0 on success, -1 with an exception set.
+ */
+static int
+consumer_store_message(ConsumerObject *self, PyObject *obj) {
+    if (!PyObject_TypeCheck(obj, &MessageType)) {
+        PyErr_Format(PyExc_TypeError, "expected a Message, got %.200s", Py_TYPE(obj)->tp_name);
+        return -1;
+    }
+    const rd_kafka_message_t *rkmessage = ((MessageObject *)obj)->rkmessage;
+    if (offset_table_store_locked(&self->offsets, rd_kafka_topic_name(rkmessage->rkt),
+                                  rkmessage->partition, rkmessage->offset) != 0) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Marks a message as processed.
+ *
+ * Exposed to Python as `Consumer.store_offset(message)`. Only the C-side
+ * offset table is updated; the offset is committed by the next flush (see
+ * commit(), `commit_interval_ms` and `commit_every`). Offsets never move
+ * backwards.
+ *
+ * @return None.
+ */
+static PyObject *
+Consumer_store_offset(ConsumerObject *self, PyObject *message) {
+    offset_table_lock(&self->offsets);
+    int rc = consumer_store_message(self, message);
+    offset_table_unlock(&self->offsets);
+    if (rc < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Marks a batch of messages as processed.
+ *
+ * Exposed to Python as `Consumer.store_offsets(messages)`, typically with
+ * the list returned by getmany() or a ColumnarBatch from
+ * getmany_columnar(). The table lock is taken once.
+ *
+ * @return None.
  */
-typedef struct {
-    PyObject_HEAD             // Standard Python object header.
-    rd_kafka_t *rk;           // Handle to the librdkafka consumer instance.
-    pthread_t poller_thread;  // Identifier for the background polling thread.
-    int run_poller;           // Flag to control the lifecycle of the poller thread.
-    MessageQueue message_queue; // Thread-safe queue to store fetched messages.
-} ConsumerObject;
+static PyObject *
+Consumer_store_offsets(ConsumerObject *self, PyObject *messages) {
+    if (PyObject_TypeCheck(messages, &ColumnarBatchType)) {
+        offset_table_lock(&self->offsets);
+        int rc = columnar_batch_store_offsets((ColumnarBatchObject *)messages, &self->offsets);
+        offset_table_unlock(&self->offsets);
+        if (rc < 0) {
+            return NULL;
+        }
+        Py_RETURN_NONE;
+    }
+    PyObject *seq = PySequence_Fast(messages, "messages must be iterable");
+    if (!seq) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    int rc = 0;
+    offset_table_lock(&self->offsets);
+    for (Py_ssize_t i = 0; i < count && rc == 0; i++) {
+        rc = consumer_store_message(self, items[i]);
+    }
+    offset_table_unlock(&self->offsets);
+    Py_DECREF(seq);
+    if (rc < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
 
 /**
- * @brief The background thread function for polling Kafka messages.
+ * @brief Asks the poller to commit the stored offsets now.
  *
- * This function runs in a separate thread and continuously polls the Kafka
- * consumer for new messages, pushing them into a thread-safe queue.
+ * Exposed to Python as `Consumer.commit(future=None)`. Never blocks: the
+ * poller commits everything stored so far with one asynchronous request,
+ * and `future`, if given, is resolved with None or a KafkaError by the
+ * deliver_events() call that handles the result. Commits requested before
+ * the poller gets to them are coalesced into that one request.
  *
- * @param arg A void pointer to the ConsumerObject instance.
- * @return Always returns NULL.
+ * @return None.
  */
-static void *poller_thread_func(void *arg) {
-    ConsumerObject *self = (ConsumerObject *)arg;
-    while (self->run_poller) {
-        // Poll for a message, with a 1-second timeout.
-        rd_kafka_message_t *message = rd_kafka_consumer_poll(self->rk, 1000);
-        if (message) {
-            if (message->err) {
-                // On error, simply destroy the message.
-                rd_kafka_message_destroy(message);
-            } else {
-                // On success, push the message onto the queue.
-                message_queue_push(&self->message_queue, message);
+static PyObject *
+Consumer_commit(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"future", NULL};
+    PyObject *future = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", kwlist, &future))
+        return NULL;
+    if (!self->events_ready || !atomic_load(&self->run_poller)) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is closed");
+        return NULL;
+    }
+    if (!self->has_group) {
+        PyErr_SetString(PyExc_RuntimeError, "commit() needs a consumer created with a group_id");
+        return NULL;
+    }
+    if (atomic_load_explicit(&self->transactional, memory_order_acquire)) {
+        PyErr_SetString(PyExc_RuntimeError, "offsets are committed by the producer's transactions");
+        return NULL;
+    }
+
+    if (future != Py_None) {
+        pthread_mutex_lock(&self->commit_lock);
+        if (self->commit_waiter_count == self->commit_waiter_capacity) {
+            size_t capacity = self->commit_waiter_capacity ? self->commit_waiter_capacity * 2 : 16;
+            PyObject **grown = PyMem_RawRealloc(self->commit_waiters, capacity * sizeof(PyObject *));
+            if (!grown) {
+                pthread_mutex_unlock(&self->commit_lock);
+                return PyErr_NoMemory();
             }
+            self->commit_waiters = grown;
+            self->commit_waiter_capacity = capacity;
         }
+        self->commit_waiters[self->commit_waiter_count++] = Py_NewRef(future);
+        pthread_mutex_unlock(&self->commit_lock);
     }
-    return NULL;
+
+    atomic_store_explicit(&self->commit_requested, 1, memory_order_release);
+    consumer_wake_poller(self);
+    Py_RETURN_NONE;
 }
 
 /**
- * @brief Allocates a new Consumer object.
+ * @brief Builds a partition list from a sequence of tuples.
  *
- * This corresponds to the `__new__` method in Python.
+ * Accepts `(topic, partition, value)` tuples, or `(topic, partition)` when
+ * `value_optional` is set, in which case the offset is `default_value`.
+ *
+ * @param items The sequence.
+ * @param what Named in error messages.
+ * @return A new list, or NULL with an exception set.
  */
-static PyObject *
-Consumer_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
-    ConsumerObject *self;
-    self = (ConsumerObject *)type->tp_alloc(type, 0);
-    return (PyObject *)self;
+static rd_kafka_topic_partition_list_t *
+partition_list_from_tuples(PyObject *items, const char *what, int value_optional, int64_t default_value) {
+    PyObject *seq = PySequence_Fast(items, "expected a sequence of tuples");
+    if (!seq) {
+        return NULL;
+    }
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    rd_kafka_topic_partition_list_t *list = rd_kafka_topic_partition_list_new((int)(n ? n : 1));
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+        const char *topic;
+        int partition;
+        long long value = default_value;
+        int parsed = value_optional
+                         ? PyArg_ParseTuple(item, "si|L", &topic, &partition, &value)
+                         : PyArg_ParseTuple(item, "siL", &topic, &partition, &value);
+        if (!parsed) {
+            PyErr_Format(PyExc_TypeError, "%s entries must be %s tuples", what,
+                         value_optional ? "(topic, partition[, offset])" : "(topic, partition, value)");
+            rd_kafka_topic_partition_list_destroy(list);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        rd_kafka_topic_partition_list_add(list, topic, partition)->offset = value;
+    }
+    Py_DECREF(seq);
+    return list;
 }
 
 /**
- * @brief Initializes a Consumer object.
+ * @brief Hands a seek or assignment to the poller.
  *
- * Corresponds to the `__init__` method in Python. It sets up the librdkafka
- * consumer, initializes the message queue, and starts the background poller thread.
+ * Takes ownership of `partitions` on success and on failure.
  *
- * @param self The ConsumerObject to initialize.
- * @param args Python arguments (bootstrap_servers, group_id).
- * @param kwds Python keyword arguments (unused).
- * @return 0 on success, -1 on failure.
+ * @return 0, or -1 with an exception set.
  */
 static int
-Consumer_init(ConsumerObject *self, PyObject *args, PyObject *kwds) {
-    char *bootstrap_servers;
-    char *group_id;
-    char errstr[512];
-
-    // Parse Python arguments.
-    if (!PyArg_ParseTuple(args, "ss", &bootstrap_servers, &group_id))
-        return -1;
-    
-    // Create and configure the Kafka client.
-    rd_kafka_conf_t *conf = rd_kafka_conf_new();
-    
-    if (rd_kafka_conf_set(conf, "bootstrap.servers", bootstrap_servers, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-        PyErr_SetString(PyExc_ValueError, errstr);
+consumer_submit(ConsumerObject *self, ConsumerRequestType type,
+                rd_kafka_topic_partition_list_t *partitions, PyObject *future) {
+    if (!self->events_ready || !atomic_load(&self->run_poller)) {
+        rd_kafka_topic_partition_list_destroy(partitions);
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is closed");
         return -1;
     }
-    
-    if (rd_kafka_conf_set(conf, "group.id", group_id, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-        PyErr_SetString(PyExc_ValueError, errstr);
-        return -1;
+    pthread_mutex_lock(&self->commit_lock);
+    if (self->request_count == self->request_capacity) {
+        size_t capacity = self->request_capacity ? self->request_capacity * 2 : 8;
+        ConsumerRequest *grown = PyMem_RawRealloc(self->requests, capacity * sizeof(ConsumerRequest));
+        if (!grown) {
+            pthread_mutex_unlock(&self->commit_lock);
+            rd_kafka_topic_partition_list_destroy(partitions);
+            PyErr_NoMemory();
+            return -1;
+        }
+        self->requests = grown;
+        self->request_capacity = capacity;
     }
-    
-    if (rd_kafka_conf_set(conf, "enable.auto.commit", "false", errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-        PyErr_SetString(PyExc_ValueError, errstr);
-        return -1;
+    self->requests[self->request_count++] = (ConsumerRequest){
+        .type = type,
+        .partitions = partitions,
+        .future = future != Py_None ? Py_NewRef(future) : NULL,
+    };
+    pthread_mutex_unlock(&self->commit_lock);
+
+    atomic_store_explicit(&self->requests_pending, 1, memory_order_release);
+    consumer_wake_poller(self);
+    return 0;
+}
+
+/**
+ * @brief Asks the poller to move partitions to new offsets.
+ *
+ * Exposed to Python as `Consumer.seek(offsets, future=None)`, with
+ * `offsets` a sequence of `(topic, partition, offset)`. Never blocks: the
+ * poller seeks between two batches and makes the queues skip everything
+ * already buffered for those partitions, so the next message popped for
+ * each is the one at its new offset. `future`, if given, is resolved with
+ * None or a KafkaError by deliver_events().
+ *
+ * @return None.
+ */
+static PyObject *
+Consumer_seek(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"offsets", "future", NULL};
+    PyObject *offsets;
+    PyObject *future = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &offsets, &future))
+        return NULL;
+    rd_kafka_topic_partition_list_t *list = partition_list_from_tuples(offsets, "offsets", 0, 0);
+    if (!list) {
+        return NULL;
     }
+    if (consumer_submit(self, CONSUMER_REQUEST_SEEK, list, future) != 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
 
-    // Create the consumer instance.
-    self->rk = rd_kafka_new(RD_KAFKA_CONSUMER, conf, errstr, sizeof(errstr));
+/**
+ * @brief Asks the poller to replace the assignment.
+ *
+ * Exposed to Python as `Consumer.assign(partitions, future=None)`, with
+ * `partitions` a sequence of `(topic, partition[, offset])`; partitions
+ * without an offset start from the committed one. Meant for consumers not
+ * in a group, or not subscribed. Messages buffered for the previous
+ * assignment are discarded. `future` is resolved like for seek().
+ *
+ * @return None.
+ */
+static PyObject *
+Consumer_assign(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"partitions", "future", NULL};
+    PyObject *partitions;
+    PyObject *future = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, &partitions, &future))
+        return NULL;
+    rd_kafka_topic_partition_list_t *list =
+        partition_list_from_tuples(partitions, "partitions", 1, RD_KAFKA_OFFSET_INVALID);
+    if (!list) {
+        return NULL;
+    }
+    if (consumer_submit(self, CONSUMER_REQUEST_ASSIGN, list, future) != 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Looks up the first offsets at or after given timestamps.
+ *
+ * Exposed to Python as `Consumer.offsets_for_times(timestamps,
+ * timeout_ms=10000)`, with `timestamps` a sequence of `(topic, partition,
+ * timestamp_ms)`. Blocks on the brokers without the GIL; the result is a
+ * list of `(topic, partition, offset)`, -1 where no message is that recent,
+ * ready to pass to seek().
+ *
+ * @return The list, or NULL with a KafkaError set.
+ */
+static PyObject *
+Consumer_offsets_for_times(ConsumerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timestamps", "timeout_ms", NULL};
+    PyObject *timestamps;
+    int timeout_ms = CONSUMER_DEFAULT_LOOKUP_TIMEOUT_MS;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, &timestamps, &timeout_ms))
+        return NULL;
     if (!self->rk) {
-        PyErr_SetString(PyExc_RuntimeError, errstr);
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    rd_kafka_topic_partition_list_t *list = partition_list_from_tuples(timestamps, "timestamps", 0, 0);
+    if (!list) {
+        return NULL;
+    }
+
+    rd_kafka_resp_err_t err;
+    Py_BEGIN_ALLOW_THREADS
+    err = rd_kafka_offsets_for_times(self->rk, list, timeout_ms);
+    Py_END_ALLOW_THREADS
+    for (int i = 0; !err && i < list->cnt; i++) {
+        err = list->elems[i].err;
+    }
+    if (err) {
+        rd_kafka_topic_partition_list_destroy(list);
+        return kafka_error_set(err, "offsets_for_times failed");
+    }
+
+    PyObject *result = PyList_New(list->cnt);
+    for (int i = 0; result && i < list->cnt; i++) {
+        PyObject *item = Py_BuildValue("(siL)", list->elems[i].topic, (int)list->elems[i].partition,
+                                       (long long)list->elems[i].offset);
+        if (!item) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, item);
+    }
+    rd_kafka_topic_partition_list_destroy(list);
+    return result;
+}
+
+/**
+ * @brief Returns the fd that becomes readable when commit results are pending.
+ *
+ * Exposed to Python as `Consumer.events_fileno()`, for use with
+ * `loop.add_reader(consumer.events_fileno(), consumer.deliver_events)`.
+ */
+static PyObject *
+Consumer_events_fileno(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->events_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    return PyLong_FromLong(self->events_wakeup.read_fd);
+}
+
+/**
+ * @brief Builds the result of a successful commit.
+ */
+static PyObject *
+commit_result(const KafkaEvent *event) {
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Drops the rebalance listener, so a closed consumer holds no callbacks.
+ */
+static void
+consumer_clear_listener(ConsumerObject *self) {
+    atomic_store_explicit(&self->report_rebalance, 0, memory_order_relaxed);
+    pthread_mutex_lock(&self->commit_lock);
+    PyObject *listener = self->rebalance_listener;
+    self->rebalance_listener = NULL;
+    pthread_mutex_unlock(&self->commit_lock);
+    Py_XDECREF(listener);
+}
+
+/**
+ * @brief Calls the rebalance listener for one assignment change.
+ *
+ * The listener gets `(assigned, [(topic, partition), ...])`. An exception
+ * it raises is reported as unraisable, so the remaining events are still
+ * delivered.
+ */
+static void
+consumer_notify_rebalance(ConsumerObject *self, const KafkaEvent *event) {
+    const rd_kafka_topic_partition_list_t *partitions = (const rd_kafka_topic_partition_list_t *)event->opaque;
+    pthread_mutex_lock(&self->commit_lock);
+    PyObject *listener = Py_XNewRef(self->rebalance_listener);
+    pthread_mutex_unlock(&self->commit_lock);
+    if (!listener) {
+        return;
+    }
+    PyObject *list = PyList_New(partitions->cnt);
+    for (int i = 0; list && i < partitions->cnt; i++) {
+        PyObject *item = Py_BuildValue("(si)", partitions->elems[i].topic, (int)partitions->elems[i].partition);
+        if (!item) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    PyObject *result = NULL;
+    if (list) {
+        result = PyObject_CallFunction(listener, "OO",
+                                       event->err == RD_KAFKA_RESP_ERR__ASSIGN_PARTITIONS ? Py_True : Py_False,
+                                       list);
+        Py_DECREF(list);
+    }
+    if (result) {
+        Py_DECREF(result);
+    } else {
+        PyErr_WriteUnraisable(listener);
+    }
+    Py_DECREF(listener);
+}
+
+/**
+ * @brief Delivers all pending commit, seek and assign() results and rebalance
+ * notifications.
+ *
+ * Exposed to Python as `Consumer.deliver_events()`. Mirrors
+ * `Producer.deliver()`: the whole batch is swapped out under one lock
+ * acquisition and handled in a single pass, in the order the poller queued
+ * it. If another thread is already delivering, this returns 0 at once.
+ *
+ * @return The number of events handled.
+ */
+static PyObject *
+Consumer_deliver_events(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->events_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    if (pthread_mutex_trylock(&self->deliver_lock) != 0) {
+        return PyLong_FromLong(0);
+    }
+    // The close queues its last revoke before the consumer is marked
+    // closed, so once it is closed before the swap, this batch is the last
+    // one the listener is needed for.
+    pthread_mutex_lock(&self->close_lock);
+    int closed = self->closed;
+    pthread_mutex_unlock(&self->close_lock);
+    // Clear the fd first: anything queued after the swap signals it again.
+    wakeup_drain(&self->events_wakeup);
+    size_t count = event_queue_swap(&self->events, &self->event_batch, &self->event_batch_capacity);
+    for (size_t i = 0; i < count; i++) {
+        const KafkaEvent *event = &self->event_batch[i];
+        if (event->type == KAFKA_EVENT_REBALANCE) {
+            consumer_notify_rebalance(self, event);
+            rd_kafka_topic_partition_list_destroy((rd_kafka_topic_partition_list_t *)event->opaque);
+            continue;
+        }
+        if (event->type == KAFKA_EVENT_REQUEST) {
+            future_resolve((PyObject *)event->opaque, event, commit_result);
+            Py_DECREF((PyObject *)event->opaque);
+            continue;
+        }
+        CommitContext *ctx = (CommitContext *)event->opaque;
+        for (size_t j = 0; j < ctx->count; j++) {
+            future_resolve(ctx->futures[j], event, commit_result);
+        }
+        commit_context_free(ctx);
+    }
+    if (closed) {
+        consumer_clear_listener(self);
+    }
+    pthread_mutex_unlock(&self->deliver_lock);
+    return PyLong_FromSize_t(count);
+}
+
+/**
+ * @brief Reports the message queue's node pool usage.
+ *
+ * Exposed to Python as `Consumer.pool_stats()`. `in_use` and `high_water`
+ * are only tracked in builds made with ASYNKAF_POOL_STATS, as reported by
+ * the `tracked` key.
+ *
+ * @return A dict with `capacity`, `in_use`, `high_water` and `tracked`.
+ */
+static PyObject *
+Consumer_pool_stats(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->queue_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    NodePoolStats stats;
+    message_queue_pool_stats(&self->message_queue, &stats);
+#ifdef ASYNKAF_POOL_STATS
+    PyObject *tracked = Py_True;
+#else
+    PyObject *tracked = Py_False;
+#endif
+    return Py_BuildValue("{s:n,s:n,s:n,s:O}",
+                         "capacity", (Py_ssize_t)stats.capacity,
+                         "in_use", (Py_ssize_t)stats.in_use,
+                         "high_water", (Py_ssize_t)stats.high_water,
+                         "tracked", tracked);
+}
+
+/**
+ * @brief Extracts the consumer lag of every partition from parsed statistics.
+ *
+ * Walks `stats["topics"][name]["partitions"]`, skipping librdkafka's
+ * internal partition -1 and partitions whose lag is not known yet (-1).
+ *
+ * @return A new dict mapping `(topic, partition)` to the lag, or NULL on
+ *         failure.
+ */
+static PyObject *stats_consumer_lag(PyObject *stats) {
+    PyObject *lag = PyDict_New();
+    if (!lag) {
+        return NULL;
+    }
+    // `stats` was just parsed and is not shared yet, so borrowed references
+    // into it stay valid.
+    PyObject *topics = PyDict_Check(stats) ? PyDict_GetItemString(stats, "topics") : NULL;
+    if (!topics || !PyDict_Check(topics)) {
+        return lag;
+    }
+    PyObject *name;
+    PyObject *topic;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(topics, &pos, &name, &topic)) {
+        PyObject *partitions = PyDict_Check(topic) ? PyDict_GetItemString(topic, "partitions") : NULL;
+        if (!partitions || !PyDict_Check(partitions)) {
+            continue;
+        }
+        PyObject *key;
+        PyObject *partition;
+        Py_ssize_t ppos = 0;
+        while (PyDict_Next(partitions, &ppos, &key, &partition)) {
+            if (!PyDict_Check(partition)) {
+                continue;
+            }
+            PyObject *id = PyDict_GetItemString(partition, "partition");
+            PyObject *value = PyDict_GetItemString(partition, "consumer_lag");
+            if (!id || !value || !PyLong_Check(id) || !PyLong_Check(value) ||
+                PyLong_AsLong(id) < 0 || PyLong_AsLongLong(value) < 0) {
+                PyErr_Clear();
+                continue;
+            }
+            PyObject *tp = PyTuple_Pack(2, name, id);
+            if (!tp || PyDict_SetItem(lag, tp, value) < 0) {
+                Py_XDECREF(tp);
+                Py_DECREF(lag);
+                return NULL;
+            }
+            Py_DECREF(tp);
+        }
+    }
+    return lag;
+}
+
+/**
+ * @brief Parses the statistics JSON the poller received since the last call.
+ *
+ * The parsed dict and its lag summary replace the cached ones. Parsing runs
+ * without `stats_lock`, so the poller is never held up by it.
+ *
+ * @return 0 on success (including when there is nothing new), -1 with an
+ *         exception set on failure.
+ */
+static int consumer_parse_stats(ConsumerObject *self) {
+    pthread_mutex_lock(&self->stats_lock);
+    char *json = self->stats_json;
+    size_t json_len = self->stats_json_len;
+    self->stats_json = NULL;
+    pthread_mutex_unlock(&self->stats_lock);
+    if (!json) {
+        return 0;
+    }
+
+    PyObject *text = PyUnicode_DecodeUTF8(json, (Py_ssize_t)json_len, "replace");
+    rd_kafka_mem_free(self->rk, json);
+    if (!text) {
+        return -1;
+    }
+    PyObject *module = PyImport_ImportModule("json");
+    PyObject *stats = module ? PyObject_CallMethod(module, "loads", "O", text) : NULL;
+    Py_XDECREF(module);
+    Py_DECREF(text);
+    if (!stats) {
+        return -1;
+    }
+    PyObject *lag = stats_consumer_lag(stats);
+    if (!lag) {
+        Py_DECREF(stats);
         return -1;
     }
-    
-    // Initialize the message queue.
-    message_queue_init(&self->message_queue);
-    
-    // Start the background poller thread.
-    self->run_poller = 1;
-    pthread_create(&self->poller_thread, NULL, poller_thread_func, self);
 
+    pthread_mutex_lock(&self->stats_lock);
+    PyObject *old_stats = self->stats;
+    PyObject *old_lag = self->lag;
+    self->stats = stats;
+    self->lag = lag;
+    pthread_mutex_unlock(&self->stats_lock);
+    // Released outside the lock: a destructor may run arbitrary code.
+    Py_XDECREF(old_stats);
+    Py_XDECREF(old_lag);
     return 0;
 }
 
 /**
- * @brief Deallocates a Consumer object.
+ * @brief Returns a snapshot of the consumer's pipeline metrics.
  *
- * Corresponds to the `__dealloc__` method. It gracefully stops the poller
- * thread, closes and destroys the Kafka consumer, cleans up the message
- * queue, and frees the object's memory.
+ * Exposed to Python as `Consumer.metrics()`. Counters and histograms are
+ * read with relaxed atomic loads, so taking a snapshot never stalls the
+ * poller. Rates cover the time since the previous call (or since the
+ * consumer was created). `stats` and `lag` come from librdkafka's
+ * statistics, which are only emitted when `statistics.interval.ms` is set
+ * through `config`; until then they are None and empty.
+ *
+ * @return A dict with the totals `messages`, `bytes`, `errors`,
+ *         `errors_dropped`, `messages_dropped`, `decode_errors` and `polls`;
+ *         `messages_per_sec` and `errors_per_sec`; the current `queue_size`
+ *         and `queue_bytes` summed over the consumer queue and every split
+ *         partition; histogram summaries `poll_ns`, `dwell_ns`,
+ *         `queue_depth` and `queue_depth_bytes`; and `stats` and `lag`.
  */
-static void
-Consumer_dealloc(ConsumerObject *self) {
-    // Signal the poller thread to stop and wait for it to exit.
-    self->run_poller = 0;
-    pthread_join(self->poller_thread, NULL);
+static PyObject *
+Consumer_metrics(ConsumerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->queue_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Consumer is not initialized");
+        return NULL;
+    }
+    if (consumer_parse_stats(self) < 0) {
+        return NULL;
+    }
 
-    // Clean up Kafka resources.
-    rd_kafka_consumer_close(self->rk);
-    rd_kafka_destroy(self->rk);
+    ConsumerMetrics *m = &self->metrics;
+    uint64_t messages = atomic_load_explicit(&m->messages, memory_order_relaxed);
+    uint64_t errors = atomic_load_explicit(&m->errors, memory_order_relaxed);
+    uint64_t now = metrics_now_ns();
 
-    // Clean up the message queue.
-    message_queue_destroy(&self->message_queue);
+    pthread_mutex_lock(&self->stats_lock);
+    double elapsed = (double)(now - self->rate_ns) / 1e9;
+    double messages_rate = elapsed > 0 ? (double)(messages - self->rate_messages) / elapsed : 0.0;
+    double errors_rate = elapsed > 0 ? (double)(errors - self->rate_errors) / elapsed : 0.0;
+    self->rate_ns = now;
+    self->rate_messages = messages;
+    self->rate_errors = errors;
+    PyObject *stats = self->stats ? Py_NewRef(self->stats) : Py_NewRef(Py_None);
+    PyObject *lag = self->lag ? Py_NewRef(self->lag) : PyDict_New();
+    pthread_mutex_unlock(&self->stats_lock);
 
-    // Free the Python object.
-    Py_TYPE(self)->tp_free((PyObject *)self);
+    size_t queue_size = message_queue_size(&self->message_queue);
+    size_t queue_bytes = message_queue_bytes(&self->message_queue);
+    pthread_mutex_lock(&self->parts_lock);
+    size_t prefetch_messages = self->prefetch_ms ? self->prefetch.high : 0;
+    double drain_rate = self->prefetch_ms && self->prefetch.rate > 0 ? self->prefetch.rate : 0.0;
+    for (size_t i = 0; i < self->part_count; i++) {
+        queue_size += message_queue_size(&self->parts[i]->queue);
+        queue_bytes += message_queue_bytes(&self->parts[i]->queue);
+    }
+    pthread_mutex_unlock(&self->parts_lock);
+
+    PyObject *poll = histogram_snapshot(&m->poll_ns);
+    PyObject *dwell = histogram_snapshot(&m->dwell_ns);
+    PyObject *depth = histogram_snapshot(&m->queue_depth);
+    PyObject *depth_bytes = histogram_snapshot(&m->queue_bytes);
+    PyObject *result = NULL;
+    if (lag && poll && dwell && depth && depth_bytes) {
+        result = Py_BuildValue(
+            "{s:K,s:K,s:K,s:K,s:K,s:K,s:K,s:d,s:d,s:n,s:n,s:n,s:d,s:O,s:O,s:O,s:O,s:O,s:O}",
+            "messages", (unsigned long long)messages,
+            "bytes", (unsigned long long)atomic_load_explicit(&m->bytes, memory_order_relaxed),
+            "errors", (unsigned long long)errors,
+            "errors_dropped", (unsigned long long)atomic_load_explicit(&m->errors_dropped, memory_order_relaxed),
+            "messages_dropped", (unsigned long long)atomic_load_explicit(&m->messages_dropped, memory_order_relaxed),
+            "decode_errors", (unsigned long long)atomic_load_explicit(&m->decode_errors, memory_order_relaxed),
+            "polls", (unsigned long long)atomic_load_explicit(&m->polls, memory_order_relaxed),
+            "messages_per_sec", messages_rate,
+            "errors_per_sec", errors_rate,
+            "queue_size", (Py_ssize_t)queue_size,
+            "queue_bytes", (Py_ssize_t)queue_bytes,
+            "prefetch_messages", (Py_ssize_t)prefetch_messages,
+            "drain_per_sec", drain_rate,
+            "poll_ns", poll,
+            "dwell_ns", dwell,
+            "queue_depth", depth,
+            "queue_depth_bytes", depth_bytes,
+            "stats", stats,
+            "lag", lag);
+    }
+    Py_XDECREF(poll);
+    Py_XDECREF(dwell);
+    Py_XDECREF(depth);
+    Py_XDECREF(depth_bytes);
+    Py_DECREF(stats);
+    Py_XDECREF(lag);
+    return result;
 }
 
+/**
+ * @brief Defines the methods available on Consumer objects.
+ */
+static PyMethodDef Consumer_methods[] = {
+    {"fileno", (PyCFunction)Consumer_fileno, METH_NOARGS,
+     "Return the fd that becomes readable when messages are available."},
+    {"getmany", (PyCFunction)(void(*)(void))Consumer_getmany, METH_VARARGS | METH_KEYWORDS,
+     "Pop up to max_records buffered messages without blocking."},
+    {"getmany_columnar", (PyCFunction)(void(*)(void))Consumer_getmany_columnar, METH_VARARGS | METH_KEYWORDS,
+     "Pop up to max_records buffered messages as a ColumnarBatch without blocking."},
+    {"getone", (PyCFunction)Consumer_getone, METH_NOARGS,
+     "Pop one buffered message without blocking, or return None."},
+    {"errors", (PyCFunction)Consumer_errors, METH_NOARGS,
+     "Return the pending consumer errors as KafkaError objects."},
+    {"pool_stats", (PyCFunction)Consumer_pool_stats, METH_NOARGS,
+     "Return the message queue's node pool usage."},
+    {"metrics", (PyCFunction)Consumer_metrics, METH_NOARGS,
+     "Return a snapshot of the consumer's counters, histograms and librdkafka statistics."},
+    {"subscribe", (PyCFunction)(void(*)(void))Consumer_subscribe, METH_VARARGS | METH_KEYWORDS,
+     "Subscribe to topics, optionally with a rebalance listener."},
+    {"partition", (PyCFunction)(void(*)(void))Consumer_partition, METH_VARARGS | METH_KEYWORDS,
+     "Return the queue of one partition, splitting it off the consumer queue."},
+    {"store_offset", (PyCFunction)Consumer_store_offset, METH_O,
+     "Record a processed message's offset for the next commit."},
+    {"store_offsets", (PyCFunction)Consumer_store_offsets, METH_O,
+     "Record the offsets of a batch of processed messages."},
+    {"commit", (PyCFunction)(void(*)(void))Consumer_commit, METH_VARARGS | METH_KEYWORDS,
+     "Ask the poller to commit the stored offsets now, resolving future when done."},
+    {"seek", (PyCFunction)(void(*)(void))Consumer_seek, METH_VARARGS | METH_KEYWORDS,
+     "Ask the poller to seek partitions, discarding what is buffered for them."},
+    {"assign", (PyCFunction)(void(*)(void))Consumer_assign, METH_VARARGS | METH_KEYWORDS,
+     "Ask the poller to replace the assignment, without a group rebalance."},
+    {"offsets_for_times", (PyCFunction)(void(*)(void))Consumer_offsets_for_times, METH_VARARGS | METH_KEYWORDS,
+     "Look up the earliest offsets whose timestamps are at or after the given ones."},
+    {"events_fileno", (PyCFunction)Consumer_events_fileno, METH_NOARGS,
+     "Return the fd that becomes readable when commit results or rebalances are pending."},
+    {"deliver_events", (PyCFunction)Consumer_deliver_events, METH_NOARGS,
+     "Resolve pending commit results and call the rebalance listener."},
+    {"close", (PyCFunction)Consumer_close, METH_NOARGS,
+     "Close the consumer on the poller thread and wait, without the GIL."},
+    {NULL, NULL, 0, NULL}  // Sentinel
+};
+
 /**
  * @brief Defines the Python type object for the Consumer.
  *
@@ -155,25 +3005,72 @@ PyTypeObject ConsumerType = {
     .tp_new = Consumer_new,
     .tp_init = (initproc)Consumer_init,
     .tp_dealloc = (destructor)Consumer_dealloc,
+    .tp_as_async = &Consumer_as_async,
+    .tp_methods = Consumer_methods,
+    .tp_getset = Consumer_getset,
 };
 
 /**
- * @brief Factory function to create and initialize a Consumer object from Python.
- *
- * This is the function exposed to Python as `_core.create_consumer`.
+ * @brief Checks that a consumer can be bound to a transactional producer.
  */
-PyObject* create_consumer(PyObject* self, PyObject* args)
-{
-    // Allocate the object.
-    ConsumerObject *consumer = PyObject_New(ConsumerObject, &ConsumerType);
-    if (!consumer) {
-        return NULL;
+int consumer_check_transactions(PyObject *consumer) {
+    if (!PyObject_TypeCheck(consumer, &ConsumerType)) {
+        PyErr_Format(PyExc_TypeError, "expected a _core.Consumer, not %.100s", Py_TYPE(consumer)->tp_name);
+        return -1;
     }
-    // Initialize the object.
-    if (Consumer_init(consumer, args, NULL) < 0) {
-        Py_DECREF(consumer);
-        return NULL;
+    ConsumerObject *self = (ConsumerObject *)consumer;
+    if (!self->rk || !self->has_group) {
+        PyErr_SetString(PyExc_RuntimeError, "transactions need a consumer created with a group_id");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Binds or releases a consumer's offsets for transactions.
+ */
+int consumer_bind_transactions(PyObject *consumer, int bound) {
+    if (bound) {
+        if (consumer_check_transactions(consumer) < 0) {
+            return -1;
+        }
+    } else if (!PyObject_TypeCheck(consumer, &ConsumerType)) {
+        PyErr_Format(PyExc_TypeError, "expected a _core.Consumer, not %.100s", Py_TYPE(consumer)->tp_name);
+        return -1;
     }
+    atomic_store_explicit(&((ConsumerObject *)consumer)->transactional, bound, memory_order_release);
+    return 0;
+}
+
+/**
+ * @brief Takes the offsets stored since the last take.
+ */
+rd_kafka_topic_partition_list_t *consumer_take_offsets(PyObject *consumer) {
+    return offset_table_take_dirty(&((ConsumerObject *)consumer)->offsets);
+}
+
+/**
+ * @brief Returns the consumer's current group metadata.
+ */
+rd_kafka_consumer_group_metadata_t *consumer_group_metadata(PyObject *consumer) {
+    return rd_kafka_consumer_group_metadata(((ConsumerObject *)consumer)->rk);
+}
+
+/**
+ * @brief Forgets offsets of an aborted transaction.
+ */
+void consumer_forget_offsets(PyObject *consumer, const rd_kafka_topic_partition_list_t *offsets) {
+    offset_table_forget(&((ConsumerObject *)consumer)->offsets, offsets);
+}
 
-    return (PyObject*)consumer;
+/**
+ * @brief Factory function to create and initialize a Consumer object from Python.
+ *
+ * This is the function exposed to Python as `_core.create_consumer`. It goes
+ * through the type's `__new__`/`__init__` so the object is zero-initialized
+ * before `Consumer_init` runs, and a failed init deallocates cleanly.
+ */
+PyObject* create_consumer(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    return PyObject_Call((PyObject*)&ConsumerType, args, kwds);
 }
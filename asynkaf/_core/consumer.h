@@ -2,6 +2,7 @@
 #define ASYNKAF_CONSUMER_H
 
 #include <Python.h>
+#include <librdkafka/rdkafka.h>
 
 /**
  * @brief External declaration of the ConsumerType object.
@@ -18,8 +19,62 @@ extern PyTypeObject ConsumerType;
  *
  * @param self The module object (unused in this context).
  * @param args The arguments passed from Python.
+ * @param kwds The keyword arguments passed from Python.
  * @return A new Consumer PyObject, or NULL on failure.
  */
-PyObject* create_consumer(PyObject* self, PyObject* args);
+PyObject* create_consumer(PyObject* self, PyObject* args, PyObject* kwds);
+
+/**
+ * @brief Checks that a consumer can be bound to a transactional producer.
+ *
+ * @param consumer The object to check.
+ * @return 0, or -1 with an exception set if `consumer` is not a Consumer
+ *         created with a group_id.
+ */
+int consumer_check_transactions(PyObject *consumer);
+
+/**
+ * @brief Hands a consumer's offset commits to a transactional producer.
+ *
+ * While bound, the consumer never commits on its own: the periodic, eager,
+ * revocation and close flushes skip the group commit and commit() raises,
+ * so stored offsets only reach the group through
+ * consumer_take_offsets() and `send_offsets_to_transaction`. Offsets stored
+ * for partitions revoked meanwhile are kept until they are taken.
+ *
+ * @param consumer A `_core.Consumer`.
+ * @param bound Whether to bind (1) or release (0) the consumer.
+ * @return 0, or -1 with an exception set if `consumer` is not a Consumer
+ *         created with a group_id.
+ */
+int consumer_bind_transactions(PyObject *consumer, int bound);
+
+/**
+ * @brief Takes the offsets stored since the last take, for a transaction.
+ *
+ * Does not need the GIL.
+ * @param consumer A consumer accepted by consumer_bind_transactions().
+ * @return A new partition list, or NULL if nothing was stored.
+ */
+rd_kafka_topic_partition_list_t *consumer_take_offsets(PyObject *consumer);
+
+/**
+ * @brief Returns the group metadata a transaction commits offsets against.
+ *
+ * Does not need the GIL.
+ * @param consumer A consumer accepted by consumer_bind_transactions().
+ * @return A new metadata object for rd_kafka_consumer_group_metadata_destroy().
+ */
+rd_kafka_consumer_group_metadata_t *consumer_group_metadata(PyObject *consumer);
+
+/**
+ * @brief Forgets offsets taken for a transaction that was aborted.
+ *
+ * The consumer's stores only move forward, so the aborted offsets must go
+ * for reprocessed messages to be stored again.
+ * @param consumer A consumer accepted by consumer_bind_transactions().
+ * @param offsets The offsets the transaction carried.
+ */
+void consumer_forget_offsets(PyObject *consumer, const rd_kafka_topic_partition_list_t *offsets);
 
 #endif
@@ -0,0 +1,185 @@
+#include "decode_pool.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "poller.h"
+
+/**
+ * @brief Decodes messages `[start, end)` of a batch.
+ * @return The number of payloads that could not be decoded.
+ */
+static size_t decode_range(const Decoder *decoder, rd_kafka_message_t **batch, void **notes,
+                           size_t start, size_t end) {
+    size_t failed = 0;
+    for (size_t i = start; i < end; i++) {
+        if (decoder_apply(decoder, batch[i], &notes[i]) != 0) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/**
+ * @brief Passed to a worker thread: its pool and chunk index.
+ */
+typedef struct {
+    DecodePool *pool;         // The pool.
+    size_t lane;              // Chunk the worker decodes, from 1; the poller takes 0.
+} DecodeWorker;
+
+/**
+ * @brief Body of a worker thread.
+ *
+ * Waits for a new generation, decodes its chunk if the batch is large
+ * enough to have one, and reports back. Workers without a chunk in this
+ * generation never touch `pending`.
+ */
+static void *decode_worker_main(void *arg) {
+    DecodeWorker *worker = (DecodeWorker *)arg;
+    DecodePool *pool = worker->pool;
+    size_t lane = worker->lane;
+    free(worker);
+
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stopping && (pool->generation == seen || lane >= pool->lanes)) {
+            if (pool->generation != seen) {
+                // Not needed for this batch.
+                seen = pool->generation;
+            }
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seen = pool->generation;
+        size_t start = lane * pool->chunk;
+        size_t end = start + pool->chunk < pool->count ? start + pool->chunk : pool->count;
+        rd_kafka_message_t **batch = pool->batch;
+        void **notes = pool->notes;
+        pthread_mutex_unlock(&pool->lock);
+
+        size_t failed = decode_range(pool->decoder, batch, notes, start, end);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->failed += failed;
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * @brief Starts `workers` decode threads.
+ *
+ * Workers are named "asynkaf-decN" and inherit the creator's placement.
+ */
+int decode_pool_start(DecodePool *pool, const Decoder *decoder, size_t workers) {
+    if (workers > DECODE_POOL_MAX_WORKERS) {
+        return EINVAL;
+    }
+    pool->decoder = decoder;
+    pool->threads = calloc(workers, sizeof(pthread_t));
+    if (!pool->threads) {
+        return ENOMEM;
+    }
+    pool->started = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    pool->generation = 0;
+    pool->stopping = 0;
+    pool->batch = NULL;
+    pool->notes = NULL;
+    pool->count = 0;
+    pool->chunk = 0;
+    pool->lanes = 0;
+    pool->pending = 0;
+    pool->failed = 0;
+
+    PollerThreadOptions options = {0};
+    for (size_t i = 0; i < workers; i++) {
+        DecodeWorker *worker = malloc(sizeof(DecodeWorker));
+        if (!worker) {
+            decode_pool_stop(pool);
+            return ENOMEM;
+        }
+        worker->pool = pool;
+        worker->lane = i + 1;
+        // The modulo is a no-op under the cap; it tells the compiler the
+        // index has at most two digits.
+        snprintf(options.name, sizeof(options.name), "asynkaf-dec%u", (unsigned)(i % DECODE_POOL_MAX_WORKERS));
+        int err = poller_thread_start(&pool->threads[i], decode_worker_main, worker, &options);
+        if (err) {
+            free(worker);
+            decode_pool_stop(pool);
+            return err;
+        }
+        pool->started++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Decodes a batch across the pool and the calling thread.
+ *
+ * The batch is cut into at most `started + 1` chunks of at least
+ * DECODE_POOL_MIN_CHUNK messages; the caller decodes chunk 0 while the
+ * workers decode the others, then sleeps until the last one is done.
+ */
+size_t decode_pool_run(DecodePool *pool, rd_kafka_message_t **batch, void **notes, size_t count) {
+    size_t lanes = count / DECODE_POOL_MIN_CHUNK;
+    if (lanes > pool->started + 1) {
+        lanes = pool->started + 1;
+    }
+    if (lanes <= 1) {
+        return decode_range(pool->decoder, batch, notes, 0, count);
+    }
+    size_t chunk = (count + lanes - 1) / lanes;
+    // Rounding up may leave the last lanes without messages.
+    lanes = (count + chunk - 1) / chunk;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->batch = batch;
+    pool->notes = notes;
+    pool->count = count;
+    pool->chunk = chunk;
+    pool->lanes = lanes;
+    pool->pending = lanes - 1;
+    pool->failed = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    size_t failed = decode_range(pool->decoder, batch, notes, 0, chunk);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    failed += pool->failed;
+    pthread_mutex_unlock(&pool->lock);
+    return failed;
+}
+
+/**
+ * @brief Stops and joins the workers and frees the pool.
+ */
+void decode_pool_stop(DecodePool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->started = 0;
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_mutex_destroy(&pool->lock);
+}
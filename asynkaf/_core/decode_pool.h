@@ -0,0 +1,82 @@
+#ifndef ASYNKAF_DECODE_POOL_H
+#define ASYNKAF_DECODE_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <librdkafka/rdkafka.h>
+#include "decoder.h"
+
+/**
+ * @brief Most worker threads a DecodePool may have.
+ */
+#define DECODE_POOL_MAX_WORKERS 64
+
+/**
+ * @brief Fewest messages worth handing to one worker.
+ *
+ * Smaller batches are decoded by the poller alone, since waking a worker
+ * costs more than decoding a handful of messages.
+ */
+#define DECODE_POOL_MIN_CHUNK 32
+
+/**
+ * @brief Worker threads that decode a poller batch in parallel.
+ *
+ * The poller hands each batch to decode_pool_run(), which splits it into
+ * contiguous chunks, decodes the first chunk itself and waits for the
+ * workers to finish the rest. The results land in the batch's note array,
+ * so the poller still pushes the messages in their original order; the
+ * MessageQueue keeps its single producer and every partition its order.
+ */
+typedef struct {
+    const Decoder *decoder;   // The stage the workers run.
+    pthread_t *threads;       // The worker threads.
+    size_t started;           // Number of entries of `threads` running.
+    pthread_mutex_t lock;     // Protects the fields below.
+    pthread_cond_t work_cond; // Signalled when a batch is posted or on stop.
+    pthread_cond_t done_cond; // Signalled when the last worker finishes a batch.
+    uint64_t generation;      // Incremented for every posted batch.
+    int stopping;             // Set to make the workers exit.
+    rd_kafka_message_t **batch; // The batch being decoded.
+    void **notes;             // Receives the results, parallel to `batch`.
+    size_t count;             // Number of messages in `batch`.
+    size_t chunk;             // Messages per chunk of the current batch.
+    size_t lanes;             // Threads taking part in the current batch, the poller included.
+    size_t pending;           // Workers still decoding the current batch.
+    size_t failed;            // Payloads the workers could not decode.
+} DecodePool;
+
+/**
+ * @brief Starts `workers` decode threads.
+ *
+ * Does not need the GIL.
+ *
+ * @param pool The pool to initialize.
+ * @param decoder The decode stage.
+ * @param workers Number of threads, 1 .. DECODE_POOL_MAX_WORKERS.
+ * @return 0 on success, otherwise an errno value; nothing is left running.
+ */
+int decode_pool_start(DecodePool *pool, const Decoder *decoder, size_t workers);
+
+/**
+ * @brief Decodes a batch across the pool and the calling thread.
+ *
+ * Returns once every message is decoded. Only one thread may call it at a
+ * time: a consumer's poller.
+ *
+ * @param pool The pool.
+ * @param batch The messages.
+ * @param notes Receives each message's result (see decoder_apply()).
+ * @param count Number of messages.
+ * @return The number of payloads that could not be decoded.
+ */
+size_t decode_pool_run(DecodePool *pool, rd_kafka_message_t **batch, void **notes, size_t count);
+
+/**
+ * @brief Stops and joins the workers and frees the pool.
+ * @param pool The pool.
+ */
+void decode_pool_stop(DecodePool *pool);
+
+#endif
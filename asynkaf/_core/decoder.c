@@ -0,0 +1,748 @@
+#include "decoder.h"
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Deepest nesting the JSON decoder accepts.
+ */
+#define JSON_MAX_DEPTH 512
+
+/**
+ * @brief Kinds of JSON tape tokens.
+ */
+typedef enum {
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_INT,                 // Fits in int64; `integer` holds the value.
+    JSON_BIGINT,              // Integer too long for int64; kept as text.
+    JSON_FLOAT,               // Kept as text, converted with the GIL.
+    JSON_STRING,              // String without escapes.
+    JSON_ESCAPED_STRING,      // String that has to be unescaped.
+    JSON_ARRAY,               // Followed by `length` values.
+    JSON_OBJECT,              // Followed by `length` key/value pairs.
+} JsonType;
+
+/**
+ * @brief One token of a parsed JSON document.
+ *
+ * The document is stored as a pre-order tape: a container is followed by
+ * its children, so building the Python value is a single forward walk.
+ * Strings and numbers point back into the payload, which lives as long as
+ * the message does.
+ */
+typedef struct {
+    uint32_t type;            // A JsonType.
+    uint32_t length;          // Bytes of a string or number, children of a container.
+    union {
+        size_t start;         // Offset into the payload of a string or number.
+        int64_t integer;      // Value of a JSON_INT.
+    };
+} JsonToken;
+
+/**
+ * @brief State of one JSON parse.
+ */
+typedef struct {
+    const char *text;         // The payload.
+    size_t length;            // Its length.
+    size_t pos;               // Next byte to read.
+    JsonToken *tokens;        // The tape being built.
+    size_t count;             // Tokens on the tape.
+    size_t capacity;          // Allocated length of `tokens`.
+    const char *error;        // Why the parse failed.
+} JsonParser;
+
+/**
+ * @brief Appends a token to the tape.
+ * @return The index of the new token, or -1 if out of memory.
+ */
+static Py_ssize_t json_push(JsonParser *p, JsonType type) {
+    if (p->count == p->capacity) {
+        size_t capacity = p->capacity ? p->capacity * 2 : 16 + p->length / 8;
+        JsonToken *grown = PyMem_RawRealloc(p->tokens, capacity * sizeof(JsonToken));
+        if (!grown) {
+            p->error = "out of memory";
+            return -1;
+        }
+        p->tokens = grown;
+        p->capacity = capacity;
+    }
+    p->tokens[p->count].type = type;
+    p->tokens[p->count].length = 0;
+    p->tokens[p->count].start = p->pos;
+    return (Py_ssize_t)p->count++;
+}
+
+/**
+ * @brief Skips insignificant whitespace.
+ */
+static void json_skip_space(JsonParser *p) {
+    while (p->pos < p->length) {
+        char c = p->text[p->pos];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            break;
+        }
+        p->pos++;
+    }
+}
+
+/**
+ * @brief Returns non-zero if `c` is a hexadecimal digit.
+ */
+static int json_is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * @brief Parses a string starting at its opening quote.
+ *
+ * Escapes are only validated here; their replacement happens when the
+ * Python string is built. UTF-8 is validated by that step as well.
+ */
+static int json_parse_string(JsonParser *p) {
+    p->pos++;
+    size_t start = p->pos;
+    int escaped = 0;
+    for (;;) {
+        if (p->pos >= p->length) {
+            p->error = "unterminated string";
+            return -1;
+        }
+        unsigned char c = (unsigned char)p->text[p->pos];
+        if (c == '"') {
+            break;
+        }
+        if (c == '\\') {
+            escaped = 1;
+            if (++p->pos >= p->length) {
+                p->error = "unterminated string";
+                return -1;
+            }
+            c = (unsigned char)p->text[p->pos];
+            if (c == 'u') {
+                if (p->pos + 4 >= p->length ||
+                    !json_is_hex(p->text[p->pos + 1]) || !json_is_hex(p->text[p->pos + 2]) ||
+                    !json_is_hex(p->text[p->pos + 3]) || !json_is_hex(p->text[p->pos + 4])) {
+                    p->error = "invalid \\u escape";
+                    return -1;
+                }
+                p->pos += 4;
+            } else if (!strchr("\"\\/bfnrt", c) || c == '\0') {
+                p->error = "invalid escape";
+                return -1;
+            }
+        } else if (c < 0x20) {
+            p->error = "control character in string";
+            return -1;
+        }
+        p->pos++;
+    }
+    if (p->pos - start > UINT32_MAX) {
+        p->error = "string too long";
+        return -1;
+    }
+    Py_ssize_t index = json_push(p, escaped ? JSON_ESCAPED_STRING : JSON_STRING);
+    if (index < 0) {
+        return -1;
+    }
+    p->tokens[index].start = start;
+    p->tokens[index].length = (uint32_t)(p->pos - start);
+    p->pos++;
+    return 0;
+}
+
+/**
+ * @brief Consumes a run of decimal digits.
+ * @return The number of digits.
+ */
+static size_t json_skip_digits(JsonParser *p) {
+    size_t start = p->pos;
+    while (p->pos < p->length && p->text[p->pos] >= '0' && p->text[p->pos] <= '9') {
+        p->pos++;
+    }
+    return p->pos - start;
+}
+
+/**
+ * @brief Parses a number. Integers of up to 18 digits are converted here.
+ */
+static int json_parse_number(JsonParser *p) {
+    size_t start = p->pos;
+    int negative = 0;
+    if (p->text[p->pos] == '-') {
+        negative = 1;
+        p->pos++;
+    }
+    size_t digits;
+    if (p->pos < p->length && p->text[p->pos] == '0') {
+        p->pos++;
+        digits = 1;
+    } else {
+        digits = json_skip_digits(p);
+        if (digits == 0) {
+            p->error = "invalid number";
+            return -1;
+        }
+    }
+    int is_float = 0;
+    if (p->pos < p->length && p->text[p->pos] == '.') {
+        p->pos++;
+        if (json_skip_digits(p) == 0) {
+            p->error = "invalid number";
+            return -1;
+        }
+        is_float = 1;
+    }
+    if (p->pos < p->length && (p->text[p->pos] == 'e' || p->text[p->pos] == 'E')) {
+        p->pos++;
+        if (p->pos < p->length && (p->text[p->pos] == '+' || p->text[p->pos] == '-')) {
+            p->pos++;
+        }
+        if (json_skip_digits(p) == 0) {
+            p->error = "invalid number";
+            return -1;
+        }
+        is_float = 1;
+    }
+
+    JsonType type = is_float ? JSON_FLOAT : digits <= 18 ? JSON_INT : JSON_BIGINT;
+    Py_ssize_t index = json_push(p, type);
+    if (index < 0) {
+        return -1;
+    }
+    JsonToken *token = &p->tokens[index];
+    if (type == JSON_INT) {
+        int64_t value = 0;
+        for (size_t i = start + negative; i < p->pos; i++) {
+            value = value * 10 + (p->text[i] - '0');
+        }
+        token->integer = negative ? -value : value;
+    } else {
+        token->start = start;
+    }
+    token->length = (uint32_t)(p->pos - start);
+    return 0;
+}
+
+/**
+ * @brief Parses a literal such as `true`.
+ */
+static int json_parse_literal(JsonParser *p, const char *literal, size_t length, JsonType type) {
+    if (p->length - p->pos < length || memcmp(p->text + p->pos, literal, length) != 0) {
+        p->error = "unexpected character";
+        return -1;
+    }
+    if (json_push(p, type) < 0) {
+        return -1;
+    }
+    p->pos += length;
+    return 0;
+}
+
+static int json_parse_value(JsonParser *p, int depth);
+
+/**
+ * @brief Parses an array or object starting at its opening bracket.
+ */
+static int json_parse_container(JsonParser *p, int depth, int is_object) {
+    if (depth >= JSON_MAX_DEPTH) {
+        p->error = "nested too deeply";
+        return -1;
+    }
+    Py_ssize_t index = json_push(p, is_object ? JSON_OBJECT : JSON_ARRAY);
+    if (index < 0) {
+        return -1;
+    }
+    char close = is_object ? '}' : ']';
+    uint32_t children = 0;
+    p->pos++;
+    json_skip_space(p);
+    if (p->pos < p->length && p->text[p->pos] == close) {
+        p->pos++;
+        return 0;
+    }
+    for (;;) {
+        if (is_object) {
+            json_skip_space(p);
+            if (p->pos >= p->length || p->text[p->pos] != '"') {
+                p->error = "expected a string key";
+                return -1;
+            }
+            if (json_parse_string(p) < 0) {
+                return -1;
+            }
+            json_skip_space(p);
+            if (p->pos >= p->length || p->text[p->pos] != ':') {
+                p->error = "expected ':'";
+                return -1;
+            }
+            p->pos++;
+        }
+        if (json_parse_value(p, depth + 1) < 0) {
+            return -1;
+        }
+        children++;
+        json_skip_space(p);
+        if (p->pos < p->length && p->text[p->pos] == ',') {
+            p->pos++;
+            continue;
+        }
+        if (p->pos < p->length && p->text[p->pos] == close) {
+            p->pos++;
+            break;
+        }
+        p->error = is_object ? "expected ',' or '}'" : "expected ',' or ']'";
+        return -1;
+    }
+    // The tape may have moved while the children were appended.
+    p->tokens[index].length = children;
+    return 0;
+}
+
+/**
+ * @brief Parses any JSON value.
+ */
+static int json_parse_value(JsonParser *p, int depth) {
+    json_skip_space(p);
+    if (p->pos >= p->length) {
+        p->error = "unexpected end of input";
+        return -1;
+    }
+    switch (p->text[p->pos]) {
+    case '{':
+        return json_parse_container(p, depth, 1);
+    case '[':
+        return json_parse_container(p, depth, 0);
+    case '"':
+        return json_parse_string(p);
+    case 't':
+        return json_parse_literal(p, "true", 4, JSON_TRUE);
+    case 'f':
+        return json_parse_literal(p, "false", 5, JSON_FALSE);
+    case 'n':
+        return json_parse_literal(p, "null", 4, JSON_NULL);
+    default:
+        if (p->text[p->pos] == '-' || (p->text[p->pos] >= '0' && p->text[p->pos] <= '9')) {
+            return json_parse_number(p);
+        }
+        p->error = "unexpected character";
+        return -1;
+    }
+}
+
+/**
+ * @brief Parses a whole document into a tape.
+ * @return The tape, or NULL with `p->error` and `p->pos` describing the failure.
+ */
+static JsonToken *json_parse(JsonParser *p, const char *text, size_t length) {
+    p->text = text;
+    p->length = length;
+    p->pos = 0;
+    p->tokens = NULL;
+    p->count = 0;
+    p->capacity = 0;
+    p->error = NULL;
+    if (json_parse_value(p, 0) == 0) {
+        json_skip_space(p);
+        if (p->pos == p->length) {
+            return p->tokens;
+        }
+        p->error = "extra data after the document";
+    }
+    PyMem_RawFree(p->tokens);
+    p->tokens = NULL;
+    return NULL;
+}
+
+/**
+ * @brief Decodes a JSON payload into a tape on the poller thread.
+ */
+static int json_decode(void *ctx, const rd_kafka_message_t *rkmessage, void **result) {
+    JsonParser parser;
+    JsonToken *tokens = json_parse(&parser, (const char *)rkmessage->payload, rkmessage->len);
+    if (!tokens) {
+        return -1;
+    }
+    *result = tokens;
+    return 0;
+}
+
+/**
+ * @brief Returns the value of a hexadecimal digit.
+ */
+static unsigned json_hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return (unsigned)(c - '0');
+    }
+    return (unsigned)((c | 0x20) - 'a' + 10);
+}
+
+/**
+ * @brief Reads the four hex digits of a `\u` escape.
+ */
+static unsigned json_read_hex4(const char *s) {
+    return json_hex_value(s[0]) << 12 | json_hex_value(s[1]) << 8 |
+           json_hex_value(s[2]) << 4 | json_hex_value(s[3]);
+}
+
+/**
+ * @brief Builds a str from a validated string body containing escapes.
+ *
+ * Unescaped, the body never grows, so one buffer of its length suffices.
+ * Lone surrogates are kept, as the json module does, which is why the
+ * result is decoded with "surrogatepass".
+ */
+static PyObject *json_build_escaped(const char *s, size_t n) {
+    char *buf = PyMem_Malloc(n ? n : 1);
+    if (!buf) {
+        return PyErr_NoMemory();
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] != '\\') {
+            buf[out++] = s[i];
+            continue;
+        }
+        char c = s[++i];
+        switch (c) {
+        case 'b': buf[out++] = '\b'; break;
+        case 'f': buf[out++] = '\f'; break;
+        case 'n': buf[out++] = '\n'; break;
+        case 'r': buf[out++] = '\r'; break;
+        case 't': buf[out++] = '\t'; break;
+        case 'u': {
+            unsigned cp = json_read_hex4(s + i + 1);
+            i += 4;
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 6 < n && s[i + 1] == '\\' && s[i + 2] == 'u') {
+                unsigned low = json_read_hex4(s + i + 3);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+            }
+            if (cp < 0x80) {
+                buf[out++] = (char)cp;
+            } else if (cp < 0x800) {
+                buf[out++] = (char)(0xC0 | cp >> 6);
+                buf[out++] = (char)(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                buf[out++] = (char)(0xE0 | cp >> 12);
+                buf[out++] = (char)(0x80 | (cp >> 6 & 0x3F));
+                buf[out++] = (char)(0x80 | (cp & 0x3F));
+            } else {
+                buf[out++] = (char)(0xF0 | cp >> 18);
+                buf[out++] = (char)(0x80 | (cp >> 12 & 0x3F));
+                buf[out++] = (char)(0x80 | (cp >> 6 & 0x3F));
+                buf[out++] = (char)(0x80 | (cp & 0x3F));
+            }
+            break;
+        }
+        default: buf[out++] = c; break;
+        }
+    }
+    PyObject *str = PyUnicode_DecodeUTF8(buf, (Py_ssize_t)out, "surrogatepass");
+    PyMem_Free(buf);
+    return str;
+}
+
+/**
+ * @brief Builds an int or float from number text kept on the tape.
+ */
+static PyObject *json_build_number(const char *s, size_t n, int is_float) {
+    char *buf = PyMem_Malloc(n + 1);
+    if (!buf) {
+        return PyErr_NoMemory();
+    }
+    memcpy(buf, s, n);
+    buf[n] = '\0';
+    PyObject *value;
+    if (is_float) {
+        // Like the json module, out-of-range exponents give +-inf.
+        double d = PyOS_string_to_double(buf, NULL, NULL);
+        value = d == -1.0 && PyErr_Occurred() ? NULL : PyFloat_FromDouble(d);
+    } else {
+        value = PyLong_FromString(buf, NULL, 10);
+    }
+    PyMem_Free(buf);
+    return value;
+}
+
+/**
+ * @brief Builds the value at `*next` and advances past it.
+ *
+ * `memo` interns object keys, so the keys of a list of records are shared
+ * like json.loads() shares them.
+ */
+static PyObject *json_build(const char *text, const JsonToken *tokens, size_t *next, PyObject *memo) {
+    const JsonToken *token = &tokens[(*next)++];
+    switch (token->type) {
+    case JSON_NULL:
+        Py_RETURN_NONE;
+    case JSON_FALSE:
+        Py_RETURN_FALSE;
+    case JSON_TRUE:
+        Py_RETURN_TRUE;
+    case JSON_INT:
+        return PyLong_FromLongLong(token->integer);
+    case JSON_BIGINT:
+    case JSON_FLOAT:
+        return json_build_number(text + token->start, token->length, token->type == JSON_FLOAT);
+    case JSON_STRING:
+        return PyUnicode_DecodeUTF8(text + token->start, (Py_ssize_t)token->length, NULL);
+    case JSON_ESCAPED_STRING:
+        return json_build_escaped(text + token->start, token->length);
+    case JSON_ARRAY: {
+        PyObject *list = PyList_New((Py_ssize_t)token->length);
+        if (!list) {
+            return NULL;
+        }
+        for (uint32_t i = 0; i < token->length; i++) {
+            PyObject *item = json_build(text, tokens, next, memo);
+            if (!item) {
+                Py_DECREF(list);
+                return NULL;
+            }
+            PyList_SET_ITEM(list, (Py_ssize_t)i, item);
+        }
+        return list;
+    }
+    default: {
+        PyObject *dict = PyDict_New();
+        if (!dict) {
+            return NULL;
+        }
+        for (uint32_t i = 0; i < token->length; i++) {
+            PyObject *key = json_build(text, tokens, next, memo);
+            PyObject *shared = key ? PyDict_SetDefault(memo, key, key) : NULL;
+            PyObject *value = shared ? json_build(text, tokens, next, memo) : NULL;
+            int rc = value ? PyDict_SetItem(dict, shared, value) : -1;
+            Py_XDECREF(key);
+            Py_XDECREF(value);
+            if (rc < 0) {
+                Py_DECREF(dict);
+                return NULL;
+            }
+        }
+        return dict;
+    }
+    }
+}
+
+/**
+ * @brief Builds the Python value of a JSON tape.
+ *
+ * A failed parse is repeated here to report where the document is broken;
+ * if the poller only ran out of memory the repeated parse is used instead.
+ */
+static PyObject *json_to_python(void *ctx, PyObject *message, const rd_kafka_message_t *rkmessage,
+                                void *result) {
+    const char *text = (const char *)rkmessage->payload;
+    JsonToken *tokens = result;
+    if (!tokens) {
+        JsonParser parser;
+        tokens = json_parse(&parser, text, rkmessage->len);
+        if (!tokens) {
+            PyErr_Format(PyExc_ValueError, "invalid JSON payload: %s at offset %zu",
+                         parser.error, parser.pos);
+            return NULL;
+        }
+    }
+    PyObject *memo = PyDict_New();
+    size_t next = 0;
+    PyObject *value = memo ? json_build(text, tokens, &next, memo) : NULL;
+    Py_XDECREF(memo);
+    if (tokens != result) {
+        PyMem_RawFree(tokens);
+    }
+    return value;
+}
+
+/**
+ * @brief Frees a JSON tape.
+ */
+static void raw_free(void *ctx, void *result) {
+    PyMem_RawFree(result);
+}
+
+/**
+ * @brief Frame boundaries found in a length-prefixed payload.
+ */
+typedef struct {
+    size_t count;             // Number of frames.
+    size_t bounds[];          // Start and length of each frame.
+} FrameList;
+
+/**
+ * @brief Walks the frames of a payload, optionally recording them.
+ * @param bounds Receives start/length pairs, or NULL to only count.
+ * @param bad Receives the offset of a truncated frame on failure.
+ * @return The number of frames, or -1 if the last one is truncated.
+ */
+static Py_ssize_t frames_scan(const unsigned char *data, size_t length, size_t *bounds, size_t *bad) {
+    size_t pos = 0;
+    Py_ssize_t count = 0;
+    while (pos < length) {
+        if (length - pos < 4) {
+            *bad = pos;
+            return -1;
+        }
+        size_t size = (size_t)data[pos] << 24 | (size_t)data[pos + 1] << 16 |
+                      (size_t)data[pos + 2] << 8 | (size_t)data[pos + 3];
+        if (length - pos - 4 < size) {
+            *bad = pos;
+            return -1;
+        }
+        if (bounds) {
+            bounds[2 * count] = pos + 4;
+            bounds[2 * count + 1] = size;
+        }
+        pos += 4 + size;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Splits a payload of big-endian uint32 length-prefixed frames.
+ */
+static int frames_decode(void *ctx, const rd_kafka_message_t *rkmessage, void **result) {
+    size_t bad;
+    Py_ssize_t count = frames_scan(rkmessage->payload, rkmessage->len, NULL, &bad);
+    if (count < 0) {
+        return -1;
+    }
+    FrameList *frames = PyMem_RawMalloc(sizeof(FrameList) + 2 * (size_t)count * sizeof(size_t));
+    if (!frames) {
+        return -1;
+    }
+    frames->count = (size_t)count;
+    frames_scan(rkmessage->payload, rkmessage->len, frames->bounds, &bad);
+    *result = frames;
+    return 0;
+}
+
+/**
+ * @brief Returns the frames as a tuple of memoryviews over the payload.
+ */
+static PyObject *frames_to_python(void *ctx, PyObject *message, const rd_kafka_message_t *rkmessage,
+                                  void *result) {
+    if (!result) {
+        size_t bad = 0;
+        if (frames_scan(rkmessage->payload, rkmessage->len, NULL, &bad) < 0) {
+            PyErr_Format(PyExc_ValueError, "truncated frame at offset %zu", bad);
+        } else {
+            PyErr_NoMemory();
+        }
+        return NULL;
+    }
+    const FrameList *frames = result;
+    PyObject *view = PyMemoryView_FromObject(message);
+    if (!view) {
+        return NULL;
+    }
+    PyObject *tuple = PyTuple_New((Py_ssize_t)frames->count);
+    for (size_t i = 0; tuple && i < frames->count; i++) {
+        Py_ssize_t start = (Py_ssize_t)frames->bounds[2 * i];
+        PyObject *frame = PySequence_GetSlice(view, start, start + (Py_ssize_t)frames->bounds[2 * i + 1]);
+        if (!frame) {
+            Py_CLEAR(tuple);
+            break;
+        }
+        PyTuple_SET_ITEM(tuple, (Py_ssize_t)i, frame);
+    }
+    Py_DECREF(view);
+    return tuple;
+}
+
+/**
+ * @brief Length of the Confluent wire-format header: magic byte and schema id.
+ */
+#define CONFLUENT_HEADER_SIZE 5
+
+/**
+ * @brief Checks the Confluent wire-format header.
+ *
+ * The result is the schema id itself, offset by one so that id 0 still
+ * gives a non-NULL result; nothing is allocated.
+ */
+static int confluent_decode(void *ctx, const rd_kafka_message_t *rkmessage, void **result) {
+    const unsigned char *data = rkmessage->payload;
+    if (rkmessage->len < CONFLUENT_HEADER_SIZE || data[0] != 0) {
+        return -1;
+    }
+    uint32_t schema_id = (uint32_t)data[1] << 24 | (uint32_t)data[2] << 16 |
+                         (uint32_t)data[3] << 8 | (uint32_t)data[4];
+    *result = (void *)((uintptr_t)schema_id + 1);
+    return 0;
+}
+
+/**
+ * @brief Returns `(schema_id, memoryview)` with the bytes after the header.
+ */
+static PyObject *confluent_to_python(void *ctx, PyObject *message, const rd_kafka_message_t *rkmessage,
+                                     void *result) {
+    if (!result) {
+        PyErr_SetString(PyExc_ValueError,
+                        "payload does not start with the schema registry wire-format header");
+        return NULL;
+    }
+    PyObject *view = PyMemoryView_FromObject(message);
+    if (!view) {
+        return NULL;
+    }
+    PyObject *body = PySequence_GetSlice(view, CONFLUENT_HEADER_SIZE, (Py_ssize_t)rkmessage->len);
+    Py_DECREF(view);
+    if (!body) {
+        return NULL;
+    }
+    return Py_BuildValue("(kN)", (unsigned long)((uintptr_t)result - 1), body);
+}
+
+static const Decoder json_decoder = {
+    .name = "json",
+    .decode = json_decode,
+    .to_python = json_to_python,
+    .release = raw_free,
+};
+
+static const Decoder frames_decoder = {
+    .name = "frames",
+    .decode = frames_decode,
+    .to_python = frames_to_python,
+    .release = raw_free,
+};
+
+static const Decoder confluent_decoder = {
+    .name = "confluent",
+    .decode = confluent_decode,
+    .to_python = confluent_to_python,
+    .release = NULL,
+};
+
+/**
+ * @brief Looks up the decoder a consumer's `decoder` argument names.
+ */
+const Decoder *decoder_from_object(PyObject *spec) {
+    if (PyUnicode_Check(spec)) {
+        static const Decoder *const builtins[] = {&json_decoder, &frames_decoder, &confluent_decoder};
+        for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+            if (PyUnicode_CompareWithASCIIString(spec, builtins[i]->name) == 0) {
+                return builtins[i];
+            }
+        }
+        PyErr_Format(PyExc_ValueError, "decoder must be 'json', 'frames' or 'confluent', not %R", spec);
+        return NULL;
+    }
+    if (PyCapsule_IsValid(spec, DECODER_CAPSULE_NAME)) {
+        const Decoder *decoder = PyCapsule_GetPointer(spec, DECODER_CAPSULE_NAME);
+        if (!decoder->decode || !decoder->to_python) {
+            PyErr_SetString(PyExc_ValueError, "decoder capsule needs decode and to_python");
+            return NULL;
+        }
+        return decoder;
+    }
+    PyErr_Format(PyExc_TypeError, "decoder must be a str or a '%s' capsule, not %.200s",
+                 DECODER_CAPSULE_NAME, Py_TYPE(spec)->tp_name);
+    return NULL;
+}
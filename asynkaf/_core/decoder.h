@@ -0,0 +1,99 @@
+#ifndef ASYNKAF_DECODER_H
+#define ASYNKAF_DECODER_H
+
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+
+/**
+ * @brief Name of the capsules accepted as a user-defined decoder.
+ */
+#define DECODER_CAPSULE_NAME "asynkaf.Decoder"
+
+/**
+ * @brief A decode stage run on the poller thread before messages are queued.
+ *
+ * `decode` parses the payload without the GIL, while Python is busy with
+ * earlier messages, and leaves whatever it produced as an opaque result
+ * next to the message. `to_python` later turns that result into objects on
+ * first access to `Message.decoded`, so Python pays only for building them.
+ *
+ * Extensions provide their own stage by filling in a static Decoder and
+ * passing `PyCapsule_New(&decoder, DECODER_CAPSULE_NAME, NULL)` as the
+ * consumer's `decoder`; the capsule is kept alive as long as the consumer.
+ */
+typedef struct Decoder {
+    const char *name;         // Shown in error messages.
+
+    /**
+     * Decodes one message with a non-NULL payload. Runs on the poller thread
+     * without the GIL and must not touch Python objects.
+     * @return 0 with a non-NULL `*result`, or -1 if the payload is invalid.
+     */
+    int (*decode)(void *ctx, const rd_kafka_message_t *rkmessage, void **result);
+
+    /**
+     * Builds the Python value of a decoded message, with the GIL. `message`
+     * is the Message, which exports the payload through the buffer protocol.
+     * `result` is NULL if decode() failed; a Python exception must then be
+     * set describing why. `result` stays owned by the caller.
+     * @return A new reference, or NULL with an exception set.
+     */
+    PyObject *(*to_python)(void *ctx, PyObject *message, const rd_kafka_message_t *rkmessage,
+                           void *result);
+
+    /**
+     * Frees a result, or NULL if results own nothing. May run on any thread,
+     * with or without the GIL.
+     */
+    void (*release)(void *ctx, void *result);
+
+    void *ctx;                // Passed to every callback.
+} Decoder;
+
+/**
+ * @brief Runs a decoder's decode stage on one message.
+ *
+ * Messages without a payload are not decoded.
+ *
+ * @param decoder The decoder.
+ * @param rkmessage The message.
+ * @param result Receives the result, or NULL if there is none.
+ * @return 0 on success, -1 if the payload could not be decoded.
+ */
+static inline int decoder_apply(const Decoder *decoder, const rd_kafka_message_t *rkmessage,
+                                void **result) {
+    *result = NULL;
+    if (!rkmessage->payload) {
+        return 0;
+    }
+    if (decoder->decode(decoder->ctx, rkmessage, result) != 0) {
+        *result = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees a decode result, if there is one.
+ * @param decoder The decoder that produced it.
+ * @param result The result, or NULL.
+ */
+static inline void decoder_release(const Decoder *decoder, void *result) {
+    if (result && decoder->release) {
+        decoder->release(decoder->ctx, result);
+    }
+}
+
+/**
+ * @brief Looks up the decoder a consumer's `decoder` argument names.
+ *
+ * Accepts "json", "frames" (big-endian uint32 length-prefixed frames),
+ * "confluent" (schema-registry wire format) or a capsule named
+ * DECODER_CAPSULE_NAME holding a Decoder.
+ *
+ * @param spec The argument.
+ * @return The decoder, or NULL with an exception set.
+ */
+const Decoder *decoder_from_object(PyObject *spec);
+
+#endif
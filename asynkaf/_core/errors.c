@@ -0,0 +1,124 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include "errors.h"
+
+PyObject *KafkaError = NULL;
+
+/**
+ * @brief Creates the KafkaError exception type.
+ *
+ * @param module The module the type is added to.
+ * @return 0 on success, -1 on failure.
+ */
+int errors_init(PyObject *module) {
+    // The class outlives any one module object, so re-running the module's
+    // exec slot reuses it.
+    if (!KafkaError) {
+        KafkaError = PyErr_NewExceptionWithDoc(
+            "_core.KafkaError",
+            "Error reported by librdkafka. `code` and `name` identify the error.",
+            NULL, NULL);
+        if (!KafkaError) {
+            return -1;
+        }
+    }
+    Py_INCREF(KafkaError);
+    if (PyModule_AddObject(module, "KafkaError", KafkaError) < 0) {
+        Py_DECREF(KafkaError);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Builds a KafkaError instance with `code` and `name` attributes.
+ *
+ * @param err The librdkafka error code.
+ * @param reason The message, or NULL for the default description.
+ * @return A new reference to the exception, or NULL on failure.
+ */
+PyObject *kafka_error_new(rd_kafka_resp_err_t err, const char *reason) {
+    PyObject *exc = PyObject_CallFunction(KafkaError, "s", reason ? reason : rd_kafka_err2str(err));
+    if (!exc) {
+        return NULL;
+    }
+    PyObject *code = PyLong_FromLong((long)err);
+    PyObject *name = PyUnicode_FromString(rd_kafka_err2name(err));
+    if (!code || !name ||
+        PyObject_SetAttrString(exc, "code", code) < 0 ||
+        PyObject_SetAttrString(exc, "name", name) < 0) {
+        Py_XDECREF(code);
+        Py_XDECREF(name);
+        Py_DECREF(exc);
+        return NULL;
+    }
+    Py_DECREF(code);
+    Py_DECREF(name);
+    return exc;
+}
+
+/**
+ * @brief Builds a KafkaError from an errored consumer message.
+ *
+ * @param rkmessage The errored message.
+ * @return A new reference to the exception, or NULL on failure.
+ */
+PyObject *kafka_error_from_message(const rd_kafka_message_t *rkmessage) {
+    PyObject *exc = kafka_error_new(rkmessage->err, rd_kafka_message_errstr(rkmessage));
+    if (!exc) {
+        return NULL;
+    }
+    PyObject *topic = rkmessage->rkt ? PyUnicode_FromString(rd_kafka_topic_name(rkmessage->rkt))
+                                     : Py_NewRef(Py_None);
+    PyObject *partition = PyLong_FromLong(rkmessage->partition);
+    PyObject *offset = PyLong_FromLongLong(rkmessage->offset);
+    if (!topic || !partition || !offset ||
+        PyObject_SetAttrString(exc, "topic", topic) < 0 ||
+        PyObject_SetAttrString(exc, "partition", partition) < 0 ||
+        PyObject_SetAttrString(exc, "offset", offset) < 0) {
+        Py_CLEAR(exc);
+    }
+    Py_XDECREF(topic);
+    Py_XDECREF(partition);
+    Py_XDECREF(offset);
+    return exc;
+}
+
+/**
+ * @brief Raises a KafkaError.
+ *
+ * @param err The librdkafka error code.
+ * @param reason The message, or NULL for the default description.
+ * @return NULL.
+ */
+PyObject *kafka_error_set(rd_kafka_resp_err_t err, const char *reason) {
+    PyObject *exc = kafka_error_new(err, reason);
+    if (exc) {
+        PyErr_SetObject(KafkaError, exc);
+        Py_DECREF(exc);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Raises a KafkaError carrying an rd_kafka_error_t's flags.
+ *
+ * @param error The error, destroyed before returning.
+ * @return NULL.
+ */
+PyObject *kafka_error_raise(rd_kafka_error_t *error) {
+    PyObject *exc = kafka_error_new(rd_kafka_error_code(error), rd_kafka_error_string(error));
+    if (exc &&
+        (PyObject_SetAttrString(exc, "fatal", rd_kafka_error_is_fatal(error) ? Py_True : Py_False) < 0 ||
+         PyObject_SetAttrString(exc, "retriable", rd_kafka_error_is_retriable(error) ? Py_True : Py_False) < 0 ||
+         PyObject_SetAttrString(exc, "txn_requires_abort",
+                                rd_kafka_error_txn_requires_abort(error) ? Py_True : Py_False) < 0)) {
+        Py_CLEAR(exc);
+    }
+    rd_kafka_error_destroy(error);
+    if (exc) {
+        PyErr_SetObject(KafkaError, exc);
+        Py_DECREF(exc);
+    }
+    return NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef ASYNKAF_ERRORS_H
+#define ASYNKAF_ERRORS_H
+
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+
+/**
+ * @brief The `_core.KafkaError` exception type.
+ *
+ * Instances carry the librdkafka error as `code` (int) and `name` (str)
+ * attributes; the message is the human-readable reason.
+ */
+extern PyObject *KafkaError;
+
+/**
+ * @brief Creates the KafkaError type and adds it to the module.
+ * @param module The `_core` module object.
+ * @return 0 on success, -1 on failure.
+ */
+int errors_init(PyObject *module);
+
+/**
+ * @brief Builds a KafkaError instance without raising it.
+ * @param err The librdkafka error code.
+ * @param reason A description, or NULL to use `rd_kafka_err2str(err)`.
+ * @return A new reference, or NULL with an exception set.
+ */
+PyObject *kafka_error_new(rd_kafka_resp_err_t err, const char *reason);
+
+/**
+ * @brief Builds a KafkaError describing an errored consumer message.
+ *
+ * Besides `code` and `name`, the instance carries the `topic` (or None),
+ * `partition` and `offset` the error refers to.
+ * @param rkmessage The errored message; it is not destroyed.
+ * @return A new reference, or NULL with an exception set.
+ */
+PyObject *kafka_error_from_message(const rd_kafka_message_t *rkmessage);
+
+/**
+ * @brief Raises a KafkaError for `err`.
+ * @param err The librdkafka error code.
+ * @param reason A description, or NULL to use `rd_kafka_err2str(err)`.
+ * @return Always NULL, for use in `return kafka_error_set(...)`.
+ */
+PyObject *kafka_error_set(rd_kafka_resp_err_t err, const char *reason);
+
+/**
+ * @brief Raises a KafkaError for a librdkafka error object and destroys it.
+ *
+ * Besides `code` and `name`, the instance carries the `fatal`,
+ * `retriable` and `txn_requires_abort` flags the transactional API sets.
+ * @param error The error; always destroyed.
+ * @return Always NULL, for use in `return kafka_error_raise(...)`.
+ */
+PyObject *kafka_error_raise(rd_kafka_error_t *error);
+
+#endif
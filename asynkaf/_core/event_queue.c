@@ -0,0 +1,102 @@
+#include "event_queue.h"
+#include <stdlib.h>
+
+/**
+ * @brief Initial capacity of an event buffer.
+ */
+#define EVENT_QUEUE_INITIAL_CAPACITY 64
+
+/**
+ * @brief Initializes an EventQueue.
+ *
+ * @param queue A pointer to the EventQueue to be initialized.
+ * @param wakeup The Wakeup signalled when events become available.
+ */
+void event_queue_init(EventQueue *queue, Wakeup *wakeup) {
+    pthread_mutex_init(&queue->lock, NULL);
+    queue->items = NULL;
+    queue->count = 0;
+    queue->capacity = 0;
+    queue->wakeup = wakeup;
+}
+
+/**
+ * @brief Appends an event to the queue.
+ *
+ * The buffer doubles when full. The Wakeup is signalled after the lock is
+ * released, and only for the first event of a batch.
+ *
+ * @param queue A pointer to the EventQueue.
+ * @param event The event to append.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int event_queue_push(EventQueue *queue, const KafkaEvent *event) {
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) {
+        size_t capacity = queue->capacity ? queue->capacity * 2 : EVENT_QUEUE_INITIAL_CAPACITY;
+        KafkaEvent *items = (KafkaEvent *)realloc(queue->items, capacity * sizeof(KafkaEvent));
+        if (!items) {
+            pthread_mutex_unlock(&queue->lock);
+            return -1;
+        }
+        queue->items = items;
+        queue->capacity = capacity;
+    }
+    queue->items[queue->count++] = *event;
+    int first = queue->count == 1;
+    pthread_mutex_unlock(&queue->lock);
+
+    if (first && queue->wakeup) {
+        wakeup_signal(queue->wakeup);
+    }
+    return 0;
+}
+
+/**
+ * @brief Swaps the pending events out of the queue.
+ *
+ * @param queue A pointer to the EventQueue.
+ * @param items In: a spare buffer. Out: the pending events.
+ * @param capacity In/out: the length of `*items`.
+ * @return The number of pending events now in `*items`.
+ */
+size_t event_queue_swap(EventQueue *queue, KafkaEvent **items, size_t *capacity) {
+    pthread_mutex_lock(&queue->lock);
+    KafkaEvent *pending = queue->items;
+    size_t pending_capacity = queue->capacity;
+    size_t count = queue->count;
+    queue->items = *items;
+    queue->capacity = *capacity;
+    queue->count = 0;
+    pthread_mutex_unlock(&queue->lock);
+
+    *items = pending;
+    *capacity = pending_capacity;
+    return count;
+}
+
+/**
+ * @brief Returns the number of pending events.
+ *
+ * @param queue A pointer to the EventQueue.
+ * @return A snapshot of the count.
+ */
+size_t event_queue_size(EventQueue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    size_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+/**
+ * @brief Destroys the EventQueue.
+ *
+ * @param queue A pointer to the EventQueue to be destroyed.
+ */
+void event_queue_destroy(EventQueue *queue) {
+    free(queue->items);
+    queue->items = NULL;
+    queue->count = 0;
+    queue->capacity = 0;
+    pthread_mutex_destroy(&queue->lock);
+}
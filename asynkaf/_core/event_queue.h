@@ -0,0 +1,88 @@
+#ifndef ASYNKAF_EVENT_QUEUE_H
+#define ASYNKAF_EVENT_QUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <librdkafka/rdkafka.h>
+#include "wakeup.h"
+
+/**
+ * @brief Kinds of events carried by an EventQueue.
+ */
+typedef enum {
+    KAFKA_EVENT_DELIVERY,     // A produced message was delivered or failed.
+    KAFKA_EVENT_COMMIT,       // An offset commit completed or failed.
+    KAFKA_EVENT_ERROR,        // A consumer error; `opaque` is the errored rd_kafka_message_t, or NULL.
+    KAFKA_EVENT_REBALANCE,    // Partitions were assigned or revoked; `opaque` is the partition list.
+    KAFKA_EVENT_REQUEST,      // A seek or assign() was applied; `opaque` is the waiting future.
+} KafkaEventType;
+
+/**
+ * @brief A small, fixed-size record handed from a librdkafka callback to Python.
+ */
+typedef struct {
+    KafkaEventType type;      // What happened.
+    rd_kafka_resp_err_t err;  // Result of the operation.
+    void *opaque;             // Per-event context owned by the receiver.
+    int32_t partition;        // Partition the event refers to.
+    int64_t offset;           // Offset the event refers to.
+} KafkaEvent;
+
+/**
+ * @brief A mutex-protected, growable batch of events with fd wakeup.
+ *
+ * Callbacks on background threads append events; the event loop swaps the
+ * whole batch out in one step and processes it without holding the lock.
+ * The Wakeup is signalled only when the queue goes from empty to non-empty,
+ * so one event-loop callback serves everything queued since the last swap.
+ */
+typedef struct {
+    pthread_mutex_t lock;     // Protects `items` and `count`.
+    KafkaEvent *items;        // Pending events.
+    size_t count;             // Number of pending events.
+    size_t capacity;          // Allocated length of `items`.
+    Wakeup *wakeup;           // Signalled on the empty -> non-empty transition.
+} EventQueue;
+
+/**
+ * @brief Initializes an empty event queue.
+ * @param queue A pointer to the EventQueue to initialize.
+ * @param wakeup The Wakeup to signal, or NULL.
+ */
+void event_queue_init(EventQueue *queue, Wakeup *wakeup);
+
+/**
+ * @brief Appends an event. Safe to call from any thread.
+ * @param queue A pointer to the EventQueue.
+ * @param event The event to copy into the queue.
+ * @return 0 on success, -1 if the queue could not grow.
+ */
+int event_queue_push(EventQueue *queue, const KafkaEvent *event);
+
+/**
+ * @brief Exchanges the pending batch with the caller's (empty) buffer.
+ *
+ * On return `*items`/`*capacity` describe the batch that was pending and the
+ * queue keeps the caller's old buffer for reuse, so a steady state needs no
+ * allocation on either side.
+ * @param queue A pointer to the EventQueue.
+ * @param items In: the caller's spare buffer. Out: the pending events.
+ * @param capacity In/out: allocated length of `*items`.
+ * @return The number of events in `*items`.
+ */
+size_t event_queue_swap(EventQueue *queue, KafkaEvent **items, size_t *capacity);
+
+/**
+ * @brief Returns the number of pending events.
+ * @param queue A pointer to the EventQueue.
+ */
+size_t event_queue_size(EventQueue *queue);
+
+/**
+ * @brief Frees the queue's buffer. Pending events are discarded.
+ * @param queue A pointer to the EventQueue to destroy.
+ */
+void event_queue_destroy(EventQueue *queue);
+
+#endif
@@ -0,0 +1,52 @@
+#include <Python.h>
+#include "errors.h"
+#include "futures.h"
+
+/**
+ * @brief Interned method names used when resolving futures.
+ */
+static PyObject *str_done;
+static PyObject *str_set_result;
+static PyObject *str_set_exception;
+
+/**
+ * @brief Creates the interned method names.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int futures_init(void) {
+    if (str_done && str_set_result && str_set_exception) {
+        return 0;
+    }
+    str_done = PyUnicode_InternFromString("done");
+    str_set_result = PyUnicode_InternFromString("set_result");
+    str_set_exception = PyUnicode_InternFromString("set_exception");
+    return (str_done && str_set_result && str_set_exception) ? 0 : -1;
+}
+
+/**
+ * @brief Resolves an asyncio future from an event.
+ *
+ * @param future The future to resolve.
+ * @param event The event carrying the outcome.
+ * @param build_result Builds the success value.
+ */
+void future_resolve(PyObject *future, const KafkaEvent *event, FutureResultBuilder build_result) {
+    PyObject *done = PyObject_CallMethodNoArgs(future, str_done);
+    int is_done = done ? PyObject_IsTrue(done) : -1;
+    Py_XDECREF(done);
+    if (is_done == 0) {
+        PyObject *outcome = event->err ? kafka_error_new(event->err, NULL) : build_result(event);
+        PyObject *rc = NULL;
+        if (outcome) {
+            rc = PyObject_CallMethodOneArg(future, event->err ? str_set_exception : str_set_result, outcome);
+            Py_DECREF(outcome);
+        }
+        if (!rc) {
+            PyErr_WriteUnraisable(future);
+        }
+        Py_XDECREF(rc);
+    } else if (is_done < 0) {
+        PyErr_WriteUnraisable(future);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef ASYNKAF_FUTURES_H
+#define ASYNKAF_FUTURES_H
+
+#include <Python.h>
+#include "event_queue.h"
+
+/**
+ * @brief Builds the result a future is resolved with on success.
+ *
+ * @param event The event being delivered.
+ * @return A new reference, or NULL with an exception set.
+ */
+typedef PyObject *(*FutureResultBuilder)(const KafkaEvent *event);
+
+/**
+ * @brief Prepares module-level state used to resolve futures (interned names).
+ * @return 0 on success, -1 on failure.
+ */
+int futures_init(void);
+
+/**
+ * @brief Resolves an asyncio future from an event.
+ *
+ * If `event->err` is set the future gets a KafkaError, otherwise the value
+ * from `build_result`, which is only called for futures that are still
+ * pending. Futures that were already cancelled are left alone. Errors raised
+ * while resolving are reported as unraisable so one bad future does not
+ * stop the rest of a batch. Requires the GIL.
+ *
+ * @param future The future to resolve.
+ * @param event The event carrying the outcome.
+ * @param build_result Builds the success value.
+ */
+void future_resolve(PyObject *future, const KafkaEvent *event, FutureResultBuilder build_result);
+
+#endif
@@ -0,0 +1,508 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <pthread.h>
+#include "message.h"
+
+// Critical sections only exist from Python 3.13; before that the GIL
+// already serializes access to a Message.
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#endif
+
+/**
+ * @brief Bounded stack of deallocated Message objects kept for reuse.
+ *
+ * Like CPython's tuple and float freelists: a message churned through at
+ * line rate is recycled instead of going back to pymalloc, and a burst
+ * never keeps more than MESSAGE_FREELIST_MAX objects around. Entries are
+ * chained through their `owner` field. The GIL protects the list; without
+ * one, a mutex does, held only for the push or pop.
+ */
+static MessageObject *message_freelist;
+static size_t message_freelist_count;
+#ifdef Py_GIL_DISABLED
+static pthread_mutex_t message_freelist_lock = PTHREAD_MUTEX_INITIALIZER;
+#define FREELIST_LOCK() pthread_mutex_lock(&message_freelist_lock)
+#define FREELIST_UNLOCK() pthread_mutex_unlock(&message_freelist_lock)
+#else
+#define FREELIST_LOCK()
+#define FREELIST_UNLOCK()
+#endif
+
+/**
+ * @brief Takes a Message from the freelist, or allocates one.
+ * @return An initialized object with uninitialized fields, or NULL with a
+ *         MemoryError set.
+ */
+static MessageObject *message_alloc(void) {
+    FREELIST_LOCK();
+    MessageObject *self = message_freelist;
+    if (self) {
+        message_freelist = (MessageObject *)self->owner;
+        message_freelist_count--;
+    }
+    FREELIST_UNLOCK();
+    if (self) {
+        // Resets the reference count; the type is still MessageType.
+        return (MessageObject *)PyObject_Init((PyObject *)self, &MessageType);
+    }
+    return PyObject_New(MessageObject, &MessageType);
+}
+
+/**
+ * @brief Returns a cleared Message to the freelist, or frees it if full.
+ */
+static void message_free(MessageObject *self) {
+    FREELIST_LOCK();
+    if (message_freelist_count < MESSAGE_FREELIST_MAX) {
+        self->owner = (PyObject *)message_freelist;
+        message_freelist = self;
+        message_freelist_count++;
+        self = NULL;
+    }
+    FREELIST_UNLOCK();
+    if (self) {
+        Py_TYPE(self)->tp_free((PyObject *)self);
+    }
+}
+
+/**
+ * @brief Wraps a Kafka message in a new Message object.
+ *
+ * The returned object takes ownership of `rkmessage` and `note` and a
+ * reference to `owner`.
+ */
+PyObject *message_new(rd_kafka_message_t *rkmessage, const Decoder *decoder, void *note,
+                      PyObject *owner) {
+    MessageObject *self = message_alloc();
+    if (!self) {
+        if (decoder) {
+            decoder_release(decoder, note);
+        }
+        rd_kafka_message_destroy(rkmessage);
+        return NULL;
+    }
+    self->rkmessage = rkmessage;
+    self->owner = Py_NewRef(owner);
+    self->key = NULL;
+    self->topic = NULL;
+    self->headers = NULL;
+    self->timestamp = NULL;
+    self->decoder = decoder;
+    self->note = note;
+    self->decoded = NULL;
+    return (PyObject *)self;
+}
+
+/**
+ * @brief Initializes an empty scratch array.
+ */
+void message_scratch_init(MessageScratch *scratch) {
+    scratch->items = NULL;
+    scratch->notes = NULL;
+    scratch->capacity = 0;
+    pthread_mutex_init(&scratch->lock, NULL);
+}
+
+/**
+ * @brief Frees a scratch array.
+ */
+void message_scratch_destroy(MessageScratch *scratch) {
+    PyMem_RawFree(scratch->items);
+    scratch->items = NULL;
+    PyMem_RawFree(scratch->notes);
+    scratch->notes = NULL;
+    scratch->capacity = 0;
+    pthread_mutex_destroy(&scratch->lock);
+}
+
+/**
+ * @brief Pops up to `max_records` messages into a scratch array.
+ *
+ * All messages are taken from the queue with one message_queue_pop_batch()
+ * call. The shared scratch array is used unless another thread is draining
+ * right now, in which case the messages are popped into a private one,
+ * allocated together with room for the notes. trylock never blocks, so this
+ * cannot deadlock against the GIL.
+ */
+Py_ssize_t message_scratch_pop(MessageQueue *queue, Wakeup *wakeup, MessageScratch *scratch,
+                               size_t max_records, rd_kafka_message_t ***out, void ***notes) {
+    rd_kafka_message_t **batch;
+    void **batch_notes;
+    if (pthread_mutex_trylock(&scratch->lock) == 0) {
+        // Grow the scratch arrays if this call asks for more than before.
+        if (max_records > scratch->capacity) {
+            rd_kafka_message_t **grown = PyMem_RawRealloc(scratch->items, max_records * sizeof(rd_kafka_message_t *));
+            if (grown) {
+                scratch->items = grown;
+            }
+            void **grown_notes = grown ? PyMem_RawRealloc(scratch->notes, max_records * sizeof(void *)) : NULL;
+            if (!grown_notes) {
+                pthread_mutex_unlock(&scratch->lock);
+                PyErr_NoMemory();
+                return -1;
+            }
+            scratch->notes = grown_notes;
+            scratch->capacity = max_records;
+        }
+        batch = scratch->items;
+        batch_notes = scratch->notes;
+    } else {
+        batch = PyMem_RawMalloc(max_records * (sizeof(rd_kafka_message_t *) + sizeof(void *)));
+        if (!batch) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        batch_notes = (void **)(batch + max_records);
+    }
+    if (!notes) {
+        batch_notes = NULL;
+    }
+
+    size_t count = message_queue_pop_batch(queue, batch, batch_notes, max_records);
+    if (count == 0) {
+        // Nothing buffered: clear the fd and re-arm it. If a message raced
+        // in while arming, pick it up now instead of waiting for the fd.
+        wakeup_drain(wakeup);
+        if (!message_queue_arm(queue)) {
+            count = message_queue_pop_batch(queue, batch, batch_notes, max_records);
+        }
+    }
+    *out = batch;
+    if (notes) {
+        *notes = batch_notes;
+    }
+    return (Py_ssize_t)count;
+}
+
+/**
+ * @brief Gives back the array message_scratch_pop() popped into.
+ */
+void message_scratch_release(MessageScratch *scratch, rd_kafka_message_t **batch) {
+    if (batch == scratch->items) {
+        pthread_mutex_unlock(&scratch->lock);
+    } else {
+        PyMem_RawFree(batch);
+    }
+}
+
+/**
+ * @brief Pops a batch from a queue and wraps it in Message objects.
+ *
+ * The messages are popped with message_scratch_pop() and the list is built
+ * in a single pass.
+ */
+PyObject *message_list_drain(MessageQueue *queue, Wakeup *wakeup, MessageScratch *scratch,
+                             size_t max_records, PyObject *owner) {
+    rd_kafka_message_t **batch;
+    void **notes;
+    Py_ssize_t popped = message_scratch_pop(queue, wakeup, scratch, max_records, &batch, &notes);
+    if (popped < 0) {
+        return NULL;
+    }
+    size_t count = (size_t)popped;
+    const Decoder *decoder = queue->decoder;
+
+    PyObject *records = PyList_New((Py_ssize_t)count);
+    size_t i = 0;
+    if (records) {
+        for (; i < count; i++) {
+            // The Message takes ownership of the librdkafka message.
+            PyObject *record = message_new(batch[i], decoder, notes[i], owner);
+            if (!record) {
+                Py_CLEAR(records);
+                i++;
+                break;
+            }
+            PyList_SET_ITEM(records, (Py_ssize_t)i, record);
+        }
+    }
+    // On failure, release whatever was not converted.
+    for (; i < count; i++) {
+        if (decoder) {
+            decoder_release(decoder, notes[i]);
+        }
+        rd_kafka_message_destroy(batch[i]);
+    }
+
+    message_scratch_release(scratch, batch);
+    return records;
+}
+
+/**
+ * @brief Deallocates a Message object.
+ *
+ * Runs only once no exported buffer refers to the payload any more, so it
+ * is safe to hand the message back to librdkafka here.
+ */
+static void
+Message_dealloc(MessageObject *self) {
+    Py_XDECREF(self->key);
+    Py_XDECREF(self->topic);
+    Py_XDECREF(self->headers);
+    Py_XDECREF(self->timestamp);
+    Py_XDECREF(self->decoded);
+    if (self->decoder) {
+        decoder_release(self->decoder, self->note);
+    }
+    if (self->rkmessage) {
+        rd_kafka_message_destroy(self->rkmessage);
+    }
+    Py_XDECREF(self->owner);
+    message_free(self);
+}
+
+/**
+ * @brief Exports the message payload through the buffer protocol.
+ *
+ * The buffer is read-only and points straight at `rkmessage->payload`; the
+ * exporter reference held by the view keeps the message alive.
+ */
+static int
+Message_getbuffer(MessageObject *self, Py_buffer *view, int flags) {
+    static char empty[1];
+    void *payload = self->rkmessage->payload ? self->rkmessage->payload : empty;
+    return PyBuffer_FillInfo(view, (PyObject *)self, payload,
+                             (Py_ssize_t)self->rkmessage->len, 1, flags);
+}
+
+/**
+ * @brief Buffer protocol slots for the Message type.
+ */
+static PyBufferProcs Message_as_buffer = {
+    .bf_getbuffer = (getbufferproc)Message_getbuffer,
+    .bf_releasebuffer = NULL,
+};
+
+/**
+ * @brief Returns a read-only memoryview over the payload, or None.
+ */
+static PyObject *
+Message_get_value(MessageObject *self, void *closure) {
+    if (!self->rkmessage->payload) {
+        Py_RETURN_NONE;
+    }
+    return PyMemoryView_FromObject((PyObject *)self);
+}
+
+/**
+ * @brief Builds the message key as bytes, or None.
+ */
+static PyObject *
+build_key(const rd_kafka_message_t *rkmessage) {
+    if (!rkmessage->key) {
+        Py_RETURN_NONE;
+    }
+    return PyBytes_FromStringAndSize((const char *)rkmessage->key, (Py_ssize_t)rkmessage->key_len);
+}
+
+/**
+ * @brief Builds the name of the topic the message was read from.
+ */
+static PyObject *
+build_topic(const rd_kafka_message_t *rkmessage) {
+    return PyUnicode_FromString(rd_kafka_topic_name(rkmessage->rkt));
+}
+
+/**
+ * @brief Builds the headers tuple from librdkafka's header list.
+ *
+ * @return A new tuple of `(name, value)` pairs, where `value` is bytes or
+ *         None; the empty tuple if the message has no headers.
+ */
+static PyObject *
+build_headers(const rd_kafka_message_t *rkmessage) {
+    rd_kafka_headers_t *hdrs = NULL;
+    if (rd_kafka_message_headers(rkmessage, &hdrs) != RD_KAFKA_RESP_ERR_NO_ERROR || !hdrs) {
+        return PyTuple_New(0);
+    }
+
+    size_t count = rd_kafka_header_cnt(hdrs);
+    PyObject *headers = PyTuple_New((Py_ssize_t)count);
+    if (!headers) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const char *name;
+        const void *value;
+        size_t size;
+        if (rd_kafka_header_get_all(hdrs, i, &name, &value, &size) != RD_KAFKA_RESP_ERR_NO_ERROR) {
+            Py_DECREF(headers);
+            PyErr_SetString(PyExc_RuntimeError, "failed to read message header");
+            return NULL;
+        }
+        PyObject *pair = Py_BuildValue("(sy#)", name, (const char *)value, (Py_ssize_t)size);
+        if (!pair) {
+            Py_DECREF(headers);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(headers, (Py_ssize_t)i, pair);
+    }
+    return headers;
+}
+
+/**
+ * @brief Builds the message timestamp in milliseconds, or None if the
+ * broker did not provide one.
+ */
+static PyObject *
+build_timestamp(const rd_kafka_message_t *rkmessage) {
+    rd_kafka_timestamp_type_t tstype;
+    int64_t timestamp = rd_kafka_message_timestamp(rkmessage, &tstype);
+    if (tstype == RD_KAFKA_TIMESTAMP_NOT_AVAILABLE) {
+        Py_RETURN_NONE;
+    }
+    return PyLong_FromLongLong(timestamp);
+}
+
+/**
+ * @brief Returns a lazily built field, building and caching it on first use.
+ *
+ * The check-and-fill runs inside a per-object critical section, so two
+ * threads of a free-threaded build reading the same Message cannot both
+ * fill (and leak) the cache slot. With the GIL it compiles to a plain block.
+ *
+ * @param self The Message.
+ * @param slot The cache slot for the field.
+ * @param build Builds the field from the underlying librdkafka message.
+ * @return A new reference, or NULL with an exception set.
+ */
+static PyObject *
+message_cached(MessageObject *self, PyObject **slot, PyObject *(*build)(const rd_kafka_message_t *)) {
+    PyObject *value;
+    Py_BEGIN_CRITICAL_SECTION(self);
+    if (!*slot) {
+        *slot = build(self->rkmessage);
+    }
+    value = Py_XNewRef(*slot);
+    Py_END_CRITICAL_SECTION();
+    return value;
+}
+
+/**
+ * @brief Returns the message key as bytes, or None. Cached after first use.
+ */
+static PyObject *
+Message_get_key(MessageObject *self, void *closure) {
+    return message_cached(self, &self->key, build_key);
+}
+
+/**
+ * @brief Returns the name of the topic the message was read from. Cached
+ * after first use.
+ */
+static PyObject *
+Message_get_topic(MessageObject *self, void *closure) {
+    return message_cached(self, &self->topic, build_topic);
+}
+
+/**
+ * @brief Returns the message headers. Cached after first use.
+ */
+static PyObject *
+Message_get_headers(MessageObject *self, void *closure) {
+    return message_cached(self, &self->headers, build_headers);
+}
+
+/**
+ * @brief Returns the message timestamp in milliseconds, or None if the
+ * broker did not provide one. Cached after first use.
+ */
+static PyObject *
+Message_get_timestamp(MessageObject *self, void *closure) {
+    return message_cached(self, &self->timestamp, build_timestamp);
+}
+
+/**
+ * @brief Returns the payload as decoded by the consumer's decoder.
+ *
+ * The result the poller left in `note` is converted on first access, under
+ * the same critical section as the other cached fields, then freed, since
+ * the cached value replaces it. A payload the decoder rejected raises
+ * ValueError on every access.
+ */
+static PyObject *
+Message_get_decoded(MessageObject *self, void *closure) {
+    if (!self->decoder) {
+        PyErr_SetString(PyExc_AttributeError, "the consumer was created without a decoder");
+        return NULL;
+    }
+    if (!self->rkmessage->payload) {
+        Py_RETURN_NONE;
+    }
+    PyObject *value;
+    Py_BEGIN_CRITICAL_SECTION(self);
+    if (!self->decoded) {
+        const Decoder *decoder = self->decoder;
+        self->decoded = decoder->to_python(decoder->ctx, (PyObject *)self, self->rkmessage, self->note);
+        if (self->decoded) {
+            decoder_release(decoder, self->note);
+            self->note = NULL;
+        }
+    }
+    value = Py_XNewRef(self->decoded);
+    Py_END_CRITICAL_SECTION();
+    return value;
+}
+
+/**
+ * @brief Returns the message's partition.
+ */
+static PyObject *
+Message_get_partition(MessageObject *self, void *closure) {
+    return PyLong_FromLong(self->rkmessage->partition);
+}
+
+/**
+ * @brief Returns the message's offset.
+ */
+static PyObject *
+Message_get_offset(MessageObject *self, void *closure) {
+    return PyLong_FromLongLong(self->rkmessage->offset);
+}
+
+/**
+ * @brief Returns a short description of the message.
+ */
+static PyObject *
+Message_repr(MessageObject *self) {
+    return PyUnicode_FromFormat("<Message topic=%s partition=%d offset=%lld>",
+                                rd_kafka_topic_name(self->rkmessage->rkt),
+                                (int)self->rkmessage->partition,
+                                (long long)self->rkmessage->offset);
+}
+
+/**
+ * @brief Attribute accessors for Message objects.
+ */
+static PyGetSetDef Message_getset[] = {
+    {"value", (getter)Message_get_value, NULL, "Zero-copy memoryview over the payload, or None.", NULL},
+    {"key", (getter)Message_get_key, NULL, "Message key as bytes, or None.", NULL},
+    {"topic", (getter)Message_get_topic, NULL, "Topic name.", NULL},
+    {"headers", (getter)Message_get_headers, NULL, "Tuple of (name, value) header pairs.", NULL},
+    {"timestamp", (getter)Message_get_timestamp, NULL, "Timestamp in milliseconds, or None.", NULL},
+    {"decoded", (getter)Message_get_decoded, NULL,
+     "Payload decoded by the consumer's decoder, or None for a null payload.", NULL},
+    {"partition", (getter)Message_get_partition, NULL, "Partition number.", NULL},
+    {"offset", (getter)Message_get_offset, NULL, "Message offset.", NULL},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the Message.
+ *
+ * Messages are only created by the consumer, so there is no `__new__`.
+ */
+PyTypeObject MessageType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_core.Message",
+    .tp_doc = "Kafka message owning its librdkafka payload",
+    .tp_basicsize = sizeof(MessageObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)Message_dealloc,
+    .tp_repr = (reprfunc)Message_repr,
+    .tp_as_buffer = &Message_as_buffer,
+    .tp_getset = Message_getset,
+};
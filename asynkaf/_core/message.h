@@ -0,0 +1,134 @@
+#ifndef ASYNKAF_MESSAGE_H
+#define ASYNKAF_MESSAGE_H
+
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <pthread.h>
+#include "decoder.h"
+#include "queue.h"
+#include "wakeup.h"
+
+/**
+ * @brief A consumed Kafka message exposed to Python.
+ *
+ * The object owns the underlying `rd_kafka_message_t` and destroys it when
+ * the last reference (including any exported buffer) goes away. The payload
+ * is exposed through the buffer protocol, so `memoryview(msg.value)` and
+ * `numpy.frombuffer(msg.value)` read librdkafka's memory without a copy.
+ *
+ * `key`, `topic`, `headers` and `timestamp` are built on first access and
+ * cached; a NULL cache slot means "not computed yet". So is `decoded`, from
+ * the result the consumer's decoder left in `note` on the poller thread.
+ */
+typedef struct {
+    PyObject_HEAD
+    rd_kafka_message_t *rkmessage; // The owned librdkafka message.
+    PyObject *owner;          // The Consumer, kept alive while the message is.
+    PyObject *key;            // Cached key (bytes or None).
+    PyObject *topic;          // Cached topic name (str).
+    PyObject *headers;        // Cached headers (tuple of (name, value) pairs).
+    PyObject *timestamp;      // Cached timestamp in ms (int or None).
+    const Decoder *decoder;   // The consumer's decoder, or NULL.
+    void *note;               // Its result for this message until `decoded` is built.
+    PyObject *decoded;        // Cached decoded payload.
+} MessageObject;
+
+/**
+ * @brief Most deallocated Message objects kept for reuse by message_new().
+ */
+#define MESSAGE_FREELIST_MAX 1024
+
+/**
+ * @brief External declaration of the MessageType object.
+ */
+extern PyTypeObject MessageType;
+
+/**
+ * @brief Wraps a Kafka message in a new Message object.
+ *
+ * Ownership of `rkmessage` and `note` is transferred to the returned
+ * object. On failure both are destroyed and NULL is returned with an
+ * exception set. The Message holds a reference to `owner` so the librdkafka
+ * handle (and the decoder it was created with) cannot be destroyed while
+ * the message is still alive.
+ *
+ * @param rkmessage The message to wrap.
+ * @param decoder The decoder that produced `note`, or NULL.
+ * @param note The decoder's result for `rkmessage`, or NULL.
+ * @param owner The object owning the librdkafka handle.
+ * @return A new reference to a Message, or NULL on failure.
+ */
+PyObject *message_new(rd_kafka_message_t *rkmessage, const Decoder *decoder, void *note,
+                      PyObject *owner);
+
+/**
+ * @brief A reusable array that queue drains pop messages into.
+ *
+ * Only one thread uses `items` at a time; a concurrent drain that finds
+ * `lock` taken pops into a private array instead of waiting.
+ */
+typedef struct {
+    rd_kafka_message_t **items; // Scratch storage.
+    void **notes;             // The messages' notes, parallel to `items`.
+    size_t capacity;          // Length of `items` and `notes`.
+    pthread_mutex_t lock;     // Held by the drain currently using `items`.
+} MessageScratch;
+
+/**
+ * @brief Initializes an empty scratch array.
+ * @param scratch A pointer to the MessageScratch.
+ */
+void message_scratch_init(MessageScratch *scratch);
+
+/**
+ * @brief Frees a scratch array.
+ * @param scratch A pointer to the MessageScratch.
+ */
+void message_scratch_destroy(MessageScratch *scratch);
+
+/**
+ * @brief Pops up to `max_records` messages into a scratch array.
+ *
+ * If the queue is empty, `wakeup` is drained and the queue re-armed, so the
+ * next push makes the fd readable again. Safe to call from several threads
+ * at once; each call gets a disjoint run of messages.
+ *
+ * @param queue The queue to drain.
+ * @param wakeup The queue's Wakeup.
+ * @param scratch Scratch array to pop into.
+ * @param max_records Maximum number of messages to pop (>= 1).
+ * @param out Receives the array holding the messages; hand it back with
+ *        message_scratch_release() once they have been taken out.
+ * @param notes Receives the array holding their notes, or NULL to have
+ *        the notes released.
+ * @return The number of messages popped, or -1 with a MemoryError set.
+ */
+Py_ssize_t message_scratch_pop(MessageQueue *queue, Wakeup *wakeup, MessageScratch *scratch,
+                               size_t max_records, rd_kafka_message_t ***out, void ***notes);
+
+/**
+ * @brief Gives back the array message_scratch_pop() popped into.
+ * @param scratch The MessageScratch passed to message_scratch_pop().
+ * @param batch The array it returned.
+ */
+void message_scratch_release(MessageScratch *scratch, rd_kafka_message_t **batch);
+
+/**
+ * @brief Pops up to `max_records` messages into a new list of Messages.
+ *
+ * If the queue is empty, `wakeup` is drained and the queue re-armed, so the
+ * next push makes the fd readable again. Safe to call from several threads
+ * at once; each call gets a disjoint run of messages. Messages take their
+ * notes along if the queue tracks them.
+ *
+ * @param queue The queue to drain.
+ * @param wakeup The queue's Wakeup.
+ * @param scratch Scratch array to pop into.
+ * @param max_records Maximum number of messages to return (>= 1).
+ * @param owner The object owning the librdkafka handle.
+ * @return A new list, possibly empty, or NULL with an exception set.
+ */
+PyObject *message_list_drain(MessageQueue *queue, Wakeup *wakeup, MessageScratch *scratch,
+                             size_t max_records, PyObject *owner);
+
+#endif
@@ -0,0 +1,150 @@
+#include <Python.h>
+#include <time.h>
+#include "metrics.h"
+
+/**
+ * @brief Number of values sharing one bucket exactly (the linear range).
+ */
+#define HISTOGRAM_SUB_COUNT (1u << HISTOGRAM_SUB_BITS)
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+uint64_t metrics_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Maps a value to its bucket index.
+ */
+static size_t histogram_index(uint64_t value) {
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return (size_t)value;
+    }
+    unsigned exponent = 63 - (unsigned)__builtin_clzll(value);
+    unsigned shift = exponent - HISTOGRAM_SUB_BITS;
+    return ((size_t)(shift + 1) << HISTOGRAM_SUB_BITS) +
+           (size_t)((value >> shift) & (HISTOGRAM_SUB_COUNT - 1));
+}
+
+/**
+ * @brief Returns the largest value that maps to bucket `index`.
+ */
+static uint64_t histogram_upper_bound(size_t index) {
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return index;
+    }
+    unsigned shift = (unsigned)(index >> HISTOGRAM_SUB_BITS) - 1;
+    uint64_t sub = index & (HISTOGRAM_SUB_COUNT - 1);
+    uint64_t lower = (HISTOGRAM_SUB_COUNT + sub) << shift;
+    return lower + ((UINT64_C(1) << shift) - 1);
+}
+
+/**
+ * @brief Initializes an empty histogram.
+ *
+ * @param hist A pointer to the Histogram.
+ */
+void histogram_init(Histogram *hist) {
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        atomic_init(&hist->counts[i], 0);
+    }
+    atomic_init(&hist->count, 0);
+    atomic_init(&hist->sum, 0);
+    atomic_init(&hist->max, 0);
+}
+
+/**
+ * @brief Records one sample.
+ *
+ * @param hist A pointer to the Histogram.
+ * @param value The sample.
+ */
+void histogram_record(Histogram *hist, uint64_t value) {
+    atomic_fetch_add_explicit(&hist->counts[histogram_index(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum, value, memory_order_relaxed);
+    uint_fast64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&hist->max, &max, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Summarizes a histogram for Python.
+ *
+ * The bucket counts are copied first and the percentiles computed from that
+ * copy, so they are consistent with each other even while samples arrive.
+ *
+ * @param hist A pointer to the Histogram.
+ * @return A new dict, or NULL on failure.
+ */
+PyObject *histogram_snapshot(Histogram *hist) {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    static const char *const names[] = {"p50", "p90", "p99", "p999"};
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&hist->counts[i], memory_order_relaxed);
+        total += counts[i];
+    }
+    uint64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+
+    PyObject *result = Py_BuildValue("{s:K,s:K,s:K}",
+                                     "count", (unsigned long long)total,
+                                     "sum", (unsigned long long)atomic_load_explicit(&hist->sum, memory_order_relaxed),
+                                     "max", (unsigned long long)max);
+    if (!result) {
+        return NULL;
+    }
+
+    size_t bucket = 0;
+    uint64_t seen = 0;
+    for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+        uint64_t value = 0;
+        if (total) {
+            // The rank of the sample the quantile falls on, 1-based.
+            uint64_t rank = (uint64_t)(quantiles[q] * (double)total);
+            if (rank == 0) {
+                rank = 1;
+            }
+            while (bucket < HISTOGRAM_BUCKETS && seen + counts[bucket] < rank) {
+                seen += counts[bucket++];
+            }
+            value = histogram_upper_bound(bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1);
+            if (value > max) {
+                value = max;
+            }
+        }
+        PyObject *item = PyLong_FromUnsignedLongLong(value);
+        if (!item || PyDict_SetItemString(result, names[q], item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(item);
+    }
+    return result;
+}
+
+/**
+ * @brief Initializes all counters and histograms to zero.
+ *
+ * @param metrics A pointer to the ConsumerMetrics.
+ */
+void consumer_metrics_init(ConsumerMetrics *metrics) {
+    atomic_init(&metrics->messages, 0);
+    atomic_init(&metrics->bytes, 0);
+    atomic_init(&metrics->errors, 0);
+    atomic_init(&metrics->errors_dropped, 0);
+    atomic_init(&metrics->messages_dropped, 0);
+    atomic_init(&metrics->decode_errors, 0);
+    atomic_init(&metrics->polls, 0);
+    histogram_init(&metrics->poll_ns);
+    histogram_init(&metrics->dwell_ns);
+    histogram_init(&metrics->queue_depth);
+    histogram_init(&metrics->queue_bytes);
+}
@@ -0,0 +1,91 @@
+#ifndef ASYNKAF_METRICS_H
+#define ASYNKAF_METRICS_H
+
+#include <Python.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * @brief Sub-buckets per power of two, as a bit count.
+ *
+ * 16 linear sub-buckets bound the relative error of a recorded value to
+ * 1/16 (about 6%).
+ */
+#define HISTOGRAM_SUB_BITS 4
+
+/**
+ * @brief Number of buckets needed to cover every uint64_t value.
+ */
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+/**
+ * @brief A lock-free HDR-style histogram of uint64_t samples.
+ *
+ * Values below 2^HISTOGRAM_SUB_BITS get a bucket each; above that every
+ * power of two is split into 2^HISTOGRAM_SUB_BITS equal sub-buckets, so the
+ * precision is relative to the value and the whole uint64_t range fits in a
+ * fixed array. Recording is a few relaxed atomic adds and may happen from
+ * any thread; snapshots read the buckets without stopping writers, so a
+ * snapshot taken during recording can be off by the samples in flight.
+ */
+typedef struct Histogram {
+    atomic_uint_fast64_t counts[HISTOGRAM_BUCKETS]; // Samples per bucket.
+    atomic_uint_fast64_t count; // Total number of samples.
+    atomic_uint_fast64_t sum;   // Sum of all samples.
+    atomic_uint_fast64_t max;   // Largest sample seen.
+} Histogram;
+
+/**
+ * @brief Lock-free counters and histograms of one consumer's pipeline.
+ *
+ * Written by the poller (and, for `dwell_ns`, by whichever thread pops), and
+ * read by `Consumer.metrics()` without any lock.
+ */
+typedef struct {
+    atomic_uint_fast64_t messages; // Messages received from librdkafka.
+    atomic_uint_fast64_t bytes;    // Payload bytes of those messages.
+    atomic_uint_fast64_t errors;   // Errored messages (including partition EOF events).
+    atomic_uint_fast64_t errors_dropped; // Errors discarded because the error queue was full.
+    atomic_uint_fast64_t messages_dropped; // Messages discarded because the queue could not take them.
+    atomic_uint_fast64_t decode_errors; // Payloads the consumer's decoder rejected.
+    atomic_uint_fast64_t polls;    // Calls into librdkafka's consume API.
+    Histogram poll_ns;        // Duration of each consume call.
+    Histogram dwell_ns;       // Receipt to pop time of the oldest message of each pop.
+    Histogram queue_depth;    // Queue length after each push.
+    Histogram queue_bytes;    // Queued payload bytes after each push.
+} ConsumerMetrics;
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+uint64_t metrics_now_ns(void);
+
+/**
+ * @brief Initializes an empty histogram.
+ * @param hist A pointer to the Histogram.
+ */
+void histogram_init(Histogram *hist);
+
+/**
+ * @brief Records one sample.
+ * @param hist A pointer to the Histogram.
+ * @param value The sample.
+ */
+void histogram_record(Histogram *hist, uint64_t value);
+
+/**
+ * @brief Summarizes a histogram for Python.
+ * @param hist A pointer to the Histogram.
+ * @return A new dict with `count`, `sum`, `max`, `p50`, `p90`, `p99` and
+ *         `p999`, or NULL on failure. Percentiles are reported as the upper
+ *         bound of their bucket, capped at `max`.
+ */
+PyObject *histogram_snapshot(Histogram *hist);
+
+/**
+ * @brief Initializes all counters and histograms to zero.
+ * @param metrics A pointer to the ConsumerMetrics.
+ */
+void consumer_metrics_init(ConsumerMetrics *metrics);
+
+#endif
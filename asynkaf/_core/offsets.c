@@ -0,0 +1,227 @@
+#include "offsets.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initial capacity of the entry array.
+ */
+#define OFFSET_TABLE_INITIAL_CAPACITY 16
+
+/**
+ * @brief Initializes an OffsetTable.
+ *
+ * @param table A pointer to the OffsetTable to be initialized.
+ */
+void offset_table_init(OffsetTable *table) {
+    pthread_mutex_init(&table->lock, NULL);
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->last = 0;
+    atomic_init(&table->pending, 0);
+}
+
+/**
+ * @brief Acquires the table lock.
+ *
+ * @param table A pointer to the OffsetTable.
+ */
+void offset_table_lock(OffsetTable *table) {
+    pthread_mutex_lock(&table->lock);
+}
+
+/**
+ * @brief Releases the table lock.
+ *
+ * @param table A pointer to the OffsetTable.
+ */
+void offset_table_unlock(OffsetTable *table) {
+    pthread_mutex_unlock(&table->lock);
+}
+
+/**
+ * @brief Finds the entry for a partition, creating it if needed.
+ *
+ * @return The entry, or NULL on allocation failure.
+ */
+static OffsetEntry *offset_table_entry(OffsetTable *table, const char *topic, int32_t partition) {
+    if (table->count) {
+        OffsetEntry *entry = &table->entries[table->last];
+        if (entry->partition == partition && strcmp(entry->topic, topic) == 0) {
+            return entry;
+        }
+    }
+    for (size_t i = 0; i < table->count; i++) {
+        OffsetEntry *entry = &table->entries[i];
+        if (entry->partition == partition && strcmp(entry->topic, topic) == 0) {
+            table->last = i;
+            return entry;
+        }
+    }
+
+    if (table->count == table->capacity) {
+        size_t capacity = table->capacity ? table->capacity * 2 : OFFSET_TABLE_INITIAL_CAPACITY;
+        OffsetEntry *entries = realloc(table->entries, capacity * sizeof(OffsetEntry));
+        if (!entries) {
+            return NULL;
+        }
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+    char *name = strdup(topic);
+    if (!name) {
+        return NULL;
+    }
+    OffsetEntry *entry = &table->entries[table->count];
+    entry->topic = name;
+    entry->partition = partition;
+    entry->offset = RD_KAFKA_OFFSET_INVALID;
+    entry->dirty = 0;
+    entry->released = 0;
+    table->last = table->count++;
+    return entry;
+}
+
+/**
+ * @brief Records a processed offset.
+ *
+ * The committed position is the next offset to consume, so `offset + 1` is
+ * stored.
+ *
+ * @param table A pointer to the OffsetTable.
+ * @param topic Topic name.
+ * @param partition Partition number.
+ * @param offset The processed message's offset.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int offset_table_store_locked(OffsetTable *table, const char *topic, int32_t partition, int64_t offset) {
+    OffsetEntry *entry = offset_table_entry(table, topic, partition);
+    if (!entry) {
+        return -1;
+    }
+    if (offset + 1 > entry->offset) {
+        entry->offset = offset + 1;
+        entry->dirty = 1;
+    }
+    entry->released = 0;
+    atomic_fetch_add_explicit(&table->pending, 1, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief Returns the number of stores since the last flush.
+ *
+ * @param table A pointer to the OffsetTable.
+ */
+size_t offset_table_pending(OffsetTable *table) {
+    return atomic_load_explicit(&table->pending, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees the released entries that are clean. Requires the table lock.
+ */
+static void offset_table_drop_released(OffsetTable *table) {
+    size_t kept = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        OffsetEntry *entry = &table->entries[i];
+        if (entry->released && !entry->dirty) {
+            free(entry->topic);
+        } else {
+            table->entries[kept++] = *entry;
+        }
+    }
+    table->count = kept;
+    table->last = 0;
+}
+
+/**
+ * @brief Collects the dirty entries into a partition list.
+ *
+ * Released entries are dropped once their offsets are in the list.
+ *
+ * @param table A pointer to the OffsetTable.
+ * @return The list, or NULL if no entry is dirty (or on allocation failure,
+ *         in which case the entries stay dirty for the next flush).
+ */
+rd_kafka_topic_partition_list_t *offset_table_take_dirty(OffsetTable *table) {
+    rd_kafka_topic_partition_list_t *list = NULL;
+    pthread_mutex_lock(&table->lock);
+    size_t dirty = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        dirty += table->entries[i].dirty;
+    }
+    if (dirty) {
+        list = rd_kafka_topic_partition_list_new((int)dirty);
+    }
+    if (list) {
+        for (size_t i = 0; i < table->count; i++) {
+            OffsetEntry *entry = &table->entries[i];
+            if (entry->dirty) {
+                rd_kafka_topic_partition_list_add(list, entry->topic, entry->partition)->offset = entry->offset;
+                entry->dirty = 0;
+            }
+        }
+        offset_table_drop_released(table);
+    }
+    if (list || !dirty) {
+        atomic_store_explicit(&table->pending, 0, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&table->lock);
+    return list;
+}
+
+/**
+ * @brief Removes the entries of the given partitions.
+ *
+ * @param table A pointer to the OffsetTable.
+ * @param partitions The partitions to forget.
+ */
+void offset_table_forget(OffsetTable *table, const rd_kafka_topic_partition_list_t *partitions) {
+    pthread_mutex_lock(&table->lock);
+    size_t kept = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        OffsetEntry *entry = &table->entries[i];
+        if (rd_kafka_topic_partition_list_find(partitions, entry->topic, entry->partition)) {
+            free(entry->topic);
+        } else {
+            table->entries[kept++] = *entry;
+        }
+    }
+    table->count = kept;
+    table->last = 0;
+    pthread_mutex_unlock(&table->lock);
+}
+
+/**
+ * @brief Marks the entries of the given partitions as released.
+ *
+ * @param table A pointer to the OffsetTable.
+ * @param partitions The partitions to release.
+ */
+void offset_table_release(OffsetTable *table, const rd_kafka_topic_partition_list_t *partitions) {
+    pthread_mutex_lock(&table->lock);
+    for (size_t i = 0; i < table->count; i++) {
+        OffsetEntry *entry = &table->entries[i];
+        if (rd_kafka_topic_partition_list_find(partitions, entry->topic, entry->partition)) {
+            entry->released = 1;
+        }
+    }
+    offset_table_drop_released(table);
+    pthread_mutex_unlock(&table->lock);
+}
+
+/**
+ * @brief Destroys the OffsetTable.
+ *
+ * @param table A pointer to the OffsetTable to be destroyed.
+ */
+void offset_table_destroy(OffsetTable *table) {
+    for (size_t i = 0; i < table->count; i++) {
+        free(table->entries[i].topic);
+    }
+    free(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    pthread_mutex_destroy(&table->lock);
+}
@@ -0,0 +1,112 @@
+#ifndef ASYNKAF_OFFSETS_H
+#define ASYNKAF_OFFSETS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <librdkafka/rdkafka.h>
+
+/**
+ * @brief The offset to commit for one partition.
+ */
+typedef struct {
+    char *topic;              // Topic name (owned copy).
+    int32_t partition;        // Partition number.
+    int64_t offset;           // Next offset to consume, i.e. last processed + 1.
+    int dirty;                // Whether `offset` changed since the last flush.
+    int released;             // Partition no longer owned; dropped once its offset is taken.
+} OffsetEntry;
+
+/**
+ * @brief Highest processed offset per partition, waiting to be committed.
+ *
+ * Python threads store offsets; the poller periodically takes the dirty
+ * entries as one partition list and commits them with a single request, so
+ * any number of stores between flushes costs one commit. Entries are kept
+ * in a flat array: consumers own few partitions, and the last entry hit is
+ * checked first because stores arrive in per-partition runs.
+ */
+typedef struct {
+    pthread_mutex_t lock;     // Protects everything but `pending`.
+    OffsetEntry *entries;     // One entry per partition seen.
+    size_t count;             // Number of entries in use.
+    size_t capacity;          // Allocated length of `entries`.
+    size_t last;              // Index of the most recently stored entry.
+    atomic_size_t pending;    // Stores since the last flush.
+} OffsetTable;
+
+/**
+ * @brief Initializes an empty offset table.
+ * @param table A pointer to the OffsetTable.
+ */
+void offset_table_init(OffsetTable *table);
+
+/**
+ * @brief Acquires the table lock, for a run of offset_table_store_locked().
+ * @param table A pointer to the OffsetTable.
+ */
+void offset_table_lock(OffsetTable *table);
+
+/**
+ * @brief Releases the table lock.
+ * @param table A pointer to the OffsetTable.
+ */
+void offset_table_unlock(OffsetTable *table);
+
+/**
+ * @brief Records that `offset` was processed. Requires the table lock.
+ *
+ * Offsets only move forward: storing an offset at or below the one already
+ * recorded is a no-op.
+ * @param table A pointer to the OffsetTable.
+ * @param topic Topic name.
+ * @param partition Partition number.
+ * @param offset The processed message's offset.
+ * @return 0 on success, -1 if a new entry could not be allocated.
+ */
+int offset_table_store_locked(OffsetTable *table, const char *topic, int32_t partition, int64_t offset);
+
+/**
+ * @brief Returns the number of stores since the last flush.
+ * @param table A pointer to the OffsetTable.
+ */
+size_t offset_table_pending(OffsetTable *table);
+
+/**
+ * @brief Takes all dirty entries as a partition list and marks them clean.
+ * @param table A pointer to the OffsetTable.
+ * @return A new partition list for `rd_kafka_commit`, or NULL if nothing
+ *         changed since the last flush.
+ */
+rd_kafka_topic_partition_list_t *offset_table_take_dirty(OffsetTable *table);
+
+/**
+ * @brief Drops the entries of partitions this consumer no longer owns.
+ *
+ * Their offsets are not committed any more, so a stale store cannot
+ * overwrite the new owner's progress with the next flush.
+ * @param table A pointer to the OffsetTable.
+ * @param partitions The partitions to forget.
+ */
+void offset_table_forget(OffsetTable *table, const rd_kafka_topic_partition_list_t *partitions);
+
+/**
+ * @brief Drops the entries of partitions that are no longer owned, once taken.
+ *
+ * Clean entries go at once; dirty ones stay until the next
+ * offset_table_take_dirty() hands their offsets out, for a consumer whose
+ * commits ride on a transaction that is still open. A new store for the
+ * partition keeps the entry.
+ * @param table A pointer to the OffsetTable.
+ * @param partitions The partitions to release.
+ */
+void offset_table_release(OffsetTable *table, const rd_kafka_topic_partition_list_t *partitions);
+
+/**
+ * @brief Frees the table.
+ * @param table A pointer to the OffsetTable to destroy.
+ */
+void offset_table_destroy(OffsetTable *table);
+
+#endif
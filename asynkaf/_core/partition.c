@@ -0,0 +1,253 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "columnar.h"
+#include "partition.h"
+
+/**
+ * @brief Bytes librdkafka writes to the poller's Wakeup on new messages.
+ *
+ * Eight bytes, as an eventfd requires; a pipe accepts them just as well.
+ */
+static const uint64_t io_event_payload = 1;
+
+/**
+ * @brief Has librdkafka signal `wakeup` whenever `rkqu` becomes non-empty.
+ */
+void rkqueue_set_wakeup(rd_kafka_queue_t *rkqu, Wakeup *wakeup) {
+    if (wakeup) {
+        rd_kafka_queue_io_event_enable(rkqu, wakeup->write_fd,
+                                       &io_event_payload, sizeof(io_event_payload));
+    } else {
+        rd_kafka_queue_io_event_enable(rkqu, -1, NULL, 0);
+    }
+}
+
+/**
+ * @brief Splits one partition off the consumer queue.
+ *
+ * Creates the partition's MessageQueue and Wakeup, then stops librdkafka
+ * from forwarding the partition to the consumer queue and has it signal the
+ * poller instead. Messages already forwarded before the split stay on the
+ * consumer queue, so split partitions before their assignment starts
+ * fetching to keep every message on one stream.
+ */
+PartitionQueue *partition_queue_new(rd_kafka_t *rk, const char *topic, int32_t partition,
+                                    const MessageQueue *template, Wakeup *poller) {
+    PartitionQueue *part = calloc(1, sizeof(PartitionQueue));
+    if (!part) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    part->partition = partition;
+    part->wakeup.read_fd = -1;
+    part->wakeup.write_fd = -1;
+    message_scratch_init(&part->scratch);
+
+    part->topic = strdup(topic);
+    if (!part->topic) {
+        PyErr_NoMemory();
+        goto fail;
+    }
+    if (message_queue_init(&part->queue, template->capacity) != 0) {
+        PyErr_NoMemory();
+        goto fail_queue;
+    }
+    message_queue_set_watermarks(&part->queue, template->high_messages, template->low_messages,
+                                 template->high_bytes, template->low_bytes);
+    if (wakeup_init(&part->wakeup) != 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto fail_wakeup;
+    }
+    message_queue_set_wakeup(&part->queue, &part->wakeup);
+    if ((template->dwell && message_queue_track_dwell(&part->queue, template->dwell) != 0) ||
+        (template->decoder && message_queue_track_notes(&part->queue, template->decoder) != 0)) {
+        PyErr_NoMemory();
+        goto fail_track;
+    }
+
+    part->rkqu = rd_kafka_queue_get_partition(rk, topic, partition);
+    if (!part->rkqu) {
+        PyErr_Format(PyExc_ValueError, "unknown partition %s [%d]", topic, (int)partition);
+        goto fail_rkqu;
+    }
+    rd_kafka_queue_forward(part->rkqu, NULL);
+    rkqueue_set_wakeup(part->rkqu, poller);
+    return part;
+
+fail_rkqu:
+fail_track:
+    wakeup_destroy(&part->wakeup);
+fail_wakeup:
+    message_queue_destroy(&part->queue);
+fail_queue:
+    free(part->topic);
+fail:
+    message_scratch_destroy(&part->scratch);
+    free(part);
+    return NULL;
+}
+
+/**
+ * @brief Destroys a PartitionQueue and any messages still buffered in it.
+ */
+void partition_queue_free(PartitionQueue *part) {
+    rkqueue_set_wakeup(part->rkqu, NULL);
+    rd_kafka_queue_destroy(part->rkqu);
+    message_queue_destroy(&part->queue);
+    wakeup_destroy(&part->wakeup);
+    message_scratch_destroy(&part->scratch);
+    free(part->topic);
+    free(part);
+}
+
+/**
+ * @brief Wraps a PartitionQueue in a new Python handle.
+ */
+PyObject *partition_queue_object_new(PartitionQueue *part, PyObject *owner) {
+    PartitionQueueObject *self = PyObject_New(PartitionQueueObject, &PartitionQueueType);
+    if (!self) {
+        return NULL;
+    }
+    self->owner = Py_NewRef(owner);
+    self->part = part;
+    return (PyObject *)self;
+}
+
+/**
+ * @brief Deallocates a PartitionQueue handle.
+ *
+ * The queue itself belongs to the consumer; only the reference is dropped.
+ */
+static void
+PartitionQueue_dealloc(PartitionQueueObject *self) {
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Returns the fd that becomes readable when messages are buffered.
+ *
+ * Exposed to Python as `PartitionQueue.fileno()`.
+ */
+static PyObject *
+PartitionQueue_fileno(PartitionQueueObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromLong(self->part->wakeup.read_fd);
+}
+
+/**
+ * @brief Drains buffered messages of this partition without blocking.
+ *
+ * Exposed to Python as `PartitionQueue.getmany(max_records=500)`. Behaves
+ * like `Consumer.getmany()`, but only ever returns this partition's
+ * messages, in offset order.
+ *
+ * @return A list of Message objects, possibly empty.
+ */
+static PyObject *
+PartitionQueue_getmany(PartitionQueueObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"max_records", NULL};
+    Py_ssize_t max_records = 500;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &max_records))
+        return NULL;
+    if (max_records < 1) {
+        PyErr_SetString(PyExc_ValueError, "max_records must be >= 1");
+        return NULL;
+    }
+
+    return message_list_drain(&self->part->queue, &self->part->wakeup, &self->part->scratch,
+                              (size_t)max_records, self->owner);
+}
+
+/**
+ * @brief Drains buffered messages of this partition into a ColumnarBatch.
+ *
+ * Exposed to Python as `PartitionQueue.getmany_columnar(max_records=500)`,
+ * the columnar counterpart of getmany().
+ *
+ * @return A ColumnarBatch, possibly empty.
+ */
+static PyObject *
+PartitionQueue_getmany_columnar(PartitionQueueObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"max_records", NULL};
+    Py_ssize_t max_records = 500;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &max_records))
+        return NULL;
+    if (max_records < 1) {
+        PyErr_SetString(PyExc_ValueError, "max_records must be >= 1");
+        return NULL;
+    }
+
+    return columnar_batch_drain(&self->part->queue, &self->part->wakeup, &self->part->scratch,
+                                (size_t)max_records);
+}
+
+/**
+ * @brief Returns the topic name.
+ */
+static PyObject *
+PartitionQueue_get_topic(PartitionQueueObject *self, void *closure) {
+    return PyUnicode_FromString(self->part->topic);
+}
+
+/**
+ * @brief Returns the partition number.
+ */
+static PyObject *
+PartitionQueue_get_partition(PartitionQueueObject *self, void *closure) {
+    return PyLong_FromLong(self->part->partition);
+}
+
+/**
+ * @brief Returns a short description of the partition queue.
+ */
+static PyObject *
+PartitionQueue_repr(PartitionQueueObject *self) {
+    return PyUnicode_FromFormat("<PartitionQueue topic=%s partition=%d>",
+                                self->part->topic, (int)self->part->partition);
+}
+
+/**
+ * @brief Defines the methods available on PartitionQueue objects.
+ */
+static PyMethodDef PartitionQueue_methods[] = {
+    {"fileno", (PyCFunction)PartitionQueue_fileno, METH_NOARGS,
+     "Return the fd that becomes readable when messages are buffered."},
+    {"getmany", (PyCFunction)(void(*)(void))PartitionQueue_getmany, METH_VARARGS | METH_KEYWORDS,
+     "Return up to max_records buffered messages of this partition without blocking."},
+    {"getmany_columnar", (PyCFunction)(void(*)(void))PartitionQueue_getmany_columnar, METH_VARARGS | METH_KEYWORDS,
+     "Return up to max_records buffered messages of this partition as a ColumnarBatch."},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Attribute accessors for PartitionQueue objects.
+ */
+static PyGetSetDef PartitionQueue_getset[] = {
+    {"topic", (getter)PartitionQueue_get_topic, NULL, "Topic name.", NULL},
+    {"partition", (getter)PartitionQueue_get_partition, NULL, "Partition number.", NULL},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the PartitionQueue.
+ *
+ * Handles are only created by `Consumer.partition()`, so there is no
+ * `__new__`.
+ */
+PyTypeObject PartitionQueueType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_core.PartitionQueue",
+    .tp_doc = "Messages of one partition, split off the consumer queue",
+    .tp_basicsize = sizeof(PartitionQueueObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)PartitionQueue_dealloc,
+    .tp_repr = (reprfunc)PartitionQueue_repr,
+    .tp_methods = PartitionQueue_methods,
+    .tp_getset = PartitionQueue_getset,
+};
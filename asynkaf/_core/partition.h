@@ -0,0 +1,87 @@
+#ifndef ASYNKAF_PARTITION_H
+#define ASYNKAF_PARTITION_H
+
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include "message.h"
+#include "prefetch.h"
+#include "queue.h"
+#include "wakeup.h"
+
+/**
+ * @brief A partition split off from the consumer queue into its own queue.
+ *
+ * `rkqu` is librdkafka's queue for the partition, obtained with
+ * `rd_kafka_queue_get_partition` and detached from the consumer queue with
+ * `rd_kafka_queue_forward(rkqu, NULL)`. When it becomes non-empty librdkafka
+ * writes to the poller's Wakeup (`rd_kafka_queue_io_event_enable`), and the
+ * poller moves its messages into `queue`. Python drains `queue` through its
+ * own `wakeup`, so each partition can be consumed in order by a separate
+ * task or thread without a shared funnel.
+ *
+ * Owned by the consumer; it lives until the consumer is destroyed.
+ */
+typedef struct {
+    char *topic;              // Topic name (owned copy).
+    int32_t partition;        // Partition number.
+    rd_kafka_queue_t *rkqu;   // librdkafka's queue for this partition.
+    MessageQueue queue;       // Messages waiting for Python.
+    Wakeup wakeup;            // Readable when `queue` becomes non-empty.
+    MessageScratch scratch;   // Scratch array used by getmany().
+    int paused;               // Whether the poller paused fetching for backpressure.
+    PrefetchController prefetch; // Sizes `queue`'s high watermark, if the consumer has prefetch_ms.
+} PartitionQueue;
+
+/**
+ * @brief The Python-facing handle of a PartitionQueue.
+ *
+ * Holds a reference to the consumer, which owns `part`.
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner;          // The Consumer owning `part`.
+    PartitionQueue *part;     // The partition's queue.
+} PartitionQueueObject;
+
+extern PyTypeObject PartitionQueueType;
+
+/**
+ * @brief Has librdkafka signal `wakeup` whenever `rkqu` becomes non-empty.
+ * @param rkqu The librdkafka queue to watch.
+ * @param wakeup The Wakeup to signal, or NULL to stop signalling.
+ */
+void rkqueue_set_wakeup(rd_kafka_queue_t *rkqu, Wakeup *wakeup);
+
+/**
+ * @brief Splits one partition off the consumer queue.
+ *
+ * The new queue copies `template`'s capacity, watermarks, dwell
+ * histogram and decoder.
+ *
+ * @param rk The consumer handle.
+ * @param topic Topic name.
+ * @param partition Partition number.
+ * @param template Queue whose capacity, watermarks, dwell histogram and decoder are reused.
+ * @param poller Wakeup librdkafka signals when the partition has messages.
+ * @return A new PartitionQueue, or NULL with a Python exception set.
+ */
+PartitionQueue *partition_queue_new(rd_kafka_t *rk, const char *topic, int32_t partition,
+                                    const MessageQueue *template, Wakeup *poller);
+
+/**
+ * @brief Destroys a PartitionQueue and any messages still buffered in it.
+ *
+ * Must run before the consumer handle is destroyed, with the poller stopped.
+ * @param part The PartitionQueue to free.
+ */
+void partition_queue_free(PartitionQueue *part);
+
+/**
+ * @brief Wraps a PartitionQueue in a new Python handle.
+ * @param part The partition's queue.
+ * @param owner The Consumer owning `part`.
+ * @return A new reference, or NULL on failure.
+ */
+PyObject *partition_queue_object_new(PartitionQueue *part, PyObject *owner);
+
+#endif
@@ -0,0 +1,491 @@
+#include <Python.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "poller.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+/**
+ * @brief Nice values accepted as a poller priority.
+ */
+#define POLLER_PRIORITY_MIN -20
+#define POLLER_PRIORITY_MAX 19
+
+/**
+ * @brief Name of a shared poller thread unless one is given.
+ */
+#define POLLER_DEFAULT_NAME "asynkaf-shared"
+
+/**
+ * @brief Fills in PollerThreadOptions from Python arguments.
+ *
+ * CPU numbers are checked against the platform's CPU set size here; whether
+ * they exist on this machine is only known once the thread applies them.
+ */
+int poller_options_parse(PollerThreadOptions *options, PyObject *cpus, PyObject *priority,
+                         const char *name, const char *default_name) {
+    memset(options, 0, sizeof(*options));
+    if (!name) {
+        name = default_name;
+    }
+    if (strlen(name) > POLLER_NAME_MAX) {
+        PyErr_Format(PyExc_ValueError, "poller thread names are limited to %d bytes", POLLER_NAME_MAX);
+        return -1;
+    }
+    strcpy(options->name, name);
+
+    if (priority && priority != Py_None) {
+        int overflow;
+        long value = PyLong_AsLongAndOverflow(priority, &overflow);
+        if (value == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (overflow || value < POLLER_PRIORITY_MIN || value > POLLER_PRIORITY_MAX) {
+            PyErr_Format(PyExc_ValueError, "poller priority must be a nice value between %d and %d",
+                         POLLER_PRIORITY_MIN, POLLER_PRIORITY_MAX);
+            return -1;
+        }
+        options->has_priority = 1;
+        options->priority = (int)value;
+    }
+
+    if (!cpus || cpus == Py_None) {
+        return 0;
+    }
+    PyObject *seq = PySequence_Fast(cpus, "poller CPUs must be an iterable of ints");
+    if (!seq) {
+        return -1;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    if (count == 0) {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "poller CPUs must not be empty");
+        return -1;
+    }
+    options->cpus = malloc((size_t)count * sizeof(int));
+    if (!options->cpus) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+    }
+    options->cpu_count = (size_t)count;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        long cpu = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+        if (cpu == -1 && PyErr_Occurred()) {
+            goto fail;
+        }
+#ifdef CPU_SETSIZE
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            PyErr_Format(PyExc_ValueError, "poller CPU numbers must be between 0 and %d", CPU_SETSIZE - 1);
+            goto fail;
+        }
+#else
+        if (cpu < 0) {
+            PyErr_SetString(PyExc_ValueError, "poller CPU numbers must be >= 0");
+            goto fail;
+        }
+#endif
+        options->cpus[i] = (int)cpu;
+    }
+    Py_DECREF(seq);
+    return 0;
+
+fail:
+    Py_DECREF(seq);
+    poller_options_clear(options);
+    return -1;
+}
+
+/**
+ * @brief Releases the memory held by PollerThreadOptions.
+ */
+void poller_options_clear(PollerThreadOptions *options) {
+    free(options->cpus);
+    options->cpus = NULL;
+    options->cpu_count = 0;
+}
+
+/**
+ * @brief Applies the options to the calling thread.
+ *
+ * The name is best effort, since it only matters to tools; pinning and
+ * priority are requested explicitly, so their failures are reported.
+ *
+ * @return 0 on success, otherwise an errno value.
+ */
+static int poller_apply_options(const PollerThreadOptions *options) {
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), options->name);
+#elif defined(__APPLE__)
+    pthread_setname_np(options->name);
+#endif
+
+    if (options->cpu_count) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < options->cpu_count; i++) {
+            CPU_SET(options->cpus[i], &set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err) {
+            return err;
+        }
+#else
+        return ENOTSUP;
+#endif
+    }
+
+    if (options->has_priority) {
+#ifdef __linux__
+        // Linux applies nice values per thread, addressed by thread id.
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), options->priority) != 0) {
+            return errno;
+        }
+#else
+        return ENOTSUP;
+#endif
+    }
+    return 0;
+}
+
+/**
+ * @brief Handshake between poller_thread_start() and the new thread.
+ *
+ * Lives on the creator's stack until the thread reports back.
+ */
+typedef struct {
+    void *(*run)(void *);     // The thread body.
+    void *arg;                // Passed to `run`.
+    const PollerThreadOptions *options; // Applied before `run`.
+    pthread_mutex_t lock;     // Protects `done` and `err`.
+    pthread_cond_t cond;      // Signalled once `done` is set.
+    int done;                 // Whether the options were applied.
+    int err;                  // Result of applying them.
+} PollerThreadStart;
+
+/**
+ * @brief Entry point of every poller thread.
+ */
+static void *poller_thread_main(void *arg) {
+    PollerThreadStart *start = (PollerThreadStart *)arg;
+    void *(*run)(void *) = start->run;
+    void *run_arg = start->arg;
+    int err = poller_apply_options(start->options);
+
+    pthread_mutex_lock(&start->lock);
+    start->err = err;
+    start->done = 1;
+    pthread_cond_signal(&start->cond);
+    pthread_mutex_unlock(&start->lock);
+    // `start` may be gone from here on.
+
+    if (err) {
+        return NULL;
+    }
+    return run(run_arg);
+}
+
+/**
+ * @brief Starts a thread that applies `options` and then runs `run(arg)`.
+ */
+int poller_thread_start(pthread_t *thread, void *(*run)(void *), void *arg,
+                        const PollerThreadOptions *options) {
+    PollerThreadStart start = {
+        .run = run,
+        .arg = arg,
+        .options = options,
+    };
+    pthread_mutex_init(&start.lock, NULL);
+    pthread_cond_init(&start.cond, NULL);
+
+    int err = pthread_create(thread, NULL, poller_thread_main, &start);
+    if (!err) {
+        pthread_mutex_lock(&start.lock);
+        while (!start.done) {
+            pthread_cond_wait(&start.cond, &start.lock);
+        }
+        err = start.err;
+        pthread_mutex_unlock(&start.lock);
+        if (err) {
+            pthread_join(*thread, NULL);
+        }
+    }
+
+    pthread_cond_destroy(&start.cond);
+    pthread_mutex_destroy(&start.lock);
+    return err;
+}
+
+/**
+ * @brief Body of the shared poller thread.
+ *
+ * Sleeps on the wakeup every member's queues signal, for as long as the
+ * most impatient member allows, then steps every member once.
+ */
+static void *poller_run(void *arg) {
+    PollerObject *self = (PollerObject *)arg;
+    int wait_ms = POLLER_IDLE_MS;
+    while (atomic_load_explicit(&self->running, memory_order_acquire)) {
+        if (wait_ms > 0) {
+            wakeup_wait(&self->wakeup, wait_ms);
+        } else {
+            poller_cpu_relax();
+        }
+        // Clear the fd before stepping: anything arriving afterwards
+        // signals it again.
+        wakeup_drain(&self->wakeup);
+
+        wait_ms = POLLER_IDLE_MS;
+        pthread_mutex_lock(&self->lock);
+        for (size_t i = 0; i < self->member_count; i++) {
+            int member_ms = self->members[i].step(self->members[i].arg);
+            if (member_ms < wait_ms) {
+                wait_ms = member_ms;
+            }
+        }
+        pthread_mutex_unlock(&self->lock);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Starts serving a member on the shared thread.
+ *
+ * The thread is woken so the member gets its first step right away.
+ */
+int poller_attach(PollerObject *poller, PollerStep step, void *arg) {
+    pthread_mutex_lock(&poller->lock);
+    if (poller->member_count == poller->member_capacity) {
+        size_t capacity = poller->member_capacity ? poller->member_capacity * 2 : 4;
+        PollerMember *members = realloc(poller->members, capacity * sizeof(PollerMember));
+        if (!members) {
+            pthread_mutex_unlock(&poller->lock);
+            PyErr_NoMemory();
+            return -1;
+        }
+        poller->members = members;
+        poller->member_capacity = capacity;
+    }
+    poller->members[poller->member_count++] = (PollerMember){.step = step, .arg = arg};
+    pthread_mutex_unlock(&poller->lock);
+    wakeup_signal(&poller->wakeup);
+    return 0;
+}
+
+/**
+ * @brief Stops serving a member.
+ *
+ * Takes the lock the thread holds while stepping, so an iteration in
+ * progress finishes first.
+ */
+void poller_detach(PollerObject *poller, void *arg) {
+    pthread_mutex_lock(&poller->lock);
+    for (size_t i = 0; i < poller->member_count; i++) {
+        if (poller->members[i].arg == arg) {
+            memmove(&poller->members[i], &poller->members[i + 1],
+                    (poller->member_count - i - 1) * sizeof(PollerMember));
+            poller->member_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&poller->lock);
+}
+
+/**
+ * @brief Allocates a new Poller object.
+ *
+ * This corresponds to the `__new__` method in Python.
+ */
+static PyObject *
+Poller_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    PollerObject *self = (PollerObject *)type->tp_alloc(type, 0);
+    if (self) {
+        pthread_mutex_init(&self->lock, NULL);
+    }
+    return (PyObject *)self;
+}
+
+/**
+ * @brief Initializes a Poller object and starts its thread.
+ *
+ * Exposed to Python as `Poller(*, cpus=None, priority=None, name=None)`:
+ * the thread is pinned to `cpus`, runs at nice value `priority` and is
+ * named `name` (at most 15 bytes, default "asynkaf-shared").
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int
+Poller_init(PollerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"cpus", "priority", "name", NULL};
+    PyObject *cpus = NULL;
+    PyObject *priority = NULL;
+    const char *name = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|$OOz", kwlist, &cpus, &priority, &name))
+        return -1;
+    if (self->started) {
+        PyErr_SetString(PyExc_RuntimeError, "Poller is already running");
+        return -1;
+    }
+    if (poller_options_parse(&self->options, cpus, priority, name, POLLER_DEFAULT_NAME) < 0) {
+        return -1;
+    }
+    if (!self->wakeup_ready) {
+        if (wakeup_init(&self->wakeup) != 0) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        self->wakeup_ready = 1;
+    }
+    if (!self->loop_wakeup_ready) {
+        if (wakeup_init(&self->loop_wakeup) != 0) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        self->loop_wakeup_ready = 1;
+    }
+
+    int err;
+    atomic_store(&self->running, 1);
+    Py_BEGIN_ALLOW_THREADS
+    err = poller_thread_start(&self->thread, poller_run, self, &self->options);
+    Py_END_ALLOW_THREADS
+    if (err) {
+        atomic_store(&self->running, 0);
+        errno = err;
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    self->started = 1;
+    return 0;
+}
+
+/**
+ * @brief Stops the thread and frees the Poller.
+ *
+ * Every member holds a reference, so nothing is attached any more.
+ */
+static void
+Poller_dealloc(PollerObject *self) {
+    if (self->started) {
+        Py_BEGIN_ALLOW_THREADS
+        atomic_store_explicit(&self->running, 0, memory_order_release);
+        wakeup_signal(&self->wakeup);
+        pthread_join(self->thread, NULL);
+        Py_END_ALLOW_THREADS
+    }
+    if (self->wakeup_ready) {
+        wakeup_destroy(&self->wakeup);
+    }
+    if (self->loop_wakeup_ready) {
+        wakeup_destroy(&self->loop_wakeup);
+    }
+    poller_options_clear(&self->options);
+    free(self->members);
+    pthread_mutex_destroy(&self->lock);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Returns the fd every member signals towards the event loop.
+ *
+ * Exposed to Python as `Poller.fileno()`. Register it once per loop, call
+ * drain() when it is readable and then let every member check its queues:
+ * a readable fd does not say which member became ready.
+ */
+static PyObject *
+Poller_fileno(PollerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->loop_wakeup_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Poller is not initialized");
+        return NULL;
+    }
+    return PyLong_FromLong(self->loop_wakeup.read_fd);
+}
+
+/**
+ * @brief Clears the fileno() fd.
+ *
+ * Exposed to Python as `Poller.drain()`. Only the poller drains the shared
+ * fd; call it before checking the members, so that anything arriving while
+ * they are checked makes the fd readable again.
+ */
+static PyObject *
+Poller_drain(PollerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->loop_wakeup_ready) {
+        wakeup_drain(&self->loop_wakeup);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Method table for Poller objects.
+ */
+static PyMethodDef Poller_methods[] = {
+    {"fileno", (PyCFunction)Poller_fileno, METH_NOARGS,
+     "Return the fd that becomes readable when any consumer of the poller has something to deliver."},
+    {"drain", (PyCFunction)Poller_drain, METH_NOARGS,
+     "Clear the fileno() fd before checking the consumers."},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Returns the thread name.
+ */
+static PyObject *
+Poller_get_name(PollerObject *self, void *closure) {
+    return PyUnicode_FromString(self->options.name);
+}
+
+/**
+ * @brief Returns the number of consumers served.
+ */
+static PyObject *
+Poller_get_consumers(PollerObject *self, void *closure) {
+    pthread_mutex_lock(&self->lock);
+    size_t count = self->member_count;
+    pthread_mutex_unlock(&self->lock);
+    return PyLong_FromSize_t(count);
+}
+
+/**
+ * @brief Returns a short description of the poller.
+ */
+static PyObject *
+Poller_repr(PollerObject *self) {
+    return PyUnicode_FromFormat("<Poller name=%s>", self->options.name);
+}
+
+/**
+ * @brief Attribute accessors for Poller objects.
+ */
+static PyGetSetDef Poller_getset[] = {
+    {"name", (getter)Poller_get_name, NULL, "Name of the poller thread.", NULL},
+    {"consumers", (getter)Poller_get_consumers, NULL, "Number of consumers served by the thread.", NULL},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the Poller.
+ */
+PyTypeObject PollerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_core.Poller",
+    .tp_doc = "A poller thread shared by several consumers",
+    .tp_basicsize = sizeof(PollerObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Poller_new,
+    .tp_init = (initproc)Poller_init,
+    .tp_dealloc = (destructor)Poller_dealloc,
+    .tp_repr = (reprfunc)Poller_repr,
+    .tp_methods = Poller_methods,
+    .tp_getset = Poller_getset,
+};
@@ -0,0 +1,144 @@
+#ifndef ASYNKAF_POLLER_H
+#define ASYNKAF_POLLER_H
+
+#include <Python.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "wakeup.h"
+
+/**
+ * @brief Longest thread name Linux accepts, excluding the terminator.
+ */
+#define POLLER_NAME_MAX 15
+
+/**
+ * @brief Longest a shared poller sleeps when no member asks for less.
+ */
+#define POLLER_IDLE_MS 1000
+
+/**
+ * @brief Placement and identity of a background poller thread.
+ *
+ * Applied by the thread itself before it starts polling, so a failure is
+ * reported to the creator instead of leaving a half-configured thread.
+ */
+typedef struct {
+    int *cpus;                // CPUs the thread may run on, or NULL for any.
+    size_t cpu_count;         // Number of entries in `cpus`.
+    int has_priority;         // Whether `priority` was given.
+    int priority;             // Nice value of the thread (-20 .. 19).
+    char name[POLLER_NAME_MAX + 1]; // Thread name shown by top, perf and gdb.
+} PollerThreadOptions;
+
+/**
+ * @brief Fills in PollerThreadOptions from Python arguments.
+ * @param options The options to initialize; cleared on failure too.
+ * @param cpus An iterable of CPU numbers, or NULL/None for no pinning.
+ * @param priority A nice value as an int, or NULL/None to inherit it.
+ * @param name The thread name, or NULL for `default_name`.
+ * @param default_name Name used when `name` is NULL.
+ * @return 0 on success, -1 with an exception set on failure.
+ */
+int poller_options_parse(PollerThreadOptions *options, PyObject *cpus, PyObject *priority,
+                         const char *name, const char *default_name);
+
+/**
+ * @brief Releases the memory held by PollerThreadOptions.
+ * @param options The options to clear.
+ */
+void poller_options_clear(PollerThreadOptions *options);
+
+/**
+ * @brief Starts a thread that applies `options` and then runs `run(arg)`.
+ *
+ * Returns only once the options were applied. If any of them fails the
+ * thread exits without calling `run`. Does not need the GIL.
+ *
+ * @param thread Receives the thread handle on success.
+ * @param run The thread body.
+ * @param arg Passed to `run`.
+ * @param options How to place and name the thread.
+ * @return 0 on success, otherwise an errno value.
+ */
+int poller_thread_start(pthread_t *thread, void *(*run)(void *), void *arg,
+                        const PollerThreadOptions *options);
+
+/**
+ * @brief Hints the CPU that this thread is busy-waiting.
+ */
+static inline void poller_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * @brief One iteration of a member's polling work.
+ *
+ * Must not block. Called on the shared poller thread without the GIL.
+ *
+ * @param arg The member's argument given to poller_attach().
+ * @return How long, in milliseconds, the poller may sleep before the member
+ *         needs another iteration when nothing signals the wakeup meanwhile.
+ */
+typedef int (*PollerStep)(void *arg);
+
+/**
+ * @brief A consumer served by a shared poller.
+ */
+typedef struct {
+    PollerStep step;          // Its polling work.
+    void *arg;                // Passed to `step`.
+} PollerMember;
+
+/**
+ * @brief A poller thread shared by several consumers.
+ *
+ * Each member's librdkafka queues signal `wakeup` when they become
+ * non-empty, so the thread sleeps on that one fd and then steps every
+ * member. Towards the event loop the members share `loop_wakeup` in the
+ * same way: their message queues and commit/rebalance results all signal
+ * it, so one reader serves every consumer of the poller. Exposed to Python
+ * as `_core.Poller`.
+ */
+typedef struct {
+    PyObject_HEAD
+    pthread_t thread;         // The shared thread.
+    int started;              // Whether `thread` was started.
+    atomic_int running;       // Cleared to stop the thread.
+    Wakeup wakeup;            // Signalled by every member's queues.
+    int wakeup_ready;         // Whether `wakeup` was initialized.
+    Wakeup loop_wakeup;       // Readable when any member has messages, errors or results.
+    int loop_wakeup_ready;    // Whether `loop_wakeup` was initialized.
+    PollerThreadOptions options; // How the thread was placed and named.
+    pthread_mutex_t lock;     // Protects the members; held while stepping them.
+    PollerMember *members;    // The consumers served.
+    size_t member_count;      // Number of entries in `members`.
+    size_t member_capacity;   // Allocated length of `members`.
+} PollerObject;
+
+extern PyTypeObject PollerType;
+
+/**
+ * @brief Starts serving a member on the shared thread.
+ * @param poller The poller.
+ * @param step The member's polling work.
+ * @param arg Passed to `step`; identifies the member for poller_detach().
+ * @return 0 on success, -1 with a MemoryError set on failure.
+ */
+int poller_attach(PollerObject *poller, PollerStep step, void *arg);
+
+/**
+ * @brief Stops serving a member.
+ *
+ * Once this returns `step` is not running and will not be called again
+ * for `arg`. Does nothing if `arg` is not a member. Does not need the GIL.
+ *
+ * @param poller The poller.
+ * @param arg The argument the member was attached with.
+ */
+void poller_detach(PollerObject *poller, void *arg);
+
+#endif
@@ -0,0 +1,134 @@
+#include "pool.h"
+#include "queue.h"
+#include <stdlib.h>
+
+/**
+ * @brief Initializes a NodePool.
+ *
+ * @param pool A pointer to the NodePool to be initialized.
+ */
+void node_pool_init(NodePool *pool) {
+    pool->local_free = NULL;
+    atomic_init(&pool->returned, NULL);
+    pool->chunks = NULL;
+    atomic_init(&pool->capacity, 0);
+#ifdef ASYNKAF_POOL_STATS
+    atomic_init(&pool->in_use, 0);
+    atomic_init(&pool->high_water, 0);
+#endif
+}
+
+/**
+ * @brief Allocates a new chunk and threads its nodes onto the local free list.
+ *
+ * The chunk header is followed directly by NODE_POOL_CHUNK_NODES nodes.
+ *
+ * @return 0 on success, -1 if malloc failed.
+ */
+static int node_pool_grow(NodePool *pool) {
+    NodeChunk *chunk = (NodeChunk *)malloc(sizeof(NodeChunk) + NODE_POOL_CHUNK_NODES * sizeof(MessageNode));
+    if (!chunk) {
+        return -1;
+    }
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+
+    MessageNode *nodes = (MessageNode *)(chunk + 1);
+    for (size_t i = 0; i + 1 < NODE_POOL_CHUNK_NODES; i++) {
+        nodes[i].next = &nodes[i + 1];
+    }
+    nodes[NODE_POOL_CHUNK_NODES - 1].next = pool->local_free;
+    pool->local_free = nodes;
+    atomic_fetch_add_explicit(&pool->capacity, NODE_POOL_CHUNK_NODES, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief Takes a node from the pool.
+ *
+ * Tries the producer's private list first, then takes over everything the
+ * consumers returned, and only then grows the pool.
+ *
+ * @param pool A pointer to the NodePool.
+ * @return A node whose fields are uninitialized, or NULL on failure.
+ */
+MessageNode *node_pool_alloc(NodePool *pool) {
+    if (!pool->local_free) {
+        pool->local_free = atomic_exchange_explicit(&pool->returned, NULL, memory_order_acquire);
+        if (!pool->local_free && node_pool_grow(pool) != 0) {
+            return NULL;
+        }
+    }
+    MessageNode *node = pool->local_free;
+    pool->local_free = node->next;
+#ifdef ASYNKAF_POOL_STATS
+    size_t in_use = atomic_fetch_add_explicit(&pool->in_use, 1, memory_order_relaxed) + 1;
+    size_t high = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+    while (in_use > high &&
+           !atomic_compare_exchange_weak_explicit(&pool->high_water, &high, in_use,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+#endif
+    return node;
+}
+
+/**
+ * @brief Pushes a chain of nodes onto the pool's shared return stack.
+ *
+ * @param pool A pointer to the NodePool.
+ * @param first The first node of the chain.
+ * @param last The last node of the chain.
+ * @param count The number of nodes in the chain.
+ */
+void node_pool_free_chain(NodePool *pool, MessageNode *first, MessageNode *last, size_t count) {
+    if (!first) {
+        return;
+    }
+    MessageNode *top = atomic_load_explicit(&pool->returned, memory_order_relaxed);
+    do {
+        last->next = top;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->returned, &top, first,
+                                                    memory_order_release, memory_order_relaxed));
+#ifdef ASYNKAF_POOL_STATS
+    atomic_fetch_sub_explicit(&pool->in_use, count, memory_order_relaxed);
+#else
+    (void)count;
+#endif
+}
+
+/**
+ * @brief Reports the pool's usage.
+ *
+ * `in_use` and `high_water` are only tracked when built with
+ * ASYNKAF_POOL_STATS; otherwise they are reported as 0.
+ *
+ * @param pool A pointer to the NodePool.
+ * @param stats Receives the snapshot.
+ */
+void node_pool_stats(NodePool *pool, NodePoolStats *stats) {
+    stats->capacity = atomic_load_explicit(&pool->capacity, memory_order_relaxed);
+#ifdef ASYNKAF_POOL_STATS
+    stats->in_use = atomic_load_explicit(&pool->in_use, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+#else
+    stats->in_use = 0;
+    stats->high_water = 0;
+#endif
+}
+
+/**
+ * @brief Frees all chunks owned by the pool.
+ *
+ * @param pool A pointer to the NodePool to be destroyed.
+ */
+void node_pool_destroy(NodePool *pool) {
+    NodeChunk *chunk = pool->chunks;
+    while (chunk) {
+        NodeChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    pool->chunks = NULL;
+    pool->local_free = NULL;
+    atomic_store(&pool->returned, NULL);
+}
@@ -0,0 +1,93 @@
+#ifndef ASYNKAF_POOL_H
+#define ASYNKAF_POOL_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+struct MessageNode;
+
+/**
+ * @brief Number of nodes carved out of each slab chunk.
+ */
+#define NODE_POOL_CHUNK_NODES 1024
+
+/**
+ * @brief A slab chunk of MessageNodes, chained for cleanup.
+ */
+typedef struct NodeChunk {
+    struct NodeChunk *next;   // Next chunk owned by the pool.
+} NodeChunk;
+
+/**
+ * @brief A per-queue slab pool of MessageNodes.
+ *
+ * Nodes are allocated in chunks of NODE_POOL_CHUNK_NODES and recycled
+ * through free lists instead of going back to malloc. The producer thread
+ * allocates from a private free list; consumers return whole chains to a
+ * lock-free stack that the producer takes over in one exchange when its
+ * private list runs dry. Only the producer ever pops from the shared stack,
+ * so the exchange cannot suffer from ABA.
+ *
+ * Building with ASYNKAF_POOL_STATS defined additionally tracks the number
+ * of nodes in use and its high-water mark.
+ */
+typedef struct {
+    struct MessageNode *local_free;           // Producer-owned free list.
+    _Atomic(struct MessageNode *) returned;   // Chains freed by consumers.
+    NodeChunk *chunks;                        // All chunks, for destroy.
+    atomic_size_t capacity;                   // Total nodes carved so far.
+#ifdef ASYNKAF_POOL_STATS
+    atomic_size_t in_use;                     // Nodes currently handed out.
+    atomic_size_t high_water;                 // Maximum of `in_use` seen.
+#endif
+} NodePool;
+
+/**
+ * @brief Usage snapshot of a NodePool.
+ */
+typedef struct {
+    size_t capacity;          // Total nodes allocated in chunks.
+    size_t in_use;            // Nodes currently handed out (stats builds only).
+    size_t high_water;        // Peak of `in_use` (stats builds only).
+} NodePoolStats;
+
+/**
+ * @brief Initializes an empty pool. No memory is allocated until first use.
+ * @param pool A pointer to the NodePool to initialize.
+ */
+void node_pool_init(NodePool *pool);
+
+/**
+ * @brief Takes a node from the pool, growing it by a chunk if needed.
+ *
+ * Must only be called from the single producer thread.
+ * @param pool A pointer to the NodePool.
+ * @return A node, or NULL if a new chunk could not be allocated.
+ */
+struct MessageNode *node_pool_alloc(NodePool *pool);
+
+/**
+ * @brief Returns a chain of nodes linked through `next` to the pool.
+ *
+ * Safe to call from any thread concurrently with node_pool_alloc().
+ * @param pool A pointer to the NodePool.
+ * @param first The first node of the chain.
+ * @param last The last node of the chain.
+ * @param count The number of nodes in the chain.
+ */
+void node_pool_free_chain(NodePool *pool, struct MessageNode *first, struct MessageNode *last, size_t count);
+
+/**
+ * @brief Fills `stats` with a snapshot of the pool's usage.
+ * @param pool A pointer to the NodePool.
+ * @param stats Receives the snapshot.
+ */
+void node_pool_stats(NodePool *pool, NodePoolStats *stats);
+
+/**
+ * @brief Frees every chunk. Nodes still in use become invalid.
+ * @param pool A pointer to the NodePool to destroy.
+ */
+void node_pool_destroy(NodePool *pool);
+
+#endif
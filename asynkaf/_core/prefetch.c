@@ -0,0 +1,49 @@
+#include "prefetch.h"
+
+/**
+ * @brief Starts a controller at the ceiling.
+ */
+void prefetch_init(PrefetchController *ctrl, int64_t target_ms, size_t floor, size_t ceiling,
+                   size_t drained, int64_t now_ms) {
+    ctrl->target_ms = target_ms;
+    ctrl->floor = floor < ceiling ? floor : ceiling;
+    ctrl->ceiling = ceiling;
+    ctrl->window_ms = now_ms;
+    ctrl->window_drained = drained;
+    ctrl->rate = -1.0;
+    ctrl->high = ceiling;
+}
+
+/**
+ * @brief Accounts for the messages drained so far.
+ *
+ * A window that ends with the queue empty measured how fast messages
+ * arrived rather than how fast Python takes them, so it may deepen the
+ * buffer but never make it shallower.
+ */
+int prefetch_update(PrefetchController *ctrl, size_t drained, size_t queued, int64_t now_ms) {
+    int64_t elapsed_ms = now_ms - ctrl->window_ms;
+    if (elapsed_ms < PREFETCH_WINDOW_MS) {
+        return 0;
+    }
+    double rate = (double)(drained - ctrl->window_drained) * 1000.0 / (double)elapsed_ms;
+    ctrl->window_ms = now_ms;
+    ctrl->window_drained = drained;
+    ctrl->rate = ctrl->rate < 0 ? rate : ctrl->rate + PREFETCH_SMOOTHING * (rate - ctrl->rate);
+
+    double wanted = ctrl->rate * (double)ctrl->target_ms / 1000.0;
+    size_t high = wanted >= (double)ctrl->ceiling ? ctrl->ceiling
+                  : wanted <= (double)ctrl->floor ? ctrl->floor
+                  : (size_t)wanted;
+    double change = (double)high - (double)ctrl->high;
+    if (change < 0) {
+        change = -change;
+    }
+    // Reaching either bound is always applied, however small the step.
+    if (high == ctrl->high || (queued == 0 && high < ctrl->high) ||
+        (change < PREFETCH_HYSTERESIS * (double)ctrl->high && high != ctrl->floor && high != ctrl->ceiling)) {
+        return 0;
+    }
+    ctrl->high = high;
+    return 1;
+}
@@ -0,0 +1,77 @@
+#ifndef ASYNKAF_PREFETCH_H
+#define ASYNKAF_PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Shortest interval a drain rate is measured over, in milliseconds.
+ */
+#define PREFETCH_WINDOW_MS 100
+
+/**
+ * @brief Smallest high watermark a controller is given.
+ */
+#define PREFETCH_MIN_MESSAGES 64
+
+/**
+ * @brief Weight of the newest window in the smoothed drain rate.
+ */
+#define PREFETCH_SMOOTHING 0.3
+
+/**
+ * @brief Relative change below which the high watermark is left alone.
+ *
+ * Keeps the watermark from jittering with every window's noise.
+ */
+#define PREFETCH_HYSTERESIS 0.125
+
+/**
+ * @brief Sizes a queue's high watermark from how fast it is drained.
+ *
+ * The poller feeds it the queue's drained count; every PREFETCH_WINDOW_MS
+ * it turns the difference into a drain rate and aims the high watermark at
+ * `rate * target`, the number of messages Python gets through in the
+ * target time. Since the backpressure pauses fetching at the high mark, a
+ * slow consumer then only ever has `target` worth of messages buffered,
+ * and a fast one gets a deep buffer that keeps the fetchers busy.
+ *
+ * Only the poller touches a controller.
+ */
+typedef struct {
+    int64_t target_ms;        // Processing time the buffer should cover.
+    size_t floor;             // Smallest high watermark set.
+    size_t ceiling;           // Largest high watermark set.
+    int64_t window_ms;        // When the current window started.
+    size_t window_drained;    // Drained count at the start of the window.
+    double rate;              // Smoothed drain rate in messages per second, < 0 before the first window.
+    size_t high;              // High watermark currently chosen.
+} PrefetchController;
+
+/**
+ * @brief Starts a controller at the ceiling.
+ *
+ * Until the first window completes the queue keeps its deepest buffer.
+ *
+ * @param ctrl The controller.
+ * @param target_ms Processing time the buffer should cover.
+ * @param floor Smallest high watermark.
+ * @param ceiling Largest high watermark, at least `floor`.
+ * @param drained The queue's drained count now.
+ * @param now_ms The current monotonic time.
+ */
+void prefetch_init(PrefetchController *ctrl, int64_t target_ms, size_t floor, size_t ceiling,
+                   size_t drained, int64_t now_ms);
+
+/**
+ * @brief Accounts for the messages drained so far.
+ *
+ * @param ctrl The controller.
+ * @param drained The queue's drained count now.
+ * @param queued Messages in the queue now.
+ * @param now_ms The current monotonic time.
+ * @return 1 if `ctrl->high` changed and should be applied, 0 otherwise.
+ */
+int prefetch_update(PrefetchController *ctrl, size_t drained, size_t queued, int64_t now_ms);
+
+#endif
@@ -0,0 +1,780 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "conf.h"
+#include "consumer.h"
+#include "errors.h"
+#include "event_queue.h"
+#include "futures.h"
+#include "wakeup.h"
+#include "producer.h"
+
+/**
+ * @brief Default maximum time the delivery thread blocks in `rd_kafka_poll`.
+ */
+#define PRODUCER_DEFAULT_POLL_TIMEOUT_MS 100
+
+/**
+ * @brief Longest a dying producer waits for the reports of purged messages.
+ *
+ * Reports left when it runs out are dropped by `rd_kafka_destroy`, and
+ * with them the contexts and buffers of those messages.
+ */
+#define PRODUCER_PURGE_TIMEOUT_MS 5000
+
+/**
+ * @brief Per-message state passed to librdkafka as the message opaque.
+ *
+ * Allocated when the message is produced and freed on the event loop once
+ * its delivery report has been handled. When the value came from a
+ * buffer-protocol object, the exported buffer is held here so librdkafka can
+ * send straight from the caller's memory instead of copying it.
+ */
+typedef struct {
+    PyObject *future;         // Future resolved with the delivery result, or NULL.
+    Py_buffer value;          // Exported value buffer, valid if `has_value`.
+    int has_value;            // Whether `value` must be released.
+} DeliveryContext;
+
+/**
+ * @brief The internal state of a Producer object.
+ *
+ * Holds the librdkafka handle, the thread that serves `rd_kafka_poll` for
+ * delivery callbacks, and the queue + wakeup fd through which delivery
+ * reports reach the event loop in batches.
+ */
+typedef struct {
+    PyObject_HEAD             // Standard Python object header.
+    rd_kafka_t *rk;           // Handle to the librdkafka producer instance.
+    pthread_t poll_thread;    // Thread serving delivery callbacks.
+    atomic_int run_poll;      // Flag to control the lifecycle of the poll thread.
+    int poll_started;         // Whether `poll_thread` was successfully created.
+    int poll_timeout_ms;      // Maximum time each `rd_kafka_poll` call blocks.
+    Wakeup wakeup;            // Readable when delivery reports are pending.
+    int wakeup_ready;         // Whether `wakeup` was successfully initialized.
+    EventQueue reports;       // Delivery reports waiting for the event loop.
+    int reports_ready;        // Whether `reports` was initialized.
+    KafkaEvent *report_batch; // Spare buffer swapped with `reports`.
+    size_t report_batch_capacity; // Length of `report_batch`.
+    pthread_mutex_t deliver_lock; // Held by the deliver() call using `report_batch`.
+    PyObject *txn_consumer;   // Consumer whose offsets the transactions commit, or NULL.
+    pthread_mutex_t txn_lock; // Protects `txn_consumer`, `txn_offsets` and `txn_offsets_sent`.
+    rd_kafka_topic_partition_list_t *txn_offsets; // Offsets taken for the open transaction, or NULL.
+    int txn_offsets_sent;     // Whether `txn_offsets` reached the transaction; a retried commit skips the send.
+} ProducerObject;
+
+/**
+ * @brief librdkafka delivery report callback.
+ *
+ * Runs on whichever thread serves `rd_kafka_poll` or `rd_kafka_flush`,
+ * without the GIL. It only records the outcome; futures are resolved later
+ * on the event loop by Producer_deliver().
+ */
+static void
+delivery_report_cb(rd_kafka_t *rk, const rd_kafka_message_t *rkmessage, void *opaque) {
+    ProducerObject *self = (ProducerObject *)opaque;
+    if (!rkmessage->_private) {
+        return;
+    }
+    KafkaEvent event = {
+        .type = KAFKA_EVENT_DELIVERY,
+        .err = rkmessage->err,
+        .opaque = rkmessage->_private,
+        .partition = rkmessage->partition,
+        .offset = rkmessage->offset,
+    };
+    event_queue_push(&self->reports, &event);
+}
+
+/**
+ * @brief The background thread function serving delivery callbacks.
+ *
+ * @param arg A void pointer to the ProducerObject instance.
+ * @return Always returns NULL.
+ */
+static void *poll_thread_func(void *arg) {
+    ProducerObject *self = (ProducerObject *)arg;
+    while (atomic_load_explicit(&self->run_poll, memory_order_acquire)) {
+        rd_kafka_poll(self->rk, self->poll_timeout_ms);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Releases a delivery context without resolving its future.
+ *
+ * Also releases the value buffer librdkafka was reading from, so this must
+ * only run once librdkafka is done with the message. Requires the GIL.
+ */
+static void
+delivery_context_free(DeliveryContext *ctx) {
+    if (ctx->has_value) {
+        PyBuffer_Release(&ctx->value);
+    }
+    Py_XDECREF(ctx->future);
+    PyMem_RawFree(ctx);
+}
+
+/**
+ * @brief Builds the `(partition, offset)` result of a successful delivery.
+ */
+static PyObject *
+delivery_result(const KafkaEvent *event) {
+    return Py_BuildValue("(iL)", (int)event->partition, (long long)event->offset);
+}
+
+/**
+ * @brief Resolves the future attached to one delivery report.
+ *
+ * Successful deliveries resolve to `(partition, offset)`; failures set a
+ * KafkaError.
+ */
+static void
+resolve_delivery(const KafkaEvent *event) {
+    DeliveryContext *ctx = (DeliveryContext *)event->opaque;
+    if (ctx->future) {
+        future_resolve(ctx->future, event, delivery_result);
+    }
+    delivery_context_free(ctx);
+}
+
+/**
+ * @brief Allocates a new Producer object.
+ *
+ * This corresponds to the `__new__` method in Python.
+ */
+static PyObject *
+Producer_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    ProducerObject *self;
+    self = (ProducerObject *)type->tp_alloc(type, 0);
+    if (self) {
+        pthread_mutex_init(&self->deliver_lock, NULL);
+        pthread_mutex_init(&self->txn_lock, NULL);
+    }
+    return (PyObject *)self;
+}
+
+/**
+ * @brief Initializes a Producer object.
+ *
+ * Corresponds to the `__init__` method in Python. It configures the
+ * librdkafka producer, passing linger and batching settings through, and
+ * starts the delivery thread.
+ *
+ * @param self The ProducerObject to initialize.
+ * @param args Python arguments (bootstrap_servers).
+ * @param kwds Python keyword arguments (linger_ms, batch_size,
+ *        batch_num_messages, poll_timeout_ms, transactional_id, and config:
+ *        a mapping of any other librdkafka properties, applied before the
+ *        named settings so those win). A transactional_id enables
+ *        init_transactions() and the other transaction methods.
+ * @return 0 on success, -1 on failure.
+ */
+static int
+Producer_init(ProducerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"bootstrap_servers", "linger_ms", "batch_size",
+                             "batch_num_messages", "poll_timeout_ms", "config",
+                             "transactional_id", NULL};
+    static const char *const reserved[] = {"bootstrap.servers", NULL};
+    char *bootstrap_servers;
+    // -1 leaves the librdkafka default in place.
+    long long linger_ms = -1;
+    long long batch_size = -1;
+    long long batch_num_messages = -1;
+    int poll_timeout_ms = PRODUCER_DEFAULT_POLL_TIMEOUT_MS;
+    PyObject *config = NULL;
+    const char *transactional_id = NULL;
+    char errstr[512];
+
+    // Parse Python arguments.
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|$LLLiOz", kwlist,
+                                     &bootstrap_servers, &linger_ms, &batch_size,
+                                     &batch_num_messages, &poll_timeout_ms, &config,
+                                     &transactional_id))
+        return -1;
+
+    if (poll_timeout_ms < 0) {
+        PyErr_SetString(PyExc_ValueError, "poll_timeout_ms must be >= 0");
+        return -1;
+    }
+
+    // Set up the path delivery reports take to the event loop.
+    if (wakeup_init(&self->wakeup) != 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    self->wakeup_ready = 1;
+    event_queue_init(&self->reports, &self->wakeup);
+    self->reports_ready = 1;
+
+    // Create and configure the Kafka client.
+    rd_kafka_conf_t *conf = rd_kafka_conf_new();
+
+    if (rd_kafka_conf_set(conf, "bootstrap.servers", bootstrap_servers, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_ValueError, errstr);
+        return -1;
+    }
+
+    if (conf_apply_mapping(conf, config, reserved) < 0 ||
+        conf_set_optional_int(conf, "linger.ms", linger_ms) < 0 ||
+        conf_set_optional_int(conf, "batch.size", batch_size) < 0 ||
+        conf_set_optional_int(conf, "batch.num.messages", batch_num_messages) < 0) {
+        rd_kafka_conf_destroy(conf);
+        return -1;
+    }
+    if (transactional_id &&
+        rd_kafka_conf_set(conf, "transactional.id", transactional_id, errstr, sizeof(errstr)) != RD_KAFKA_CONF_OK) {
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_ValueError, errstr);
+        return -1;
+    }
+
+    rd_kafka_conf_set_opaque(conf, self);
+    rd_kafka_conf_set_dr_msg_cb(conf, delivery_report_cb);
+
+    // Create the producer instance.
+    self->rk = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errstr, sizeof(errstr));
+    if (!self->rk) {
+        // rd_kafka_new() only takes ownership of the conf on success.
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_RuntimeError, errstr);
+        return -1;
+    }
+
+    // Start the thread that serves delivery callbacks.
+    self->poll_timeout_ms = poll_timeout_ms;
+    atomic_store(&self->run_poll, 1);
+    if (pthread_create(&self->poll_thread, NULL, poll_thread_func, self) != 0) {
+        atomic_store(&self->run_poll, 0);
+        PyErr_SetString(PyExc_RuntimeError, "failed to start the delivery thread");
+        return -1;
+    }
+    self->poll_started = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Frees the contexts of any reports that were never delivered to Python.
+ */
+static void
+Producer_discard_reports(ProducerObject *self) {
+    size_t count = event_queue_swap(&self->reports, &self->report_batch, &self->report_batch_capacity);
+    for (size_t i = 0; i < count; i++) {
+        delivery_context_free((DeliveryContext *)self->report_batch[i].opaque);
+    }
+}
+
+/**
+ * @brief Deallocates a Producer object.
+ *
+ * Stops the delivery thread, purges anything not yet sent (call `flush()`
+ * first to avoid losing messages), releases their contexts and destroys the
+ * librdkafka handle. The GIL is released while the thread and librdkafka
+ * wind down.
+ */
+static void
+Producer_dealloc(ProducerObject *self) {
+    Py_BEGIN_ALLOW_THREADS
+    // Signal the delivery thread to stop and wait for it to exit.
+    atomic_store_explicit(&self->run_poll, 0, memory_order_release);
+    if (self->poll_started) {
+        pthread_join(self->poll_thread, NULL);
+    }
+
+    // Clean up Kafka resources. Purged messages still get delivery reports,
+    // which turn into events so their contexts can be freed. Those of
+    // in-flight messages arrive from the broker threads, so wait for the
+    // out queue to empty: destroy() would drop the rest without a report.
+    if (self->rk) {
+        rd_kafka_purge(self->rk, RD_KAFKA_PURGE_F_QUEUE | RD_KAFKA_PURGE_F_INFLIGHT);
+        rd_kafka_flush(self->rk, PRODUCER_PURGE_TIMEOUT_MS);
+        rd_kafka_destroy(self->rk);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (self->reports_ready) {
+        Producer_discard_reports(self);
+        event_queue_destroy(&self->reports);
+    }
+    if (self->wakeup_ready) {
+        wakeup_destroy(&self->wakeup);
+    }
+    free(self->report_batch);
+    pthread_mutex_destroy(&self->deliver_lock);
+    if (self->txn_consumer) {
+        // Let the consumer commit on its own again.
+        consumer_bind_transactions(self->txn_consumer, 0);
+        Py_DECREF(self->txn_consumer);
+    }
+    if (self->txn_offsets) {
+        rd_kafka_topic_partition_list_destroy(self->txn_offsets);
+    }
+    pthread_mutex_destroy(&self->txn_lock);
+
+    // Free the Python object.
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Enqueues a message for delivery.
+ *
+ * Exposed to Python as `Producer.produce(topic, value, key=None,
+ * partition=-1, future=None)`. `value` may be None, a str (sent as UTF-8)
+ * or any contiguous buffer-protocol object (bytes, bytearray, memoryview,
+ * numpy array). Its
+ * buffer is held until the delivery report fires and handed to librdkafka
+ * without RD_KAFKA_MSG_F_COPY, so large payloads are never copied on the
+ * Python -> librdkafka hop. Mutable buffers must not be modified until the
+ * send completes. `future` is resolved from the event loop once the delivery
+ * report arrives. Raises BufferError when librdkafka's local queue is full,
+ * so the caller can back off and retry.
+ */
+static PyObject *
+Producer_produce(ProducerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"topic", "value", "key", "partition", "future", NULL};
+    const char *topic;
+    PyObject *value;
+    const char *key = NULL;
+    Py_ssize_t key_len = 0;
+    int partition = RD_KAFKA_PARTITION_UA;
+    PyObject *future = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|z#iO", kwlist,
+                                     &topic, &value, &key, &key_len,
+                                     &partition, &future))
+        return NULL;
+    if (!self->rk) {
+        PyErr_SetString(PyExc_RuntimeError, "Producer is not initialized");
+        return NULL;
+    }
+
+    // A context is needed whenever there is a future to resolve or a value
+    // buffer to keep alive until delivery.
+    DeliveryContext *ctx = NULL;
+    if (future != Py_None || value != Py_None) {
+        ctx = (DeliveryContext *)PyMem_RawMalloc(sizeof(DeliveryContext));
+        if (!ctx) {
+            return PyErr_NoMemory();
+        }
+        ctx->future = NULL;
+        ctx->has_value = 0;
+        if (value != Py_None) {
+            // str values are encoded once; the view keeps the bytes alive.
+            PyObject *source = PyUnicode_Check(value) ? PyUnicode_AsUTF8String(value) : Py_NewRef(value);
+            int rc = source ? PyObject_GetBuffer(source, &ctx->value, PyBUF_SIMPLE) : -1;
+            Py_XDECREF(source);
+            if (rc < 0) {
+                PyMem_RawFree(ctx);
+                return NULL;
+            }
+            ctx->has_value = 1;
+        }
+        if (future != Py_None) {
+            ctx->future = Py_NewRef(future);
+        }
+    }
+
+    // No RD_KAFKA_MSG_F_COPY: librdkafka reads the exported buffer in place
+    // and the context releases it after the delivery report. The key is
+    // always copied by librdkafka.
+    rd_kafka_resp_err_t err = rd_kafka_producev(
+        self->rk,
+        RD_KAFKA_V_TOPIC(topic),
+        RD_KAFKA_V_PARTITION(partition),
+        RD_KAFKA_V_VALUE(ctx && ctx->has_value ? ctx->value.buf : NULL,
+                         ctx && ctx->has_value ? (size_t)ctx->value.len : 0),
+        RD_KAFKA_V_KEY(key, (size_t)key_len),
+        RD_KAFKA_V_MSGFLAGS(0),
+        RD_KAFKA_V_OPAQUE(ctx),
+        RD_KAFKA_V_END);
+    if (err) {
+        if (ctx) {
+            delivery_context_free(ctx);
+        }
+        if (err == RD_KAFKA_RESP_ERR__QUEUE_FULL) {
+            PyErr_SetString(PyExc_BufferError, rd_kafka_err2str(err));
+            return NULL;
+        }
+        return kafka_error_set(err, NULL);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Resolves the futures of all pending delivery reports.
+ *
+ * Exposed to Python as `Producer.deliver()` and meant to be registered with
+ * `loop.add_reader(producer.fileno(), producer.deliver)`. The whole batch
+ * queued since the last call is swapped out under one lock acquisition and
+ * resolved in a single pass, so many in-flight sends cost one event-loop
+ * callback rather than one each.
+ *
+ * If another thread is already delivering, this returns 0 at once: that call
+ * resolves the current batch, and anything queued after its swap signals
+ * the fd again.
+ *
+ * @return The number of reports handled.
+ */
+static PyObject *
+Producer_deliver(ProducerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->reports_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Producer is not initialized");
+        return NULL;
+    }
+    if (pthread_mutex_trylock(&self->deliver_lock) != 0) {
+        return PyLong_FromLong(0);
+    }
+    // Clear the fd first: anything queued after the swap signals it again.
+    wakeup_drain(&self->wakeup);
+    size_t count = event_queue_swap(&self->reports, &self->report_batch, &self->report_batch_capacity);
+    for (size_t i = 0; i < count; i++) {
+        resolve_delivery(&self->report_batch[i]);
+    }
+    pthread_mutex_unlock(&self->deliver_lock);
+    return PyLong_FromSize_t(count);
+}
+
+/**
+ * @brief Waits for all outstanding messages to be delivered.
+ *
+ * Exposed to Python as `Producer.flush(timeout_ms=-1)`. The GIL is released
+ * while librdkafka waits; delivery reports are queued as usual and resolved
+ * by the next `deliver()`.
+ *
+ * @return The number of messages still in flight (0 unless timed out).
+ */
+static PyObject *
+Producer_flush(ProducerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timeout_ms", NULL};
+    int timeout_ms = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &timeout_ms))
+        return NULL;
+    if (!self->rk) {
+        PyErr_SetString(PyExc_RuntimeError, "Producer is not initialized");
+        return NULL;
+    }
+
+    int remaining;
+    Py_BEGIN_ALLOW_THREADS
+    rd_kafka_flush(self->rk, timeout_ms);
+    remaining = rd_kafka_outq_len(self->rk);
+    Py_END_ALLOW_THREADS
+    return PyLong_FromLong(remaining);
+}
+
+/**
+ * @brief Raises unless the producer was initialized.
+ * @return 0, or -1 with an exception set.
+ */
+static int
+producer_check_ready(ProducerObject *self) {
+    if (!self->rk) {
+        PyErr_SetString(PyExc_RuntimeError, "Producer is not initialized");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Prepares the producer for transactions.
+ *
+ * Exposed to Python as `Producer.init_transactions(timeout_ms=-1,
+ * consumer=None)`. Blocks without the GIL while the transaction
+ * coordinator fences off earlier instances with the same
+ * transactional_id. With a `consumer`, every commit_transaction() also
+ * commits the offsets stored on that consumer since the previous one,
+ * against its group, and the consumer stops committing on its own. The
+ * consumer is only bound, and a previously bound one released, once the
+ * producer is initialized: after a failure both keep committing as before.
+ *
+ * @return None, or NULL with a KafkaError set.
+ */
+static PyObject *
+Producer_init_transactions(ProducerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timeout_ms", "consumer", NULL};
+    int timeout_ms = -1;
+    PyObject *consumer = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iO", kwlist, &timeout_ms, &consumer))
+        return NULL;
+    if (producer_check_ready(self) < 0) {
+        return NULL;
+    }
+    if (consumer != Py_None && consumer_check_transactions(consumer) < 0) {
+        return NULL;
+    }
+
+    rd_kafka_error_t *error;
+    Py_BEGIN_ALLOW_THREADS
+    error = rd_kafka_init_transactions(self->rk, timeout_ms);
+    Py_END_ALLOW_THREADS
+    if (error) {
+        return kafka_error_raise(error);
+    }
+
+    if (consumer != Py_None) {
+        pthread_mutex_lock(&self->txn_lock);
+        PyObject *old = self->txn_consumer;
+        self->txn_consumer = Py_NewRef(consumer);
+        pthread_mutex_unlock(&self->txn_lock);
+        if (old != consumer) {
+            // Checked above, so binding cannot fail.
+            consumer_bind_transactions(consumer, 1);
+            if (old) {
+                consumer_bind_transactions(old, 0);
+            }
+        }
+        Py_XDECREF(old);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Starts a transaction.
+ *
+ * Exposed to Python as `Producer.begin_transaction()`. Local only: it
+ * never waits on the network.
+ *
+ * @return None, or NULL with a KafkaError set.
+ */
+static PyObject *
+Producer_begin_transaction(ProducerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (producer_check_ready(self) < 0) {
+        return NULL;
+    }
+    rd_kafka_error_t *error = rd_kafka_begin_transaction(self->rk);
+    if (error) {
+        return kafka_error_raise(error);
+    }
+    pthread_mutex_lock(&self->txn_lock);
+    rd_kafka_topic_partition_list_t *stale = self->txn_offsets;
+    self->txn_offsets = NULL;
+    self->txn_offsets_sent = 0;
+    pthread_mutex_unlock(&self->txn_lock);
+    if (stale) {
+        rd_kafka_topic_partition_list_destroy(stale);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Adds the consumer's newly stored offsets to the open transaction.
+ *
+ * If an earlier send of the transaction failed, everything taken so far is
+ * sent again, so the retry still carries the offsets the failed attempt
+ * took from the consumer. Once a send succeeded the commit may already be
+ * under way, and librdkafka only takes offsets while the transaction is
+ * open, so a retried commit sends nothing. Runs without the GIL.
+ *
+ * @return NULL on success, otherwise the error.
+ */
+static rd_kafka_error_t *
+producer_send_offsets(ProducerObject *self, PyObject *consumer, int timeout_ms) {
+    pthread_mutex_lock(&self->txn_lock);
+    int sent = self->txn_offsets_sent;
+    pthread_mutex_unlock(&self->txn_lock);
+    if (sent) {
+        return NULL;
+    }
+
+    rd_kafka_topic_partition_list_t *taken = consumer_take_offsets(consumer);
+    pthread_mutex_lock(&self->txn_lock);
+    if (taken && !self->txn_offsets) {
+        self->txn_offsets = taken;
+        taken = NULL;
+    } else if (taken) {
+        for (int i = 0; i < taken->cnt; i++) {
+            rd_kafka_topic_partition_t *elem = &taken->elems[i];
+            rd_kafka_topic_partition_t *known =
+                rd_kafka_topic_partition_list_find(self->txn_offsets, elem->topic, elem->partition);
+            if (!known) {
+                known = rd_kafka_topic_partition_list_add(self->txn_offsets, elem->topic, elem->partition);
+            }
+            known->offset = elem->offset;
+        }
+    }
+    rd_kafka_topic_partition_list_t *offsets =
+        self->txn_offsets ? rd_kafka_topic_partition_list_copy(self->txn_offsets) : NULL;
+    pthread_mutex_unlock(&self->txn_lock);
+    if (taken) {
+        rd_kafka_topic_partition_list_destroy(taken);
+    }
+    rd_kafka_error_t *error = NULL;
+    if (offsets) {
+        rd_kafka_consumer_group_metadata_t *metadata = consumer_group_metadata(consumer);
+        error = rd_kafka_send_offsets_to_transaction(self->rk, offsets, metadata, timeout_ms);
+        rd_kafka_consumer_group_metadata_destroy(metadata);
+        rd_kafka_topic_partition_list_destroy(offsets);
+    }
+    if (!error) {
+        // Stores arriving from now on belong to the next transaction.
+        pthread_mutex_lock(&self->txn_lock);
+        self->txn_offsets_sent = 1;
+        pthread_mutex_unlock(&self->txn_lock);
+    }
+    return error;
+}
+
+/**
+ * @brief Commits the open transaction.
+ *
+ * Exposed to Python as `Producer.commit_transaction(timeout_ms=-1)`.
+ * Blocks without the GIL: sends the bound consumer's stored offsets, then
+ * flushes the transaction's messages and commits it, so a whole batch of
+ * consumed-transformed-produced messages costs these two round trips.
+ * Delivery reports are queued as usual and resolved by the next
+ * `deliver()`. After a KafkaError with `txn_requires_abort` set, call
+ * abort_transaction(); with `retriable` set, this may be retried, and a
+ * retry whose offsets already went out only repeats the commit.
+ *
+ * @return None, or NULL with a KafkaError set.
+ */
+static PyObject *
+Producer_commit_transaction(ProducerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timeout_ms", NULL};
+    int timeout_ms = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &timeout_ms))
+        return NULL;
+    if (producer_check_ready(self) < 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&self->txn_lock);
+    PyObject *consumer = Py_XNewRef(self->txn_consumer);
+    pthread_mutex_unlock(&self->txn_lock);
+    rd_kafka_error_t *error = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    if (consumer) {
+        error = producer_send_offsets(self, consumer, timeout_ms);
+    }
+    if (!error) {
+        error = rd_kafka_commit_transaction(self->rk, timeout_ms);
+    }
+    Py_END_ALLOW_THREADS
+    Py_XDECREF(consumer);
+    if (error) {
+        return kafka_error_raise(error);
+    }
+
+    pthread_mutex_lock(&self->txn_lock);
+    rd_kafka_topic_partition_list_t *committed = self->txn_offsets;
+    self->txn_offsets = NULL;
+    self->txn_offsets_sent = 0;
+    pthread_mutex_unlock(&self->txn_lock);
+    if (committed) {
+        rd_kafka_topic_partition_list_destroy(committed);
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Aborts the open transaction.
+ *
+ * Exposed to Python as `Producer.abort_transaction(timeout_ms=-1)`. Blocks
+ * without the GIL. The transaction's messages are never seen by
+ * read_committed consumers and its offsets are not committed; the bound
+ * consumer forgets them, so the messages can be reprocessed (after seeking
+ * back to the committed offsets) and stored again.
+ *
+ * @return None, or NULL with a KafkaError set.
+ */
+static PyObject *
+Producer_abort_transaction(ProducerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"timeout_ms", NULL};
+    int timeout_ms = -1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &timeout_ms))
+        return NULL;
+    if (producer_check_ready(self) < 0) {
+        return NULL;
+    }
+
+    rd_kafka_error_t *error;
+    Py_BEGIN_ALLOW_THREADS
+    error = rd_kafka_abort_transaction(self->rk, timeout_ms);
+    Py_END_ALLOW_THREADS
+    if (error) {
+        return kafka_error_raise(error);
+    }
+
+    pthread_mutex_lock(&self->txn_lock);
+    rd_kafka_topic_partition_list_t *aborted = self->txn_offsets;
+    self->txn_offsets = NULL;
+    self->txn_offsets_sent = 0;
+    PyObject *consumer = Py_XNewRef(self->txn_consumer);
+    pthread_mutex_unlock(&self->txn_lock);
+    if (aborted) {
+        if (consumer) {
+            consumer_forget_offsets(consumer, aborted);
+        }
+        rd_kafka_topic_partition_list_destroy(aborted);
+    }
+    Py_XDECREF(consumer);
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns the delivery-report wakeup file descriptor.
+ */
+static PyObject *
+Producer_fileno(ProducerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->wakeup_ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Producer is not initialized");
+        return NULL;
+    }
+    return PyLong_FromLong(self->wakeup.read_fd);
+}
+
+/**
+ * @brief Defines the methods available on Producer objects.
+ */
+static PyMethodDef Producer_methods[] = {
+    {"produce", (PyCFunction)(void(*)(void))Producer_produce, METH_VARARGS | METH_KEYWORDS,
+     "Enqueue a message; `future` is resolved when it is delivered."},
+    {"deliver", (PyCFunction)Producer_deliver, METH_NOARGS,
+     "Resolve the futures of all pending delivery reports."},
+    {"flush", (PyCFunction)(void(*)(void))Producer_flush, METH_VARARGS | METH_KEYWORDS,
+     "Wait for outstanding messages; returns how many are still in flight."},
+    {"fileno", (PyCFunction)Producer_fileno, METH_NOARGS,
+     "Return the fd that becomes readable when delivery reports are pending."},
+    {"init_transactions", (PyCFunction)(void(*)(void))Producer_init_transactions, METH_VARARGS | METH_KEYWORDS,
+     "Prepare for transactions, optionally committing a consumer's offsets with them."},
+    {"begin_transaction", (PyCFunction)Producer_begin_transaction, METH_NOARGS,
+     "Start a transaction."},
+    {"commit_transaction", (PyCFunction)(void(*)(void))Producer_commit_transaction, METH_VARARGS | METH_KEYWORDS,
+     "Send the bound consumer's offsets and commit the transaction, without the GIL."},
+    {"abort_transaction", (PyCFunction)(void(*)(void))Producer_abort_transaction, METH_VARARGS | METH_KEYWORDS,
+     "Abort the transaction, without the GIL."},
+    {NULL, NULL, 0, NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the Producer.
+ */
+PyTypeObject ProducerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_core.Producer",
+    .tp_doc = "Kafka Producer",
+    .tp_basicsize = sizeof(ProducerObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = Producer_new,
+    .tp_init = (initproc)Producer_init,
+    .tp_dealloc = (destructor)Producer_dealloc,
+    .tp_methods = Producer_methods,
+};
+
+/**
+ * @brief Factory function to create and initialize a Producer object from Python.
+ *
+ * This is the function exposed to Python as `_core.create_producer`.
+ */
+PyObject* create_producer(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    return PyObject_Call((PyObject*)&ProducerType, args, kwds);
+}
@@ -0,0 +1,23 @@
+#ifndef ASYNKAF_PRODUCER_H
+#define ASYNKAF_PRODUCER_H
+
+#include <Python.h>
+
+/**
+ * @brief External declaration of the ProducerType object.
+ */
+extern PyTypeObject ProducerType;
+
+/**
+ * @brief Declaration of the function to create a new Producer object.
+ *
+ * This function is exposed to Python through the module's method table.
+ *
+ * @param self The module object (unused in this context).
+ * @param args The arguments passed from Python.
+ * @param kwds The keyword arguments passed from Python.
+ * @return A new Producer PyObject, or NULL on failure.
+ */
+PyObject* create_producer(PyObject* self, PyObject* args, PyObject* kwds);
+
+#endif
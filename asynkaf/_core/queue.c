@@ -1,52 +1,680 @@
 #include "queue.h"
+#include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "decoder.h"
+#include "metrics.h"
+
+/**
+ * @brief Rounds a requested capacity up to the next power of two.
+ */
+static size_t round_up_pow2(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+/**
+ * @brief Converts a relative timeout into an absolute deadline for
+ * `pthread_cond_timedwait`.
+ */
+static void deadline_after_ms(struct timespec *deadline, int timeout_ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += timeout_ms / 1000;
+    deadline->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief Wakes any thread sleeping on the queue's condition variable.
+ *
+ * The full fence pairs with the one in the sleeping side: either the sleeper
+ * sees the index we just published, or we see its `waiters` increment and
+ * take the lock to wake it. The fast path (nobody asleep) never locks.
+ */
+static void message_queue_wake(MessageQueue *queue) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->waiters, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_broadcast(&queue->cond);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+/**
+ * @brief Signals the attached Wakeup if the consumer armed it.
+ *
+ * Called by the producer after publishing. The load of `armed` must not be
+ * ordered before the publish, or a consumer arming in between would miss
+ * both the signal and, in message_queue_arm(), the message. In ring mode the
+ * full fence in message_queue_wake() already separates them; the list
+ * push releases the mutex, which message_queue_arm() never takes, so it
+ * fences here.
+ */
+static void message_queue_notify(MessageQueue *queue) {
+    if (!queue->slots) {
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+    if (queue->wakeup &&
+        atomic_load_explicit(&queue->armed, memory_order_relaxed) &&
+        atomic_exchange(&queue->armed, 0)) {
+        wakeup_signal(queue->wakeup);
+    }
+}
+
+/**
+ * @brief Returns the push timestamp to store, or 0 if dwell is not tracked.
+ */
+static uint64_t message_queue_stamp(MessageQueue *queue) {
+    return queue->dwell ? metrics_now_ns() : 0;
+}
+
+/**
+ * @brief Records the wait of the oldest message a pop took.
+ */
+static void message_queue_record_dwell(MessageQueue *queue, uint64_t received_ns) {
+    if (queue->dwell) {
+        uint64_t now = metrics_now_ns();
+        histogram_record(queue->dwell, now > received_ns ? now - received_ns : 0);
+    }
+}
+
+/**
+ * @brief Frees the note of a message the queue drops instead of handing out.
+ */
+static void message_queue_release_note(MessageQueue *queue, void *note) {
+    if (note) {
+        decoder_release(queue->decoder, note);
+    }
+}
+
+/**
+ * @brief Returns non-zero if a fence covers the message pushed at `position`.
+ *
+ * The caller holds the lock guarding the fences.
+ */
+static int message_queue_is_stale(MessageQueue *queue, const rd_kafka_message_t *message,
+                                  size_t position) {
+    for (size_t i = 0; i < queue->fence_count; i++) {
+        const MessageFence *fence = &queue->fences[i];
+        if (position < fence->until && fence->partition == message->partition &&
+            strcmp(fence->topic, rd_kafka_topic_name(message->rkt)) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Destroys a stale message and its note.
+ */
+static void message_queue_drop(MessageQueue *queue, rd_kafka_message_t *message, void *note) {
+    rd_kafka_message_destroy(message);
+    message_queue_release_note(queue, note);
+}
+
+/**
+ * @brief Retires the fences that cover nothing at or after `position`.
+ *
+ * `position` is that of the oldest message still queued (SIZE_MAX if there
+ * is none), so nothing a retired fence covered is left. The caller holds
+ * the lock guarding the fences.
+ */
+static void message_queue_expire_fences(MessageQueue *queue, size_t position) {
+    size_t kept = 0;
+    for (size_t i = 0; i < queue->fence_count; i++) {
+        if (queue->fences[i].until > position) {
+            queue->fences[kept++] = queue->fences[i];
+        } else {
+            free(queue->fences[i].topic);
+        }
+    }
+    queue->fence_count = kept;
+}
+
+/**
+ * @brief Drops the stale messages of a run just popped from the ring.
+ *
+ * `out` and `notes` (if given) are compacted in place. The caller holds
+ * `pop_lock`.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param head The position of `out[0]`.
+ * @param out The popped messages.
+ * @param notes Their notes, or NULL if they were already released.
+ * @param n Number of messages in `out`.
+ * @return The number of messages kept.
+ */
+static size_t ring_drop_stale(MessageQueue *queue, size_t head, rd_kafka_message_t **out,
+                              void **notes, size_t n) {
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (message_queue_is_stale(queue, out[i], head + i)) {
+            message_queue_drop(queue, out[i], notes ? notes[i] : NULL);
+            continue;
+        }
+        out[kept] = out[i];
+        if (notes) {
+            notes[kept] = notes[i];
+        }
+        kept++;
+    }
+    message_queue_expire_fences(queue, head + n);
+    return kept;
+}
+
+/**
+ * @brief Unlinks the stale nodes at the head of the list.
+ *
+ * The caller holds `lock` and returns the chain to the pool.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param first Receives the first unlinked node.
+ * @param last Receives the last unlinked node.
+ * @return The number of nodes unlinked.
+ */
+static size_t list_drop_stale(MessageQueue *queue, MessageNode **first, MessageNode **last) {
+    *first = NULL;
+    *last = NULL;
+    if (!queue->fence_count) {
+        return 0;
+    }
+    size_t n = 0;
+    MessageNode *node;
+    while ((node = queue->list_head) && message_queue_is_stale(queue, node->message, node->position)) {
+        queue->list_head = node->next;
+        atomic_fetch_sub_explicit(&queue->bytes, node->message->len, memory_order_relaxed);
+        message_queue_drop(queue, node->message, node->note);
+        node->next = NULL;
+        if (*last) {
+            (*last)->next = node;
+        } else {
+            *first = node;
+        }
+        *last = node;
+        n++;
+    }
+    if (!queue->list_head) {
+        queue->list_tail = NULL;
+    }
+    queue->list_size -= n;
+    message_queue_expire_fences(queue, queue->list_head ? queue->list_head->position : SIZE_MAX);
+    return n;
+}
+
+/**
+ * @brief Returns non-zero if the ring has no messages (consumer's view).
+ */
+static int ring_is_empty(MessageQueue *queue) {
+    return atomic_load_explicit(&queue->tail, memory_order_acquire) ==
+           atomic_load_explicit(&queue->head, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns non-zero if the ring has no free slot (producer's view).
+ */
+static int ring_is_full(MessageQueue *queue) {
+    return queue->slots && atomic_load_explicit(&queue->tail, memory_order_relaxed) -
+           atomic_load_explicit(&queue->head, memory_order_acquire) >= queue->capacity;
+}
+
+/**
+ * @brief Returns non-zero once the producer may push again.
+ */
+static int ring_has_room(MessageQueue *queue) {
+    return !ring_is_full(queue);
+}
+
+/**
+ * @brief Sleeps on the queue's condition variable until `ready` holds.
+ *
+ * Uses the same announce-then-recheck protocol as message_queue_pop(), so a
+ * concurrent pop either satisfies the re-check or sees our `waiters`
+ * increment and broadcasts.
+ *
+ * @return 1 if `ready` holds, 0 on timeout.
+ */
+static int message_queue_wait_until(MessageQueue *queue, int (*ready)(MessageQueue *), int timeout_ms) {
+    if (ready(queue)) {
+        return 1;
+    }
+
+    struct timespec deadline;
+    deadline_after_ms(&deadline, timeout_ms);
+
+    pthread_mutex_lock(&queue->lock);
+    atomic_fetch_add(&queue->waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    int rc = 0;
+    while (!ready(queue) && rc != ETIMEDOUT) {
+        rc = pthread_cond_timedwait(&queue->cond, &queue->lock, &deadline);
+    }
+    atomic_fetch_sub(&queue->waiters, 1);
+    pthread_mutex_unlock(&queue->lock);
+    return ready(queue);
+}
 
 /**
  * @brief Initializes a MessageQueue.
  *
- * Sets the head and tail to NULL, size to 0, and initializes the
- * mutex and condition variable for thread safety.
+ * Allocates the ring storage (or prepares the linked-list fallback when
+ * `capacity` is 0) and initializes the mutex and condition variable used
+ * for sleeping.
  *
  * @param queue A pointer to the MessageQueue to be initialized.
+ * @param capacity The requested ring capacity.
+ * @return 0 on success, -1 on allocation failure.
  */
-void message_queue_init(MessageQueue *queue) {
-    queue->head = NULL;
-    queue->tail = NULL;
-    queue->size = 0;
+int message_queue_init(MessageQueue *queue, size_t capacity) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->cached_head = 0;
+    queue->cached_tail = 0;
+    queue->slots = NULL;
+    queue->stamps = NULL;
+    queue->notes = NULL;
+    queue->capacity = 0;
+    queue->mask = 0;
+    if (capacity > 0) {
+        queue->capacity = round_up_pow2(capacity);
+        queue->mask = queue->capacity - 1;
+        queue->slots = (rd_kafka_message_t **)calloc(queue->capacity, sizeof(rd_kafka_message_t *));
+        if (!queue->slots) {
+            return -1;
+        }
+    }
+
+    queue->list_head = NULL;
+    queue->list_tail = NULL;
+    atomic_init(&queue->list_size, 0);
+    queue->list_pushed = 0;
+    node_pool_init(&queue->pool);
+    queue->fences = NULL;
+    queue->fence_count = 0;
+    queue->fence_capacity = 0;
+    atomic_init(&queue->waiters, 0);
+    queue->wakeup = NULL;
+    atomic_init(&queue->armed, 1);
+    queue->dwell = NULL;
+    queue->decoder = NULL;
+    atomic_init(&queue->bytes, 0);
+    queue->high_messages = 0;
+    queue->low_messages = 0;
+    queue->high_bytes = 0;
+    queue->low_bytes = 0;
     pthread_mutex_init(&queue->lock, NULL);
+    pthread_mutex_init(&queue->pop_lock, NULL);
     pthread_cond_init(&queue->cond, NULL);
+    return 0;
 }
 
 /**
  * @brief Pushes a Kafka message onto the queue.
  *
- * This operation is thread-safe. It appends a new message to the tail of the
- * linked list and signals any waiting consumer threads.
+ * In ring mode this is lock-free: the message is stored in the next slot and
+ * published with a release store of `tail`. Only the producer thread may
+ * call it. In linked-list mode a node is appended under the mutex.
  *
  * @param queue A pointer to the MessageQueue.
  * @param message The Kafka message to be added.
+ * @return 0 on success, -1 if the ring is full.
  */
-void message_queue_push(MessageQueue *queue, rd_kafka_message_t *message) {
-    // Create a new node for the message.
-    MessageNode *new_node = (MessageNode *)malloc(sizeof(MessageNode));
+int message_queue_push(MessageQueue *queue, rd_kafka_message_t *message) {
+    if (queue->slots) {
+        size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        if (tail - queue->cached_head >= queue->capacity) {
+            // Refresh our view of the consumer's progress before giving up.
+            queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+            if (tail - queue->cached_head >= queue->capacity) {
+                return -1;
+            }
+        }
+        queue->slots[tail & queue->mask] = message;
+        if (queue->stamps) {
+            queue->stamps[tail & queue->mask] = metrics_now_ns();
+        }
+        if (queue->notes) {
+            queue->notes[tail & queue->mask] = NULL;
+        }
+        atomic_fetch_add_explicit(&queue->bytes, message->len, memory_order_relaxed);
+        atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+        message_queue_wake(queue);
+        message_queue_notify(queue);
+        return 0;
+    }
+
+    // Take a node for the message from the pool.
+    MessageNode *new_node = node_pool_alloc(&queue->pool);
+    if (!new_node) {
+        return -1;
+    }
     new_node->message = message;
     new_node->next = NULL;
+    new_node->received_ns = message_queue_stamp(queue);
+    new_node->note = NULL;
+    new_node->position = queue->list_pushed++;
 
     // Lock the queue for safe modification.
     pthread_mutex_lock(&queue->lock);
 
     // Append the new node to the tail of the list.
-    if (queue->tail) {
-        queue->tail->next = new_node;
+    if (queue->list_tail) {
+        queue->list_tail->next = new_node;
     } else {
-        queue->head = new_node;
+        queue->list_head = new_node;
     }
-    queue->tail = new_node;
-    queue->size++;
+    queue->list_tail = new_node;
+    queue->list_size++;
+    atomic_fetch_add_explicit(&queue->bytes, message->len, memory_order_relaxed);
 
     // Signal that a new item is available.
-    pthread_cond_signal(&queue->cond);
+    pthread_cond_broadcast(&queue->cond);
     pthread_mutex_unlock(&queue->lock);
+    message_queue_notify(queue);
+    return 0;
+}
+
+/**
+ * @brief Pushes a batch of Kafka messages onto the queue.
+ *
+ * The ring copies as many messages as fit into consecutive slots and then
+ * publishes them with one release store, one fence and at most one wakeup.
+ * The linked list takes the node chain from the pool before taking the lock
+ * so the critical section is a constant-time splice.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param messages The messages to add.
+ * @param notes Their decode results, or NULL.
+ * @param count The number of messages.
+ * @return The number of messages taken from the front of `messages`.
+ */
+size_t message_queue_push_batch(MessageQueue *queue, rd_kafka_message_t **messages, void **notes,
+                                size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+
+    if (queue->slots) {
+        size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        size_t free_slots = queue->capacity - (tail - queue->cached_head);
+        if (free_slots < count) {
+            queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+            free_slots = queue->capacity - (tail - queue->cached_head);
+        }
+        size_t n = count < free_slots ? count : free_slots;
+        if (n == 0) {
+            return 0;
+        }
+        size_t bytes = 0;
+        for (size_t i = 0; i < n; i++) {
+            queue->slots[(tail + i) & queue->mask] = messages[i];
+            bytes += messages[i]->len;
+        }
+        if (queue->stamps) {
+            // One clock read per batch: its messages arrived together.
+            uint64_t now = metrics_now_ns();
+            for (size_t i = 0; i < n; i++) {
+                queue->stamps[(tail + i) & queue->mask] = now;
+            }
+        }
+        if (queue->notes) {
+            for (size_t i = 0; i < n; i++) {
+                queue->notes[(tail + i) & queue->mask] = notes ? notes[i] : NULL;
+            }
+        }
+        atomic_fetch_add_explicit(&queue->bytes, bytes, memory_order_relaxed);
+        atomic_store_explicit(&queue->tail, tail + n, memory_order_release);
+        message_queue_wake(queue);
+        message_queue_notify(queue);
+        return n;
+    }
+
+    // Build the chain from pooled nodes outside the lock.
+    MessageNode *first = NULL;
+    MessageNode *last = NULL;
+    size_t n = 0;
+    size_t bytes = 0;
+    uint64_t stamp = message_queue_stamp(queue);
+    for (; n < count; n++) {
+        MessageNode *node = node_pool_alloc(&queue->pool);
+        if (!node) {
+            break;
+        }
+        bytes += messages[n]->len;
+        node->message = messages[n];
+        node->next = NULL;
+        node->received_ns = stamp;
+        node->note = notes && queue->decoder ? notes[n] : NULL;
+        node->position = queue->list_pushed + n;
+        if (last) {
+            last->next = node;
+        } else {
+            first = node;
+        }
+        last = node;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    queue->list_pushed += n;
+
+    // Splice it onto the tail in one step.
+    pthread_mutex_lock(&queue->lock);
+    if (queue->list_tail) {
+        queue->list_tail->next = first;
+    } else {
+        queue->list_head = first;
+    }
+    queue->list_tail = last;
+    queue->list_size += n;
+    atomic_fetch_add_explicit(&queue->bytes, bytes, memory_order_relaxed);
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->lock);
+    message_queue_notify(queue);
+    return n;
+}
+
+/**
+ * @brief Pops a Kafka message from the queue without blocking.
+ *
+ * Safe to call from several consumer threads: the ring's consumer index is
+ * advanced under `pop_lock`, the list under `lock`.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @return The message at the head of the queue, or NULL if it is empty.
+ */
+rd_kafka_message_t *message_queue_try_pop(MessageQueue *queue) {
+    if (queue->slots) {
+        pthread_mutex_lock(&queue->pop_lock);
+        rd_kafka_message_t *message;
+        uint64_t received_ns;
+        void *note;
+        size_t kept;
+        int dropped = 0;
+        do {
+            size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+            if (head == queue->cached_tail) {
+                queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+                if (head == queue->cached_tail) {
+                    pthread_mutex_unlock(&queue->pop_lock);
+                    if (dropped) {
+                        message_queue_wake(queue);
+                    }
+                    return NULL;
+                }
+            }
+            message = queue->slots[head & queue->mask];
+            received_ns = queue->stamps ? queue->stamps[head & queue->mask] : 0;
+            note = queue->notes ? queue->notes[head & queue->mask] : NULL;
+            atomic_fetch_sub_explicit(&queue->bytes, message->len, memory_order_relaxed);
+            atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+            kept = queue->fence_count ? ring_drop_stale(queue, head, &message, &note, 1) : 1;
+            dropped = 1;
+        } while (kept == 0);
+        pthread_mutex_unlock(&queue->pop_lock);
+        // The producer may be sleeping on a full ring or a high watermark.
+        message_queue_wake(queue);
+        message_queue_record_dwell(queue, received_ns);
+        message_queue_release_note(queue, note);
+        return message;
+    }
+
+    MessageNode *stale_first;
+    MessageNode *stale_last;
+    pthread_mutex_lock(&queue->lock);
+    size_t stale = list_drop_stale(queue, &stale_first, &stale_last);
+    MessageNode *node = queue->list_head;
+    rd_kafka_message_t *message = NULL;
+    uint64_t received_ns = 0;
+    if (node) {
+        message = node->message;
+        received_ns = node->received_ns;
+        queue->list_head = node->next;
+        if (queue->list_head == NULL) {
+            queue->list_tail = NULL;
+        }
+        queue->list_size--;
+        atomic_fetch_sub_explicit(&queue->bytes, message->len, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    if (stale) {
+        node_pool_free_chain(&queue->pool, stale_first, stale_last, stale);
+        if (!message) {
+            message_queue_wake(queue);
+        }
+    }
+    if (message) {
+        message_queue_release_note(queue, node->note);
+        node_pool_free_chain(&queue->pool, node, node, 1);
+        message_queue_wake(queue);
+        message_queue_record_dwell(queue, received_ns);
+    }
+    return message;
+}
+
+/**
+ * @brief Pops a batch of Kafka messages from the queue without blocking.
+ *
+ * The ring copies out up to `max_count` consecutive slots and releases them
+ * with one store of `head`, under `pop_lock` so concurrent consumers each
+ * get a disjoint run. The linked list unlinks the nodes under a single
+ * lock acquisition and returns them to the pool as one chain afterwards.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param out Receives the popped messages.
+ * @param notes Receives their notes, or NULL to release them.
+ * @param max_count The maximum number of messages to pop.
+ * @return The number of messages popped.
+ */
+size_t message_queue_pop_batch(MessageQueue *queue, rd_kafka_message_t **out, void **notes,
+                               size_t max_count) {
+    if (max_count == 0) {
+        return 0;
+    }
+
+    if (queue->slots) {
+        pthread_mutex_lock(&queue->pop_lock);
+        size_t kept;
+        uint64_t received_ns;
+        int dropped = 0;
+        // Runs again only if a whole run turned out to be stale.
+        do {
+            size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+            size_t available = queue->cached_tail - head;
+            if (available < max_count) {
+                queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+                available = queue->cached_tail - head;
+            }
+            size_t n = available < max_count ? available : max_count;
+            if (n == 0) {
+                pthread_mutex_unlock(&queue->pop_lock);
+                if (dropped) {
+                    message_queue_wake(queue);
+                }
+                return 0;
+            }
+            size_t bytes = 0;
+            for (size_t i = 0; i < n; i++) {
+                out[i] = queue->slots[(head + i) & queue->mask];
+                bytes += out[i]->len;
+            }
+            if (queue->notes) {
+                // Copied out before `head` moves: the slots may be reused after.
+                for (size_t i = 0; i < n; i++) {
+                    void *note = queue->notes[(head + i) & queue->mask];
+                    if (notes) {
+                        notes[i] = note;
+                    } else {
+                        message_queue_release_note(queue, note);
+                    }
+                }
+            } else if (notes) {
+                memset(notes, 0, n * sizeof(void *));
+            }
+            received_ns = queue->stamps ? queue->stamps[head & queue->mask] : 0;
+            atomic_fetch_sub_explicit(&queue->bytes, bytes, memory_order_relaxed);
+            atomic_store_explicit(&queue->head, head + n, memory_order_release);
+            kept = queue->fence_count ? ring_drop_stale(queue, head, out, notes, n) : n;
+            dropped = 1;
+        } while (kept == 0);
+        pthread_mutex_unlock(&queue->pop_lock);
+        message_queue_wake(queue);
+        message_queue_record_dwell(queue, received_ns);
+        return kept;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    MessageNode *first = queue->list_head;
+    MessageNode *node = first;
+    MessageNode *last = NULL;
+    size_t n = 0;
+    size_t kept = 0;
+    size_t bytes = 0;
+    uint64_t received_ns = first ? first->received_ns : 0;
+    // Stale nodes are unlinked with the rest but not handed out.
+    while (node && kept < max_count) {
+        bytes += node->message->len;
+        if (queue->fence_count && message_queue_is_stale(queue, node->message, node->position)) {
+            message_queue_drop(queue, node->message, node->note);
+        } else {
+            if (notes) {
+                notes[kept] = node->note;
+            } else {
+                message_queue_release_note(queue, node->note);
+            }
+            out[kept++] = node->message;
+        }
+        n++;
+        last = node;
+        node = node->next;
+    }
+    queue->list_head = node;
+    if (node == NULL) {
+        queue->list_tail = NULL;
+    }
+    queue->list_size -= n;
+    atomic_fetch_sub_explicit(&queue->bytes, bytes, memory_order_relaxed);
+    if (queue->fence_count) {
+        message_queue_expire_fences(queue, node ? node->position : SIZE_MAX);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    if (n > 0) {
+        message_queue_wake(queue);
+        message_queue_record_dwell(queue, received_ns);
+    }
+
+    // Recycle the detached nodes outside the lock.
+    if (n > 0) {
+        node_pool_free_chain(&queue->pool, first, last, n);
+    }
+    return kept;
 }
 
 /**
@@ -59,47 +687,441 @@ void message_queue_push(MessageQueue *queue, rd_kafka_message_t *message) {
  * @return The `rd_kafka_message_t` from the head of the queue.
  */
 rd_kafka_message_t *message_queue_pop(MessageQueue *queue) {
+    if (queue->slots) {
+        for (;;) {
+            rd_kafka_message_t *message = message_queue_try_pop(queue);
+            if (message) {
+                return message;
+            }
+            // Announce ourselves before re-checking, so a concurrent push
+            // either becomes visible here or sees us and signals.
+            pthread_mutex_lock(&queue->lock);
+            atomic_fetch_add(&queue->waiters, 1);
+            atomic_thread_fence(memory_order_seq_cst);
+            while (ring_is_empty(queue)) {
+                pthread_cond_wait(&queue->cond, &queue->lock);
+            }
+            atomic_fetch_sub(&queue->waiters, 1);
+            pthread_mutex_unlock(&queue->lock);
+        }
+    }
+
     pthread_mutex_lock(&queue->lock);
     // Wait for a message to become available if the queue is empty.
-    while (queue->head == NULL) {
+    for (;;) {
+        MessageNode *stale_first;
+        MessageNode *stale_last;
+        size_t stale = list_drop_stale(queue, &stale_first, &stale_last);
+        if (stale) {
+            node_pool_free_chain(&queue->pool, stale_first, stale_last, stale);
+        }
+        if (queue->list_head) {
+            break;
+        }
         pthread_cond_wait(&queue->cond, &queue->lock);
     }
 
     // Remove the node from the head of the list.
-    MessageNode *node = queue->head;
+    MessageNode *node = queue->list_head;
     rd_kafka_message_t *message = node->message;
-    queue->head = node->next;
-    if (queue->head == NULL) {
-        queue->tail = NULL;
+    uint64_t received_ns = node->received_ns;
+    queue->list_head = node->next;
+    if (queue->list_head == NULL) {
+        queue->list_tail = NULL;
     }
-    queue->size--;
-    free(node);
+    queue->list_size--;
+    atomic_fetch_sub_explicit(&queue->bytes, message->len, memory_order_relaxed);
 
     pthread_mutex_unlock(&queue->lock);
+    message_queue_release_note(queue, node->note);
+    node_pool_free_chain(&queue->pool, node, node, 1);
+    message_queue_wake(queue);
+    message_queue_record_dwell(queue, received_ns);
     return message;
 }
 
+/**
+ * @brief Removes the messages `match` selects from anywhere in the queue.
+ *
+ * The ring is compacted towards its tail under `pop_lock`: kept messages
+ * slide up, in order, over the removed ones and `head` moves forward by the
+ * number removed. Only `head` and the consumers' `cached_tail` change,
+ * which consumers cannot observe while the lock is held, and the producer
+ * is the caller, so neither side sees a half-compacted ring. The list
+ * unlinks the matching nodes under `lock`.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param match Returns non-zero for messages to remove.
+ * @param arg Passed to `match`.
+ * @return The number of messages removed.
+ */
+size_t message_queue_purge(MessageQueue *queue, MessageMatch match, void *arg) {
+    size_t removed = 0;
+    size_t bytes = 0;
+
+    if (queue->slots) {
+        pthread_mutex_lock(&queue->pop_lock);
+        size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        size_t write = tail;
+        for (size_t read = tail; read != head; read--) {
+            size_t from = (read - 1) & queue->mask;
+            rd_kafka_message_t *message = queue->slots[from];
+            // Kept messages move up, so stale ones must go now or they
+            // would slide past their fence.
+            if (match(message, arg) ||
+                (queue->fence_count && message_queue_is_stale(queue, message, read - 1))) {
+                bytes += message->len;
+                rd_kafka_message_destroy(message);
+                if (queue->notes) {
+                    message_queue_release_note(queue, queue->notes[from]);
+                }
+                removed++;
+                continue;
+            }
+            write--;
+            size_t to = write & queue->mask;
+            if (to != from) {
+                queue->slots[to] = message;
+                if (queue->stamps) {
+                    queue->stamps[to] = queue->stamps[from];
+                }
+                if (queue->notes) {
+                    queue->notes[to] = queue->notes[from];
+                }
+            }
+        }
+        if (removed) {
+            atomic_fetch_sub_explicit(&queue->bytes, bytes, memory_order_relaxed);
+            atomic_store_explicit(&queue->head, write, memory_order_release);
+            // `head` may now be past the consumers' cached tail, which the
+            // pops assume never happens.
+            queue->cached_tail = tail;
+        }
+        if (queue->fence_count) {
+            message_queue_expire_fences(queue, SIZE_MAX);
+        }
+        pthread_mutex_unlock(&queue->pop_lock);
+        return removed;
+    }
+
+    MessageNode *first = NULL;
+    MessageNode *last = NULL;
+    pthread_mutex_lock(&queue->lock);
+    MessageNode **link = &queue->list_head;
+    MessageNode *prev = NULL;
+    while (*link) {
+        MessageNode *node = *link;
+        if (match(node->message, arg)) {
+            *link = node->next;
+            bytes += node->message->len;
+            rd_kafka_message_destroy(node->message);
+            message_queue_release_note(queue, node->note);
+            node->next = NULL;
+            if (last) {
+                last->next = node;
+            } else {
+                first = node;
+            }
+            last = node;
+            removed++;
+        } else {
+            prev = node;
+            link = &node->next;
+        }
+    }
+    queue->list_tail = prev;
+    queue->list_size -= removed;
+    atomic_fetch_sub_explicit(&queue->bytes, bytes, memory_order_relaxed);
+    pthread_mutex_unlock(&queue->lock);
+    if (removed) {
+        node_pool_free_chain(&queue->pool, first, last, removed);
+    }
+    return removed;
+}
+
+/**
+ * @brief Drops one partition's queued messages lazily.
+ *
+ * Records the current push position for the partition (replacing an older
+ * fence for it); the pops destroy the partition's messages before that
+ * position as they reach them, and retire the fence once the queue has
+ * moved past it. Only the producer pushes, so nothing stale can be pushed
+ * after the position is taken.
+ */
+int message_queue_fence(MessageQueue *queue, const char *topic, int32_t partition) {
+    pthread_mutex_t *lock = queue->slots ? &queue->pop_lock : &queue->lock;
+    size_t until = queue->slots ? atomic_load_explicit(&queue->tail, memory_order_relaxed)
+                                : queue->list_pushed;
+    int rc = 0;
+    pthread_mutex_lock(lock);
+    size_t i = 0;
+    while (i < queue->fence_count &&
+           !(queue->fences[i].partition == partition && strcmp(queue->fences[i].topic, topic) == 0)) {
+        i++;
+    }
+    if (i < queue->fence_count) {
+        queue->fences[i].until = until;
+    } else {
+        char *name = strdup(topic);
+        if (name && queue->fence_count == queue->fence_capacity) {
+            size_t capacity = queue->fence_capacity ? queue->fence_capacity * 2 : 8;
+            MessageFence *grown = realloc(queue->fences, capacity * sizeof(MessageFence));
+            if (grown) {
+                queue->fences = grown;
+                queue->fence_capacity = capacity;
+            } else {
+                free(name);
+                name = NULL;
+            }
+        }
+        if (name) {
+            queue->fences[queue->fence_count++] = (MessageFence){name, partition, until};
+        } else {
+            rc = -1;
+        }
+    }
+    pthread_mutex_unlock(lock);
+    return rc;
+}
+
+/**
+ * @brief Blocks the producer until the ring has room for another message.
+ *
+ * Linked-list queues are unbounded, so this returns immediately for them.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param timeout_ms Maximum time to wait, in milliseconds.
+ * @return 1 if a slot is free, 0 if the wait timed out.
+ */
+int message_queue_wait_not_full(MessageQueue *queue, int timeout_ms) {
+    return message_queue_wait_until(queue, ring_has_room, timeout_ms);
+}
+
+/**
+ * @brief Sets the queue's backpressure watermarks.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param high_messages High watermark by message count (0 disables).
+ * @param low_messages Low watermark by message count.
+ * @param high_bytes High watermark by payload bytes (0 disables).
+ * @param low_bytes Low watermark by payload bytes.
+ */
+void message_queue_set_watermarks(MessageQueue *queue, size_t high_messages, size_t low_messages,
+                                  size_t high_bytes, size_t low_bytes) {
+    queue->high_messages = high_messages;
+    queue->low_messages = low_messages;
+    queue->high_bytes = high_bytes;
+    queue->low_bytes = low_bytes;
+}
+
+/**
+ * @brief Checks whether the queue has reached a high watermark.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @return 1 if the count or byte high mark (when enabled) is reached.
+ */
+int message_queue_above_high(MessageQueue *queue) {
+    if (queue->high_messages && message_queue_size(queue) >= queue->high_messages) {
+        return 1;
+    }
+    if (queue->high_bytes && message_queue_bytes(queue) >= queue->high_bytes) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks whether the queue has drained to its low watermarks.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @return 1 if every enabled dimension is at or below its low mark.
+ */
+int message_queue_below_low(MessageQueue *queue) {
+    if (queue->high_messages && message_queue_size(queue) > queue->low_messages) {
+        return 0;
+    }
+    if (queue->high_bytes && message_queue_bytes(queue) > queue->low_bytes) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Blocks the producer until the queue drains to its low watermarks.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param timeout_ms Maximum time to wait, in milliseconds.
+ * @return 1 if the queue is below its low marks, 0 if the wait timed out.
+ */
+int message_queue_wait_below_low(MessageQueue *queue, int timeout_ms) {
+    return message_queue_wait_until(queue, message_queue_below_low, timeout_ms);
+}
+
+/**
+ * @brief Returns the total payload bytes currently in the queue.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @return A snapshot of the queued payload size.
+ */
+size_t message_queue_bytes(MessageQueue *queue) {
+    return atomic_load_explicit(&queue->bytes, memory_order_relaxed);
+}
+
+/**
+ * @brief Attaches a Wakeup to the queue.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param wakeup The Wakeup to signal, or NULL.
+ */
+void message_queue_set_wakeup(MessageQueue *queue, Wakeup *wakeup) {
+    queue->wakeup = wakeup;
+    atomic_store(&queue->armed, 1);
+}
+
+/**
+ * @brief Starts recording receipt-to-pop times into `dwell`.
+ *
+ * The ring keeps the stamps in an array parallel to its slots, so tracking
+ * costs one store per pushed message and one clock read per push and pop.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param dwell The histogram to record into.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int message_queue_track_dwell(MessageQueue *queue, struct Histogram *dwell) {
+    if (queue->slots && !queue->stamps) {
+        queue->stamps = (uint64_t *)calloc(queue->capacity, sizeof(uint64_t));
+        if (!queue->stamps) {
+            return -1;
+        }
+    }
+    queue->dwell = dwell;
+    return 0;
+}
+
+/**
+ * @brief Starts keeping a decode result with every pushed message.
+ *
+ * Like the dwell stamps, the ring keeps the notes in an array parallel to
+ * its slots; list nodes carry theirs.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param decoder The decoder the notes come from.
+ * @return 0 on success, -1 on allocation failure.
+ */
+int message_queue_track_notes(MessageQueue *queue, const struct Decoder *decoder) {
+    if (queue->slots && !queue->notes) {
+        queue->notes = (void **)calloc(queue->capacity, sizeof(void *));
+        if (!queue->notes) {
+            return -1;
+        }
+    }
+    queue->decoder = decoder;
+    return 0;
+}
+
+/**
+ * @brief Arms the Wakeup and re-checks for a racing push.
+ *
+ * The seq_cst store of `armed` pairs with the producer's fence: either the
+ * producer sees the flag and signals, or the re-check below sees its message.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @return 1 if the queue is still empty, 0 if a message is available.
+ */
+int message_queue_arm(MessageQueue *queue) {
+    atomic_store(&queue->armed, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    return message_queue_size(queue) == 0;
+}
+
+/**
+ * @brief Reports the usage of the queue's node pool.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @param stats Receives the snapshot.
+ */
+void message_queue_pool_stats(MessageQueue *queue, NodePoolStats *stats) {
+    node_pool_stats(&queue->pool, stats);
+}
+
+/**
+ * @brief Returns the number of messages currently in the queue.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @return A snapshot of the queue depth.
+ */
+size_t message_queue_size(MessageQueue *queue) {
+    if (queue->slots) {
+        return atomic_load_explicit(&queue->tail, memory_order_acquire) -
+               atomic_load_explicit(&queue->head, memory_order_acquire);
+    }
+    // Atomic so that it can be read without the lock, including from
+    // predicates evaluated while the lock is already held.
+    return atomic_load_explicit(&queue->list_size, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns how many messages have left the queue since it was created.
+ *
+ * Popped, purged and fenced-off messages all count. Producer only: list
+ * mode derives it from the producer's push count.
+ *
+ * @param queue A pointer to the MessageQueue.
+ * @return The running total.
+ */
+size_t message_queue_drained(MessageQueue *queue) {
+    if (queue->slots) {
+        return atomic_load_explicit(&queue->head, memory_order_acquire);
+    }
+    return queue->list_pushed - atomic_load_explicit(&queue->list_size, memory_order_relaxed);
+}
+
 /**
  * @brief Destroys the message queue and frees all resources.
  *
- * It iterates through any remaining messages in the queue, destroys them,
- * and frees the corresponding nodes. It also destroys the mutex and
- * condition variable.
+ * It destroys any messages still in the ring or list, frees the storage,
+ * and destroys the mutex and condition variable. Neither the producer nor
+ * the consumer may be using the queue any more.
  *
  * @param queue A pointer to the MessageQueue to be destroyed.
  */
 void message_queue_destroy(MessageQueue *queue) {
+    if (queue->slots) {
+        size_t head = atomic_load(&queue->head);
+        size_t tail = atomic_load(&queue->tail);
+        for (; head != tail; head++) {
+            rd_kafka_message_destroy(queue->slots[head & queue->mask]);
+            if (queue->notes) {
+                message_queue_release_note(queue, queue->notes[head & queue->mask]);
+            }
+        }
+        free(queue->slots);
+        queue->slots = NULL;
+        free(queue->stamps);
+        queue->stamps = NULL;
+        free(queue->notes);
+        queue->notes = NULL;
+    }
+
     pthread_mutex_lock(&queue->lock);
-    // Free all remaining nodes and their messages.
-    while (queue->head) {
-        MessageNode *node = queue->head;
-        queue->head = node->next;
+    // Destroy all remaining messages; their nodes go away with the pool.
+    while (queue->list_head) {
+        MessageNode *node = queue->list_head;
+        queue->list_head = node->next;
         rd_kafka_message_destroy(node->message);
-        free(node);
+        message_queue_release_note(queue, node->note);
     }
+    queue->list_tail = NULL;
     pthread_mutex_unlock(&queue->lock);
+    node_pool_destroy(&queue->pool);
+    message_queue_expire_fences(queue, SIZE_MAX);
+    free(queue->fences);
+    queue->fences = NULL;
 
     // Destroy synchronization primitives.
     pthread_mutex_destroy(&queue->lock);
+    pthread_mutex_destroy(&queue->pop_lock);
     pthread_cond_destroy(&queue->cond);
 }
@@ -2,55 +2,352 @@
 #define ASYNKAF_QUEUE_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <librdkafka/rdkafka.h>
+#include "pool.h"
+#include "wakeup.h"
+
+struct Decoder;
+struct Histogram;
+
+/**
+ * @brief Assumed size of a CPU cache line, used to pad the ring indices.
+ */
+#define MESSAGE_QUEUE_CACHE_LINE 64
+
+/**
+ * @brief Default ring capacity used when the caller does not choose one.
+ */
+#define MESSAGE_QUEUE_DEFAULT_CAPACITY 65536
 
 /**
  * @brief A node in the message queue's linked list.
  *
  * Each node contains a single Kafka message and a pointer to the next node.
+ * Only used by the unbounded fallback mode (capacity 0); nodes come from the
+ * queue's NodePool rather than malloc.
  */
 typedef struct MessageNode {
     rd_kafka_message_t *message; // Pointer to the Kafka message.
     struct MessageNode *next;    // Pointer to the next node in the queue.
+    uint64_t received_ns;        // When the message was pushed, if dwell is tracked.
+    void *note;                  // Decode result travelling with the message, or NULL.
+    size_t position;             // Push position, compared against fences.
 } MessageNode;
 
+/**
+ * @brief Marks the queued messages of one partition as stale.
+ *
+ * Every message of the partition pushed before `until` is dropped by the
+ * pops instead of being handed out, so discarding a partition's backlog
+ * after a seek costs nothing up front. Positions count pushes: the ring's
+ * `tail`, or the list's `list_pushed`.
+ */
+typedef struct {
+    char *topic;                 // Topic name (owned).
+    int32_t partition;           // Partition number.
+    size_t until;                // First push position the fence does not cover.
+} MessageFence;
+
 /**
  * @brief A thread-safe queue for Kafka messages.
  *
- * This structure implements a FIFO (First-In, First-Out) queue using a
- * singly linked list. It uses a mutex and a condition variable to ensure
- * thread-safe operations.
+ * With a non-zero capacity the queue is a fixed-size, lock-free
+ * single-producer ring: the poller thread is the only producer. Pops take a
+ * short consumer-side lock, so several Python threads (e.g. on a
+ * free-threaded build) may drain the same queue; the producer never touches
+ * that lock and stays lock-free. The producer- and
+ * consumer-owned indices live on separate cache lines so the two threads
+ * do not false-share. The mutex and condition variable are only touched
+ * when one side has to sleep.
+ *
+ * An optional Wakeup is signalled when a push makes the queue non-empty
+ * after the consumer has armed it (see message_queue_arm()), so an event
+ * loop is woken once per batch rather than once per message.
+ *
+ * Optional high/low watermarks, by message count and by total payload bytes,
+ * let the producer apply backpressure upstream long before the ring fills.
+ *
+ * With a capacity of 0 the queue falls back to an unbounded, mutex-protected
+ * singly linked list.
+ *
+ * Fences (see message_queue_fence()) let the producer invalidate one
+ * partition's queued messages without scanning the queue. While none is
+ * active the pops pay a single branch for them.
  */
 typedef struct {
-    MessageNode *head;        // Pointer to the first message in the queue.
-    MessageNode *tail;        // Pointer to the last message in the queue.
-    int size;                 // The current number of messages in the queue.
-    pthread_mutex_t lock;     // Mutex to protect access to the queue.
-    pthread_cond_t cond;      // Condition variable to signal when the queue is not empty.
+    // Consumer-owned cache line.
+    atomic_size_t head;       // Index of the next slot to pop.
+    size_t cached_tail;       // Consumer's last observed value of `tail`.
+    char pad_head[MESSAGE_QUEUE_CACHE_LINE - sizeof(atomic_size_t) - sizeof(size_t)];
+
+    // Producer-owned cache line.
+    atomic_size_t tail;       // Index of the next slot to fill.
+    size_t cached_head;       // Producer's last observed value of `head`.
+    char pad_tail[MESSAGE_QUEUE_CACHE_LINE - sizeof(atomic_size_t) - sizeof(size_t)];
+
+    pthread_mutex_t pop_lock; // Serializes ring pops between consumer threads.
+
+    // Read-mostly ring description.
+    rd_kafka_message_t **slots; // Ring storage, NULL in linked-list mode.
+    uint64_t *stamps;         // Push time per slot, only while dwell is tracked.
+    void **notes;             // Decode result per slot, only while notes are tracked.
+    size_t capacity;          // Number of slots (a power of two), 0 for linked-list mode.
+    size_t mask;              // capacity - 1, used to wrap indices.
+
+    // Linked-list fallback.
+    MessageNode *list_head;   // Pointer to the first message in the list.
+    MessageNode *list_tail;   // Pointer to the last message in the list.
+    atomic_size_t list_size;  // The current number of messages in the list (written under `lock`).
+    size_t list_pushed;       // Positions handed out to list nodes (producer-owned).
+    NodePool pool;            // Slab pool the list's nodes are recycled through.
+
+    // Read under `pop_lock` in ring mode and under `lock` in list mode.
+    MessageFence *fences;     // Partitions whose older messages are stale.
+    size_t fence_count;       // Number of entries in `fences`.
+    size_t fence_capacity;    // Allocated length of `fences`.
+
+    pthread_mutex_t lock;     // Protects the list and the sleeping protocol.
+    pthread_cond_t cond;      // Signalled when the queue becomes non-empty or non-full.
+    atomic_int waiters;       // Number of threads sleeping on `cond`.
+
+    Wakeup *wakeup;           // Optional fd signalled on the empty -> non-empty transition.
+    atomic_int armed;         // Set by the consumer when it saw the queue empty.
+    struct Histogram *dwell;  // Optional receipt-to-pop time histogram.
+    const struct Decoder *decoder; // Produced the notes and frees dropped ones, or NULL.
+
+    atomic_size_t bytes;      // Total payload bytes currently queued.
+    size_t high_messages;     // Count at/above which the queue is "high" (0 = off).
+    size_t low_messages;      // Count at/below which a high queue has drained.
+    size_t high_bytes;        // Payload bytes at/above which the queue is "high" (0 = off).
+    size_t low_bytes;         // Payload bytes at/below which a high queue has drained.
 } MessageQueue;
 
 /**
  * @brief Initializes a message queue.
  * @param queue A pointer to the MessageQueue to initialize.
+ * @param capacity Ring capacity, rounded up to a power of two. 0 selects the
+ *        unbounded linked-list fallback.
+ * @return 0 on success, -1 if the ring storage could not be allocated.
  */
-void message_queue_init(MessageQueue *queue);
+int message_queue_init(MessageQueue *queue, size_t capacity);
 
 /**
  * @brief Pushes a new message onto the tail of the queue.
+ *
+ * Never blocks. Must only be called from the single producer thread.
  * @param queue A pointer to the MessageQueue.
  * @param message The Kafka message to add.
+ * @return 0 on success, -1 if the ring is full (the message is not taken).
+ */
+int message_queue_push(MessageQueue *queue, rd_kafka_message_t *message);
+
+/**
+ * @brief Pushes up to `count` messages onto the tail of the queue at once.
+ *
+ * The ring publishes the whole batch with a single index store; the linked
+ * list builds the chain outside the lock and splices it in one step.
+ * Must only be called from the single producer thread.
+ * @param queue A pointer to the MessageQueue.
+ * @param messages The messages to add, in order.
+ * @param notes Decode results to keep with each message, or NULL. Only
+ *        stored if the queue tracks notes.
+ * @param count Number of entries in `messages`.
+ * @return The number of leading messages that were taken, with their
+ *         notes; the rest remain owned by the caller.
  */
-void message_queue_push(MessageQueue *queue, rd_kafka_message_t *message);
+size_t message_queue_push_batch(MessageQueue *queue, rd_kafka_message_t **messages, void **notes,
+                                size_t count);
 
 /**
  * @brief Pops a message from the head of the queue.
  *
  * If the queue is empty, this function will block until a message is available.
+ * Its note, if any, is released.
  * @param queue A pointer to the MessageQueue.
  * @return The Kafka message from the front of the queue.
  */
 rd_kafka_message_t *message_queue_pop(MessageQueue *queue);
 
+/**
+ * @brief Pops a message from the head of the queue without blocking.
+ *
+ * Its note, if any, is released.
+ * @param queue A pointer to the MessageQueue.
+ * @return The Kafka message from the front of the queue, or NULL if empty.
+ */
+rd_kafka_message_t *message_queue_try_pop(MessageQueue *queue);
+
+/**
+ * @brief Pops up to `max_count` messages from the head of the queue at once.
+ *
+ * Never blocks. The ring consumes them with a single index store; the list
+ * detaches them under one lock acquisition.
+ * @param queue A pointer to the MessageQueue.
+ * @param out Array receiving the messages, in order.
+ * @param notes Array receiving each message's note (NULL if it has none),
+ *        or NULL to release the notes.
+ * @param max_count Capacity of `out` and `notes`.
+ * @return The number of messages stored in `out`.
+ */
+size_t message_queue_pop_batch(MessageQueue *queue, rd_kafka_message_t **out, void **notes,
+                               size_t max_count);
+
+/**
+ * @brief Predicate selecting the messages message_queue_purge() removes.
+ * @param message A queued message.
+ * @param arg The caller's context.
+ * @return Non-zero to remove `message`.
+ */
+typedef int (*MessageMatch)(const rd_kafka_message_t *message, void *arg);
+
+/**
+ * @brief Destroys every queued message `match` selects, keeping the order of
+ * the rest.
+ *
+ * Must only be called from the single producer thread. Consumers are held
+ * off for the duration of the scan. Messages behind a fence are removed
+ * as well.
+ * @param queue A pointer to the MessageQueue.
+ * @param match The predicate.
+ * @param arg Passed to `match`.
+ * @return The number of messages removed.
+ */
+size_t message_queue_purge(MessageQueue *queue, MessageMatch match, void *arg);
+
+/**
+ * @brief Drops one partition's queued messages lazily.
+ *
+ * Every message of `topic`/`partition` queued so far is destroyed by the
+ * pop that reaches it, instead of being returned; messages pushed from now
+ * on are kept. Costs O(1) here, and the pops skip the stale messages at
+ * the price of one comparison per fence while they are still queued.
+ * Must only be called from the single producer thread.
+ * @param queue A pointer to the MessageQueue.
+ * @param topic Topic name.
+ * @param partition Partition number.
+ * @return 0 on success, -1 on allocation failure (nothing is dropped).
+ */
+int message_queue_fence(MessageQueue *queue, const char *topic, int32_t partition);
+
+/**
+ * @brief Blocks the producer until the ring has a free slot.
+ * @param queue A pointer to the MessageQueue.
+ * @param timeout_ms Maximum time to wait.
+ * @return 1 if there is room, 0 on timeout.
+ */
+int message_queue_wait_not_full(MessageQueue *queue, int timeout_ms);
+
+/**
+ * @brief Attaches a Wakeup to be signalled when the queue becomes non-empty.
+ *
+ * Must be called before the producer starts. The queue starts armed.
+ * @param queue A pointer to the MessageQueue.
+ * @param wakeup The Wakeup to signal, or NULL to detach.
+ */
+void message_queue_set_wakeup(MessageQueue *queue, Wakeup *wakeup);
+
+/**
+ * @brief Records how long messages wait in the queue.
+ *
+ * Every push is stamped, and every pop records the time the oldest popped
+ * message spent in the queue into `dwell`. Must be called before the
+ * producer starts.
+ * @param queue A pointer to the MessageQueue.
+ * @param dwell The histogram to record into, in nanoseconds.
+ * @return 0 on success, -1 if the ring's stamp array could not be allocated.
+ */
+int message_queue_track_dwell(MessageQueue *queue, struct Histogram *dwell);
+
+/**
+ * @brief Keeps a decode result ("note") with every pushed message.
+ *
+ * Notes pushed with message_queue_push_batch() come out of
+ * message_queue_pop_batch() next to their messages; those of messages the
+ * queue destroys itself are freed with decoder_release(). Must be called
+ * before the producer starts.
+ * @param queue A pointer to the MessageQueue.
+ * @param decoder The decoder the notes come from.
+ * @return 0 on success, -1 if the ring's note array could not be allocated.
+ */
+int message_queue_track_notes(MessageQueue *queue, const struct Decoder *decoder);
+
+/**
+ * @brief Arms the queue's Wakeup after the consumer found the queue empty.
+ *
+ * The next push will signal the Wakeup. Returns whether the queue is still
+ * empty after arming; if not, a message raced in and the consumer should
+ * pop again instead of waiting on the fd.
+ * @param queue A pointer to the MessageQueue.
+ * @return 1 if the queue is empty and the caller may wait, 0 otherwise.
+ */
+int message_queue_arm(MessageQueue *queue);
+
+/**
+ * @brief Sets the backpressure watermarks.
+ *
+ * A high mark of 0 disables that dimension. Low marks should be below their
+ * high marks so pause/resume has hysteresis.
+ * @param queue A pointer to the MessageQueue.
+ * @param high_messages Message count that makes the queue "high".
+ * @param low_messages Message count the queue must drain to.
+ * @param high_bytes Payload bytes that make the queue "high".
+ * @param low_bytes Payload bytes the queue must drain to.
+ */
+void message_queue_set_watermarks(MessageQueue *queue, size_t high_messages, size_t low_messages,
+                                  size_t high_bytes, size_t low_bytes);
+
+/**
+ * @brief Returns 1 if either enabled high watermark has been reached.
+ * @param queue A pointer to the MessageQueue.
+ */
+int message_queue_above_high(MessageQueue *queue);
+
+/**
+ * @brief Returns 1 if every enabled dimension is at or below its low mark.
+ * @param queue A pointer to the MessageQueue.
+ */
+int message_queue_below_low(MessageQueue *queue);
+
+/**
+ * @brief Blocks the producer until the queue drains to its low watermarks.
+ * @param queue A pointer to the MessageQueue.
+ * @param timeout_ms Maximum time to wait.
+ * @return 1 if the queue is below its low marks, 0 on timeout.
+ */
+int message_queue_wait_below_low(MessageQueue *queue, int timeout_ms);
+
+/**
+ * @brief Returns the total payload bytes currently queued.
+ * @param queue A pointer to the MessageQueue.
+ */
+size_t message_queue_bytes(MessageQueue *queue);
+
+/**
+ * @brief Reports the usage of the queue's node pool.
+ * @param queue A pointer to the MessageQueue.
+ * @param stats Receives the snapshot.
+ */
+void message_queue_pool_stats(MessageQueue *queue, NodePoolStats *stats);
+
+/**
+ * @brief Returns the number of messages currently queued.
+ *
+ * The value is a snapshot and may be stale by the time it is used.
+ * @param queue A pointer to the MessageQueue.
+ */
+size_t message_queue_size(MessageQueue *queue);
+
+/**
+ * @brief Returns how many messages have left the queue since it was created.
+ *
+ * Only the producer thread may call it.
+ * @param queue A pointer to the MessageQueue.
+ */
+size_t message_queue_drained(MessageQueue *queue);
+
 /**
  * @brief Destroys a message queue, freeing all associated resources.
  * @param queue A pointer to the MessageQueue to destroy.
@@ -0,0 +1,166 @@
+#include "wakeup.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#ifndef __linux__
+/**
+ * @brief Marks a descriptor non-blocking and close-on-exec.
+ */
+static int set_nonblock_cloexec(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+    flags = fcntl(fd, F_GETFD);
+    if (flags < 0 || fcntl(fd, F_SETFD, flags | FD_CLOEXEC) < 0) {
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+/**
+ * @brief Initializes a Wakeup.
+ *
+ * On Linux a single non-blocking eventfd is used for both ends. Other
+ * platforms get a non-blocking pipe.
+ *
+ * @param wakeup A pointer to the Wakeup to initialize.
+ * @return 0 on success, -1 on failure.
+ */
+int wakeup_init(Wakeup *wakeup) {
+    wakeup->read_fd = -1;
+    wakeup->write_fd = -1;
+    wakeup->borrowed = 0;
+#ifdef __linux__
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    wakeup->read_fd = fd;
+    wakeup->write_fd = fd;
+    return 0;
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    if (set_nonblock_cloexec(fds[0]) != 0 || set_nonblock_cloexec(fds[1]) != 0) {
+        int saved = errno;
+        close(fds[0]);
+        close(fds[1]);
+        errno = saved;
+        return -1;
+    }
+    wakeup->read_fd = fds[0];
+    wakeup->write_fd = fds[1];
+    return 0;
+#endif
+}
+
+/**
+ * @brief Borrows another Wakeup's descriptors.
+ *
+ * @param wakeup A pointer to the Wakeup to initialize.
+ * @param owner The Wakeup whose descriptors are signalled.
+ */
+void wakeup_share(Wakeup *wakeup, const Wakeup *owner) {
+    wakeup->read_fd = owner->read_fd;
+    wakeup->write_fd = owner->write_fd;
+    wakeup->borrowed = 1;
+}
+
+/**
+ * @brief Signals the Wakeup.
+ *
+ * A full pipe or a saturated eventfd already means "readable", so EAGAIN is
+ * not an error here.
+ *
+ * @param wakeup A pointer to the Wakeup.
+ */
+void wakeup_signal(Wakeup *wakeup) {
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t rc;
+    do {
+        rc = write(wakeup->write_fd, &one, sizeof(one));
+    } while (rc < 0 && errno == EINTR);
+#else
+    char byte = 1;
+    ssize_t rc;
+    do {
+        rc = write(wakeup->write_fd, &byte, 1);
+    } while (rc < 0 && errno == EINTR);
+#endif
+}
+
+/**
+ * @brief Drains all pending signals from the Wakeup.
+ *
+ * @param wakeup A pointer to the Wakeup.
+ */
+void wakeup_drain(Wakeup *wakeup) {
+    if (wakeup->borrowed) {
+        return;
+    }
+#ifdef __linux__
+    uint64_t value;
+    ssize_t rc;
+    do {
+        rc = read(wakeup->read_fd, &value, sizeof(value));
+    } while (rc < 0 && errno == EINTR);
+#else
+    char buf[64];
+    ssize_t rc;
+    do {
+        rc = read(wakeup->read_fd, buf, sizeof(buf));
+    } while (rc > 0 || (rc < 0 && errno == EINTR));
+#endif
+}
+
+/**
+ * @brief Waits for the Wakeup to become readable.
+ *
+ * Interrupted waits are retried with the full timeout; callers only use
+ * this to bound idle time, so the slack does not matter.
+ *
+ * @param wakeup A pointer to the Wakeup.
+ * @param timeout_ms Maximum time to wait, or -1 to wait indefinitely.
+ * @return 1 if signalled, 0 on timeout.
+ */
+int wakeup_wait(Wakeup *wakeup, int timeout_ms) {
+    struct pollfd pfd = {.fd = wakeup->read_fd, .events = POLLIN};
+    int rc;
+    do {
+        rc = poll(&pfd, 1, timeout_ms);
+    } while (rc < 0 && errno == EINTR);
+    return rc > 0;
+}
+
+/**
+ * @brief Closes the Wakeup's descriptors, unless they are borrowed.
+ *
+ * @param wakeup A pointer to the Wakeup to destroy.
+ */
+void wakeup_destroy(Wakeup *wakeup) {
+    if (wakeup->borrowed) {
+        wakeup->read_fd = -1;
+        wakeup->write_fd = -1;
+        return;
+    }
+    if (wakeup->read_fd >= 0) {
+        close(wakeup->read_fd);
+    }
+    if (wakeup->write_fd >= 0 && wakeup->write_fd != wakeup->read_fd) {
+        close(wakeup->write_fd);
+    }
+    wakeup->read_fd = -1;
+    wakeup->write_fd = -1;
+}
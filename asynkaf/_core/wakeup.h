@@ -0,0 +1,69 @@
+#ifndef ASYNKAF_WAKEUP_H
+#define ASYNKAF_WAKEUP_H
+
+/**
+ * @brief A readable file descriptor that a background thread can signal.
+ *
+ * Backed by an eventfd on Linux, where `read_fd` and `write_fd` are the same
+ * descriptor, and by a non-blocking pipe elsewhere. Python registers
+ * `read_fd` with `loop.add_reader()` so the event loop is woken without ever
+ * blocking on a condition variable.
+ *
+ * A Wakeup may also borrow another one's descriptors (wakeup_share()), so
+ * that many queues signal one fd. Only the owner drains a shared fd: a
+ * borrower draining it could swallow a signal meant for a sibling.
+ */
+typedef struct {
+    int read_fd;  // Descriptor that becomes readable when signalled.
+    int write_fd; // Descriptor the signalling thread writes to.
+    int borrowed; // Whether the descriptors belong to another Wakeup.
+} Wakeup;
+
+/**
+ * @brief Creates the underlying eventfd or pipe.
+ * @param wakeup A pointer to the Wakeup to initialize.
+ * @return 0 on success, -1 on failure with `errno` set.
+ */
+int wakeup_init(Wakeup *wakeup);
+
+/**
+ * @brief Makes `wakeup` signal the descriptors of `owner`.
+ *
+ * wakeup_drain() and wakeup_destroy() leave the descriptors alone, so
+ * `owner` must outlive `wakeup` and is the one to drain them.
+ * @param wakeup A pointer to the Wakeup to initialize.
+ * @param owner The Wakeup whose descriptors are signalled.
+ */
+void wakeup_share(Wakeup *wakeup, const Wakeup *owner);
+
+/**
+ * @brief Makes `read_fd` readable. Safe to call from any thread.
+ * @param wakeup A pointer to the Wakeup.
+ */
+void wakeup_signal(Wakeup *wakeup);
+
+/**
+ * @brief Consumes any pending signals so `read_fd` stops being readable.
+ *
+ * Does nothing for a borrowed Wakeup.
+ * @param wakeup A pointer to the Wakeup.
+ */
+void wakeup_drain(Wakeup *wakeup);
+
+/**
+ * @brief Blocks until the Wakeup is signalled or the timeout passes.
+ *
+ * Does not consume the signal; call wakeup_drain() afterwards.
+ * @param wakeup A pointer to the Wakeup.
+ * @param timeout_ms Maximum time to wait, or -1 to wait indefinitely.
+ * @return 1 if signalled, 0 on timeout.
+ */
+int wakeup_wait(Wakeup *wakeup, int timeout_ms);
+
+/**
+ * @brief Closes the underlying descriptors.
+ * @param wakeup A pointer to the Wakeup to destroy.
+ */
+void wakeup_destroy(Wakeup *wakeup);
+
+#endif
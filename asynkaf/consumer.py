@@ -1,6 +1,510 @@
+import asyncio
+import collections
+import weakref
+from typing import Optional
+
 from . import _core
 
 
 class Consumer:
-    def __init__(self, bootstrap_servers: str, group_id: str):
-        self._consumer = _core.create_consumer(bootstrap_servers, group_id)
\ No newline at end of file
+    def __init__(self, bootstrap_servers: str, group_id: Optional[str] = None, **options):
+        self._consumer = _core.create_consumer(bootstrap_servers, group_id, **options)
+        self._poller = options.get("poller")
+        self._loop = None
+        self._on_assign = None
+        self._on_revoke = None
+        self._consumer.waiter = _next_message_waiter(self)
+
+    def _attach(self) -> asyncio.AbstractEventLoop:
+        """Register the commit-result and rebalance fd with the running loop once.
+
+        On a shared poller the consumer joins the loop's reactor for that
+        poller instead, which watches the one fd all its consumers signal.
+        """
+        loop = asyncio.get_running_loop()
+        if self._loop is not loop:
+            self._detach()
+            if self._poller is not None:
+                _Reactor.get(self._poller, loop).add(self)
+            else:
+                loop.add_reader(self._consumer.events_fileno(), self._consumer.deliver_events)
+            self._loop = loop
+        return loop
+
+    def _detach(self) -> None:
+        if self._loop is not None and not self._loop.is_closed():
+            if self._poller is not None:
+                _Reactor.get(self._poller, self._loop).remove(self)
+            else:
+                self._loop.remove_reader(self._consumer.events_fileno())
+        self._loop = None
+
+    async def _wait(self, loop: asyncio.AbstractEventLoop, timeout: Optional[float]) -> None:
+        if self._poller is not None:
+            await _Reactor.get(self._poller, loop).wait(timeout)
+        else:
+            await _wait_readable(loop, self._consumer.fileno(), timeout)
+
+    def fileno(self) -> int:
+        """Return the fd that becomes readable when messages are buffered."""
+        return self._consumer.fileno()
+
+    def subscribe(self, topics, on_assign=None, on_revoke=None) -> None:
+        """Join the group and consume ``topics``.
+
+        Rebalances use ``cooperative-sticky`` assignment unless
+        ``partition.assignment.strategy`` is overridden in ``config``, so
+        only the partitions that move are paused. Offsets stored for revoked
+        partitions are committed and their buffered messages discarded
+        before the partitions are released. ``on_assign`` and ``on_revoke``
+        are called on the event loop with the list of ``(topic, partition)``
+        pairs that changed, once the change has been applied.
+        """
+        self._on_assign = on_assign
+        self._on_revoke = on_revoke
+        listener = _rebalance_listener(self) if on_assign or on_revoke else None
+        self._consumer.subscribe(list(topics), listener)
+        try:
+            self._attach()
+        except RuntimeError:
+            # No running loop yet; getmany() attaches on first use.
+            pass
+
+    async def assign(self, partitions) -> None:
+        """Consume exactly ``partitions``, replacing the current assignment.
+
+        Takes ``(topic, partition)`` pairs, or ``(topic, partition,
+        offset)`` to start somewhere other than the committed offset. Needs
+        no ``group_id`` and no :meth:`subscribe`. Messages buffered for the
+        previous assignment are discarded.
+        """
+        loop = self._attach()
+        future = loop.create_future()
+        self._consumer.assign([tuple(p) for p in partitions], future)
+        await future
+
+    async def seek(self, topic: str, partition: int, offset: int) -> None:
+        """Continue ``partition`` of ``topic`` from ``offset``.
+
+        Once this returns, :meth:`getmany` no longer yields anything the
+        consumer had buffered for the partition before the seek; its next
+        message is the one at ``offset``. Raises :class:`_core.KafkaError`
+        if the seek failed.
+        """
+        await self.seek_many({(topic, partition): offset})
+
+    async def seek_many(self, offsets: dict) -> None:
+        """Seek several partitions at once; ``offsets`` maps ``(topic, partition)`` to an offset."""
+        loop = self._attach()
+        future = loop.create_future()
+        self._consumer.seek([(topic, partition, offset) for (topic, partition), offset in offsets.items()],
+                            future)
+        await future
+
+    async def offsets_for_times(self, timestamps: dict, timeout_ms: int = 10000) -> dict:
+        """Map ``(topic, partition)`` to the first offset at or after a timestamp in ms.
+
+        The offset is -1 where the partition has no message that recent.
+        The lookup asks the brokers from an executor thread; pass the result
+        to :meth:`seek_many` to rewind the partitions to those times.
+        """
+        lookup = [(topic, partition, ts) for (topic, partition), ts in timestamps.items()]
+        found = await asyncio.to_thread(self._consumer.offsets_for_times, lookup, timeout_ms)
+        return {(topic, partition): offset for topic, partition, offset in found}
+
+    def _on_rebalance(self, assigned: bool, partitions: list) -> None:
+        callback = self._on_assign if assigned else self._on_revoke
+        if callback is not None:
+            callback(partitions)
+
+    async def getmany(self, max_records: int = 500, timeout_ms: int = 0) -> list:
+        """Return up to ``max_records`` buffered :class:`_core.Message` objects.
+
+        Waits up to ``timeout_ms`` for the first record to arrive, without
+        blocking the event loop. Returns an empty list on timeout, or early
+        when consumer errors are pending so they can be read with
+        :meth:`errors`.
+        """
+        if not self._consumer.closed:
+            self._attach()
+        return await _getmany(self._consumer, max_records, timeout_ms, self._has_errors,
+                              wait=self._wait)
+
+    async def getmany_columnar(self, max_records: int = 500, timeout_ms: int = 0) -> "_core.ColumnarBatch":
+        """Like :meth:`getmany`, but return the records as one :class:`_core.ColumnarBatch`.
+
+        Payloads and keys are concatenated into single buffers with int64
+        boundary arrays, as Arrow's ``large_binary`` lays them out; offsets,
+        partitions and timestamps are int64 arrays and topics are dictionary
+        encoded. Every column supports the buffer protocol, so for example::
+
+            batch = await consumer.getmany_columnar(10_000)
+            offsets = numpy.frombuffer(batch.offsets, dtype=numpy.int64)
+            values = pyarrow.Array.from_buffers(
+                pyarrow.large_binary(), len(batch),
+                [None if batch.value_validity is None else pyarrow.py_buffer(batch.value_validity),
+                 pyarrow.py_buffer(batch.value_offsets), pyarrow.py_buffer(batch.values)])
+
+        A batch costs about a dozen allocations regardless of its size. Pass
+        it to :meth:`store_offsets` once processed.
+        """
+        if not self._consumer.closed:
+            self._attach()
+        return await _getmany(self._consumer, max_records, timeout_ms, self._has_errors,
+                              self._consumer.getmany_columnar, wait=self._wait)
+
+    def __aiter__(self) -> "_core.Consumer":
+        """Iterate the messages with ``async for``, until the consumer is closed and drained.
+
+        The native consumer is its own async iterator: while messages are
+        buffered, each step returns an already completed awaitable, so the
+        loop body runs again without an asyncio Future or a pass through
+        the event loop. Only an empty queue makes it wait for
+        :meth:`fileno`. Consumer errors are not raised here; read them
+        with :meth:`errors`.
+        """
+        try:
+            self._attach()
+        except RuntimeError:
+            # No running loop yet; the first wait attaches.
+            pass
+        return self._consumer
+
+    async def _next_message(self):
+        """Wait for the next message; called by the native ``__anext__`` when none is buffered."""
+        while True:
+            closed = self._consumer.closed
+            message = self._consumer.getone()
+            if message is not None:
+                return message
+            if closed:
+                # The poller pushes its last messages before it marks the
+                # consumer closed, so this drain saw them all.
+                raise StopAsyncIteration
+            # Closing signals the fd, so this cannot miss the end.
+            await self._wait(self._attach(), None)
+
+    def _has_errors(self) -> bool:
+        return self._consumer.pending_errors > 0
+
+    def errors(self) -> list:
+        """Return the pending consumer errors as :class:`_core.KafkaError` objects.
+
+        Errored messages such as partition EOF (with
+        ``enable.partition.eof``), transport failures and offsets out of
+        range never reach :meth:`getmany`; they are collected here in
+        arrival order, each with ``topic``, ``partition`` and ``offset``
+        attributes. Group failures the consumer could not recover from on
+        its own, such as failing to drop the assignment after a rebalance
+        error, come through here too, with just ``code`` and ``name``.
+        :meth:`fileno` also becomes readable for them.
+        """
+        return self._consumer.errors()
+
+    def store_offset(self, message) -> None:
+        """Mark ``message`` as processed; it is committed by the next flush."""
+        self._consumer.store_offset(message)
+
+    def store_offsets(self, messages) -> None:
+        """Mark a batch of messages, e.g. a :meth:`getmany` or :meth:`getmany_columnar` result, as processed."""
+        self._consumer.store_offsets(messages)
+
+    async def commit(self) -> None:
+        """Commit every stored offset and wait for the broker's answer.
+
+        Concurrent calls are coalesced into one asynchronous commit request;
+        stored offsets are also flushed in the background on the
+        ``commit_interval_ms`` timer and every ``commit_every`` stores.
+        Raises :class:`_core.KafkaError` if the commit failed.
+        """
+        loop = self._attach()
+        future = loop.create_future()
+        self._consumer.commit(future)
+        await future
+
+    def metrics(self) -> dict:
+        """Return a snapshot of the consumer's pipeline metrics.
+
+        Includes message, byte and error totals and per-second rates, the
+        current queue depth, HDR-style histogram summaries (``count``,
+        ``sum``, ``max`` and ``p50``..``p999``) of poll latency, queue dwell
+        time and queue depth, and, once ``statistics.interval.ms`` is set in
+        ``config``, librdkafka's parsed statistics and the per-partition
+        consumer ``lag``. Cheap enough to call on every scrape.
+        """
+        return self._consumer.metrics()
+
+    def partition(self, topic: str, partition: int) -> "PartitionConsumer":
+        """Return an ordered async iterator over one partition's messages.
+
+        Requires ``partition_queues=True``. The partition gets its own queue
+        and wakeup fd, so each partition can be processed by its own task
+        (or thread) without going through :meth:`getmany`.
+        """
+        return PartitionConsumer(self._consumer, self._consumer.partition(topic, partition))
+
+    async def close(self) -> None:
+        """Leave the group and close the consumer without blocking the loop.
+
+        The close itself runs on the consumer's poller thread; this only
+        waits for it from an executor thread. Offsets stored since the last
+        flush are committed first. Buffered records can still be drained
+        with :meth:`getmany` afterwards.
+        """
+        await asyncio.to_thread(self._consumer.close)
+        self._consumer.deliver_events()
+        self._detach()
+
+    @property
+    def closed(self) -> bool:
+        return self._consumer.closed
+
+
+class PartitionConsumer:
+    """Messages of a single partition, in offset order.
+
+    Iterate with ``async for`` from one task; the iteration ends once the
+    consumer is closed and the partition's queue is drained.
+    """
+
+    def __init__(self, consumer, queue, batch_size: int = 500):
+        self._consumer = consumer
+        self._queue = queue
+        self._batch_size = batch_size
+        self._buffer = collections.deque()
+
+    @property
+    def topic(self) -> str:
+        return self._queue.topic
+
+    @property
+    def partition(self) -> int:
+        return self._queue.partition
+
+    def fileno(self) -> int:
+        """Return the fd that becomes readable when messages are buffered."""
+        return self._queue.fileno()
+
+    async def getmany(self, max_records: int = 500, timeout_ms: int = 0) -> list:
+        """Return up to ``max_records`` buffered messages of this partition."""
+        if self._buffer:
+            count = min(max_records, len(self._buffer))
+            return [self._buffer.popleft() for _ in range(count)]
+        return await _getmany(self._queue, max_records, timeout_ms)
+
+    async def getmany_columnar(self, max_records: int = 500, timeout_ms: int = 0) -> "_core.ColumnarBatch":
+        """Return up to ``max_records`` buffered messages of this partition as columns.
+
+        Records already buffered by ``async for`` are not included.
+        """
+        return await _getmany(self._queue, max_records, timeout_ms, drain=self._queue.getmany_columnar)
+
+    def __aiter__(self) -> "PartitionConsumer":
+        return self
+
+    async def __anext__(self):
+        if not self._buffer:
+            loop = asyncio.get_running_loop()
+            while True:
+                records = self._queue.getmany(self._batch_size)
+                if not records and self._consumer.closed:
+                    # The poller pushes its last messages before it marks
+                    # the consumer closed, so one more drain sees them all.
+                    records = self._queue.getmany(self._batch_size)
+                    if not records:
+                        raise StopAsyncIteration
+                if records:
+                    self._buffer.extend(records)
+                    break
+                # Closing signals the fd, so this cannot miss the end.
+                await _wait_readable(loop, self._queue.fileno(), None)
+        return self._buffer.popleft()
+
+
+async def _getmany(source, max_records: int, timeout_ms: int, interrupted=None, drain=None, wait=None):
+    """Drain ``source``, waiting up to ``timeout_ms`` for the first record.
+
+    ``interrupted``, if given, is checked whenever the wait would start and
+    ends it early when it returns true. ``drain`` replaces
+    ``source.getmany``; its result must be falsy when empty. ``wait(loop,
+    timeout)`` replaces waiting for ``source.fileno()`` to become readable.
+    """
+    if drain is None:
+        drain = source.getmany
+    records = drain(max_records)
+    if records or timeout_ms <= 0:
+        return records
+
+    loop = asyncio.get_running_loop()
+    deadline = loop.time() + timeout_ms / 1000
+    while not records:
+        if interrupted is not None and interrupted():
+            break
+        remaining = deadline - loop.time()
+        if remaining <= 0:
+            break
+        if wait is not None:
+            await wait(loop, remaining)
+        else:
+            await _wait_readable(loop, source.fileno(), remaining)
+        records = drain(max_records)
+    return records
+
+
+def _next_message_waiter(consumer: Consumer):
+    """Return ``consumer._next_message`` without the native consumer keeping ``consumer`` alive."""
+    ref = weakref.ref(consumer)
+
+    async def waiter():
+        consumer = ref()
+        if consumer is None:
+            raise StopAsyncIteration
+        return await consumer._next_message()
+
+    return waiter
+
+
+def _rebalance_listener(consumer: Consumer):
+    """Return ``consumer._on_rebalance`` without the native consumer keeping ``consumer`` alive."""
+    ref = weakref.ref(consumer)
+
+    def listener(assigned: bool, partitions: list) -> None:
+        consumer = ref()
+        if consumer is not None:
+            consumer._on_rebalance(assigned, partitions)
+
+    return listener
+
+
+class _Reactor:
+    """Serves every consumer of one shared :class:`Poller` on one event loop.
+
+    The consumers all signal the poller's fd, so it is registered with the
+    loop once. When it becomes readable the reactor clears it, delivers each
+    consumer's commit and rebalance results and wakes every pending wait,
+    which then re-checks its own queue. Consumers are held weakly; the
+    reactor goes away with its last consumer and last wait.
+    """
+
+    _reactors = weakref.WeakKeyDictionary()  # loop -> {poller fd: _Reactor}
+
+    @classmethod
+    def get(cls, poller, loop: asyncio.AbstractEventLoop) -> "_Reactor":
+        reactors = cls._reactors.setdefault(loop, {})
+        reactor = reactors.get(poller.fileno())
+        if reactor is None:
+            reactor = reactors[poller.fileno()] = cls(poller, loop)
+        return reactor
+
+    def __init__(self, poller, loop: asyncio.AbstractEventLoop):
+        self._poller = poller
+        self._loop = loop
+        self._consumers = weakref.WeakSet()
+        self._waiters = set()
+        loop.add_reader(poller.fileno(), self._on_readable)
+
+    def add(self, consumer: "Consumer") -> None:
+        self._consumers.add(consumer)
+
+    def remove(self, consumer: "Consumer") -> None:
+        self._consumers.discard(consumer)
+        self._release()
+
+    async def wait(self, timeout: Optional[float]) -> None:
+        """Wait until any consumer of the poller may have something, or ``timeout`` seconds pass."""
+        waiter = self._loop.create_future()
+        self._waiters.add(waiter)
+        try:
+            await asyncio.wait_for(waiter, timeout)
+        except asyncio.TimeoutError:
+            pass
+        finally:
+            self._waiters.discard(waiter)
+            self._release()
+
+    def _on_readable(self) -> None:
+        # Clear the fd first: anything arriving while the consumers are
+        # checked signals it again.
+        self._poller.drain()
+        for consumer in list(self._consumers):
+            consumer._consumer.deliver_events()
+        for waiter in self._waiters:
+            if not waiter.done():
+                waiter.set_result(None)
+
+    def _release(self) -> None:
+        if self._consumers or self._waiters:
+            return
+        fd = self._poller.fileno()
+        reactors = self._reactors.get(self._loop)
+        if reactors is not None and reactors.get(fd) is self:
+            del reactors[fd]
+            if not self._loop.is_closed():
+                self._loop.remove_reader(fd)
+
+
+class _Readable:
+    """Wakes every task waiting for one fd to become readable.
+
+    A loop keeps a single reader callback per fd, so waiters that each
+    registered their own would replace one another, and the first to
+    finish would unregister the rest. The fd is registered once for all
+    pending waits instead, and unregistered when it fires, since nobody
+    may drain it before the woken tasks run, or when the last wait ends.
+    """
+
+    _readables = weakref.WeakKeyDictionary()  # loop -> {fd: _Readable}
+
+    @classmethod
+    def get(cls, loop: asyncio.AbstractEventLoop, fd: int) -> "_Readable":
+        readables = cls._readables.setdefault(loop, {})
+        readable = readables.get(fd)
+        if readable is None:
+            readable = readables[fd] = cls(loop, fd)
+        return readable
+
+    def __init__(self, loop: asyncio.AbstractEventLoop, fd: int):
+        self._loop = loop
+        self._fd = fd
+        self._waiters = set()
+        self._reading = False
+
+    async def wait(self, timeout: Optional[float]) -> None:
+        """Wait until the fd is readable or ``timeout`` seconds pass."""
+        waiter = self._loop.create_future()
+        self._waiters.add(waiter)
+        if not self._reading:
+            self._loop.add_reader(self._fd, self._on_readable)
+            self._reading = True
+        try:
+            await asyncio.wait_for(waiter, timeout)
+        except asyncio.TimeoutError:
+            pass
+        finally:
+            self._waiters.discard(waiter)
+            if not self._waiters:
+                self._stop()
+
+    def _on_readable(self) -> None:
+        self._stop()
+        for waiter in self._waiters:
+            if not waiter.done():
+                waiter.set_result(None)
+
+    def _stop(self) -> None:
+        if self._reading:
+            self._reading = False
+            if not self._loop.is_closed():
+                self._loop.remove_reader(self._fd)
+        if not self._waiters:
+            readables = self._readables.get(self._loop)
+            if readables is not None and readables.get(self._fd) is self:
+                del readables[self._fd]
+
+
+async def _wait_readable(loop: asyncio.AbstractEventLoop, fd: int, timeout: Optional[float]) -> None:
+    """Wait until ``fd`` is readable or ``timeout`` seconds pass.
+
+    Any number of tasks may wait for the same fd at once.
+    """
+    await _Readable.get(loop, fd).wait(timeout)
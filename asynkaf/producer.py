@@ -0,0 +1,131 @@
+import asyncio
+import contextlib
+
+from . import _core
+
+# How long send() backs off when librdkafka's local queue is full.
+_QUEUE_FULL_BACKOFF = 0.005
+
+
+class Producer:
+    def __init__(self, bootstrap_servers: str, **options):
+        self._producer = _core.create_producer(bootstrap_servers, **options)
+        self._loop = None
+
+    def _attach(self) -> asyncio.AbstractEventLoop:
+        """Register the delivery-report fd with the running loop once."""
+        loop = asyncio.get_running_loop()
+        if self._loop is not loop:
+            fd = self._producer.fileno()
+            if self._loop is not None and not self._loop.is_closed():
+                self._loop.remove_reader(fd)
+            loop.add_reader(fd, self._producer.deliver)
+            self._loop = loop
+        return loop
+
+    async def send(self, topic: str, value, key=None, partition: int = -1) -> asyncio.Future:
+        """Enqueue a message and return a future for its delivery.
+
+        ``value`` may be any contiguous buffer (bytes, bytearray, memoryview,
+        numpy array). It is sent without copying, so mutable buffers must
+        not be changed until the future completes. The future resolves to ``(partition, offset)`` or raises
+        :class:`_core.KafkaError`. Delivery reports are resolved in batches
+        when the producer's fd becomes readable.
+        """
+        loop = self._attach()
+        future = loop.create_future()
+        while True:
+            try:
+                self._producer.produce(topic, value, key, partition, future)
+                return future
+            except BufferError:
+                await asyncio.sleep(_QUEUE_FULL_BACKOFF)
+
+    async def send_and_wait(self, topic: str, value, key=None, partition: int = -1):
+        """Send a message and wait for its delivery report."""
+        return await (await self.send(topic, value, key, partition))
+
+    async def flush(self, timeout_ms: int = -1) -> int:
+        """Wait off the event loop for outstanding messages to be delivered.
+
+        Returns the number of messages still in flight.
+        """
+        remaining = await asyncio.to_thread(self._producer.flush, timeout_ms)
+        self._producer.deliver()
+        return remaining
+
+    async def init_transactions(self, consumer=None, timeout_ms: int = -1) -> None:
+        """Prepare a producer created with ``transactional_id`` for transactions.
+
+        With a :class:`~asynkaf.consumer.Consumer` (one with a
+        ``group_id``), every :meth:`commit_transaction` also commits the
+        offsets stored on it since the previous one, atomically with the
+        transaction's messages, and the consumer stops committing on its
+        own. Store offsets with ``consumer.store_offsets(records)`` as
+        records are processed.
+        """
+        native = getattr(consumer, "_consumer", consumer)
+        await asyncio.to_thread(self._producer.init_transactions, timeout_ms, native)
+
+    def begin_transaction(self) -> None:
+        """Start a transaction; this never waits on the network."""
+        self._producer.begin_transaction()
+
+    async def commit_transaction(self, timeout_ms: int = -1) -> None:
+        """Commit the transaction from an executor thread.
+
+        Sends the bound consumer's stored offsets, waits for the
+        transaction's messages and commits, whatever the number of messages.
+        Raises :class:`_core.KafkaError`; when its ``txn_requires_abort`` is
+        set, call :meth:`abort_transaction`, and when ``retriable`` is set
+        this may be retried.
+        """
+        try:
+            await asyncio.to_thread(self._producer.commit_transaction, timeout_ms)
+        finally:
+            self._producer.deliver()
+
+    async def abort_transaction(self, timeout_ms: int = -1) -> None:
+        """Abort the transaction from an executor thread.
+
+        The bound consumer forgets the offsets the transaction carried; seek
+        it back to its committed offsets to process those records again.
+        """
+        try:
+            await asyncio.to_thread(self._producer.abort_transaction, timeout_ms)
+        finally:
+            self._producer.deliver()
+
+    @contextlib.asynccontextmanager
+    async def transaction(self):
+        """Run the body in one transaction, for example a whole ``getmany()`` batch::
+
+            async with producer.transaction():
+                for record in await consumer.getmany(10_000, timeout_ms=100):
+                    await producer.send("out", transform(record))
+                    consumer.store_offset(record)
+
+        Commits when the body completes and aborts when it raises, or when
+        the commit fails in a way that requires it. Put many records in each
+        transaction: a commit costs a few broker round trips however many
+        messages it covers.
+        """
+        self.begin_transaction()
+        try:
+            yield self
+        except BaseException:
+            await self.abort_transaction()
+            raise
+        try:
+            await self.commit_transaction()
+        except _core.KafkaError as exc:
+            if getattr(exc, "txn_requires_abort", False):
+                await self.abort_transaction()
+            raise
+
+    async def close(self) -> None:
+        """Flush outstanding messages and stop watching the delivery fd."""
+        await self.flush()
+        if self._loop is not None and not self._loop.is_closed():
+            self._loop.remove_reader(self._producer.fileno())
+        self._loop = None
@@ -0,0 +1,78 @@
+"""End-to-end consumer benchmark against librdkafka's mock cluster.
+
+Build the benchmark module first::
+
+    ASYNKAF_BENCH=1 pip install -e .
+
+then run ``python benchmarks/consumer_e2e.py``. No broker is needed: the
+messages are produced into an in-process mock cluster and consumed back
+through :meth:`asynkaf.Consumer.getmany`. Timing starts at the first
+record, so the group join is not counted.
+"""
+
+import argparse
+import asyncio
+import time
+
+from asynkaf import Consumer, Producer
+from asynkaf import _bench
+
+TOPIC = "asynkaf-bench"
+
+
+async def produce(bootstrap_servers: str, count: int, size: int) -> None:
+    producer = Producer(bootstrap_servers, linger_ms=5)
+    value = b"x" * size
+    for _ in range(count):
+        await producer.send(TOPIC, value)
+    await producer.close()
+
+
+async def consume(bootstrap_servers: str, count: int, args) -> dict:
+    consumer = Consumer(
+        bootstrap_servers,
+        "asynkaf-bench",
+        poll_strategy=args.poll_strategy,
+        config={"auto.offset.reset": "earliest"},
+    )
+    consumer.subscribe([TOPIC])
+    received = 0
+    start = None
+    while received < count:
+        records = await consumer.getmany(args.max_records, timeout_ms=1000)
+        if records and start is None:
+            start = time.perf_counter()
+        received += len(records)
+    elapsed = time.perf_counter() - start
+    metrics = consumer.metrics()
+    await consumer.close()
+    return {"elapsed": elapsed, "metrics": metrics}
+
+
+async def run(args) -> None:
+    cluster = _bench.MockCluster(brokers=args.brokers)
+    cluster.create_topic(TOPIC, partitions=args.partitions)
+    await produce(cluster.bootstrap_servers, args.messages, args.size)
+    result = await consume(cluster.bootstrap_servers, args.messages, args)
+
+    elapsed = result["elapsed"]
+    dwell = result["metrics"]["dwell_ns"]
+    print(f"messages      {args.messages:,} x {args.size} B over {args.partitions} partitions")
+    print(f"throughput    {args.messages / elapsed:,.0f} msg/s, {args.messages * args.size / elapsed / 1e6:,.1f} MB/s")
+    print(f"cost          {elapsed * 1e9 / args.messages:,.0f} ns/msg")
+    print(f"queue dwell   p50 {dwell['p50']:,} ns, p99 {dwell['p99']:,} ns, p999 {dwell['p999']:,} ns")
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--messages", type=int, default=200_000)
+    parser.add_argument("--size", type=int, default=100, help="payload bytes per message")
+    parser.add_argument("--brokers", type=int, default=3)
+    parser.add_argument("--partitions", type=int, default=6)
+    parser.add_argument("--max-records", type=int, default=500)
+    parser.add_argument("--poll-strategy", choices=["block", "hybrid", "spin"], default="block")
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,485 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <librdkafka/rdkafka_mock.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "metrics.h"
+#include "poller.h"
+#include "queue.h"
+
+/**
+ * @brief How the benchmark's producer thread feeds the queue.
+ */
+typedef enum {
+    PATTERN_STEADY,           // Fixed-size pushes back to back: a 1:1 handoff.
+    PATTERN_BURST,            // `burst` messages at once, then `gap_us` idle, like a fetch response.
+} BenchPattern;
+
+/**
+ * @brief State shared by the producer thread and the measuring thread.
+ */
+typedef struct {
+    MessageQueue queue;       // The queue under test.
+    rd_kafka_message_t **messages; // Synthetic messages, in push order.
+    uint64_t *pushed_ns;      // Push time per message, indexed by its offset.
+    size_t count;             // Number of messages to hand over.
+    size_t push_batch;        // Messages per push.
+    size_t pop_batch;         // Messages per pop.
+    BenchPattern pattern;     // How pushes are spaced.
+    uint64_t gap_ns;          // Idle time between bursts.
+    Histogram *handoff;       // Push-to-pop latency per message.
+} QueueBench;
+
+/**
+ * @brief Sleeps for `ns` nanoseconds.
+ */
+static void bench_sleep_ns(uint64_t ns) {
+    struct timespec delay = {
+        .tv_sec = (time_t)(ns / 1000000000u),
+        .tv_nsec = (long)(ns % 1000000000u),
+    };
+    nanosleep(&delay, NULL);
+}
+
+/**
+ * @brief Producer thread: pushes every message, spinning while the ring is full.
+ *
+ * One clock read stamps a whole push, as the poller's single splice per
+ * batch would.
+ */
+static void *bench_producer(void *arg) {
+    QueueBench *bench = (QueueBench *)arg;
+    size_t pushed = 0;
+    while (pushed < bench->count) {
+        size_t want = bench->count - pushed;
+        if (want > bench->push_batch) {
+            want = bench->push_batch;
+        }
+        uint64_t now = metrics_now_ns();
+        for (size_t i = 0; i < want; i++) {
+            bench->pushed_ns[bench->messages[pushed + i]->offset] = now;
+        }
+        size_t done = 0;
+        while (done < want) {
+            size_t taken = message_queue_push_batch(&bench->queue, bench->messages + pushed + done,
+                                                    NULL, want - done);
+            if (taken == 0) {
+                poller_cpu_relax();
+            }
+            done += taken;
+        }
+        pushed += want;
+        if (bench->pattern == PATTERN_BURST && bench->gap_ns) {
+            bench_sleep_ns(bench->gap_ns);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Measuring thread: pops every message and records its handoff latency.
+ */
+static void bench_consume(QueueBench *bench, rd_kafka_message_t **out) {
+    size_t popped = 0;
+    while (popped < bench->count) {
+        size_t count = message_queue_pop_batch(&bench->queue, out, NULL, bench->pop_batch);
+        if (count == 0) {
+            poller_cpu_relax();
+            continue;
+        }
+        uint64_t now = metrics_now_ns();
+        for (size_t i = 0; i < count; i++) {
+            histogram_record(bench->handoff, now - bench->pushed_ns[out[i]->offset]);
+        }
+        popped += count;
+    }
+}
+
+/**
+ * @brief Runs one MessageQueue benchmark.
+ *
+ * Exposed to Python as `_bench.queue(pattern="steady", *, messages=1000000,
+ * capacity=65536, push_batch=1, pop_batch=500, burst=1000, gap_us=100,
+ * payload=100)`. A producer thread pushes synthetic messages, `push_batch`
+ * at a time ("steady") or `burst` at a time with `gap_us` between bursts
+ * ("burst"), while the calling thread pops them `pop_batch` at a time.
+ * A capacity of 0 benchmarks the linked-list fallback.
+ *
+ * @return A dict with `elapsed_ns`, `ns_per_op`, `messages_per_sec`,
+ *         `p99_handoff_ns` and the full `handoff_ns` histogram summary.
+ */
+static PyObject *
+bench_queue(PyObject *module, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"pattern", "messages", "capacity", "push_batch", "pop_batch",
+                             "burst", "gap_us", "payload", NULL};
+    const char *pattern = "steady";
+    Py_ssize_t messages = 1000000;
+    Py_ssize_t capacity = MESSAGE_QUEUE_DEFAULT_CAPACITY;
+    Py_ssize_t push_batch = 1;
+    Py_ssize_t pop_batch = 500;
+    Py_ssize_t burst = 1000;
+    long long gap_us = 100;
+    Py_ssize_t payload = 100;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s$nnnnnLn", kwlist, &pattern, &messages,
+                                     &capacity, &push_batch, &pop_batch, &burst, &gap_us, &payload))
+        return NULL;
+
+    QueueBench bench = {0};
+    if (strcmp(pattern, "steady") == 0) {
+        bench.pattern = PATTERN_STEADY;
+    } else if (strcmp(pattern, "burst") == 0) {
+        bench.pattern = PATTERN_BURST;
+        push_batch = burst;
+    } else {
+        PyErr_Format(PyExc_ValueError, "pattern must be 'steady' or 'burst', not '%s'", pattern);
+        return NULL;
+    }
+    if (messages < 1 || push_batch < 1 || pop_batch < 1) {
+        PyErr_SetString(PyExc_ValueError, "messages, push_batch, pop_batch and burst must be >= 1");
+        return NULL;
+    }
+    if (capacity < 0 || gap_us < 0 || payload < 0) {
+        PyErr_SetString(PyExc_ValueError, "capacity, gap_us and payload must be >= 0");
+        return NULL;
+    }
+    bench.count = (size_t)messages;
+    bench.push_batch = (size_t)push_batch;
+    bench.pop_batch = (size_t)pop_batch;
+    bench.gap_ns = (uint64_t)gap_us * 1000;
+
+    // Messages are never handed to librdkafka: the queue only reads their
+    // length, and everything pushed is popped again before it is destroyed.
+    rd_kafka_message_t *storage = calloc(bench.count, sizeof(rd_kafka_message_t));
+    bench.messages = malloc(bench.count * sizeof(rd_kafka_message_t *));
+    bench.pushed_ns = malloc(bench.count * sizeof(uint64_t));
+    bench.handoff = malloc(sizeof(Histogram));
+    rd_kafka_message_t **out = malloc(bench.pop_batch * sizeof(rd_kafka_message_t *));
+    PyObject *result = NULL;
+    if (!storage || !bench.messages || !bench.pushed_ns || !bench.handoff || !out) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (size_t i = 0; i < bench.count; i++) {
+        storage[i].offset = (int64_t)i;
+        storage[i].len = (size_t)payload;
+        bench.messages[i] = &storage[i];
+    }
+    histogram_init(bench.handoff);
+    if (message_queue_init(&bench.queue, (size_t)capacity) != 0) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    pthread_t producer;
+    int err;
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    Py_BEGIN_ALLOW_THREADS
+    start = metrics_now_ns();
+    err = pthread_create(&producer, NULL, bench_producer, &bench);
+    if (!err) {
+        bench_consume(&bench, out);
+        elapsed = metrics_now_ns() - start;
+        pthread_join(producer, NULL);
+    }
+    message_queue_destroy(&bench.queue);
+    Py_END_ALLOW_THREADS
+    if (err) {
+        PyErr_SetString(PyExc_RuntimeError, "failed to start the producer thread");
+        goto done;
+    }
+
+    PyObject *handoff = histogram_snapshot(bench.handoff);
+    if (!handoff) {
+        goto done;
+    }
+    PyObject *p99 = PyDict_GetItemString(handoff, "p99");
+    result = Py_BuildValue("{s:s,s:n,s:n,s:K,s:d,s:d,s:O,s:O}",
+                           "pattern", pattern,
+                           "messages", messages,
+                           "capacity", capacity,
+                           "elapsed_ns", (unsigned long long)elapsed,
+                           "ns_per_op", (double)elapsed / (double)bench.count,
+                           "messages_per_sec", (double)bench.count * 1e9 / (double)(elapsed ? elapsed : 1),
+                           "p99_handoff_ns", p99 ? p99 : Py_None,
+                           "handoff_ns", handoff);
+    Py_DECREF(handoff);
+
+done:
+    free(out);
+    free(bench.handoff);
+    free(bench.pushed_ns);
+    free(bench.messages);
+    free(storage);
+    return result;
+}
+
+/**
+ * @brief A librdkafka mock cluster for benchmarks that need a broker.
+ *
+ * `test.mock.num.brokers` gives each client its own private cluster, so the
+ * producer and consumer of an end-to-end run could not meet. This hosts one
+ * cluster in a bare handle and exposes its bootstrap servers instead.
+ */
+typedef struct {
+    PyObject_HEAD
+    rd_kafka_t *rk;           // Handle that owns the cluster.
+    rd_kafka_mock_cluster_t *mcluster; // The cluster.
+} MockClusterObject;
+
+/**
+ * @brief Starts a mock cluster.
+ *
+ * Exposed to Python as `MockCluster(brokers=3)`.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int
+MockCluster_init(MockClusterObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"brokers", NULL};
+    int brokers = 3;
+    char errstr[512];
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, &brokers))
+        return -1;
+    if (brokers < 1) {
+        PyErr_SetString(PyExc_ValueError, "brokers must be >= 1");
+        return -1;
+    }
+    if (self->rk) {
+        PyErr_SetString(PyExc_RuntimeError, "MockCluster is already running");
+        return -1;
+    }
+
+    rd_kafka_conf_t *conf = rd_kafka_conf_new();
+    self->rk = rd_kafka_new(RD_KAFKA_PRODUCER, conf, errstr, sizeof(errstr));
+    if (!self->rk) {
+        rd_kafka_conf_destroy(conf);
+        PyErr_SetString(PyExc_RuntimeError, errstr);
+        return -1;
+    }
+    self->mcluster = rd_kafka_mock_cluster_new(self->rk, brokers);
+    if (!self->mcluster) {
+        PyErr_SetString(PyExc_RuntimeError, "failed to create the mock cluster");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops the cluster.
+ */
+static void
+MockCluster_dealloc(MockClusterObject *self) {
+    Py_BEGIN_ALLOW_THREADS
+    if (self->mcluster) {
+        rd_kafka_mock_cluster_destroy(self->mcluster);
+    }
+    if (self->rk) {
+        rd_kafka_destroy(self->rk);
+    }
+    Py_END_ALLOW_THREADS
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Creates a topic.
+ *
+ * Exposed to Python as `MockCluster.create_topic(name, partitions=1,
+ * replication_factor=1)`.
+ */
+static PyObject *
+MockCluster_create_topic(MockClusterObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"name", "partitions", "replication_factor", NULL};
+    const char *name;
+    int partitions = 1;
+    int replication_factor = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|ii", kwlist, &name, &partitions, &replication_factor))
+        return NULL;
+    if (!self->mcluster) {
+        PyErr_SetString(PyExc_RuntimeError, "MockCluster is not initialized");
+        return NULL;
+    }
+    rd_kafka_resp_err_t err = rd_kafka_mock_topic_create(self->mcluster, name, partitions,
+                                                         replication_factor);
+    if (err) {
+        PyErr_SetString(PyExc_RuntimeError, rd_kafka_err2str(err));
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Delays every response of one broker.
+ *
+ * Exposed to Python as `MockCluster.set_rtt(broker_id, rtt_ms)`, so tests
+ * can keep requests in flight.
+ */
+static PyObject *
+MockCluster_set_rtt(MockClusterObject *self, PyObject *args) {
+    int broker_id;
+    int rtt_ms;
+
+    if (!PyArg_ParseTuple(args, "ii", &broker_id, &rtt_ms))
+        return NULL;
+    if (!self->mcluster) {
+        PyErr_SetString(PyExc_RuntimeError, "MockCluster is not initialized");
+        return NULL;
+    }
+    rd_kafka_resp_err_t err = rd_kafka_mock_broker_set_rtt(self->mcluster, broker_id, rtt_ms);
+    if (err) {
+        PyErr_SetString(PyExc_RuntimeError, rd_kafka_err2str(err));
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Makes the next requests of one type fail.
+ *
+ * Exposed to Python as `MockCluster.push_request_errors(api_key, errors)`.
+ * Each of the next `len(errors)` requests with that ApiKey, on any broker,
+ * is answered with the next error code; 0 lets one through.
+ */
+static PyObject *
+MockCluster_push_request_errors(MockClusterObject *self, PyObject *args) {
+    int api_key;
+    PyObject *errors;
+
+    if (!PyArg_ParseTuple(args, "iO", &api_key, &errors))
+        return NULL;
+    if (!self->mcluster) {
+        PyErr_SetString(PyExc_RuntimeError, "MockCluster is not initialized");
+        return NULL;
+    }
+    PyObject *seq = PySequence_Fast(errors, "errors must be a sequence of error codes");
+    if (!seq) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    rd_kafka_resp_err_t *codes = PyMem_Malloc((count ? count : 1) * sizeof(rd_kafka_resp_err_t));
+    if (!codes) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        long code = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+        if (code == -1 && PyErr_Occurred()) {
+            PyMem_Free(codes);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        codes[i] = (rd_kafka_resp_err_t)code;
+    }
+    Py_DECREF(seq);
+    rd_kafka_mock_push_request_errors_array(self->mcluster, (int16_t)api_key, (size_t)count, codes);
+    PyMem_Free(codes);
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns the cluster's bootstrap servers.
+ */
+static PyObject *
+MockCluster_get_bootstrap_servers(MockClusterObject *self, void *closure) {
+    if (!self->mcluster) {
+        PyErr_SetString(PyExc_RuntimeError, "MockCluster is not initialized");
+        return NULL;
+    }
+    return PyUnicode_FromString(rd_kafka_mock_cluster_bootstraps(self->mcluster));
+}
+
+/**
+ * @brief Defines the methods available on MockCluster objects.
+ */
+static PyMethodDef MockCluster_methods[] = {
+    {"create_topic", (PyCFunction)(void(*)(void))MockCluster_create_topic, METH_VARARGS | METH_KEYWORDS,
+     "Create a topic with the given number of partitions."},
+    {"set_rtt", (PyCFunction)MockCluster_set_rtt, METH_VARARGS,
+     "Delay every response of a broker by rtt_ms."},
+    {"push_request_errors", (PyCFunction)MockCluster_push_request_errors, METH_VARARGS,
+     "Fail the next requests with api_key with the given error codes."},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Attribute accessors for MockCluster objects.
+ */
+static PyGetSetDef MockCluster_getset[] = {
+    {"bootstrap_servers", (getter)MockCluster_get_bootstrap_servers, NULL,
+     "Bootstrap servers of the cluster.", NULL},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the MockCluster.
+ */
+static PyTypeObject MockClusterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_bench.MockCluster",
+    .tp_doc = "An in-process librdkafka mock cluster",
+    .tp_basicsize = sizeof(MockClusterObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)MockCluster_init,
+    .tp_dealloc = (destructor)MockCluster_dealloc,
+    .tp_methods = MockCluster_methods,
+    .tp_getset = MockCluster_getset,
+};
+
+/**
+ * @brief Defines the methods available in the `_bench` module.
+ */
+static PyMethodDef bench_methods[] = {
+    {"queue", (PyCFunction)(void(*)(void))bench_queue, METH_VARARGS | METH_KEYWORDS,
+     "Benchmark MessageQueue handoff between two threads."},
+    {NULL, NULL, 0, NULL}  // Sentinel
+};
+
+/**
+ * @brief Populates a freshly created `_bench` module.
+ */
+static int bench_exec(PyObject *m) {
+    if (PyType_Ready(&MockClusterType) < 0)
+        return -1;
+    return PyModule_AddObjectRef(m, "MockCluster", (PyObject *)&MockClusterType);
+}
+
+/**
+ * @brief Module slots.
+ */
+static PyModuleDef_Slot bench_slots[] = {
+    {Py_mod_exec, bench_exec},
+#ifdef Py_mod_multiple_interpreters
+    {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_NOT_SUPPORTED},
+#endif
+#ifdef Py_mod_gil
+    {Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+    {0, NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the `_bench` module.
+ */
+static struct PyModuleDef bench_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_bench",
+    .m_doc = "Benchmarks of asynkaf's C internals.",
+    .m_size = 0,
+    .m_methods = bench_methods,
+    .m_slots = bench_slots,
+};
+
+/**
+ * @brief Initializes the `_bench` module.
+ */
+PyMODINIT_FUNC PyInit__bench(void) {
+    return PyModuleDef_Init(&bench_module);
+}
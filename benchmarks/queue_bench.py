@@ -0,0 +1,54 @@
+"""MessageQueue handoff benchmark.
+
+Build the benchmark module first::
+
+    ASYNKAF_BENCH=1 pip install -e .
+
+then run ``python benchmarks/queue_bench.py``. Each case hands synthetic
+messages from a producer thread to a consumer thread through a
+``MessageQueue`` and reports the cost per message and the push-to-pop
+latency percentiles.
+"""
+
+import argparse
+
+from asynkaf import _bench
+
+# (label, keyword arguments of _bench.queue)
+CASES = [
+    ("ring 1:1", dict(pattern="steady")),
+    ("ring 1:1, push 64", dict(pattern="steady", push_batch=64)),
+    ("ring burst", dict(pattern="burst")),
+    ("list 1:1", dict(pattern="steady", capacity=0)),
+    ("list burst", dict(pattern="burst", capacity=0)),
+]
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--messages", type=int, default=1_000_000)
+    parser.add_argument("--capacity", type=int, default=65536, help="ring capacity of the ring cases")
+    parser.add_argument("--pop-batch", type=int, default=500)
+    parser.add_argument("--burst", type=int, default=1000)
+    parser.add_argument("--gap-us", type=int, default=100)
+    args = parser.parse_args()
+
+    print(f"{'case':<20} {'ns/op':>8} {'msg/s':>12} {'p50 ns':>10} {'p99 ns':>10} {'p999 ns':>10}")
+    for label, kwargs in CASES:
+        kwargs.setdefault("capacity", args.capacity)
+        result = _bench.queue(
+            messages=args.messages,
+            pop_batch=args.pop_batch,
+            burst=args.burst,
+            gap_us=args.gap_us,
+            **kwargs,
+        )
+        handoff = result["handoff_ns"]
+        print(
+            f"{label:<20} {result['ns_per_op']:>8.1f} {result['messages_per_sec']:>12,.0f}"
+            f" {handoff['p50']:>10} {handoff['p99']:>10} {handoff['p999']:>10}"
+        )
+
+
+if __name__ == "__main__":
+    main()
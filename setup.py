@@ -1,19 +1,86 @@
+import os
+
 from setuptools import setup, Extension
 
+# Set ASYNKAF_POOL_STATS=1 at build time to track node pool high-water usage.
+define_macros = []
+if os.environ.get('ASYNKAF_POOL_STATS'):
+    define_macros.append(('ASYNKAF_POOL_STATS', '1'))
+
+# Set ASYNKAF_BENCH=1 at build time to also build asynkaf._bench, the
+# C-level benchmarks driven by the scripts in benchmarks/.
+build_bench = bool(os.environ.get('ASYNKAF_BENCH'))
+
+# Set ASYNKAF_TESTING=1 at build time to also build asynkaf._testing, the
+# hooks into the C internals used by the tests in tests/. It provides the few
+# librdkafka functions those internals call itself, so it does not link it.
+build_testing = bool(os.environ.get('ASYNKAF_TESTING'))
+
 asynkaf_core = Extension(
     'asynkaf._core',
     sources=[
         'asynkaf/_core/_core.c',
+        'asynkaf/_core/awaitable.c',
+        'asynkaf/_core/columnar.c',
+        'asynkaf/_core/conf.c',
         'asynkaf/_core/consumer.c',
+        'asynkaf/_core/decode_pool.c',
+        'asynkaf/_core/decoder.c',
+        'asynkaf/_core/errors.c',
+        'asynkaf/_core/event_queue.c',
+        'asynkaf/_core/futures.c',
+        'asynkaf/_core/message.c',
+        'asynkaf/_core/metrics.c',
+        'asynkaf/_core/offsets.c',
+        'asynkaf/_core/partition.c',
+        'asynkaf/_core/poller.c',
+        'asynkaf/_core/pool.c',
+        'asynkaf/_core/prefetch.c',
+        'asynkaf/_core/producer.c',
         'asynkaf/_core/queue.c',
+        'asynkaf/_core/wakeup.c',
     ],
     include_dirs=['/usr/local/include'],
     libraries=['rdkafka'],
     library_dirs=['/usr/local/lib'],
+    define_macros=define_macros,
 )
 
+ext_modules = [asynkaf_core]
+if build_bench:
+    ext_modules.append(Extension(
+        'asynkaf._bench',
+        sources=[
+            'benchmarks/queue_bench.c',
+            'asynkaf/_core/metrics.c',
+            'asynkaf/_core/pool.c',
+            'asynkaf/_core/queue.c',
+            'asynkaf/_core/wakeup.c',
+        ],
+        include_dirs=['asynkaf/_core', '/usr/local/include'],
+        libraries=['rdkafka'],
+        library_dirs=['/usr/local/lib'],
+        define_macros=define_macros,
+    ))
+if build_testing:
+    ext_modules.append(Extension(
+        'asynkaf._testing',
+        sources=[
+            'tests/_testing.c',
+            'asynkaf/_core/decoder.c',
+            'asynkaf/_core/metrics.c',
+            'asynkaf/_core/offsets.c',
+            'asynkaf/_core/pool.c',
+            'asynkaf/_core/prefetch.c',
+            'asynkaf/_core/queue.c',
+            'asynkaf/_core/wakeup.c',
+        ],
+        include_dirs=['asynkaf/_core', '/usr/local/include'],
+        define_macros=define_macros,
+    ))
+
 setup(
     packages=['asynkaf'],
-    ext_modules=[asynkaf_core],
+    ext_modules=ext_modules,
 )
 
@@ -0,0 +1,879 @@
+#include <Python.h>
+#include <librdkafka/rdkafka.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "decoder.h"
+#include "offsets.h"
+#include "prefetch.h"
+#include "queue.h"
+
+/*
+ * Hooks the C internals under test into Python without a broker.
+ *
+ * The modules exercised here only need a handful of librdkafka functions,
+ * so this module defines them itself instead of linking librdkafka:
+ * messages are plain allocations with a topic attached, and partition
+ * lists are grown by hand. That lets the tests build messages and lists of
+ * their choosing and check that the queue destroys every message it drops.
+ */
+
+/**
+ * @brief Topic handle of the synthetic messages: just its name.
+ */
+struct rd_kafka_topic_s {
+    char *name;               // Topic name (owned).
+};
+
+/**
+ * @brief A synthetic message and the topic it points at, in one allocation.
+ */
+typedef struct {
+    rd_kafka_message_t message; // Must stay first: the queue only sees this.
+    struct rd_kafka_topic_s topic; // Pointed at by `message.rkt`.
+} TestMessage;
+
+/**
+ * @brief Synthetic messages created and not yet destroyed.
+ */
+static atomic_long live_messages = 0;
+
+/**
+ * @brief Creates a synthetic message with a NULL payload of `len` bytes.
+ * @return The message, or NULL if out of memory.
+ */
+static rd_kafka_message_t *test_message_new(const char *topic, int32_t partition, int64_t offset,
+                                            size_t len) {
+    TestMessage *msg = calloc(1, sizeof(TestMessage));
+    if (!msg) {
+        return NULL;
+    }
+    msg->topic.name = strdup(topic);
+    if (!msg->topic.name) {
+        free(msg);
+        return NULL;
+    }
+    msg->message.rkt = &msg->topic;
+    msg->message.partition = partition;
+    msg->message.offset = offset;
+    msg->message.len = len;
+    atomic_fetch_add(&live_messages, 1);
+    return &msg->message;
+}
+
+void rd_kafka_message_destroy(rd_kafka_message_t *rkmessage) {
+    TestMessage *msg = (TestMessage *)rkmessage;
+    free(msg->topic.name);
+    free(msg);
+    atomic_fetch_sub(&live_messages, 1);
+}
+
+const char *rd_kafka_topic_name(const rd_kafka_topic_t *rkt) {
+    return rkt->name;
+}
+
+rd_kafka_topic_partition_list_t *rd_kafka_topic_partition_list_new(int size) {
+    rd_kafka_topic_partition_list_t *list = calloc(1, sizeof(*list));
+    if (!list) {
+        return NULL;
+    }
+    list->size = size > 0 ? size : 1;
+    list->elems = calloc((size_t)list->size, sizeof(*list->elems));
+    if (!list->elems) {
+        free(list);
+        return NULL;
+    }
+    return list;
+}
+
+rd_kafka_topic_partition_t *rd_kafka_topic_partition_list_add(rd_kafka_topic_partition_list_t *rktparlist,
+                                                              const char *topic, int32_t partition) {
+    if (rktparlist->cnt == rktparlist->size) {
+        int size = rktparlist->size * 2;
+        rd_kafka_topic_partition_t *elems = realloc(rktparlist->elems, (size_t)size * sizeof(*elems));
+        if (!elems) {
+            abort();
+        }
+        rktparlist->elems = elems;
+        rktparlist->size = size;
+    }
+    rd_kafka_topic_partition_t *elem = &rktparlist->elems[rktparlist->cnt++];
+    memset(elem, 0, sizeof(*elem));
+    elem->topic = strdup(topic);
+    if (!elem->topic) {
+        abort();
+    }
+    elem->partition = partition;
+    elem->offset = RD_KAFKA_OFFSET_INVALID;
+    return elem;
+}
+
+rd_kafka_topic_partition_t *rd_kafka_topic_partition_list_find(const rd_kafka_topic_partition_list_t *rktparlist,
+                                                               const char *topic, int32_t partition) {
+    for (int i = 0; i < rktparlist->cnt; i++) {
+        rd_kafka_topic_partition_t *elem = &rktparlist->elems[i];
+        if (elem->partition == partition && strcmp(elem->topic, topic) == 0) {
+            return elem;
+        }
+    }
+    return NULL;
+}
+
+void rd_kafka_topic_partition_list_destroy(rd_kafka_topic_partition_list_t *rkparlist) {
+    for (int i = 0; i < rkparlist->cnt; i++) {
+        free(rkparlist->elems[i].topic);
+    }
+    free(rkparlist->elems);
+    free(rkparlist);
+}
+
+/**
+ * @brief Builds a partition list from an iterable of `(topic, partition)`.
+ * @return A new list, or NULL with an exception set.
+ */
+static rd_kafka_topic_partition_list_t *partition_list_from_object(PyObject *partitions) {
+    PyObject *seq = PySequence_Fast(partitions, "partitions must be an iterable of (topic, partition)");
+    if (!seq) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    rd_kafka_topic_partition_list_t *list = rd_kafka_topic_partition_list_new((int)count);
+    if (!list) {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        const char *topic;
+        int partition;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, i), "si", &topic, &partition)) {
+            rd_kafka_topic_partition_list_destroy(list);
+            Py_DECREF(seq);
+            return NULL;
+        }
+        rd_kafka_topic_partition_list_add(list, topic, partition);
+    }
+    Py_DECREF(seq);
+    return list;
+}
+
+/**
+ * @brief A MessageQueue holding synthetic messages.
+ */
+typedef struct {
+    PyObject_HEAD
+    MessageQueue queue;       // The queue under test.
+    int ready;                // Whether `queue` was initialized.
+} QueueObject;
+
+/**
+ * @brief Creates the queue.
+ *
+ * Exposed to Python as `Queue(capacity=0)`.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int
+Queue_init(QueueObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"capacity", NULL};
+    Py_ssize_t capacity = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &capacity))
+        return -1;
+    if (capacity < 0) {
+        PyErr_SetString(PyExc_ValueError, "capacity must be >= 0");
+        return -1;
+    }
+    if (self->ready) {
+        PyErr_SetString(PyExc_RuntimeError, "Queue is already initialized");
+        return -1;
+    }
+    if (message_queue_init(&self->queue, (size_t)capacity) != 0) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->ready = 1;
+    return 0;
+}
+
+/**
+ * @brief Destroys the queue and the messages still in it.
+ */
+static void
+Queue_dealloc(QueueObject *self) {
+    if (self->ready) {
+        message_queue_destroy(&self->queue);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Pushes one message per offset as a single batch.
+ *
+ * Exposed to Python as `Queue.push(topic, partition, offsets, size=0)`;
+ * `size` is the payload length every message is accounted with.
+ *
+ * @return The number of messages the queue took; the rest are destroyed.
+ */
+static PyObject *
+Queue_push(QueueObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"topic", "partition", "offsets", "size", NULL};
+    const char *topic;
+    int partition;
+    PyObject *offsets;
+    Py_ssize_t size = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "siO|n", kwlist, &topic, &partition, &offsets, &size))
+        return NULL;
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "size must be >= 0");
+        return NULL;
+    }
+    PyObject *seq = PySequence_Fast(offsets, "offsets must be an iterable of ints");
+    if (!seq) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    rd_kafka_message_t **messages = PyMem_Calloc((size_t)count + 1, sizeof(*messages));
+    if (!messages) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+    PyObject *result = NULL;
+    Py_ssize_t built = 0;
+    for (; built < count; built++) {
+        long long offset = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(seq, built));
+        if (offset == -1 && PyErr_Occurred()) {
+            goto done;
+        }
+        messages[built] = test_message_new(topic, partition, offset, (size_t)size);
+        if (!messages[built]) {
+            PyErr_NoMemory();
+            goto done;
+        }
+    }
+    size_t taken = message_queue_push_batch(&self->queue, messages, NULL, (size_t)count);
+    for (size_t i = taken; i < (size_t)count; i++) {
+        rd_kafka_message_destroy(messages[i]);
+    }
+    built = 0;
+    result = PyLong_FromSize_t(taken);
+
+done:
+    for (Py_ssize_t i = 0; i < built; i++) {
+        rd_kafka_message_destroy(messages[i]);
+    }
+    PyMem_Free(messages);
+    Py_DECREF(seq);
+    return result;
+}
+
+/**
+ * @brief Pops up to `max_count` messages.
+ *
+ * Exposed to Python as `Queue.pop(max_count=64)`.
+ *
+ * @return A list of `(topic, partition, offset)` tuples, oldest first.
+ */
+static PyObject *
+Queue_pop(QueueObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"max_count", NULL};
+    Py_ssize_t max_count = 64;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n", kwlist, &max_count))
+        return NULL;
+    if (max_count < 1) {
+        PyErr_SetString(PyExc_ValueError, "max_count must be >= 1");
+        return NULL;
+    }
+    rd_kafka_message_t **out = PyMem_Calloc((size_t)max_count, sizeof(*out));
+    if (!out) {
+        return PyErr_NoMemory();
+    }
+    size_t count = message_queue_pop_batch(&self->queue, out, NULL, (size_t)max_count);
+    PyObject *list = PyList_New((Py_ssize_t)count);
+    for (size_t i = 0; i < count; i++) {
+        if (list) {
+            PyObject *item = Py_BuildValue("(siL)", rd_kafka_topic_name(out[i]->rkt),
+                                           (int)out[i]->partition, (long long)out[i]->offset);
+            if (!item) {
+                Py_CLEAR(list);
+            } else {
+                PyList_SET_ITEM(list, (Py_ssize_t)i, item);
+            }
+        }
+        rd_kafka_message_destroy(out[i]);
+    }
+    PyMem_Free(out);
+    return list;
+}
+
+/**
+ * @brief Pops a single message without blocking.
+ *
+ * Exposed to Python as `Queue.try_pop()`.
+ *
+ * @return A `(topic, partition, offset)` tuple, or None if the queue is empty.
+ */
+static PyObject *
+Queue_try_pop(QueueObject *self, PyObject *Py_UNUSED(ignored)) {
+    rd_kafka_message_t *message = message_queue_try_pop(&self->queue);
+    if (!message) {
+        Py_RETURN_NONE;
+    }
+    PyObject *item = Py_BuildValue("(siL)", rd_kafka_topic_name(message->rkt),
+                                   (int)message->partition, (long long)message->offset);
+    rd_kafka_message_destroy(message);
+    return item;
+}
+
+/**
+ * @brief Fences the messages of one partition queued so far.
+ *
+ * Exposed to Python as `Queue.fence(topic, partition)`.
+ */
+static PyObject *
+Queue_fence(QueueObject *self, PyObject *args) {
+    const char *topic;
+    int partition;
+
+    if (!PyArg_ParseTuple(args, "si", &topic, &partition))
+        return NULL;
+    if (message_queue_fence(&self->queue, topic, partition) != 0) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Partition selected by Queue_purge().
+ */
+typedef struct {
+    const char *topic;        // Topic name.
+    int32_t partition;        // Partition number.
+} PurgeTarget;
+
+/**
+ * @brief Matches the messages of the partition being purged.
+ */
+static int purge_match(const rd_kafka_message_t *message, void *arg) {
+    const PurgeTarget *target = arg;
+    return message->partition == target->partition &&
+           strcmp(rd_kafka_topic_name(message->rkt), target->topic) == 0;
+}
+
+/**
+ * @brief Destroys every queued message of one partition.
+ *
+ * Exposed to Python as `Queue.purge(topic, partition)`.
+ *
+ * @return The number of messages removed.
+ */
+static PyObject *
+Queue_purge(QueueObject *self, PyObject *args) {
+    PurgeTarget target;
+    int partition;
+
+    if (!PyArg_ParseTuple(args, "si", &target.topic, &partition))
+        return NULL;
+    target.partition = partition;
+    return PyLong_FromSize_t(message_queue_purge(&self->queue, purge_match, &target));
+}
+
+/**
+ * @brief Sets the backpressure watermarks.
+ *
+ * Exposed to Python as `Queue.set_watermarks(high_messages, low_messages,
+ * high_bytes, low_bytes)`.
+ */
+static PyObject *
+Queue_set_watermarks(QueueObject *self, PyObject *args) {
+    Py_ssize_t high_messages;
+    Py_ssize_t low_messages;
+    Py_ssize_t high_bytes;
+    Py_ssize_t low_bytes;
+
+    if (!PyArg_ParseTuple(args, "nnnn", &high_messages, &low_messages, &high_bytes, &low_bytes))
+        return NULL;
+    if (high_messages < 0 || low_messages < 0 || high_bytes < 0 || low_bytes < 0) {
+        PyErr_SetString(PyExc_ValueError, "watermarks must be >= 0");
+        return NULL;
+    }
+    message_queue_set_watermarks(&self->queue, (size_t)high_messages, (size_t)low_messages,
+                                 (size_t)high_bytes, (size_t)low_bytes);
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns whether either enabled high watermark has been reached.
+ */
+static PyObject *
+Queue_above_high(QueueObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyBool_FromLong(message_queue_above_high(&self->queue));
+}
+
+/**
+ * @brief Returns whether every enabled dimension is at or below its low mark.
+ */
+static PyObject *
+Queue_below_low(QueueObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyBool_FromLong(message_queue_below_low(&self->queue));
+}
+
+/**
+ * @brief Returns the payload bytes currently queued.
+ */
+static PyObject *
+Queue_bytes(QueueObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromSize_t(message_queue_bytes(&self->queue));
+}
+
+/**
+ * @brief Returns the number of queued messages.
+ */
+static PyObject *
+Queue_size(QueueObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromSize_t(message_queue_size(&self->queue));
+}
+
+/**
+ * @brief Returns how many messages have left the queue so far.
+ */
+static PyObject *
+Queue_drained(QueueObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromSize_t(message_queue_drained(&self->queue));
+}
+
+/**
+ * @brief Defines the methods available on Queue objects.
+ */
+static PyMethodDef Queue_methods[] = {
+    {"push", (PyCFunction)(void(*)(void))Queue_push, METH_VARARGS | METH_KEYWORDS,
+     "Push one message per offset of a partition; returns how many were taken."},
+    {"pop", (PyCFunction)(void(*)(void))Queue_pop, METH_VARARGS | METH_KEYWORDS,
+     "Pop up to max_count messages as (topic, partition, offset) tuples."},
+    {"try_pop", (PyCFunction)Queue_try_pop, METH_NOARGS,
+     "Pop one message as a (topic, partition, offset) tuple, or None."},
+    {"fence", (PyCFunction)Queue_fence, METH_VARARGS,
+     "Drop the partition's messages queued so far, lazily."},
+    {"purge", (PyCFunction)Queue_purge, METH_VARARGS,
+     "Destroy the partition's queued messages; returns how many were removed."},
+    {"set_watermarks", (PyCFunction)Queue_set_watermarks, METH_VARARGS,
+     "Set the high/low watermarks by message count and payload bytes."},
+    {"above_high", (PyCFunction)Queue_above_high, METH_NOARGS,
+     "Whether either enabled high watermark has been reached."},
+    {"below_low", (PyCFunction)Queue_below_low, METH_NOARGS,
+     "Whether every enabled dimension is at or below its low mark."},
+    {"bytes", (PyCFunction)Queue_bytes, METH_NOARGS, "Payload bytes currently queued."},
+    {"size", (PyCFunction)Queue_size, METH_NOARGS, "Number of queued messages."},
+    {"drained", (PyCFunction)Queue_drained, METH_NOARGS,
+     "Number of messages that have left the queue."},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the Queue.
+ */
+static PyTypeObject QueueType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_testing.Queue",
+    .tp_doc = "A MessageQueue of synthetic messages",
+    .tp_basicsize = sizeof(QueueObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Queue_init,
+    .tp_dealloc = (destructor)Queue_dealloc,
+    .tp_methods = Queue_methods,
+};
+
+/**
+ * @brief An OffsetTable.
+ */
+typedef struct {
+    PyObject_HEAD
+    OffsetTable table;        // The table under test.
+    int ready;                // Whether `table` was initialized.
+} OffsetTableObject;
+
+/**
+ * @brief Creates an empty table.
+ *
+ * Exposed to Python as `OffsetTable()`.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int
+OffsetTable_init(OffsetTableObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist))
+        return -1;
+    if (self->ready) {
+        PyErr_SetString(PyExc_RuntimeError, "OffsetTable is already initialized");
+        return -1;
+    }
+    offset_table_init(&self->table);
+    self->ready = 1;
+    return 0;
+}
+
+/**
+ * @brief Frees the table.
+ */
+static void
+OffsetTable_dealloc(OffsetTableObject *self) {
+    if (self->ready) {
+        offset_table_destroy(&self->table);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * @brief Records a processed offset.
+ *
+ * Exposed to Python as `OffsetTable.store(topic, partition, offset)`.
+ */
+static PyObject *
+OffsetTable_store(OffsetTableObject *self, PyObject *args) {
+    const char *topic;
+    int partition;
+    long long offset;
+
+    if (!PyArg_ParseTuple(args, "siL", &topic, &partition, &offset))
+        return NULL;
+    offset_table_lock(&self->table);
+    int rc = offset_table_store_locked(&self->table, topic, partition, offset);
+    offset_table_unlock(&self->table);
+    if (rc != 0) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Takes the dirty entries.
+ *
+ * Exposed to Python as `OffsetTable.take_dirty()`.
+ *
+ * @return A list of `(topic, partition, offset)` tuples, or None if
+ *         nothing changed since the last call.
+ */
+static PyObject *
+OffsetTable_take_dirty(OffsetTableObject *self, PyObject *Py_UNUSED(ignored)) {
+    rd_kafka_topic_partition_list_t *list = offset_table_take_dirty(&self->table);
+    if (!list) {
+        Py_RETURN_NONE;
+    }
+    PyObject *result = PyList_New(list->cnt);
+    for (int i = 0; result && i < list->cnt; i++) {
+        const rd_kafka_topic_partition_t *elem = &list->elems[i];
+        PyObject *item = Py_BuildValue("(siL)", elem->topic, (int)elem->partition,
+                                       (long long)elem->offset);
+        if (!item) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, i, item);
+    }
+    rd_kafka_topic_partition_list_destroy(list);
+    return result;
+}
+
+/**
+ * @brief Drops the entries of the given partitions.
+ *
+ * Exposed to Python as `OffsetTable.forget(partitions)`.
+ */
+static PyObject *
+OffsetTable_forget(OffsetTableObject *self, PyObject *partitions) {
+    rd_kafka_topic_partition_list_t *list = partition_list_from_object(partitions);
+    if (!list) {
+        return NULL;
+    }
+    offset_table_forget(&self->table, list);
+    rd_kafka_topic_partition_list_destroy(list);
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Drops the entries of the given partitions once they are taken.
+ *
+ * Exposed to Python as `OffsetTable.release(partitions)`.
+ */
+static PyObject *
+OffsetTable_release(OffsetTableObject *self, PyObject *partitions) {
+    rd_kafka_topic_partition_list_t *list = partition_list_from_object(partitions);
+    if (!list) {
+        return NULL;
+    }
+    offset_table_release(&self->table, list);
+    rd_kafka_topic_partition_list_destroy(list);
+    Py_RETURN_NONE;
+}
+
+/**
+ * @brief Returns the number of stores since the last take.
+ */
+static PyObject *
+OffsetTable_pending(OffsetTableObject *self, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromSize_t(offset_table_pending(&self->table));
+}
+
+/**
+ * @brief Defines the methods available on OffsetTable objects.
+ */
+static PyMethodDef OffsetTable_methods[] = {
+    {"store", (PyCFunction)OffsetTable_store, METH_VARARGS, "Record a processed offset."},
+    {"take_dirty", (PyCFunction)OffsetTable_take_dirty, METH_NOARGS,
+     "Take the changed entries as (topic, partition, offset) tuples, or None."},
+    {"forget", (PyCFunction)OffsetTable_forget, METH_O,
+     "Drop the entries of the given (topic, partition) pairs."},
+    {"release", (PyCFunction)OffsetTable_release, METH_O,
+     "Drop the entries of the given (topic, partition) pairs once taken."},
+    {"pending", (PyCFunction)OffsetTable_pending, METH_NOARGS,
+     "Number of stores since the last take."},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the OffsetTable.
+ */
+static PyTypeObject OffsetTableType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_testing.OffsetTable",
+    .tp_doc = "An OffsetTable",
+    .tp_basicsize = sizeof(OffsetTableObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)OffsetTable_init,
+    .tp_dealloc = (destructor)OffsetTable_dealloc,
+    .tp_methods = OffsetTable_methods,
+};
+
+/**
+ * @brief A PrefetchController driven with explicit times.
+ */
+typedef struct {
+    PyObject_HEAD
+    PrefetchController ctrl;  // The controller under test.
+} PrefetchObject;
+
+/**
+ * @brief Starts the controller.
+ *
+ * Exposed to Python as `Prefetch(target_ms, floor, ceiling, drained=0,
+ * now_ms=0)`.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int
+Prefetch_init(PrefetchObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"target_ms", "floor", "ceiling", "drained", "now_ms", NULL};
+    long long target_ms;
+    Py_ssize_t floor;
+    Py_ssize_t ceiling;
+    Py_ssize_t drained = 0;
+    long long now_ms = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Lnn|nL", kwlist, &target_ms, &floor, &ceiling,
+                                     &drained, &now_ms))
+        return -1;
+    if (floor < 0 || ceiling < floor || drained < 0) {
+        PyErr_SetString(PyExc_ValueError, "need 0 <= floor <= ceiling and drained >= 0");
+        return -1;
+    }
+    prefetch_init(&self->ctrl, target_ms, (size_t)floor, (size_t)ceiling, (size_t)drained, now_ms);
+    return 0;
+}
+
+/**
+ * @brief Feeds the controller.
+ *
+ * Exposed to Python as `Prefetch.update(drained, queued, now_ms)`.
+ *
+ * @return True if the high watermark changed.
+ */
+static PyObject *
+Prefetch_update(PrefetchObject *self, PyObject *args) {
+    Py_ssize_t drained;
+    Py_ssize_t queued;
+    long long now_ms;
+
+    if (!PyArg_ParseTuple(args, "nnL", &drained, &queued, &now_ms))
+        return NULL;
+    if (drained < 0 || queued < 0) {
+        PyErr_SetString(PyExc_ValueError, "drained and queued must be >= 0");
+        return NULL;
+    }
+    return PyBool_FromLong(prefetch_update(&self->ctrl, (size_t)drained, (size_t)queued, now_ms));
+}
+
+/**
+ * @brief Returns the high watermark currently chosen.
+ */
+static PyObject *
+Prefetch_get_high(PrefetchObject *self, void *closure) {
+    return PyLong_FromSize_t(self->ctrl.high);
+}
+
+/**
+ * @brief Returns the smoothed drain rate, or None before the first window.
+ */
+static PyObject *
+Prefetch_get_rate(PrefetchObject *self, void *closure) {
+    if (self->ctrl.rate < 0) {
+        Py_RETURN_NONE;
+    }
+    return PyFloat_FromDouble(self->ctrl.rate);
+}
+
+/**
+ * @brief Defines the methods available on Prefetch objects.
+ */
+static PyMethodDef Prefetch_methods[] = {
+    {"update", (PyCFunction)Prefetch_update, METH_VARARGS,
+     "Account for the drained count; returns whether the high watermark changed."},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Attribute accessors for Prefetch objects.
+ */
+static PyGetSetDef Prefetch_getset[] = {
+    {"high", (getter)Prefetch_get_high, NULL, "High watermark currently chosen.", NULL},
+    {"rate", (getter)Prefetch_get_rate, NULL,
+     "Smoothed drain rate in messages per second, or None.", NULL},
+    {NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the Python type object for the Prefetch controller.
+ */
+static PyTypeObject PrefetchType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_testing.Prefetch",
+    .tp_doc = "A PrefetchController",
+    .tp_basicsize = sizeof(PrefetchObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Prefetch_init,
+    .tp_methods = Prefetch_methods,
+    .tp_getset = Prefetch_getset,
+};
+
+/**
+ * @brief Runs a decoder on a payload, as the poller and `Message.decoded` would.
+ *
+ * Exposed to Python as `decode(decoder, payload)`. The payload object stands
+ * in for the Message, so it must export the same bytes through the buffer
+ * protocol.
+ *
+ * @return The decoded value, None for a None payload, or NULL with the
+ *         decoder's exception set.
+ */
+static PyObject *
+testing_decode(PyObject *module, PyObject *args) {
+    PyObject *spec;
+    PyObject *payload;
+
+    if (!PyArg_ParseTuple(args, "OO", &spec, &payload))
+        return NULL;
+    const Decoder *decoder = decoder_from_object(spec);
+    if (!decoder) {
+        return NULL;
+    }
+    rd_kafka_message_t rkmessage = {0};
+    if (payload != Py_None) {
+        if (!PyBytes_Check(payload)) {
+            PyErr_SetString(PyExc_TypeError, "payload must be bytes or None");
+            return NULL;
+        }
+        rkmessage.payload = PyBytes_AS_STRING(payload);
+        rkmessage.len = (size_t)PyBytes_GET_SIZE(payload);
+    }
+    void *result;
+    decoder_apply(decoder, &rkmessage, &result);
+    if (!rkmessage.payload) {
+        Py_RETURN_NONE;
+    }
+    PyObject *value = decoder->to_python(decoder->ctx, payload, &rkmessage, result);
+    decoder_release(decoder, result);
+    return value;
+}
+
+/**
+ * @brief Returns the number of synthetic messages not yet destroyed.
+ */
+static PyObject *
+testing_live_messages(PyObject *module, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromLong(atomic_load(&live_messages));
+}
+
+/**
+ * @brief Defines the methods available in the `_testing` module.
+ */
+static PyMethodDef testing_methods[] = {
+    {"decode", (PyCFunction)testing_decode, METH_VARARGS,
+     "Decode a payload with a built-in decoder or a decoder capsule."},
+    {"live_messages", (PyCFunction)testing_live_messages, METH_NOARGS,
+     "Number of synthetic messages not yet destroyed."},
+    {NULL, NULL, 0, NULL}  // Sentinel
+};
+
+/**
+ * @brief Readies a type and adds it to the module under its short name.
+ * @return 0 on success, -1 on failure.
+ */
+static int testing_add_type(PyObject *m, PyTypeObject *type) {
+    if (PyType_Ready(type) < 0)
+        return -1;
+    return PyModule_AddObjectRef(m, strrchr(type->tp_name, '.') + 1, (PyObject *)type);
+}
+
+/**
+ * @brief Populates a freshly created `_testing` module.
+ */
+static int testing_exec(PyObject *m) {
+    if (testing_add_type(m, &QueueType) < 0)
+        return -1;
+    if (testing_add_type(m, &OffsetTableType) < 0)
+        return -1;
+    if (testing_add_type(m, &PrefetchType) < 0)
+        return -1;
+    if (PyModule_AddIntConstant(m, "PREFETCH_WINDOW_MS", PREFETCH_WINDOW_MS) < 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief Module slots.
+ */
+static PyModuleDef_Slot testing_slots[] = {
+    {Py_mod_exec, testing_exec},
+#ifdef Py_mod_multiple_interpreters
+    {Py_mod_multiple_interpreters, Py_MOD_MULTIPLE_INTERPRETERS_NOT_SUPPORTED},
+#endif
+    {0, NULL}  // Sentinel
+};
+
+/**
+ * @brief Defines the `_testing` module.
+ */
+static struct PyModuleDef testing_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_testing",
+    .m_doc = "Test hooks into asynkaf's C internals.",
+    .m_size = 0,
+    .m_methods = testing_methods,
+    .m_slots = testing_slots,
+};
+
+/**
+ * @brief Initializes the `_testing` module.
+ */
+PyMODINIT_FUNC PyInit__testing(void) {
+    return PyModuleDef_Init(&testing_module);
+}
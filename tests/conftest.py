@@ -0,0 +1,15 @@
+import pytest
+
+
+@pytest.fixture
+def topic() -> str:
+    return "asynkaf-test"
+
+
+@pytest.fixture
+def cluster(topic):
+    """A one-broker librdkafka mock cluster with a two-partition ``topic``."""
+    _bench = pytest.importorskip("asynkaf._bench", reason="build with ASYNKAF_BENCH=1 for the mock cluster")
+    cluster = _bench.MockCluster(brokers=1)
+    cluster.create_topic(topic, partitions=2)
+    return cluster
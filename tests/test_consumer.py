@@ -0,0 +1,436 @@
+import asyncio
+import gc
+import json
+import os
+import weakref
+
+import pytest
+
+_core = pytest.importorskip("asynkaf._core")
+
+from asynkaf import Consumer, Producer
+from asynkaf.consumer import _wait_readable
+
+GROUP = "asynkaf-test-group"
+DEADLINE = 30.0
+
+
+@pytest.fixture
+def pipe():
+    read_fd, write_fd = os.pipe()
+    yield read_fd, write_fd
+    os.close(read_fd)
+    os.close(write_fd)
+
+
+def run(coro):
+    return asyncio.run(asyncio.wait_for(coro, 10))
+
+
+def test_concurrent_waiters_are_all_woken(pipe):
+    read_fd, write_fd = pipe
+
+    async def main():
+        loop = asyncio.get_running_loop()
+        waits = [asyncio.create_task(_wait_readable(loop, read_fd, None)) for _ in range(3)]
+        await asyncio.sleep(0.05)
+        assert not any(wait.done() for wait in waits)
+        os.write(write_fd, b"x")
+        await asyncio.gather(*waits)
+        # Nothing is left registered for the fd.
+        assert not loop.remove_reader(read_fd)
+
+    run(main())
+
+
+def test_a_finished_waiter_does_not_unregister_the_others(pipe):
+    read_fd, write_fd = pipe
+
+    async def main():
+        loop = asyncio.get_running_loop()
+        forever = asyncio.create_task(_wait_readable(loop, read_fd, None))
+        await _wait_readable(loop, read_fd, 0.05)
+        cancelled = asyncio.create_task(_wait_readable(loop, read_fd, None))
+        await asyncio.sleep(0.05)
+        cancelled.cancel()
+        with pytest.raises(asyncio.CancelledError):
+            await cancelled
+        assert not forever.done()
+        os.write(write_fd, b"x")
+        await forever
+        assert not loop.remove_reader(read_fd)
+
+    run(main())
+
+
+def test_waiters_of_different_fds_are_independent(pipe):
+    read_fd, write_fd = pipe
+    other_read, other_write = os.pipe()
+
+    async def main():
+        loop = asyncio.get_running_loop()
+        first = asyncio.create_task(_wait_readable(loop, read_fd, None))
+        second = asyncio.create_task(_wait_readable(loop, other_read, None))
+        await asyncio.sleep(0.05)
+        os.write(other_write, b"x")
+        await second
+        assert not first.done()
+        os.write(write_fd, b"x")
+        await first
+
+    try:
+        run(main())
+    finally:
+        os.close(other_read)
+        os.close(other_write)
+
+
+def test_timeout(pipe):
+    read_fd, _ = pipe
+
+    async def main():
+        loop = asyncio.get_running_loop()
+        start = loop.time()
+        await _wait_readable(loop, read_fd, 0.05)
+        assert loop.time() - start >= 0.04
+
+    run(main())
+
+
+async def produce(bootstrap_servers: str, topic: str, values) -> None:
+    producer = Producer(bootstrap_servers, linger_ms=1)
+    futures = [await producer.send(topic, value, partition=i % 2) for i, value in enumerate(values)]
+    await producer.flush()
+    for future in futures:
+        await future
+    await producer.close()
+
+
+async def consume(consumer: Consumer, count: int) -> list:
+    async def collect():
+        records = []
+        while len(records) < count:
+            records += await consumer.getmany(100, timeout_ms=500)
+        return records
+
+    return await asyncio.wait_for(collect(), DEADLINE)
+
+
+def group_consumer(cluster, **options) -> Consumer:
+    options.setdefault("config", {"auto.offset.reset": "earliest"})
+    return Consumer(cluster.bootstrap_servers, GROUP, **options)
+
+
+def test_getmany_and_commit_round_trip(cluster, topic):
+    values = [b"value-%d" % n for n in range(20)]
+
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, values)
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic])
+        records = await consume(consumer, len(values))
+        assert sorted(bytes(record.value) for record in records) == sorted(values)
+        consumer.store_offsets(records)
+        await consumer.commit()
+        await consumer.close()
+
+        # The group resumes after the committed offsets: only new records arrive.
+        await produce(cluster.bootstrap_servers, topic, [b"new-0", b"new-1"])
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic])
+        records = await consume(consumer, 2)
+        await asyncio.sleep(1)
+        records += await consumer.getmany(100)
+        assert sorted(bytes(record.value) for record in records) == [b"new-0", b"new-1"]
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+def test_unstored_records_are_not_committed(cluster, topic):
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, [b"a", b"b"])
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic])
+        records = await consume(consumer, 2)
+        # Only the first record is processed.
+        first = min(records, key=lambda record: bytes(record.value))
+        consumer.store_offset(first)
+        await consumer.commit()
+        await consumer.close()
+
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic])
+        records = await consume(consumer, 1)
+        assert [bytes(record.value) for record in records] == [b"b"]
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+async def until(done) -> None:
+    while not done():
+        await asyncio.sleep(0.05)
+
+
+async def settle(consumers, done) -> None:
+    """Keep ``consumers`` polling, which delivers their rebalance events, until ``done()``."""
+    async def poll():
+        while not done():
+            for consumer in consumers:
+                await consumer.getmany(100, timeout_ms=100)
+
+    await asyncio.wait_for(poll(), DEADLINE)
+
+
+def test_rebalance_listener_sees_assign_and_revoke(cluster, topic):
+    assigned, revoked = [], []
+
+    async def main():
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic], on_assign=assigned.extend, on_revoke=revoked.extend)
+        await settle([consumer], lambda: len(assigned) == 2)
+        assert sorted(assigned) == [(topic, 0), (topic, 1)]
+        assert revoked == []
+        # Leaving the group revokes everything it held.
+        await consumer.close()
+        assert sorted(revoked) == [(topic, 0), (topic, 1)]
+
+    asyncio.run(main())
+
+
+def test_cooperative_rebalance_revokes_only_what_moves(cluster, topic):
+    first_assigned, first_revoked, second_assigned = [], [], []
+
+    async def main():
+        first = group_consumer(cluster)
+        first.subscribe([topic], on_assign=first_assigned.extend, on_revoke=first_revoked.extend)
+        await settle([first], lambda: len(first_assigned) == 2)
+
+        second = group_consumer(cluster)
+        second.subscribe([topic], on_assign=second_assigned.extend)
+        await settle([first, second], lambda: len(second_assigned) == 1)
+        # The first consumer gives up one partition and keeps the other.
+        assert len(first_revoked) == 1
+        assert first_revoked == second_assigned
+        assert len(first_assigned) == 2
+        await second.close()
+        await first.close()
+
+    asyncio.run(main())
+
+
+def test_subscribed_consumer_is_collected(cluster, topic):
+    def on_assign(partitions):
+        pass
+
+    async def main():
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic], on_assign=on_assign)
+        await consumer.close()
+        return weakref.ref(consumer)
+
+    ref = asyncio.run(main())
+    gc.collect()
+    assert ref() is None
+
+
+def test_unclosed_subscribed_consumer_is_collected(cluster, topic):
+    assigned = []
+    consumer = group_consumer(cluster)
+    consumer.subscribe([topic], on_assign=assigned.extend)
+    asyncio.run(settle([consumer], lambda: assigned))
+    ref = weakref.ref(consumer)
+    del consumer
+    gc.collect()
+    # Nothing but the consumer itself holds it, so it goes away and stops
+    # its poller thread.
+    assert ref() is None
+
+
+MALFORMED = b'{"n": '
+
+
+def test_decoded_values(cluster, topic):
+    values = [json.dumps({"n": n}).encode() for n in range(20)]
+    values[7] = MALFORMED
+
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, values)
+        consumer = group_consumer(cluster, decoder="json")
+        consumer.subscribe([topic])
+        records = await consume(consumer, len(values))
+        decoded = []
+        for record in records:
+            if bytes(record.value) == MALFORMED:
+                # One bad payload fails on its own; the batch is still usable.
+                with pytest.raises(ValueError, match="invalid JSON payload"):
+                    record.decoded
+            else:
+                decoded.append(record.decoded["n"])
+        assert sorted(decoded) == [n for n in range(20) if n != 7]
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+def test_decoded_null_payload(cluster, topic):
+    async def main():
+        producer = Producer(cluster.bootstrap_servers)
+        await producer.send_and_wait(topic, None, key=b"tombstone", partition=0)
+        await producer.close()
+
+        consumer = group_consumer(cluster, decoder="json")
+        consumer.subscribe([topic])
+        (record,) = await consume(consumer, 1)
+        assert record.value is None
+        assert record.decoded is None
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+async def iterate(source, records: list) -> None:
+    async for record in source:
+        records.append(record)
+
+
+def test_async_for_reads_every_record_and_ends_on_close(cluster, topic):
+    values = [b"value-%d" % n for n in range(20)]
+    records = []
+
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, values)
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic])
+        task = asyncio.create_task(iterate(consumer, records))
+        await asyncio.wait_for(until(lambda: len(records) == len(values)), DEADLINE)
+        assert not task.done()
+        await consumer.close()
+        await asyncio.wait_for(task, DEADLINE)
+
+    asyncio.run(main())
+    assert sorted(bytes(record.value) for record in records) == sorted(values)
+
+
+def test_async_for_on_a_closed_consumer_ends(cluster, topic):
+    async def main():
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic])
+        await consumer.close()
+        records = []
+        await asyncio.wait_for(iterate(consumer, records), DEADLINE)
+        assert records == []
+
+    asyncio.run(main())
+
+
+def test_partition_consumer_async_for(cluster, topic):
+    values = [b"value-%d" % n for n in range(20)]
+    records = []
+
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, values)
+        consumer = group_consumer(cluster, partition_queues=True)
+        partition = consumer.partition(topic, 0)
+        consumer.subscribe([topic])
+        task = asyncio.create_task(iterate(partition, records))
+        # produce() alternates partitions, so partition 0 gets the even values.
+        await asyncio.wait_for(until(lambda: len(records) == len(values) // 2), DEADLINE)
+        await consumer.close()
+        await asyncio.wait_for(task, DEADLINE)
+
+    asyncio.run(main())
+    assert {(record.topic, record.partition) for record in records} == {(topic, 0)}
+    offsets = [record.offset for record in records]
+    assert offsets == sorted(offsets)
+    assert [bytes(record.value) for record in records] == values[::2]
+
+
+def test_buffered_message_steps_without_a_future(cluster, topic):
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, [b"a", b"b"])
+        consumer = group_consumer(cluster)
+        consumer.subscribe([topic])
+        # Wait for both records to be buffered without taking any.
+        await asyncio.wait_for(until(lambda: consumer.metrics()["queue_size"] == 2), DEADLINE)
+        iterator = aiter(consumer)
+        step = anext(iterator)
+        assert type(step) is _core.Completed
+        first = await step
+        second = await anext(iterator)
+        assert sorted([bytes(first.value), bytes(second.value)]) == [b"a", b"b"]
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+def test_assign_without_a_group_starts_at_the_given_offset(cluster, topic):
+    values = [b"value-%d" % n for n in range(20)]
+
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, values)
+        consumer = Consumer(cluster.bootstrap_servers)
+        await consumer.assign([(topic, 0, 4)])
+        records = await consume(consumer, 6)
+        assert [(record.partition, record.offset) for record in records] == [(0, n) for n in range(4, 10)]
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+def test_seek_discards_buffered_records(cluster, topic):
+    values = [b"value-%d" % n for n in range(20)]
+
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, values)
+        consumer = Consumer(cluster.bootstrap_servers)
+        await consumer.assign([(topic, 0, 0)])
+        await asyncio.wait_for(until(lambda: consumer.metrics()["queue_size"] == 10), DEADLINE)
+        records = await consumer.getmany(3)
+        assert [record.offset for record in records] == [0, 1, 2]
+        # Offsets 3..9 are still buffered; none of them may come out after
+        # the seek, only the records fetched again from offset 1.
+        await consumer.seek(topic, 0, 1)
+        records = await consume(consumer, 9)
+        assert [record.offset for record in records] == list(range(1, 10))
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+def test_offsets_for_times(cluster, topic):
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, [b"a", b"b"])
+        consumer = Consumer(cluster.bootstrap_servers)
+        found = await consumer.offsets_for_times({(topic, 0): 0, (topic, 1): 2**62})
+        assert found == {(topic, 0): 0, (topic, 1): -1}
+        await consumer.close()
+
+    asyncio.run(main())
+
+
+def test_prefetch_reports_its_buffer_size(cluster, topic):
+    values = [b"value-%d" % n for n in range(200)]
+
+    async def main():
+        await produce(cluster.bootstrap_servers, topic, values)
+        consumer = group_consumer(cluster, prefetch_ms=100)
+        consumer.subscribe([topic])
+        await consume(consumer, len(values))
+        metrics = consumer.metrics()
+        # The controller always keeps some buffer, even before it has a rate.
+        assert metrics["prefetch_messages"] > 0
+        assert metrics["drain_per_sec"] >= 0
+        await consumer.close()
+
+        off = group_consumer(cluster)
+        assert off.metrics()["prefetch_messages"] == 0
+        await off.close()
+
+    asyncio.run(main())
+
+
+def test_negative_prefetch_is_rejected(cluster):
+    with pytest.raises(ValueError, match="prefetch_ms"):
+        group_consumer(cluster, prefetch_ms=-1)
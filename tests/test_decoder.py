@@ -0,0 +1,147 @@
+import json
+import struct
+
+import pytest
+
+_testing = pytest.importorskip("asynkaf._testing")
+decode = _testing.decode
+
+
+def frames(*chunks: bytes) -> bytes:
+    return b"".join(struct.pack(">I", len(chunk)) + chunk for chunk in chunks)
+
+
+def confluent(schema_id: int, body: bytes) -> bytes:
+    return b"\x00" + struct.pack(">I", schema_id) + body
+
+
+@pytest.mark.parametrize(
+    "document",
+    [
+        "null",
+        "true",
+        "false",
+        "0",
+        "-17",
+        "9223372036854775807",
+        "-9223372036854775808",
+        "123456789012345678901234567890",
+        "3.25",
+        "-1.5e-3",
+        "6E+2",
+        '""',
+        '"plain"',
+        r'"esc\"ap\\ed\/\b\f\n\r\t"',
+        r'"é中😀"',
+        '"café"',
+        "[]",
+        "{}",
+        ' \t\r\n[1, "two", 3.0, null, [true, false], {"k": {}}] \n',
+        '{"id": 7, "tags": ["a", "b"], "nested": {"deep": [[[]]]}, "id2": -0}',
+        '{"a": 1, "a": 2}',
+        "[" * 100 + "]" * 100,
+    ],
+)
+def test_json_matches_stdlib(document):
+    assert decode("json", document.encode()) == json.loads(document)
+
+
+def test_json_repeated_keys_are_shared():
+    records = decode("json", b'[{"name": 1}, {"name": 2}]')
+    first, second = (next(iter(record)) for record in records)
+    assert first is second
+
+
+@pytest.mark.parametrize(
+    "payload",
+    [
+        b"",
+        b"   ",
+        b"{",
+        b"[1, 2",
+        b"[1,]",
+        b'{"a": 1,}',
+        b'{"a" 1}',
+        b"{1: 2}",
+        b"tru",
+        b"nul",
+        b"01",
+        b"1.",
+        b"-",
+        b"1e",
+        b"+1",
+        b'"unterminated',
+        b'"bad \\x escape"',
+        b'"\\u12"',
+        b'"raw \x01 control"',
+        b"1 2",
+        b"[1] x",
+        b"[" * 600 + b"]" * 600,
+    ],
+)
+def test_json_malformed(payload):
+    with pytest.raises(ValueError, match="invalid JSON payload"):
+        decode("json", payload)
+
+
+def test_json_invalid_utf8():
+    with pytest.raises(ValueError):
+        decode("json", b'"\xff"')
+
+
+def test_frames():
+    payload = frames(b"first", b"", b"third")
+    result = decode("frames", payload)
+    assert isinstance(result, tuple)
+    assert [bytes(frame) for frame in result] == [b"first", b"", b"third"]
+    assert all(isinstance(frame, memoryview) for frame in result)
+
+
+def test_frames_empty_payload():
+    assert decode("frames", b"") == ()
+
+
+@pytest.mark.parametrize(
+    "payload, bad",
+    [
+        (b"\x00\x00", 0),
+        (struct.pack(">I", 10) + b"short", 0),
+        (frames(b"ok") + b"\x00\x00\x00", 6),
+        (frames(b"ok") + struct.pack(">I", 2) + b"x", 6),
+    ],
+)
+def test_frames_truncated(payload, bad):
+    with pytest.raises(ValueError, match=f"truncated frame at offset {bad}$"):
+        decode("frames", payload)
+
+
+@pytest.mark.parametrize("schema_id", [0, 1, 0x01020304, 0xFFFFFFFF])
+def test_confluent(schema_id):
+    found, body = decode("confluent", confluent(schema_id, b"avro-bytes"))
+    assert found == schema_id
+    assert isinstance(body, memoryview)
+    assert bytes(body) == b"avro-bytes"
+
+
+def test_confluent_empty_body():
+    found, body = decode("confluent", confluent(5, b""))
+    assert found == 5
+    assert bytes(body) == b""
+
+
+@pytest.mark.parametrize("payload", [b"", b"\x00\x00\x00\x01", b"\x01\x00\x00\x00\x01body"])
+def test_confluent_malformed(payload):
+    with pytest.raises(ValueError, match="wire-format header"):
+        decode("confluent", payload)
+
+
+@pytest.mark.parametrize("name", ["json", "frames", "confluent"])
+def test_null_payload_is_none(name):
+    assert decode(name, None) is None
+
+
+def test_unknown_decoder():
+    with pytest.raises(ValueError, match="decoder must be"):
+        decode("yaml", b"{}")
+    with pytest.raises(TypeError, match="decoder must be a str"):
+        decode(42, b"{}")
@@ -0,0 +1,93 @@
+import pytest
+
+_testing = pytest.importorskip("asynkaf._testing")
+
+
+@pytest.fixture
+def table():
+    return _testing.OffsetTable()
+
+
+def test_nothing_to_take(table):
+    assert table.take_dirty() is None
+
+
+def test_commits_the_next_offset_to_consume(table):
+    table.store("t", 0, 41)
+    assert table.take_dirty() == [("t", 0, 42)]
+
+
+def test_offset_zero_commits_one(table):
+    table.store("t", 0, 0)
+    assert table.take_dirty() == [("t", 0, 1)]
+
+
+def test_highest_offset_wins(table):
+    table.store("t", 0, 5)
+    table.store("t", 0, 9)
+    table.store("t", 0, 7)
+    assert table.pending() == 3
+    assert table.take_dirty() == [("t", 0, 10)]
+    assert table.pending() == 0
+
+
+def test_offsets_only_move_forward(table):
+    table.store("t", 0, 9)
+    table.take_dirty()
+    table.store("t", 0, 9)
+    table.store("t", 0, 3)
+    assert table.take_dirty() is None
+    table.store("t", 0, 10)
+    assert table.take_dirty() == [("t", 0, 11)]
+
+
+def test_only_changed_partitions_are_taken(table):
+    table.store("t", 0, 1)
+    table.store("t", 1, 2)
+    table.store("u", 0, 3)
+    assert sorted(table.take_dirty()) == [("t", 0, 2), ("t", 1, 3), ("u", 0, 4)]
+    table.store("t", 1, 5)
+    assert table.take_dirty() == [("t", 1, 6)]
+
+
+def test_forget_drops_the_entry(table):
+    table.store("t", 0, 9)
+    table.store("t", 1, 9)
+    table.forget([("t", 0)])
+    assert table.take_dirty() == [("t", 1, 10)]
+    # A reassigned partition starts over, so a rewind can be committed.
+    table.store("t", 0, 2)
+    assert table.take_dirty() == [("t", 0, 3)]
+
+
+def test_release_drops_clean_entries_at_once(table):
+    table.store("t", 0, 9)
+    table.take_dirty()
+    table.release([("t", 0)])
+    table.store("t", 0, 2)
+    assert table.take_dirty() == [("t", 0, 3)]
+
+
+def test_release_keeps_dirty_entries_until_taken(table):
+    table.store("t", 0, 9)
+    table.release([("t", 0)])
+    assert table.take_dirty() == [("t", 0, 10)]
+    assert table.take_dirty() is None
+    table.store("t", 0, 2)
+    assert table.take_dirty() == [("t", 0, 3)]
+
+
+def test_store_after_release_keeps_the_entry(table):
+    table.store("t", 0, 9)
+    table.release([("t", 0)])
+    table.store("t", 0, 12)
+    assert table.take_dirty() == [("t", 0, 13)]
+    # Owned again: later stores below it are still ignored.
+    table.store("t", 0, 4)
+    assert table.take_dirty() is None
+
+
+def test_many_partitions(table):
+    for partition in range(100):
+        table.store("t", partition, partition * 10)
+    assert sorted(table.take_dirty()) == [("t", p, p * 10 + 1) for p in range(100)]
@@ -0,0 +1,84 @@
+import pytest
+
+_testing = pytest.importorskip("asynkaf._testing")
+WINDOW = _testing.PREFETCH_WINDOW_MS
+
+
+def controller(target_ms=1000, floor=100, ceiling=100_000):
+    return _testing.Prefetch(target_ms, floor, ceiling, drained=0, now_ms=0)
+
+
+def test_starts_at_the_ceiling():
+    ctrl = controller()
+    assert ctrl.high == 100_000
+    assert ctrl.rate is None
+
+
+def test_waits_for_a_full_window():
+    ctrl = controller()
+    assert not ctrl.update(10, 50, WINDOW - 1)
+    assert ctrl.rate is None
+    assert ctrl.high == 100_000
+
+
+def test_sizes_the_buffer_to_the_drain_rate():
+    ctrl = controller()
+    # 500 messages in 100 ms is 5000/s; one second of that is 5000 messages.
+    assert ctrl.update(500, 50, WINDOW)
+    assert ctrl.rate == pytest.approx(5000.0)
+    assert ctrl.high == 5000
+
+
+def test_clamps_to_the_bounds():
+    ctrl = controller(floor=100, ceiling=1000)
+    assert ctrl.update(1, 10, WINDOW)
+    assert ctrl.high == 100
+    fast = controller(floor=100, ceiling=1000)
+    fast.update(10**6, 10, WINDOW)
+    assert fast.high == 1000
+
+
+def test_rate_is_smoothed():
+    ctrl = controller()
+    ctrl.update(500, 50, WINDOW)
+    ctrl.update(500 + 1500, 50, 2 * WINDOW)
+    # 0.3 of the way from 5000/s to the new window's 15000/s.
+    assert ctrl.rate == pytest.approx(8000.0)
+    assert ctrl.high == 8000
+
+
+def test_small_changes_are_ignored():
+    ctrl = controller()
+    ctrl.update(500, 50, WINDOW)
+    assert ctrl.high == 5000
+    # The next window nudges the smoothed rate by less than the hysteresis.
+    assert not ctrl.update(500 + 600, 50, 2 * WINDOW)
+    assert ctrl.high == 5000
+    assert ctrl.rate == pytest.approx(5300.0)
+
+
+def test_empty_queue_never_shrinks_the_buffer():
+    ctrl = controller()
+    ctrl.update(500, 50, WINDOW)
+    assert ctrl.high == 5000
+    # Python outran the fetchers: 50/s only says how fast messages came in.
+    assert not ctrl.update(505, 0, 2 * WINDOW)
+    assert ctrl.high == 5000
+    # It may still deepen it.
+    assert ctrl.update(505 + 10_000, 0, 3 * WINDOW)
+    assert ctrl.high > 5000
+
+
+def test_reaching_a_bound_is_always_applied():
+    ctrl = controller(floor=4900, ceiling=100_000)
+    ctrl.update(500, 50, WINDOW)
+    assert ctrl.high == 5000
+    # A step to the floor is below the hysteresis, but still taken.
+    assert ctrl.update(500 + 100, 50, 2 * WINDOW)
+    assert ctrl.high == 4900
+
+
+def test_late_window_uses_its_real_length():
+    ctrl = controller()
+    assert ctrl.update(1000, 50, 4 * WINDOW)
+    assert ctrl.rate == pytest.approx(2500.0)
@@ -0,0 +1,225 @@
+import asyncio
+import gc
+import time
+
+import pytest
+
+_core = pytest.importorskip("asynkaf._core")
+
+from asynkaf import Consumer, Producer
+
+
+def assert_pinned(value: bytearray) -> None:
+    with pytest.raises(BufferError):
+        value.extend(b"!")
+
+
+def test_value_is_pinned_until_the_producer_goes_away():
+    # Nothing listens there, so the message stays queued.
+    producer = _core.create_producer("127.0.0.1:1")
+    value = bytearray(b"payload")
+    producer.produce("t", value)
+    assert_pinned(value)
+    del producer
+    gc.collect()
+    value.extend(b"!")
+
+
+def test_value_is_released_after_delivery(cluster, topic):
+    async def main():
+        producer = Producer(cluster.bootstrap_servers)
+        value = bytearray(b"x" * 1000)
+        await producer.send_and_wait(topic, value, partition=0)
+        value.extend(b"!")
+        await producer.close()
+
+    asyncio.run(main())
+
+
+def test_in_flight_value_is_released_on_dealloc(cluster, topic):
+    producer = _core.create_producer(cluster.bootstrap_servers, linger_ms=0)
+    producer.produce(topic, b"warm-up", None, 0)
+    assert producer.flush(10_000) == 0
+    # Responses now take long enough for the next message to be in flight
+    # when the producer goes away.
+    cluster.set_rtt(1, 3000)
+    value = bytearray(b"x" * 1000)
+    producer.produce(topic, value, None, 0)
+    time.sleep(0.5)
+    assert_pinned(value)
+    del producer
+    gc.collect()
+    value.extend(b"!")
+
+
+# Kafka ApiKeys and error codes used to inject transaction failures.
+ADD_OFFSETS_TO_TXN = 25
+GROUP_AUTHORIZATION_FAILED = 30
+
+GROUP = "asynkaf-txn-group"
+OUT = "asynkaf-txn-out"
+DEADLINE = 30.0
+
+
+async def fill(cluster, topic: str, values) -> None:
+    producer = Producer(cluster.bootstrap_servers)
+    for value in values:
+        await producer.send_and_wait(topic, value, partition=0)
+    await producer.close()
+
+
+async def consume(consumer: Consumer, count: int) -> list:
+    async def collect():
+        records = []
+        while len(records) < count:
+            records += await consumer.getmany(100, timeout_ms=500)
+        return records
+
+    return await asyncio.wait_for(collect(), DEADLINE)
+
+
+async def subscribed(cluster, topic: str) -> Consumer:
+    consumer = Consumer(cluster.bootstrap_servers, GROUP, config={"auto.offset.reset": "earliest"})
+    consumer.subscribe([topic])
+    return consumer
+
+
+async def committed_values(cluster, topic: str, count: int) -> list:
+    """Return the values a fresh consumer of the group reads, past its committed offset."""
+    consumer = await subscribed(cluster, topic)
+    records = await consume(consumer, count)
+    await asyncio.sleep(1)
+    records += await consumer.getmany(100)
+    await consumer.close()
+    return [bytes(record.value) for record in records]
+
+
+@pytest.fixture
+def txn_producer(cluster):
+    cluster.create_topic(OUT, partitions=1)
+    return Producer(cluster.bootstrap_servers, transactional_id="asynkaf-test-txn")
+
+
+def test_transaction_commits_the_consumed_offsets(cluster, topic, txn_producer):
+    async def main():
+        await fill(cluster, topic, [b"a", b"b", b"c"])
+        consumer = await subscribed(cluster, topic)
+        await txn_producer.init_transactions(consumer)
+        records = await consume(consumer, 3)
+        async with txn_producer.transaction():
+            for record in records:
+                await txn_producer.send(OUT, bytes(record.value).upper())
+                consumer.store_offset(record)
+        # Bound consumers leave committing to the producer.
+        with pytest.raises(RuntimeError, match="transactions"):
+            await consumer.commit()
+        await consumer.close()
+
+        await fill(cluster, topic, [b"d"])
+        assert await committed_values(cluster, topic, 1) == [b"d"]
+        await txn_producer.close()
+
+    asyncio.run(main())
+
+
+def test_aborted_transaction_commits_nothing(cluster, topic, txn_producer):
+    async def main():
+        await fill(cluster, topic, [b"a", b"b"])
+        consumer = await subscribed(cluster, topic)
+        await txn_producer.init_transactions(consumer)
+        records = await consume(consumer, 2)
+        with pytest.raises(ZeroDivisionError):
+            async with txn_producer.transaction():
+                await txn_producer.send(OUT, b"never")
+                consumer.store_offsets(records)
+                1 / 0
+        await consumer.close()
+
+        assert sorted(await committed_values(cluster, topic, 2)) == [b"a", b"b"]
+        await txn_producer.close()
+
+    asyncio.run(main())
+
+
+def test_abortable_offset_error_lets_the_next_transaction_commit(cluster, topic, txn_producer):
+    async def main():
+        await fill(cluster, topic, [b"a", b"b"])
+        consumer = await subscribed(cluster, topic)
+        await txn_producer.init_transactions(consumer)
+        records = await consume(consumer, 2)
+
+        cluster.push_request_errors(ADD_OFFSETS_TO_TXN, [GROUP_AUTHORIZATION_FAILED])
+        with pytest.raises(_core.KafkaError) as excinfo:
+            async with txn_producer.transaction():
+                consumer.store_offsets(records)
+        assert excinfo.value.txn_requires_abort
+
+        # The abort made the consumer forget the offsets, so storing them
+        # again puts them in the next transaction.
+        async with txn_producer.transaction():
+            consumer.store_offsets(records)
+        await consumer.close()
+
+        await fill(cluster, topic, [b"c"])
+        assert await committed_values(cluster, topic, 1) == [b"c"]
+        await txn_producer.close()
+
+    asyncio.run(main())
+
+
+def test_timed_out_commit_can_be_retried(cluster, topic, txn_producer):
+    async def main():
+        await fill(cluster, topic, [b"a", b"b"])
+        consumer = await subscribed(cluster, topic)
+        await txn_producer.init_transactions(consumer)
+        records = await consume(consumer, 2)
+
+        txn_producer.begin_transaction()
+        await txn_producer.send(OUT, b"out")
+        consumer.store_offsets(records)
+        cluster.set_rtt(1, 3000)
+        with pytest.raises(_core.KafkaError) as excinfo:
+            await txn_producer.commit_transaction(timeout_ms=500)
+        assert excinfo.value.retriable
+        cluster.set_rtt(1, 0)
+        # The retry still carries the offsets the first attempt took.
+        await txn_producer.commit_transaction()
+        await consumer.close()
+
+        await fill(cluster, topic, [b"c"])
+        assert await committed_values(cluster, topic, 1) == [b"c"]
+        await txn_producer.close()
+
+    asyncio.run(main())
+
+
+def test_failed_init_leaves_the_consumer_unbound(cluster, topic, txn_producer):
+    async def main():
+        await fill(cluster, topic, [b"a"])
+        consumer = await subscribed(cluster, topic)
+        records = await consume(consumer, 1)
+        cluster.set_rtt(1, 3000)
+        with pytest.raises(_core.KafkaError):
+            await txn_producer.init_transactions(consumer, timeout_ms=500)
+        cluster.set_rtt(1, 0)
+        # Still committing on its own.
+        consumer.store_offsets(records)
+        await consumer.commit()
+
+        await txn_producer.init_transactions(consumer)
+        with pytest.raises(RuntimeError, match="transactions"):
+            await consumer.commit()
+        await consumer.close()
+        await txn_producer.close()
+
+    asyncio.run(main())
+
+
+def test_init_transactions_rejects_a_consumer_without_group(cluster, txn_producer):
+    async def main():
+        consumer = Consumer(cluster.bootstrap_servers)
+        with pytest.raises(RuntimeError, match="group_id"):
+            await txn_producer.init_transactions(consumer)
+        await consumer.close()
+
+    asyncio.run(main())
@@ -0,0 +1,259 @@
+import threading
+
+import pytest
+
+_testing = pytest.importorskip("asynkaf._testing")
+
+
+@pytest.fixture(params=[64, 0], ids=["ring", "list"])
+def queue(request):
+    live = _testing.live_messages()
+    queue = _testing.Queue(request.param)
+    yield queue
+    del queue
+    assert _testing.live_messages() == live
+
+
+def drain(queue):
+    popped = []
+    while batch := queue.pop(7):
+        popped.extend(batch)
+    return popped
+
+
+def test_fifo(queue):
+    assert queue.push("t", 0, range(20)) == 20
+    assert queue.size() == 20
+    assert drain(queue) == [("t", 0, offset) for offset in range(20)]
+    assert queue.size() == 0
+    assert queue.drained() == 20
+
+
+def test_try_pop(queue):
+    assert queue.try_pop() is None
+    queue.push("t", 0, [1, 2])
+    assert queue.try_pop() == ("t", 0, 1)
+    assert queue.pop() == [("t", 0, 2)]
+    assert queue.try_pop() is None
+
+
+def test_capacity_is_rounded_up_to_a_power_of_two():
+    queue = _testing.Queue(5)
+    assert queue.push("t", 0, range(10)) == 8
+    assert drain(queue) == [("t", 0, offset) for offset in range(8)]
+
+
+def test_full_ring_takes_the_leading_messages():
+    queue = _testing.Queue(4)
+    assert queue.push("t", 0, range(6)) == 4
+    assert queue.push("t", 0, [6]) == 0
+    assert queue.pop(1) == [("t", 0, 0)]
+    assert queue.push("t", 0, [6, 7]) == 1
+    assert drain(queue) == [("t", 0, offset) for offset in (1, 2, 3, 6)]
+
+
+def test_list_is_unbounded():
+    queue = _testing.Queue(0)
+    assert queue.push("t", 0, range(100_000)) == 100_000
+    assert queue.size() == 100_000
+
+
+def test_wraparound():
+    queue = _testing.Queue(8)
+    popped = []
+    for round in range(50):
+        queue.push("t", round % 3, [round * 10 + i for i in range(5)])
+        popped += queue.pop(5)
+    assert popped == [("t", round % 3, round * 10 + i) for round in range(50) for i in range(5)]
+
+
+def test_one_producer_one_consumer():
+    queue = _testing.Queue(64)
+    count = 20_000
+
+    def produce():
+        offset = 0
+        while offset < count:
+            offset += queue.push("t", 0, range(offset, min(offset + 50, count)))
+
+    producer = threading.Thread(target=produce)
+    producer.start()
+    popped = []
+    while len(popped) < count:
+        popped += [offset for _, _, offset in queue.pop(37)]
+    producer.join()
+    assert popped == list(range(count))
+
+
+def test_destroy_frees_queued_messages():
+    live = _testing.live_messages()
+    queue = _testing.Queue(16)
+    queue.push("t", 0, range(10))
+    assert _testing.live_messages() == live + 10
+    del queue
+    assert _testing.live_messages() == live
+
+
+def test_no_watermarks(queue):
+    queue.push("t", 0, range(1000), size=100)
+    assert not queue.above_high()
+    assert queue.below_low()
+
+
+def test_message_watermarks(queue):
+    queue.set_watermarks(10, 4, 0, 0)
+    queue.push("t", 0, range(9))
+    assert not queue.above_high()
+    queue.push("t", 0, [9])
+    assert queue.above_high()
+    queue.pop(5)
+    # Between the marks: no longer high, not yet drained.
+    assert not queue.above_high()
+    assert not queue.below_low()
+    queue.pop(1)
+    assert queue.below_low()
+
+
+def test_byte_watermarks(queue):
+    queue.set_watermarks(0, 0, 1000, 400)
+    queue.push("t", 0, range(9), size=100)
+    assert queue.bytes() == 900
+    assert not queue.above_high()
+    queue.push("t", 0, [9], size=100)
+    assert queue.above_high()
+    queue.pop(6)
+    assert queue.bytes() == 400
+    assert queue.below_low()
+
+
+def test_either_dimension_makes_the_queue_high(queue):
+    queue.set_watermarks(50, 10, 1000, 100)
+    queue.push("t", 0, [0], size=1000)
+    assert queue.above_high()
+    queue.pop()
+    queue.push("t", 0, range(50))
+    assert queue.above_high()
+    queue.pop(39)
+    # 11 messages and no bytes: drained only once both dimensions are.
+    assert not queue.below_low()
+    queue.pop(1)
+    assert queue.below_low()
+
+
+def test_bytes_follow_the_payloads(queue):
+    queue.push("t", 0, range(4), size=10)
+    queue.push("t", 1, range(2), size=25)
+    assert queue.bytes() == 90
+    queue.pop(5)
+    assert queue.bytes() == 25
+    queue.pop()
+    assert queue.bytes() == 0
+
+
+def test_purge_keeps_the_order_of_the_rest(queue):
+    for offset in range(6):
+        queue.push("t", offset % 2, [offset])
+    assert queue.purge("t", 1) == 3
+    assert queue.size() == 3
+    assert drain(queue) == [("t", 0, 0), ("t", 0, 2), ("t", 0, 4)]
+
+
+def test_purge_without_match(queue):
+    queue.push("t", 0, [0, 1])
+    assert queue.purge("u", 0) == 0
+    assert drain(queue) == [("t", 0, 0), ("t", 0, 1)]
+
+
+def test_purge_then_refill_a_full_ring():
+    queue = _testing.Queue(8)
+    queue.push("t", 0, range(4))
+    queue.push("t", 1, range(4))
+    assert queue.purge("t", 0) == 4
+    # The freed slots are usable again, and the survivors still come first.
+    assert queue.push("t", 0, range(4, 8)) == 4
+    assert drain(queue) == [("t", 1, offset) for offset in range(4)] + [("t", 0, offset) for offset in range(4, 8)]
+
+
+def test_fence_drops_only_older_messages_of_the_partition(queue):
+    queue.push("t", 0, [0, 1, 2])
+    queue.push("t", 1, [0, 1])
+    queue.push("u", 0, [0])
+    queue.fence("t", 0)
+    queue.push("t", 0, [10, 11])
+    assert drain(queue) == [("t", 1, 0), ("t", 1, 1), ("u", 0, 0), ("t", 0, 10), ("t", 0, 11)]
+    # Fenced-off messages have left the queue too.
+    assert queue.drained() == 8
+    assert queue.size() == 0
+
+
+def test_fence_with_nothing_queued(queue):
+    queue.fence("t", 0)
+    queue.push("t", 0, [5])
+    assert drain(queue) == [("t", 0, 5)]
+
+
+def test_fences_stack(queue):
+    queue.push("t", 0, [0])
+    queue.fence("t", 0)
+    queue.push("t", 0, [1])
+    queue.push("t", 1, [0])
+    queue.fence("t", 0)
+    queue.fence("t", 1)
+    queue.push("t", 0, [2])
+    assert drain(queue) == [("t", 0, 2)]
+
+
+def test_fence_is_retired_once_passed(queue):
+    queue.push("t", 0, [0, 1])
+    queue.fence("t", 0)
+    assert drain(queue) == []
+    # A new push after the fence was passed must not be mistaken for stale.
+    queue.push("t", 0, [2, 3])
+    assert drain(queue) == [("t", 0, 2), ("t", 0, 3)]
+
+
+def test_purge_behind_a_fence(queue):
+    queue.push("t", 0, [0, 1])
+    queue.push("t", 1, [0, 1])
+    queue.fence("t", 0)
+    queue.push("t", 0, [2])
+    queue.purge("t", 1)
+    # Compacting the ring must not let stale messages slide past the fence.
+    assert drain(queue) == [("t", 0, 2)]
+    queue.push("t", 0, [3])
+    assert drain(queue) == [("t", 0, 3)]
+
+
+def test_wraparound_with_fences():
+    queue = _testing.Queue(8)
+    expected = []
+    popped = []
+    for round in range(10):
+        queue.push("t", 0, [round * 10, round * 10 + 1])
+        queue.push("t", 1, [round * 10 + 2])
+        if round % 3 == 0:
+            queue.fence("t", 0)
+        else:
+            expected += [("t", 0, round * 10), ("t", 0, round * 10 + 1)]
+        expected.append(("t", 1, round * 10 + 2))
+        popped += drain(queue)
+    assert popped == expected
+
+
+def test_destroy_with_a_fence_frees_queued_messages():
+    live = _testing.live_messages()
+    queue = _testing.Queue(16)
+    queue.push("t", 0, range(10))
+    queue.fence("t", 0)
+    assert _testing.live_messages() == live + 10
+    del queue
+    assert _testing.live_messages() == live
+
+
+def test_purged_messages_count_as_drained(queue):
+    queue.push("t", 0, range(4))
+    queue.push("t", 1, range(3))
+    queue.purge("t", 1)
+    assert queue.drained() == 3
+    drain(queue)
+    assert queue.drained() == 7